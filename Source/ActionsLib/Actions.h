@@ -50,6 +50,8 @@ template <typename ElemType>
 void DoCrossValidate(const ConfigParameters& config);
 template <typename ElemType>
 void DoWriteOutput(const ConfigParameters& config);
+template <typename ElemType>
+void DoBeamSearch(const ConfigParameters& config);
 
 // misc (OtherActions.cpp)
 template <typename ElemType>
@@ -57,7 +59,11 @@ void DoCreateLabelMap(const ConfigParameters& config);
 template <typename ElemType>
 void DoParameterSVD(const ConfigParameters& config);
 template <typename ElemType>
+void DoParameterPruning(const ConfigParameters& config);
+template <typename ElemType>
 void DoWriteWordAndClassInfo(const ConfigParameters& config);
+void CountWords(const string& inputFile, const string& beginSequence, const string& endSequence, size_t numThreads,
+                unordered_map<string, double>& counts); // the word counting of DoWriteWordAndClassInfo()
 template <typename ElemType>
 void DoTopologyPlot(const ConfigParameters& config);
 
@@ -17,6 +17,7 @@
 #include "Config.h"
 #include "SimpleEvaluator.h"
 #include "SimpleOutputWriter.h"
+#include "BeamSearchDecoder.h"
 #include "BestGpu.h"
 #include "ScriptableObjects.h"
 #include "BrainScriptEvaluator.h"
@@ -225,7 +226,8 @@ void DoWriteOutput(const ConfigParameters& config)
 
     auto net = GetModelFromConfig<ConfigParameters, ElemType>(config, outputNodeNamesVector);
 
-    SimpleOutputWriter<ElemType> writer(net, 1);
+    size_t outputQueueDepth = config(L"outputQueueDepth", (size_t) 4);
+    SimpleOutputWriter<ElemType> writer(net, 1, outputQueueDepth);
 
     if (config.Exists("writer"))
     {
@@ -261,6 +263,7 @@ void DoWriteOutput(const ConfigParameters& config)
             formattingOptions.elementSeparator  = formatConfig(L"elementSeparator",  formattingOptions.elementSeparator);
             formattingOptions.sampleSeparator   = formatConfig(L"sampleSeparator",   formattingOptions.sampleSeparator);
             formattingOptions.precisionFormat   = formatConfig(L"precisionFormat",   formattingOptions.precisionFormat);
+            formattingOptions.binary            = formatConfig(L"binary",            formattingOptions.binary);
         }
 
         bool nodeUnitTest = config(L"nodeUnitTest", "false");
@@ -273,3 +276,46 @@ void DoWriteOutput(const ConfigParameters& config)
 
 template void DoWriteOutput<float>(const ConfigParameters& config);
 template void DoWriteOutput<double>(const ConfigParameters& config);
+
+// ===========================================================================
+// DoBeamSearch() - implements CNTK "beamSearch" command
+// ===========================================================================
+
+template <typename ElemType>
+void DoBeamSearch(const ConfigParameters& config)
+{
+    ConfigParameters readerConfig(config(L"reader"));
+    readerConfig.Insert("traceLevel", config(L"traceLevel", "0"));
+    readerConfig.Insert("randomize", "None"); // we don't want randomization when output results
+
+    DataReader testDataReader(readerConfig);
+
+    DEVICEID_TYPE deviceId = DeviceFromConfig(config);
+    ConfigArray minibatchSize = config(L"minibatchSize", "2048");
+    intargvector mbSize = minibatchSize;
+
+    size_t epochSize = config(L"epochSize", "0");
+    if (epochSize == 0)
+    {
+        epochSize = requestDataSize;
+    }
+
+    wstring modelPath = config(L"modelPath");
+    wstring outputPath = config(L"outputPath");
+    wstring labelMappingFile = config(L"labelMappingFile", L"");
+    wstring tokenInputNodeName = config(L"tokenInputNodeName");
+    wstring outputNodeName = config(L"outputNodeName");
+    size_t beamWidth = config(L"beamWidth", (size_t) 5);
+    size_t maxLength = config(L"maxLength", (size_t) 100);
+    size_t endSymbol = config(L"endSymbol");
+    size_t numBest = config(L"numBest", (size_t) 1);
+    int traceLevel = config(L"traceLevel", "0");
+
+    auto net = ComputationNetwork::CreateFromFile<ElemType>(deviceId, modelPath);
+
+    BeamSearchDecoder<ElemType> decoder(net, tokenInputNodeName, outputNodeName, beamWidth, maxLength, endSymbol, numBest, traceLevel);
+    decoder.Decode(testDataReader, mbSize[0], outputPath, labelMappingFile, epochSize);
+}
+
+template void DoBeamSearch<float>(const ConfigParameters& config);
+template void DoBeamSearch<double>(const ConfigParameters& config);
@@ -26,6 +26,10 @@
 #include <set>
 #include <memory>
 #include <map>
+#include <unordered_map>
+#include <future>
+#include <thread>
+#include <cstring>
 
 #ifndef let
 #define let const auto
@@ -202,6 +206,55 @@ void DoParameterSVD(const ConfigParameters& config)
 template void DoParameterSVD<float>(const ConfigParameters& config);
 template void DoParameterSVD<double>(const ConfigParameters& config);
 
+// ===========================================================================
+// DoParameterPruning() - implements CNTK "prune" command
+// ===========================================================================
+
+// Prunes the weight matrices of a model to one or more sparsity levels. For each level, the speed of a forward pass
+// and the largest relative output deviation from the unpruned model are reported, both measured on a random minibatch.
+// With a single level, the pruned model is written to outputModelPath; with several, to outputModelPath.<percent> each.
+template <typename ElemType>
+void DoParameterPruning(const ConfigParameters& config)
+{
+    wstring modelPath = config(L"modelPath");
+    wstring outputModelPath = config(L"outputModelPath", L"");
+    wstring nodeNameRegex = config(L"nodeNameRegex", L"");
+    ConfigArray sparsityConfig = config(L"sparsity", "0.8");
+    floatargvector sparsityLevels = sparsityConfig;
+    size_t numSamples = config(L"numSamples", (size_t) 256);
+    double minSparseSpeedup = config(L"minSparseSpeedup", 1.0); // store a pruned matrix as sparse if its product is this much faster (0: always)
+
+    // pruning is done on the CPU, where the sparse kernels are chosen by speed
+    ComputationNetworkPtr refNet = ComputationNetwork::CreateFromFile<ElemType>(CPUDEVICE, modelPath);
+    for (size_t k = 0; k < sparsityLevels.size(); k++)
+    {
+        float sparsity = sparsityLevels[k];
+        fprintf(stderr, "\nPruning %ls to sparsity %.1f%%.\n", modelPath.c_str(), 100.0 * sparsity);
+        ComputationNetworkPtr net = ComputationNetwork::CreateFromFile<ElemType>(CPUDEVICE, modelPath);
+        size_t numPruned = net->PruneParameters<ElemType>(sparsity, nodeNameRegex, numSamples, minSparseSpeedup);
+
+        double seconds, refSeconds;
+        double deviation = ComputationNetwork::MaxOutputDeviation<ElemType>(net, refNet, numSamples, 1, &seconds, &refSeconds);
+        if (deviation < 0)
+            fprintf(stderr, "Sparsity %.1f%%: %d weight matrices pruned (network cannot be evaluated on random dense input).\n", 100.0 * sparsity, (int) numPruned);
+        else
+            fprintf(stderr, "Sparsity %.1f%%: %d weight matrices pruned, forward pass of %d samples %.3f ms (unpruned %.3f ms, speed-up %.2fx), max relative output deviation %.8g.\n",
+                    100.0 * sparsity, (int) numPruned, (int) numSamples, 1000 * seconds, 1000 * refSeconds, refSeconds / seconds, deviation);
+
+        if (!outputModelPath.empty())
+        {
+            wstring path = outputModelPath;
+            if (sparsityLevels.size() > 1)
+                path += L"." + to_wstring((int) (100 * sparsity + 0.5f));
+            net->Save(path);
+            fprintf(stderr, "Pruned model written to %ls.\n", path.c_str());
+        }
+    }
+}
+
+template void DoParameterPruning<float>(const ConfigParameters& config);
+template void DoParameterPruning<double>(const ConfigParameters& config);
+
 // ===========================================================================
 // DoWriteWordAndClassInfo() - implements CNTK "writeWordAndClass" command
 // ===========================================================================
@@ -221,6 +274,161 @@ struct compare_second
     }
 };
 
+// Word counts of one shard of the training text. Each distinct word is interned once; tokens are counted by id.
+// Ids are assigned in order of first occurrence, which lets the merged counts preserve the order of a single pass.
+class WordCountShard
+{
+    unordered_map<string, size_t> m_index; // word -> id
+    vector<const string*> m_words;          // id -> word (keys of m_index, which are stable)
+    vector<size_t> m_counts;                // id -> count
+    size_t m_numTokens;
+    string m_token;                         // buffer to look up tokens without allocating
+    const string& m_beginSequence;
+    const string& m_endSequence;
+    const string m_beginSequencePattern;
+    const string m_endSequencePattern;
+
+    void CountToken(const string& str, size_t begin, size_t end)
+    {
+        m_token.assign(str, begin, end - begin);
+        auto iter = m_index.find(m_token);
+        if (iter == m_index.end())
+        {
+            iter = m_index.insert(make_pair(m_token, m_counts.size())).first;
+            m_words.push_back(&iter->first);
+            m_counts.push_back(0);
+        }
+        m_counts[iter->second]++;
+        m_numTokens++;
+    }
+
+    // process one line the way DoWriteWordAndClassInfo() always has
+    void CountLine(string& str)
+    {
+        str.erase(0, str.find_first_not_of(' ')); // prefixing spaces
+        str.erase(str.find_last_not_of(' ') + 1); // surfixing spaces
+
+        if (!m_beginSequence.empty() && str.find(m_beginSequencePattern) == str.npos)
+            str.insert(0, m_beginSequencePattern);
+
+        if (!m_endSequence.empty() && str.find(m_endSequencePattern) == str.npos)
+            str.append(m_endSequencePattern);
+
+        // same tokens as msra::strfun::split(str, "\t "); the first token is not counted
+        size_t i = 0;
+        for (size_t st = str.find_first_not_of("\t "); st != str.npos; i++)
+        {
+            size_t en = str.find_first_of("\t ", st + 1);
+            if (en == str.npos)
+                en = str.length();
+            if (i > 0)
+                CountToken(str, st, en);
+            st = str.find_first_not_of("\t ", en + 1);
+        }
+    }
+
+public:
+    WordCountShard(const string& beginSequence, const string& endSequence)
+        : m_numTokens(0), m_beginSequence(beginSequence), m_endSequence(endSequence), m_beginSequencePattern(beginSequence + " "), m_endSequencePattern(" " + endSequence)
+    {
+    }
+
+    // count the lines that begin within the byte range [begin, end) of the file
+    void CountLines(const string& inputFile, uint64_t begin, uint64_t end)
+    {
+        FILE* f = fopenOrDie(inputFile, "rb");
+        uint64_t pos = begin > 0 ? begin - 1 : 0; // a line begins at 'begin' only if the byte before it is a newline
+        fsetpos(f, pos);
+        bool inLine = begin == 0;                 // false while skipping the tail of the previous shard's last line
+        bool done = begin >= end;
+        string line;
+        vector<char> buffer(1 << 20);
+        while (!done)
+        {
+            size_t n = fread(buffer.data(), 1, buffer.size(), f);
+            if (n == 0)
+                break;
+            for (const char* p = buffer.data(), *pend = p + n; p < pend && !done;)
+            {
+                const char* eol = (const char*) memchr(p, '\n', pend - p);
+                if (!eol) // line continues in next buffer
+                {
+                    if (inLine)
+                        line.append(p, pend);
+                    break;
+                }
+                if (inLine)
+                {
+                    line.append(p, eol);
+#ifdef _WIN32
+                    if (!line.empty() && line.back() == '\r') // the ifstream we used to read with was in text mode
+                        line.pop_back();
+#endif
+                    CountLine(line);
+                    line.clear();
+                }
+                inLine = true;
+                p = eol + 1;
+                done = pos + (p - buffer.data()) >= end; // next line belongs to the next shard
+            }
+            pos += n;
+        }
+        if (!done && inLine && !line.empty()) // last line without newline
+            CountLine(line);
+        fclose(f);
+    }
+
+    // add the counts into the overall table; shards must be merged in file order
+    void MergeInto(unordered_map<string, double>& counts) const
+    {
+        for (size_t id = 0; id < m_words.size(); id++)
+            counts[*m_words[id]] += m_counts[id];
+    }
+
+    size_t GetNumTokens() const { return m_numTokens; }
+};
+
+// Counts the words of the training text in parallel. The file is split into byte ranges at line boundaries, one per thread.
+// Since each shard lists its words in order of first occurrence, merging the shards in file order inserts the words into
+// 'counts' in the same order as counting the file in a single pass. Hence the hash table iterates in the same order, and
+// the sorting by count below breaks ties in the same way as before.
+void CountWords(const string& inputFile, const string& beginSequence, const string& endSequence, size_t numThreads,
+                unordered_map<string, double>& counts)
+{
+    FILE* f = fopen(inputFile.c_str(), "rb"); // TODO: use class File, as to support pipes
+    if (!f)
+        RuntimeError("Failed to open input file: %s", inputFile.c_str());
+    uint64_t fileSize = filesize(f);
+    fclose(f);
+    cerr << "Reading input file inputFile: " << inputFile << endl;
+
+    const uint64_t minShardSize = 1 << 20; // not worth a thread below this
+    if (numThreads == 0)
+        numThreads = max(thread::hardware_concurrency(), 1u);
+    size_t numShards = (size_t) max(min((uint64_t) numThreads, fileSize / minShardSize), (uint64_t) 1);
+
+    auto startTime = chrono::steady_clock::now();
+    vector<unique_ptr<WordCountShard>> shards;
+    vector<future<void>> pending;
+    for (size_t k = 0; k < numShards; k++)
+    {
+        shards.push_back(make_unique<WordCountShard>(beginSequence, endSequence));
+        WordCountShard* shard = shards.back().get();
+        uint64_t begin = fileSize * k / numShards, end = fileSize * (k + 1) / numShards;
+        pending.push_back(async(launch::async, [shard, &inputFile, begin, end]() { shard->CountLines(inputFile, begin, end); }));
+    }
+    size_t numTokens = 0;
+    for (size_t k = 0; k < numShards; k++)
+    {
+        pending[k].get(); // (rethrows errors from the shard)
+        shards[k]->MergeInto(counts);
+        numTokens += shards[k]->GetNumTokens();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+    fprintf(stderr, "Counted %llu tokens with %d threads in %.3f seconds (%.0f tokens/s).\n",
+            (unsigned long long) numTokens, (int) numShards, seconds, seconds > 0 ? numTokens / seconds : 0.0);
+}
+
 // This converts the training text file into a special format that encodes class information.
 //
 // The outputs are the vocabulary, word2class and class2idx file with the information below:
@@ -291,39 +499,14 @@ void DoWriteWordAndClassInfo(const ConfigParameters& config)
     Matrix<ElemType> wrd2cls(CPUDEVICE);
     Matrix<ElemType> cls2idx(CPUDEVICE);
 
-    ifstream fp(inputFile.c_str()); // TODO: use class File, as to support pipes
-    if (!fp)
-        RuntimeError("Failed to open input file: %s", inputFile.c_str());
-    cerr << "Reading input file inputFile: " << inputFile << endl;
-
     if (nbrCls > 0)
         cls2idx.Resize(nbrCls, 1);
 
+    // count the words; each line is padded with beginSequence and endSequence unless it contains them, and its first token is skipped
     unordered_map<string, double> v_count;
-
-    // process input line by line
-    string str;
-    vector<string> vstr;
     long long prevClsIdx = -1;
-    string token;
-    const string beginSequencePattern = beginSequence + " ";
-    const string endSequencePattern   = " " + endSequence;
-    while (getline(fp, str))
-    {
-        str.erase(0, str.find_first_not_of(' ')); // prefixing spaces
-        str.erase(str.find_last_not_of(' ') + 1); // surfixing spaces
-
-        if (!beginSequence.empty() && str.find(beginSequencePattern) == str.npos)
-            str = beginSequencePattern + str;
-
-        if (!endSequence.empty() && str.find(endSequencePattern) == str.npos)
-            str = str + endSequencePattern;
-
-        vstr = msra::strfun::split(str, "\t ");
-        for (int i = 1; i < vstr.size(); i++)
-            v_count[vstr[i]]++;
-    }
-    fp.close();
+    size_t numThreads = config(L"numThreads", (size_t) 0); // 0 means one per hardware thread
+    CountWords(inputFile, beginSequence, endSequence, numThreads, v_count);
 
     cerr << "Vocabulary size " << v_count.size() << ".\n";
 
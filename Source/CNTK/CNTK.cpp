@@ -168,6 +168,10 @@ void DoCommands(const ConfigParameters& config, const shared_ptr<MPIWrapper>& mp
         std::cerr << "Using " << numCPUThreads << " CPU threads." << endl;
     }
 
+    bool numaAffinity = config(L"numaAffinity", false);
+    if (numaAffinity)
+        CPUMatrix<ElemType>::SetNumaAffinity(true);
+
     bool progressTracing = config(L"progressTracing", false);
 
     // temporary hack to prevent users from failing due to a small breaking change related to the "truncated" flag (will be redone bigger and better some day)
@@ -260,6 +264,10 @@ void DoCommands(const ConfigParameters& config, const shared_ptr<MPIWrapper>& mp
                 {
                     DoWriteOutput<ElemType>(commandParams);
                 }
+                else if (thisAction == "beamSearch")
+                {
+                    DoBeamSearch<ElemType>(commandParams);
+                }
                 else if (thisAction == "devtest")
                 {
                     TestCn<ElemType>(config); // for "devtest" action pass the root config instead
@@ -292,6 +300,10 @@ void DoCommands(const ConfigParameters& config, const shared_ptr<MPIWrapper>& mp
                 {
                     DoParameterSVD<ElemType>(commandParams);
                 }
+                else if (thisAction == "prune")
+                {
+                    DoParameterPruning<ElemType>(commandParams);
+                }
                 else
                 {
                     RuntimeError("unknown action: %s  in command set: %s", thisAction.c_str(), command[i].c_str());
@@ -498,6 +510,9 @@ int wmainWithBS(int argc, wchar_t* argv[]) // called from wmain which is a wrapp
     numCPUThreads = CPUMatrix<float /*any will do*/>::SetNumThreads(numCPUThreads);
     if (numCPUThreads > 0)
         fprintf(stderr, "Using %d CPU threads.\n", numCPUThreads);
+    bool numaAffinity = config(L"numaAffinity", false);
+    if (numaAffinity)
+        CPUMatrix<float /*any will do*/>::SetNumaAffinity(true);
 
     bool progressTracing = config(L"progressTracing", false);
     size_t fullTotalMaxEpochs = 1; // BUGBUG: BS does not allow me to read out the max epochs parameters, as that would instantiate and thus execute the objects
@@ -657,6 +657,23 @@ void MELScript<ElemType>::CallFunction(const std::string& p_name, const ConfigPa
             netNdlFrom->cn->RenameNode(node, nodeName.second);
         }
     }
+    else if (EqualInsensitive(name, "FoldNormalization"))
+    {
+        size_t numFixedParams = 1, numOptionalParams = 1;
+        if (params.size() > numFixedParams + numOptionalParams || params.size() < numFixedParams)
+            RuntimeError("Invalid number of parameters. Valid parameters: FoldNormalization(modelName, [verify=true|false])");
+
+        bool verify = GetOptionalVerifyValue(params, numFixedParams);
+
+        std::string modelName = params[0];
+        auto found = m_mapNameToNetNdl.find(modelName);
+        if (found == m_mapNameToNetNdl.end() || found->second.cn == NULL)
+            RuntimeError("FoldNormalization: Model %s does not exist.", modelName.c_str());
+
+        NetNdl<ElemType>* netNdl = &found->second;
+        ProcessNDLScript(netNdl, ndlPassAll, true);
+        netNdl->cn->template FoldNormalizationIntoParameters<ElemType>(verify);
+    }
     else if (EqualInsensitive(name, "ReviseParameter"))
     {
         typedef LearnableParameter<ElemType> LearnableParameterNode;
@@ -437,6 +437,28 @@ public:
 
         return includeData;
     }
+    bool GetOptionalVerifyValue(const ConfigParamList& params, const size_t numFixedParams)
+    {
+        bool verify = true;
+        for (size_t paramNumber = params.size(); paramNumber > numFixedParams; paramNumber--)
+        {
+            // process optional parameter if it exists
+            std::string propName, value;
+            if (OptionalParameter(params[paramNumber - 1], propName, value))
+            {
+                if (EqualInsensitive(propName, "verify"))
+                {
+                    verify = ConfigValue(value);
+                }
+                else
+                {
+                    RuntimeError("Invalid optional parameter %s, valid optional parameters: verify=(false|true)", propName.c_str());
+                }
+            }
+        }
+
+        return verify;
+    }
     wstring GetOptionalModelFormat(const ConfigParamList& params, const size_t numFixedParams)
     {
         wstring modelFormat = L"cntk"; // default
@@ -138,6 +138,45 @@ void Eval<ElemType>::Evaluate(std::map<std::wstring, std::vector<ElemType>*>& ou
     m_eval->Evaluate(outputs);
 }
 
+// BeamSearch - continue each prompt by beam search, decoding all prompts together as one batch
+// prompts - token ids of each prompt
+// nbest - for each prompt, the best continuations and their log probabilities, best first
+template <class ElemType>
+void Eval<ElemType>::BeamSearch(const std::vector<std::vector<size_t>>& prompts, std::vector<std::vector<std::pair<std::vector<size_t>, double>>>& nbest)
+{
+    m_eval->BeamSearch(prompts, nbest);
+}
+
+// EvaluateChunk - streaming evaluation of recurrent models: evaluate the next chunk of frames of several streams as one minibatch
+// inputs - map from stream id to map from node name to the chunk's input frames; a new stream id starts a new stream
+// outputs - map from stream id to map from node name to output vector, sized during evaluation to the chunk's output frames
+template <class ElemType>
+void Eval<ElemType>::EvaluateChunk(std::map<size_t, std::map<std::wstring, std::vector<ElemType>*>>& inputs, std::map<size_t, std::map<std::wstring, std::vector<ElemType>*>>& outputs)
+{
+    m_eval->EvaluateChunk(inputs, outputs);
+}
+
+// EndStream - release the state of a stream
+template <class ElemType>
+void Eval<ElemType>::EndStream(size_t streamId)
+{
+    m_eval->EndStream(streamId);
+}
+
+// ExportStreamState - get the state of a stream after its last chunk, as map from PastValue node name to state vector
+template <class ElemType>
+void Eval<ElemType>::ExportStreamState(size_t streamId, std::map<std::wstring, std::vector<ElemType>>& state)
+{
+    m_eval->ExportStreamState(streamId, state);
+}
+
+// ImportStreamState - continue a stream from a state obtained from ExportStreamState()
+template <class ElemType>
+void Eval<ElemType>::ImportStreamState(size_t streamId, const std::map<std::wstring, std::vector<ElemType>>& state)
+{
+    m_eval->ImportStreamState(streamId, state);
+}
+
 // ResetState - Reset the cell state when we get the start of an utterance
 template <class ElemType>
 void Eval<ElemType>::ResetState()
@@ -49,6 +49,11 @@ public:
     virtual void Evaluate(std::map<std::wstring, std::vector<ElemType>*>& inputs, std::map<std::wstring, std::vector<ElemType>*>& outputs) = 0;
     virtual void Evaluate(std::map<std::wstring, std::vector<ElemType>*>& outputs) = 0;
     virtual void ResetState() = 0;
+    virtual void BeamSearch(const std::vector<std::vector<size_t>>& prompts, std::vector<std::vector<std::pair<std::vector<size_t>, double>>>& nbest) = 0;
+    virtual void EvaluateChunk(std::map<size_t, std::map<std::wstring, std::vector<ElemType>*>>& inputs, std::map<size_t, std::map<std::wstring, std::vector<ElemType>*>>& outputs) = 0;
+    virtual void EndStream(size_t streamId) = 0;
+    virtual void ExportStreamState(size_t streamId, std::map<std::wstring, std::vector<ElemType>>& state) = 0;
+    virtual void ImportStreamState(size_t streamId, const std::map<std::wstring, std::vector<ElemType>>& state) = 0;
 };
 
 // GetEval - get a evaluator type from the DLL
@@ -105,6 +110,28 @@ public:
     // outputs - map from node name to output vector, outputs vectors need to be preallocated by caller, sizing will happen during evaluation
     virtual void Evaluate(std::map<std::wstring, std::vector<ElemType>*>& outputs);
 
+    // BeamSearch - continue each prompt by beam search, decoding all prompts together as one batch
+    // prompts - token ids of each prompt, fed one-hot into the token input node
+    // nbest - for each prompt, the best continuations (token ids without the end symbol) and their log probabilities, best first
+    // The decoder is configured in the config passed to Init(): tokenInputNodeName, outputNodeName, endSymbol, beamWidth=5, maxLength=100, numBest=1
+    virtual void BeamSearch(const std::vector<std::vector<size_t>>& prompts, std::vector<std::vector<std::pair<std::vector<size_t>, double>>>& nbest);
+
+    // EvaluateChunk - streaming evaluation of recurrent models: evaluate the next chunk of frames of several streams as one minibatch
+    // inputs - map from stream id to map from node name to the chunk's input frames; a new stream id starts a new stream
+    // outputs - map from stream id to map from node name to output vector, sized during evaluation to the chunk's output frames
+    // The state of each stream (PastValue nodes) is carried over from its previous chunk, without re-evaluating earlier frames.
+    virtual void EvaluateChunk(std::map<size_t, std::map<std::wstring, std::vector<ElemType>*>>& inputs, std::map<size_t, std::map<std::wstring, std::vector<ElemType>*>>& outputs);
+
+    // EndStream - release the state of a stream
+    virtual void EndStream(size_t streamId);
+
+    // ExportStreamState - get the state of a stream after its last chunk
+    // state - map from PastValue node name to its state vector
+    virtual void ExportStreamState(size_t streamId, std::map<std::wstring, std::vector<ElemType>>& state);
+
+    // ImportStreamState - continue a stream from a state obtained from ExportStreamState(), e.g. from another evaluator
+    virtual void ImportStreamState(size_t streamId, const std::map<std::wstring, std::vector<ElemType>>& state);
+
     virtual void Init(const std::string& config);
     virtual void ResetState();
 };
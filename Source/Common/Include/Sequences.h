@@ -11,6 +11,7 @@
 #include "Matrix.h"
 #include <vector>
 #include <memory> // for shared_ptr
+#include <algorithm> // for sort
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -126,6 +127,7 @@ struct MBLayout
         m_timeStepHasGap = other->m_timeStepHasGap;
 
         m_columnsValidityMask.SetValue(other->m_columnsValidityMask);
+        m_validColumnIndices = other->m_validColumnIndices;
         m_writable = other->m_writable;
     }
 
@@ -149,6 +151,7 @@ struct MBLayout
         m_timeStepHasGap = std::move(other->m_timeStepHasGap);
 
         m_columnsValidityMask = std::move(other->m_columnsValidityMask);
+        m_validColumnIndices = std::move(other->m_validColumnIndices);
         m_writable = other->m_writable;
     }
 
@@ -168,6 +171,7 @@ public:
         m_distanceToNearestEnd.assign(m_numTimeSteps, PTRDIFF_MAX);
         m_timeStepHasGap.assign(m_numTimeSteps, false);
         m_columnsValidityMask.Resize(0, 0); // invalidate
+        m_validColumnIndices.clear();
         // reset state
         m_numFramesDeclared = 0;
         m_numGapFrames = 0;
@@ -183,7 +187,7 @@ public:
     template<typename SequenceInfoVector>
     void InitAsPackedSequences(const SequenceInfoVector& inputSequences,
         /*temp buffer*/std::vector<std::pair<size_t, size_t>>& placement,
-        /*temp buffer*/std::vector<size_t> rowAllocations)
+        /*temp buffer*/std::vector<size_t>& rowAllocations)
     {
         placement.resize(inputSequences.size()); // [sequence index] result goes here (entries are invalid for gaps)
         // determine width of MBLayout
@@ -262,6 +266,10 @@ public:
 
     const Matrix<char>& GetColumnsValidityMask(DEVICEID_TYPE deviceId) const;
 
+    // matrix-column indices of all non-gap frames, in increasing order
+    // Used to compute on a compacted copy of the minibatch instead of the full [S x T] grid.
+    const vector<size_t>& GetValidColumnIndices() const;
+
     // compare whether two layouts are the same
     bool operator==(const MBLayout &other) const
     {
@@ -420,6 +428,13 @@ public:
     bool IsBeyondStartOrEnd(const FrameRange &fr) const;
     bool IsGap(const FrameRange &fr) const;
 
+    // test whether all parallel sequences have a gap at time step t, i.e. the time step holds no data at all
+    bool IsAllGaps(size_t t) const
+    {
+        CheckIsValid();
+        return m_distanceToNearestStart[t] == PTRDIFF_MAX; // only set by non-gap sequences
+    }
+
     // test whether at least one sequence crosses the bounds of this minibatch
     bool HasSequenceBeyondBegin() const
     {
@@ -526,6 +541,9 @@ private:
     // and 0 indicates invalid (aka MinibatchPackingFlags::NoInput)
     mutable Matrix<char> m_columnsValidityMask;
 
+    // Cached sorted column indices of the non-gap frames, lazily created by GetValidColumnIndices().
+    mutable vector<size_t> m_validColumnIndices;
+
     // A boolean flag indicating whether the MBLayout can be further modified
     // When it's value is false, no set operations are allowed on the MBLayout.
     // Meant to guard in lazy creation of m_columnsValidityMask.
@@ -834,6 +852,32 @@ inline const Matrix<char> &MBLayout::GetColumnsValidityMask(DEVICEID_TYPE device
     return m_columnsValidityMask;
 }
 
+// return m_validColumnIndices, which is lazily created here upon first call
+inline const vector<size_t>& MBLayout::GetValidColumnIndices() const
+{
+    CheckIsValid();
+    if (m_validColumnIndices.empty())
+    {
+        Lock();
+
+        const size_t nT = GetNumTimeSteps();
+        const size_t nS = GetNumParallelSequences();
+        m_validColumnIndices.reserve(GetActualNumSamples());
+        for (const auto& seq : m_sequences)
+        {
+            if (seq.seqId == GAP_SEQUENCE_ID)
+                continue;
+            size_t b = (size_t)(max(seq.tBegin, (ptrdiff_t) 0));
+            size_t e = min(seq.tEnd, nT);
+            for (size_t t = b; t < e; t++)
+                m_validColumnIndices.push_back(t * nS + seq.s);
+        }
+        sort(m_validColumnIndices.begin(), m_validColumnIndices.end()); // keep the column order of the original minibatch
+        assert(m_validColumnIndices.size() == GetActualNumSamples()); // sanity check
+    }
+    return m_validColumnIndices;
+}
+
 // class for defining an iteration over a sequence, forward and backward
 // One day, we may also have nested structures. For those, FrameRangeIterations will be able to be instantiated from FrameRange objects to loop over their nested dimension.
 class FrameRangeIteration
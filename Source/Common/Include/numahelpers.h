@@ -10,6 +10,15 @@
 #ifndef __unix__
 #include <Windows.h>
 #include "pplhelpers.h"
+#else
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <string>
 #endif
 #include <stdexcept>
 #include "simple_checked_arrays.h"
@@ -26,6 +35,224 @@ static inline void overridenode(int n = -1)
     node_override = n;
 }
 
+#ifdef __unix__
+// ---------------------------------------------------------------------------
+// Linux implementation, based on the topology exposed under /sys/devices/system/node.
+// No dependency on libnuma; placement beyond first-touch uses the raw mbind() syscall.
+// ---------------------------------------------------------------------------
+
+// parse a sysfs cpu list such as "0-3,8-11" into individual ids
+static inline std::vector<size_t> parsecpulist(const char *s)
+{
+    std::vector<size_t> ids;
+    while (*s && *s != '\n')
+    {
+        char *end;
+        size_t first = strtoul(s, &end, 10);
+        size_t last = first;
+        if (end == s)
+            break;
+        if (*end == '-')
+        {
+            s = end + 1;
+            last = strtoul(s, &end, 10);
+        }
+        for (size_t i = first; i <= last; i++)
+            ids.push_back(i);
+        s = (*end == ',') ? end + 1 : end;
+    }
+    return ids;
+}
+
+// read the first line of a sysfs file; returns empty string if it does not exist
+static inline std::string readsysfsline(const std::string &path)
+{
+    std::string line;
+    FILE *f = fopen(path.c_str(), "r");
+    if (f == NULL)
+        return line;
+    char buf[4096];
+    if (fgets(buf, sizeof(buf), f))
+        line = buf;
+    fclose(f);
+    return line;
+}
+
+// get the number of NUMA nodes we would like to distinguish
+static inline size_t getnumnodes()
+{
+    static size_t numnodes = 0; // topology does not change while we run
+    if (numnodes == 0)
+    {
+        std::vector<size_t> nodes = parsecpulist(readsysfsline("/sys/devices/system/node/online").c_str());
+        numnodes = nodes.empty() ? 1 : nodes.back() + 1;
+    }
+    return numnodes;
+}
+
+// get the list of logical CPUs that belong to a NUMA node
+static inline std::vector<size_t> getnodecpus(size_t node)
+{
+    std::vector<size_t> cpus = parsecpulist(readsysfsline("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist").c_str());
+    if (cpus.empty() && getnumnodes() == 1) // no NUMA information exposed: all CPUs form one node
+    {
+        for (long i = 0; i < sysconf(_SC_NPROCESSORS_CONF); i++)
+            cpus.push_back((size_t) i);
+    }
+    return cpus;
+}
+
+// get the current NUMA node
+static inline size_t getcurrentnode()
+{
+    // we can force it to be a certain node, for use in initializations
+    if (node_override >= 0)
+        return (size_t) node_override;
+    // actually use current node
+    unsigned int cpu = 0, node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0)
+        return 0;
+    return node;
+}
+
+// the CPUs we were allowed to run on before any binding (e.g. restricted by taskset, a cgroup cpuset, or numactl)
+// Captured by the first call, which bindcurrentthreadtonode() makes before it changes anything.
+static inline const cpu_set_t &getinitialaffinitymask()
+{
+    static const cpu_set_t initialmask = []()
+    {
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        if (sched_getaffinity(0, sizeof(mask), &mask) != 0)
+        {
+            for (long i = 0; i < sysconf(_SC_NPROCESSORS_CONF) && i < CPU_SETSIZE; i++)
+                CPU_SET(i, &mask);
+        }
+        return mask;
+    }();
+    return initialmask;
+}
+
+// get the CPUs of a NUMA node that we are allowed to run on
+static inline cpu_set_t getallowednodemask(size_t node)
+{
+    const cpu_set_t &initialmask = getinitialaffinitymask();
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    for (size_t cpu : getnodecpus(node))
+        if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &initialmask))
+            CPU_SET(cpu, &mask);
+    return mask;
+}
+
+// whether we are allowed to run on at least one CPU of a NUMA node
+static inline bool isnodeallowed(size_t node)
+{
+    cpu_set_t mask = getallowednodemask(node);
+    return CPU_COUNT(&mask) > 0;
+}
+
+// restrict the calling thread to the CPUs of one NUMA node (within those it was initially allowed to use)
+// Subsequent first-touch allocations by this thread will be placed on that node.
+static inline bool bindcurrentthreadtonode(size_t node)
+{
+    cpu_set_t mask = getallowednodemask(node);
+    if (CPU_COUNT(&mask) == 0)
+        return false;
+    return sched_setaffinity(0, sizeof(mask), &mask) == 0;
+}
+
+// undo bindcurrentthreadtonode(), restoring the affinity the process started with
+static inline void unbindcurrentthread()
+{
+    cpu_set_t mask = getinitialaffinitymask();
+    sched_setaffinity(0, sizeof(mask), &mask);
+}
+
+// number of free bytes on a node as reported by its meminfo, 0 if unknown
+static inline size_t getavailablebytes(size_t node)
+{
+    FILE *f = fopen(("/sys/devices/system/node/node" + std::to_string(node) + "/meminfo").c_str(), "r");
+    if (f == NULL)
+        return 0;
+    size_t availkb = 0;
+    char buf[256];
+    while (fgets(buf, sizeof(buf), f))
+    {
+        const char *p = strstr(buf, "MemFree:");
+        if (p != NULL)
+        {
+            availkb = strtoull(p + 8, NULL, 10);
+            break;
+        }
+    }
+    fclose(f);
+    return availkb * 1024;
+}
+
+// allocate memory on the current (or overridden) node
+// The pages are bound with MPOL_PREFERRED, so allocation falls back to other nodes if this one is full.
+// The mapping length is kept in front of the returned block so that free() does not need it.
+static inline void *malloc(size_t n, size_t align)
+{
+    const size_t pagesize = (size_t) sysconf(_SC_PAGESIZE);
+    if (align > pagesize || pagesize % align != 0)
+        LogicError("numa::malloc: alignment %d not supported", (int) align);
+    const size_t total = n + pagesize; // first page holds the length
+    char *base = (char *) mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == (char *) MAP_FAILED)
+    {
+        fprintf(stderr, "numa::malloc: failed allocating %d bytes with alignment %d\n", (int) n, (int) align);
+        return NULL;
+    }
+    const size_t node = getcurrentnode();
+    if (getnumnodes() > 1 && node < 8 * sizeof(unsigned long))
+    {
+        const int MPOL_PREFERRED_ = 1; // from <numaif.h>, which is part of libnuma
+        unsigned long nodemask = 1ul << node;
+        syscall(SYS_mbind, base, total, MPOL_PREFERRED_, &nodemask, 8 * sizeof(nodemask), 0); // best effort; ignore failure
+    }
+    *(size_t *) base = total;
+    return base + pagesize;
+}
+
+// free memory allocated with numa::malloc()
+static inline void free(void *p)
+{
+    assert(p != NULL);
+    char *base = (char *) p - (size_t) sysconf(_SC_PAGESIZE);
+    if (munmap(base, *(size_t *) base) != 0)
+        LogicError("numa::free: munmap failure");
+}
+
+// dump memory allocation
+static inline void showavailablememory(const char *what)
+{
+    size_t n = getnumnodes();
+    for (size_t i = 0; i < n; i++)
+        fprintf(stderr, "%s: %8.2f MB available on NUMA node %d\n", what, getavailablebytes(i) / (1024.0 * 1024.0), (int) i);
+}
+
+// determine NUMA node with most memory available
+static inline size_t getmostspaciousnumanode()
+{
+    size_t n = getnumnodes();
+    size_t bestnode = 0;
+    size_t bestavailbytes = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        size_t availbytes = getavailablebytes(i);
+        if (availbytes > bestavailbytes)
+        {
+            bestavailbytes = availbytes;
+            bestnode = i;
+        }
+    }
+    return bestnode;
+}
+
+#else // Windows
+
 // get the number of NUMA nodes we would like to distinguish
 static inline size_t getnumnodes()
 {
@@ -108,6 +335,40 @@ static inline size_t getcurrentnode()
     return n;
 }
 
+// get the CPUs of a NUMA node that the process is allowed to run on
+static inline DWORD_PTR getallowednodemask(size_t node)
+{
+    ULONGLONG mask = 0;
+    DWORD_PTR processmask, systemmask;
+    if (!GetNumaNodeProcessorMask((UCHAR) node, &mask) || !GetProcessAffinityMask(GetCurrentProcess(), &processmask, &systemmask))
+        return 0;
+    return (DWORD_PTR) mask & processmask;
+}
+
+// whether we are allowed to run on at least one CPU of a NUMA node
+static inline bool isnodeallowed(size_t node)
+{
+    return getallowednodemask(node) != 0;
+}
+
+// restrict the calling thread to the CPUs of one NUMA node (within the process affinity)
+// Subsequent first-touch allocations by this thread will be placed on that node.
+static inline bool bindcurrentthreadtonode(size_t node)
+{
+    DWORD_PTR mask = getallowednodemask(node);
+    if (mask == 0)
+        return false;
+    return SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+}
+
+// undo bindcurrentthreadtonode(), allowing the thread to run on any node
+static inline void unbindcurrentthread()
+{
+    DWORD_PTR processmask, systemmask;
+    if (GetProcessAffinityMask(GetCurrentProcess(), &processmask, &systemmask))
+        SetThreadAffinityMask(GetCurrentThread(), processmask);
+}
+
 // allocate memory
 // Allocation seems to be at least on a 512-byte boundary. We nevertheless verify alignment requirements.
 typedef LPVOID(WINAPI *VirtualAllocExNuma_t)(HANDLE, LPVOID, SIZE_T, DWORD, DWORD, DWORD);
@@ -185,6 +446,7 @@ static inline size_t getmostspaciousnumanode()
     }
     return bestnode;
 }
+#endif
 
 #if 0 // this is no longer used (we now parallelize the big matrix products directly)
 // class to manage multiple copies of data on local NUMA nodes
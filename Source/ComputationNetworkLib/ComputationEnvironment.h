@@ -10,6 +10,8 @@
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
+class NodeProfiler;
+
 // ===========================================================================
 // ComputationEnvironment -- global network properties of interest to nodes
 // ===========================================================================
@@ -31,6 +33,13 @@ struct ComputationEnvironment
     NetworkOperationMode m_networkOperationMode = NetworkOperationMode::inferring; // by default, a network is always able to infer
     bool IsTraining()     const { return m_networkOperationMode == NetworkOperationMode::training; }
     bool IsPreComputing() const { return m_networkOperationMode == NetworkOperationMode::preComputing; }
+
+    // skipGaps tells nodes that support it to compute on the valid (non-gap) frames of minibatches with gaps only,
+    // rather than on the full [S x T] column grid (see ComputationNode::GetValidColumnMap())
+    bool m_skipGaps = false;
+
+    // if set, the network traversal times each node's ForwardProp() and Backprop() (see NodeProfiler)
+    std::shared_ptr<NodeProfiler> m_nodeProfiler;
     // more properties should be added here as needed
 };
 typedef std::shared_ptr<ComputationEnvironment> ComputationEnvironmentPtr;
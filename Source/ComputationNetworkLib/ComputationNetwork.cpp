@@ -443,24 +443,39 @@ void ComputationNetwork::CollectInputAndLearnableParameters(const ComputationNod
     m_learnableParameters[rootNode] = move(learnableParameters);
 }
 
-void ComputationNetwork::CollectInputAndLearnableParametersRec(const ComputationNodeBasePtr& node, set<ComputationNodeBasePtr>& visited, list<ComputationNodeBasePtr>& inputs, list<ComputationNodeBasePtr>& learnableParameters)
+// (depth-first part of CollectInputAndLearnableParameters(), with an explicit stack so that deep networks do not overflow it)
+void ComputationNetwork::CollectInputAndLearnableParametersRec(const ComputationNodeBasePtr& rootNode, set<ComputationNodeBasePtr>& visited, list<ComputationNodeBasePtr>& inputs, list<ComputationNodeBasePtr>& learnableParameters)
 {
-    if (visited.find(node) != visited.end())    // allready got this one
-        return;
-    else if (node->OperationName() == OperationNameOf(InputValue) || node->OperationName() == OperationNameOf(SparseInputValue))
-        inputs.push_back(node);
-    else if (node->OperationName() == OperationNameOf(LearnableParameter) && node->IsParameterUpdateRequired())
-        learnableParameters.push_back(node);
-    else
+    vector<pair<ComputationNodeBasePtr, size_t>> stack; // [depth] -> (node, index of next input to visit)
+    auto visit = [&](const ComputationNodeBasePtr& node)
     {
-        // PreComputeNodes that are already done should not be traversed
-        auto pcnode = dynamic_pointer_cast<IPreComputeNode>(node);
-        if (pcnode && pcnode->HasComputed())
+        if (visited.find(node) != visited.end())    // allready got this one
             return;
-        // recurse
-        visited.insert(node);
-        for (const auto & input : node->GetInputs())
-            CollectInputAndLearnableParametersRec(input, visited, inputs, learnableParameters);
+        else if (node->OperationName() == OperationNameOf(InputValue) || node->OperationName() == OperationNameOf(SparseInputValue))
+            inputs.push_back(node);
+        else if (node->OperationName() == OperationNameOf(LearnableParameter) && node->IsParameterUpdateRequired())
+            learnableParameters.push_back(node);
+        else
+        {
+            // PreComputeNodes that are already done should not be traversed
+            auto pcnode = dynamic_pointer_cast<IPreComputeNode>(node);
+            if (pcnode && pcnode->HasComputed())
+                return;
+            // and traverse its inputs next
+            visited.insert(node);
+            stack.push_back(make_pair(node, (size_t) 0));
+        }
+    };
+
+    visit(rootNode);
+    while (!stack.empty())
+    {
+        auto node = stack.back().first;
+        size_t i = stack.back().second++;
+        if (i < node->GetNumInputs())
+            visit(node->GetInputs()[i]);
+        else
+            stack.pop_back();
     }
 }
 
@@ -1041,6 +1056,519 @@ void ComputationNetwork::PerformSVDecomposition(const map<wstring, float>& SVDCo
     CompileNetwork();
 }
 
+// -----------------------------------------------------------------------
+// folding of normalization nodes into adjacent weights
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+static vector<ElemType> ValueToVector(const ComputationNodeBasePtr& node)
+{
+    const Matrix<ElemType>& value = node->As<ComputationNode<ElemType>>()->Value();
+    ElemType* p = value.CopyToArray();
+    vector<ElemType> result(p, p + value.GetNumElements());
+    delete[] p;
+    return result;
+}
+
+template <class ElemType>
+static void SetValueFromVector(const ComputationNodeBasePtr& node, vector<ElemType>& v)
+{
+    Matrix<ElemType>& value = node->As<ComputationNode<ElemType>>()->Value();
+    assert(v.size() == value.GetNumElements());
+    value.SetValue(value.GetNumRows(), value.GetNumCols(), value.GetDeviceId(), v.data());
+}
+
+// if 'node' is a normalization that computes y = a .* x + c per element (or per channel if 'spatial'), get a and c
+// Only BatchNormalization nodes in inference mode qualify, since in training mode they use minibatch statistics.
+template <class ElemType>
+static bool GetNormalizationAsAffine(const ComputationNodeBasePtr& node, vector<ElemType>& a, vector<ElemType>& c, bool& spatial)
+{
+    if (node->OperationName() == OperationNameOf(BatchNormalizationNode))
+    {
+        auto bn = node->As<BatchNormalizationNode<ElemType>>();
+        if (!bn->IsEvalMode())
+            return false;
+        vector<ElemType> scale = ValueToVector<ElemType>(node->Input(1));
+        vector<ElemType> bias = ValueToVector<ElemType>(node->Input(2));
+        vector<ElemType> mean = ValueToVector<ElemType>(node->Input(3));
+        vector<ElemType> invStdDev = ValueToVector<ElemType>(node->Input(4));
+        if (bias.size() != scale.size() || mean.size() != scale.size() || invStdDev.size() != scale.size())
+            return false;
+        a.resize(scale.size());
+        c.resize(scale.size());
+        for (size_t i = 0; i < scale.size(); i++)
+        {
+            a[i] = scale[i] * invStdDev[i];
+            c[i] = bias[i] - mean[i] * a[i];
+        }
+        spatial = bn->IsSpatial();
+        return true;
+    }
+    else if (node->OperationName() == OperationNameOf(PerDimMeanVarNormalizationNode))
+    {
+        vector<ElemType> mean = ValueToVector<ElemType>(node->Input(1));
+        vector<ElemType> invStdDev = ValueToVector<ElemType>(node->Input(2));
+        if (invStdDev.size() != mean.size() || mean.size() != node->GetSampleLayout().GetNumElements())
+            return false;
+        a = invStdDev;
+        c.resize(mean.size());
+        for (size_t i = 0; i < mean.size(); i++)
+            c[i] = -mean[i] * invStdDev[i];
+        spatial = false;
+        return true;
+    }
+    return false;
+}
+
+// Fold all foldable normalization nodes. Two patterns are recognized:
+//  - output side:  Norm(Plus(Times(W, x), b))  or  Norm(Times(W, x)), same with Convolution for a spatial BatchNormalization
+//    W := diag(a) W,  b := a .* b + c. The Plus node (newly created if there was no bias) takes over the name of the normalization node.
+//  - input side:   Times(W, Norm(x))  for a non-spatial normalization
+//    W := W diag(a), and W c is added to the bias of a following Plus node, or to a newly created one.
+// Each node along a pattern must have no other consumers, and W and b must be LearnableParameters.
+template <class ElemType>
+size_t ComputationNetwork::FoldNormalizationNodes()
+{
+    InvalidateCompiledNetwork();
+
+    // count of references to each node: input links plus memberships in node groups
+    auto countConsumers = [&]()
+    {
+        map<ComputationNodeBasePtr, size_t> numConsumers;
+        for (const auto& iter : m_nameToNodeMap)
+            for (const auto& input : iter.second->GetInputs())
+                numConsumers[input]++;
+        for (auto group : GetAllNodeGroups())
+            for (const auto& node : *group)
+                numConsumers[node]++;
+        return numConsumers;
+    };
+    // redirect all references to oldNode (except from newNode itself) to newNode
+    auto replaceReferences = [&](const ComputationNodeBasePtr& oldNode, const ComputationNodeBasePtr& newNode)
+    {
+        for (const auto& iter : m_nameToNodeMap)
+        {
+            if (iter.second == newNode)
+                continue;
+            for (size_t i = 0; i < iter.second->GetNumInputs(); i++)
+                if (iter.second->GetInputs()[i] == oldNode)
+                    iter.second->SetInput(i, newNode);
+        }
+        for (auto group : GetAllNodeGroups())
+            replace(group->begin(), group->end(), oldNode, newNode);
+    };
+    auto uniqueName = [&](const wstring& baseName)
+    {
+        wstring name = baseName;
+        for (size_t k = 1; NodeNameExists(name); k++)
+            name = baseName + to_wstring(k);
+        return name;
+    };
+    auto isFoldableParameter = [&](const ComputationNodeBasePtr& node, map<ComputationNodeBasePtr, size_t>& numConsumers)
+    {
+        return node && node->OperationName() == OperationNameOf(LearnableParameter) && numConsumers[node] == 1;
+    };
+    // delete the normalization node, and its inputs that are no longer referenced (parameters, Mean and InvStdDev nodes)
+    auto deleteNormalization = [&](const ComputationNodeBasePtr& norm)
+    {
+        vector<ComputationNodeBasePtr> inputs(norm->GetInputs().begin() + 1, norm->GetInputs().end());
+        DeleteNode(norm->NodeName());
+        auto numConsumers = countConsumers();
+        for (const auto& input : inputs)
+            if (input && numConsumers[input] == 0 && NodeNameExists(input->NodeName()))
+                DeleteNode(input->NodeName());
+    };
+
+    vector<ComputationNodeBasePtr> candidates;
+    for (const auto& iter : m_nameToNodeMap)
+        if (iter.second->OperationName() == OperationNameOf(BatchNormalizationNode) || iter.second->OperationName() == OperationNameOf(PerDimMeanVarNormalizationNode))
+            candidates.push_back(iter.second);
+
+    size_t numFolded = 0;
+    for (const auto& norm : candidates)
+    {
+        vector<ElemType> a, c;
+        bool spatial;
+        if (!GetNormalizationAsAffine<ElemType>(norm, a, c, spatial))
+            continue;
+        const size_t dim = a.size();
+        auto numConsumers = countConsumers();
+
+        // output side: find the linear operation and its optional bias below the normalization
+        ComputationNodeBasePtr linear = norm->Input(0), plus, bias;
+        if (linear->OperationName() == OperationNameOf(PlusNode) && numConsumers[linear] == 1)
+        {
+            plus = linear;
+            for (size_t i = 0; i < 2 && !bias; i++)
+            {
+                if (isFoldableParameter(plus->Input(i), numConsumers) && plus->Input(i)->GetSampleLayout().GetNumElements() == dim)
+                {
+                    bias = plus->Input(i);
+                    linear = plus->Input(1 - i);
+                }
+            }
+            if (!bias)
+                plus = nullptr;
+        }
+        bool isTimes = linear->OperationName() == OperationNameOf(TimesNode) && !spatial;
+        bool isConvolution = linear->OperationName() == OperationNameOf(ConvolutionNode) && spatial;
+        if ((isTimes || isConvolution) && numConsumers[linear] == 1 && isFoldableParameter(linear->Input(0), numConsumers) &&
+            linear->Input(0)->GetAsMatrixNumRows() == dim && (!isTimes || linear->GetSampleLayout().GetNumElements() == dim))
+        {
+            auto weights = linear->Input(0);
+            vector<ElemType> w = ValueToVector<ElemType>(weights);
+            for (size_t j = 0; j < w.size(); j++) // column-major: scale row (j % dim)
+                w[j] *= a[j % dim];
+            SetValueFromVector(weights, w);
+
+            if (bias)
+            {
+                vector<ElemType> b = ValueToVector<ElemType>(bias);
+                for (size_t i = 0; i < dim; i++)
+                    b[i] = a[i] * b[i] + c[i];
+                SetValueFromVector(bias, b);
+            }
+            else
+            {
+                TensorShape biasShape = isTimes ? TensorShape(dim) : ImageDimensions::AsTensorShape(1, 1, dim, linear->As<ConvolutionNode<ElemType>>()->GetImageLayoutKind());
+                bias = AddNodeToNetWithElemType(New<LearnableParameter<ElemType>>(m_deviceId, uniqueName(norm->NodeName() + L"_foldedBias"), biasShape));
+                SetValueFromVector(bias, c);
+                plus = AddNodeToNetAndAttachInputs(New<PlusNode<ElemType>>(m_deviceId, uniqueName(norm->NodeName() + L"_folded")), linear, bias);
+            }
+
+            fprintf(stderr, "FoldNormalizationIntoParameters: folding %ls %ls operation into %ls.\n", norm->NodeName().c_str(), norm->OperationName().c_str(), weights->NodeName().c_str());
+            wstring normName = norm->NodeName();
+            replaceReferences(norm, plus);
+            deleteNormalization(norm);
+            RenameNode(plus, normName);
+            numFolded++;
+            continue;
+        }
+
+        // input side: the normalization feeds the right operand of a Times node
+        // (a bias found by the failed output-side match above is unrelated)
+        bias = nullptr;
+        plus = nullptr;
+        if (spatial || numConsumers[norm] != 1)
+            continue;
+        ComputationNodeBasePtr times;
+        for (const auto& iter : m_nameToNodeMap)
+            if (iter.second->OperationName() == OperationNameOf(TimesNode) && iter.second->Input(1) == norm)
+                times = iter.second;
+        if (!times || !isFoldableParameter(times->Input(0), numConsumers) || times->Input(0)->GetAsMatrixNumCols() != dim)
+            continue;
+        auto weights = times->Input(0);
+        const size_t rows = weights->GetAsMatrixNumRows();
+
+        // bias delta W c must be computed with the original weights
+        vector<ElemType> w = ValueToVector<ElemType>(weights);
+        vector<ElemType> delta(rows, 0);
+        for (size_t j = 0; j < dim; j++)
+        {
+            for (size_t i = 0; i < rows; i++)
+            {
+                delta[i] += w[i + j * rows] * c[j];
+                w[i + j * rows] *= a[j];
+            }
+        }
+        SetValueFromVector(weights, w);
+
+        // add the delta to the bias of a following Plus, or create one
+        ComputationNodeBasePtr consumer;
+        if (numConsumers[times] == 1)
+            for (const auto& iter : m_nameToNodeMap)
+                if (iter.second->OperationName() == OperationNameOf(PlusNode) && (iter.second->Input(0) == times || iter.second->Input(1) == times))
+                    consumer = iter.second;
+        if (consumer)
+        {
+            bias = consumer->Input(consumer->Input(0) == times ? 1 : 0);
+            if (!isFoldableParameter(bias, numConsumers) || bias->GetSampleLayout().GetNumElements() != rows)
+                bias = nullptr;
+        }
+        if (bias)
+        {
+            vector<ElemType> b = ValueToVector<ElemType>(bias);
+            for (size_t i = 0; i < rows; i++)
+                b[i] += delta[i];
+            SetValueFromVector(bias, b);
+        }
+        else if (any_of(delta.begin(), delta.end(), [](ElemType d) { return d != 0; }))
+        {
+            // the new Plus node takes over the name of the Times node, so that references by name remain valid
+            wstring timesName = times->NodeName();
+            RenameNode(times, uniqueName(timesName + L"_unbiased"));
+            bias = AddNodeToNetWithElemType(New<LearnableParameter<ElemType>>(m_deviceId, uniqueName(timesName + L"_foldedBias"), TensorShape(rows)));
+            SetValueFromVector(bias, delta);
+            plus = AddNodeToNetAndAttachInputs(New<PlusNode<ElemType>>(m_deviceId, timesName), times, bias);
+            replaceReferences(times, plus);
+        }
+
+        fprintf(stderr, "FoldNormalizationIntoParameters: folding %ls %ls operation into %ls.\n", norm->NodeName().c_str(), norm->OperationName().c_str(), weights->NodeName().c_str());
+        times->SetInput(1, norm->Input(0));
+        deleteNormalization(norm);
+        numFolded++;
+    }
+
+    CompileNetwork();
+    return numFolded;
+}
+
+template <class ElemType>
+size_t ComputationNetwork::FoldNormalizationIntoParameters(bool verify, double tolerance)
+{
+    if (verify)
+    {
+        // fold a copy first and compare it against the unmodified network
+        auto folded = Clone();
+        if (folded->FoldNormalizationNodes<ElemType>() == 0)
+            return 0;
+        double deviation = MaxOutputDeviation<ElemType>(folded, Clone());
+        if (deviation < 0)
+        {
+            fprintf(stderr, "FoldNormalizationIntoParameters: WARNING: Network cannot be verified on random dense input, nothing folded.\n");
+            return 0;
+        }
+        if (deviation > tolerance)
+        {
+            fprintf(stderr, "FoldNormalizationIntoParameters: WARNING: Outputs of the folded network deviate by %.8g (tolerance %.8g), nothing folded.\n", deviation, tolerance);
+            return 0;
+        }
+        fprintf(stderr, "FoldNormalizationIntoParameters: Outputs verified, largest relative deviation %.8g.\n", deviation);
+    }
+    size_t numFolded = FoldNormalizationNodes<ElemType>();
+    fprintf(stderr, "FoldNormalizationIntoParameters: %d normalization nodes folded.\n", (int) numFolded);
+    return numFolded;
+}
+
+// ========================================
+// Magnitude pruning of weight matrices
+// The elements of smallest magnitude are set to zero. With enough of them zero, the product of the remaining ones with dense
+// input is cheaper through a sparse representation than through dense GEMM. Whether it is, depends on the sparsity, the
+// shape, and the machine, so the decision is made by timing both products.
+// ========================================
+template <class ElemType>
+size_t ComputationNetwork::PruneParameters(double sparsity, const wstring& nodeNameRegex, size_t numSamples, double minSparseSpeedup)
+{
+    if (sparsity < 0 || sparsity > 1)
+        InvalidArgument("PruneParameters: Sparsity %.8g is not between 0 and 1.", sparsity);
+    if (minSparseSpeedup < 0)
+        InvalidArgument("PruneParameters: Minimum sparse speed-up %.8g is negative.", minSparseSpeedup);
+
+    // find the weight matrices, sorted by name, together with whether they are used transposed
+    map<wstring, pair<ComputationNodeBasePtr, bool>> weights;
+    set<ComputationNodeBasePtr> otherUses;
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        const auto& node = iter.second;
+        bool isTimes = node->OperationName() == OperationNameOf(TimesNode);
+        bool isTransposeTimes = node->OperationName() == OperationNameOf(TransposeTimesNode);
+        for (size_t i = 0; i < node->GetNumInputs(); i++)
+        {
+            const auto& input = node->GetInputs()[i];
+            if (!input || input->OperationName() != OperationNameOf(LearnableParameter))
+                continue;
+            auto found = weights.find(input->NodeName());
+            if (i != 0 || (!isTimes && !isTransposeTimes) || (found != weights.end() && found->second.second != isTransposeTimes))
+                otherUses.insert(input);
+            else
+                weights[input->NodeName()] = make_pair(input, isTransposeTimes);
+        }
+    }
+
+    wregex nameFilter(nodeNameRegex);
+    unsigned long randomSeed = 1;
+    size_t numPruned = 0;
+    for (const auto& iter : weights)
+    {
+        const auto& name = iter.first;
+        const auto& node = iter.second.first;
+        auto weight = dynamic_pointer_cast<LearnableParameter<ElemType>>(node);
+        bool transposed = iter.second.second;
+        if (!weight || otherUses.find(node) != otherUses.end() || (!nodeNameRegex.empty() && !regex_match(name, nameFilter)))
+            continue;
+        Matrix<ElemType>& value = weight->Value();
+        size_t rows = value.GetNumRows(), cols = value.GetNumCols();
+        if (value.GetMatrixType() != MatrixType::DENSE || node->GetSampleLayout().GetRank() != 2 || rows == 1 || cols == 1)
+            continue;
+
+        // zero all elements below the magnitude at the requested rank
+        vector<ElemType> data(rows * cols);
+        value.CopySection(rows, cols, data.data(), rows);
+        vector<ElemType> magnitudes(data.size());
+        for (size_t k = 0; k < data.size(); k++)
+            magnitudes[k] = fabs(data[k]);
+        size_t rank = (size_t) (sparsity * data.size());
+        ElemType threshold = numeric_limits<ElemType>::infinity();
+        if (rank < magnitudes.size())
+        {
+            nth_element(magnitudes.begin(), magnitudes.begin() + rank, magnitudes.end());
+            threshold = magnitudes[rank];
+        }
+        size_t nz = 0;
+        for (auto& x : data)
+        {
+            if (fabs(x) < threshold)
+                x = 0;
+            nz += x != 0;
+        }
+        value.SetValue(rows, cols, value.GetDeviceId(), data.data(), matrixFlagNormal);
+        numPruned++;
+
+        fprintf(stderr, "PruneParameters: %ls [%d x %d]: threshold %.8g, sparsity %.1f%%", name.c_str(), (int) rows, (int) cols, (double) threshold, 100.0 * (data.size() - nz) / data.size());
+        if (value.GetDeviceId() != CPUDEVICE)
+        {
+            fprintf(stderr, ".\n");
+            continue;
+        }
+
+        // the same values in CSR format
+        vector<CPUSPARSE_INDEX_TYPE> rowStarts(rows + 1), colIds;
+        vector<ElemType> nzValues;
+        colIds.reserve(nz);
+        nzValues.reserve(nz);
+        for (size_t i = 0; i < rows; i++)
+        {
+            rowStarts[i] = (CPUSPARSE_INDEX_TYPE) colIds.size();
+            for (size_t j = 0; j < cols; j++)
+            {
+                if (data[j * rows + i] != 0)
+                {
+                    colIds.push_back((CPUSPARSE_INDEX_TYPE) j);
+                    nzValues.push_back(data[j * rows + i]);
+                }
+            }
+        }
+        rowStarts[rows] = (CPUSPARSE_INDEX_TYPE) colIds.size();
+        Matrix<ElemType> sparseValue(rows, cols, CPUDEVICE, MatrixType::SPARSE, matrixFormatSparseCSR);
+        sparseValue.SetMatrixFromCSRFormat(rowStarts.data(), colIds.data(), nzValues.data(), nz, rows, cols);
+
+        // time the product as the Times node would compute it (best of a few runs)
+        Matrix<ElemType> input(transposed ? rows : cols, numSamples, CPUDEVICE);
+        input.SetUniformRandomValue(-1, 1, randomSeed++);
+        Matrix<ElemType> output(CPUDEVICE);
+        auto timeProduct = [&](const Matrix<ElemType>& a)
+        {
+            double bestSeconds = numeric_limits<double>::infinity();
+            for (size_t run = 0; run < 5; run++)
+            {
+                auto startTime = chrono::steady_clock::now();
+                Matrix<ElemType>::MultiplyAndWeightedAdd(1, a, transposed, input, false, 0, output);
+                bestSeconds = min(bestSeconds, chrono::duration<double>(chrono::steady_clock::now() - startTime).count());
+            }
+            return bestSeconds;
+        };
+        double denseSeconds = timeProduct(value);
+        double sparseSeconds = timeProduct(sparseValue);
+        bool useSparse = sparseSeconds * minSparseSpeedup < denseSeconds;
+        fprintf(stderr, ", product with %d columns %.3f ms dense, %.3f ms sparse --> %s.\n", (int) numSamples, 1000 * denseSeconds, 1000 * sparseSeconds, useSparse ? "sparse" : "dense");
+        if (useSparse)
+        {
+            value.SetValue(sparseValue, matrixFormatSparseCSR);
+            node->SetLearningRateMultiplier(0); // sparse parameters cannot be updated
+        }
+    }
+    return numPruned;
+}
+
+ComputationNetworkPtr ComputationNetwork::Clone()
+{
+    auto net = make_shared<ComputationNetwork>(m_deviceId);
+    for (const auto& iter : m_nameToNodeMap)
+        net->AddNodeToNet(iter.second->Duplicate(iter.first, CopyNodeFlags::copyNodeValue));
+    for (const auto& iter : m_nameToNodeMap)
+    {
+        vector<ComputationNodeBasePtr> inputs;
+        for (const auto& input : iter.second->GetInputs())
+            inputs.push_back(input ? net->GetNodeFromName(input->NodeName()) : nullptr);
+        net->GetNodeFromName(iter.first)->AttachInputs(inputs);
+    }
+    auto fromGroups = GetAllNodeGroups();
+    auto toGroups = net->GetAllNodeGroups();
+    for (size_t k = 0; k < fromGroups.size(); k++)
+        for (const auto& node : *fromGroups[k])
+            toGroups[k]->push_back(net->GetNodeFromName(node->NodeName()));
+    net->CompileNetwork();
+    return net;
+}
+
+template <class ElemType>
+/*static*/ double ComputationNetwork::MaxOutputDeviation(const ComputationNetworkPtr& net, const ComputationNetworkPtr& refNet, size_t numSamples, unsigned long randomSeed,
+                                                        double* seconds, double* refSeconds)
+{
+    vector<ComputationNodeBasePtr> outputNodes, refOutputNodes;
+    for (const auto& node : refNet->OutputNodes())
+    {
+        if (!net->NodeNameExists(node->NodeName()))
+            return -1;
+        refOutputNodes.push_back(node);
+        outputNodes.push_back(net->GetNodeFromName(node->NodeName()));
+    }
+    if (outputNodes.empty())
+        return -1;
+
+    // forward the same random minibatch through a network; returns false if an input cannot be filled with random dense data
+    auto evaluate = [numSamples, randomSeed](const ComputationNetworkPtr& n, const vector<ComputationNodeBasePtr>& roots, vector<vector<ElemType>>& outputs, double* seconds)
+    {
+        ScopedNetworkOperationMode modeGuard(n, NetworkOperationMode::inferring);
+        n->AllocateAllMatrices({}, roots, nullptr);
+        n->StartEvaluateMinibatchLoop(roots);
+
+        map<wstring, ComputationNodeBasePtr> inputNodes; // (sorted by name, so that both networks draw the same random numbers)
+        for (const auto& root : roots)
+            for (const auto& node : n->InputNodes(root))
+                inputNodes[node->NodeName()] = node;
+        vector<ComputationNodeBasePtr> inputs;
+        unsigned long seed = randomSeed;
+        for (const auto& iter : inputNodes)
+        {
+            const auto& node = iter.second;
+            if (node->OperationName() != OperationNameOf(InputValue) || !node->HasMBLayout())
+                return false;
+            Matrix<ElemType>& value = node->As<ComputationNode<ElemType>>()->Value();
+            value.Resize(node->GetSampleMatrixNumRows(), numSamples);
+            value.SetUniformRandomValue(-1, 1, seed++);
+            inputs.push_back(node);
+        }
+        n->GetMBLayoutPtr()->InitAsFrameMode(numSamples);
+        for (const auto& node : inputs)
+            node->NotifyFunctionValuesMBSizeModified();
+        ComputationNetwork::BumpEvalTimeStamp(inputs);
+
+        for (const auto& root : roots)
+        {
+            n->ForwardProp(root);
+            outputs.push_back(ValueToVector<ElemType>(root));
+        }
+
+        if (seconds) // time another pass, now that all buffers are allocated
+        {
+            auto startTime = chrono::steady_clock::now();
+            ComputationNetwork::BumpEvalTimeStamp(inputs);
+            for (const auto& root : roots)
+                n->ForwardProp(root);
+            *seconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+        }
+        return true;
+    };
+
+    vector<vector<ElemType>> outputs, refOutputs;
+    if (!evaluate(refNet, refOutputNodes, refOutputs, refSeconds) || !evaluate(net, outputNodes, outputs, seconds))
+        return -1;
+
+    double maxDeviation = 0, maxMagnitude = 1; // (deviations of outputs below 1 are measured absolutely)
+    for (size_t k = 0; k < outputs.size(); k++)
+    {
+        if (outputs[k].size() != refOutputs[k].size())
+            return numeric_limits<double>::infinity();
+        for (size_t i = 0; i < outputs[k].size(); i++)
+        {
+            maxDeviation = max(maxDeviation, fabs((double) outputs[k][i] - (double) refOutputs[k][i]));
+            maxMagnitude = max(maxMagnitude, fabs((double) refOutputs[k][i]));
+        }
+    }
+    return maxDeviation / maxMagnitude;
+}
+
 // Helper class to form a logical DBN layer while exporting the network (used by SaveToDbnFile)
 class DbnLayer
 {
@@ -1408,6 +1936,10 @@ template void ComputationNetwork::InitLearnableParameters<float>(const Computati
 template void ComputationNetwork::Read<float>(const wstring& fileName);
 template void ComputationNetwork::ReadPersistableParameters<float>(File& fstream, bool create);
 template void ComputationNetwork::PerformSVDecomposition<float>(const map<wstring, float>& SVDConfig, size_t alignedsize);
+template size_t ComputationNetwork::FoldNormalizationIntoParameters<float>(bool verify, double tolerance);
+template size_t ComputationNetwork::PruneParameters<float>(double sparsity, const wstring& nodeNameRegex, size_t numSamples, double minSparseSpeedup);
+template /*static*/ double ComputationNetwork::MaxOutputDeviation<float>(const ComputationNetworkPtr& net, const ComputationNetworkPtr& refNet, size_t numSamples, unsigned long randomSeed,
+                                                                         double* seconds, double* refSeconds);
 template /*static*/ void ComputationNetwork::SetDropoutRate<float>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double dropoutRate, double& prevDropoutRate, unsigned long& dropOutSeed);
 template /*static*/ void ComputationNetwork::SetBatchNormalizationTimeConstant<float>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double normalizationTimeConstant, double& prevNormalizationTimeConstant);
 template void ComputationNetwork::SetSeqParam<float>(ComputationNetworkPtr net, const ComputationNodeBasePtr criterionNode, const double& hsmoothingWeight, const double& frameDropThresh, const bool& doreferencealign,
@@ -1418,6 +1950,10 @@ template void ComputationNetwork::InitLearnableParameters<double>(const Computat
 template void ComputationNetwork::Read<double>(const wstring& fileName);
 template void ComputationNetwork::ReadPersistableParameters<double>(File& fstream, bool create);
 template void ComputationNetwork::PerformSVDecomposition<double>(const map<wstring, float>& SVDConfig, size_t alignedsize);
+template size_t ComputationNetwork::FoldNormalizationIntoParameters<double>(bool verify, double tolerance);
+template size_t ComputationNetwork::PruneParameters<double>(double sparsity, const wstring& nodeNameRegex, size_t numSamples, double minSparseSpeedup);
+template /*static*/ double ComputationNetwork::MaxOutputDeviation<double>(const ComputationNetworkPtr& net, const ComputationNetworkPtr& refNet, size_t numSamples, unsigned long randomSeed,
+                                                                         double* seconds, double* refSeconds);
 template /*static*/ void ComputationNetwork::SetDropoutRate<double>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double dropoutRate, double& prevDropoutRate, unsigned long& dropOutSeed);
 template /*static*/ void ComputationNetwork::SetBatchNormalizationTimeConstant<double>(ComputationNetworkPtr net, const ComputationNodeBasePtr& criterionNode, const double normalizationTimeConstant, double& prevNormalizationTimeConstant);
 template void ComputationNetwork::SetSeqParam<double>(ComputationNetworkPtr net, const ComputationNodeBasePtr criterionNode, const double& hsmoothingWeight, const double& frameDropThresh, const bool& doreferencealign,
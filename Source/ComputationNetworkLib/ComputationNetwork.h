@@ -125,7 +125,8 @@ public:
     void ForwardProp(const ComputationNodeBasePtr rootNode);
 
     // main entry point for backprop
-    void Backprop(const ComputationNodeBasePtr rootNode);
+    // With accumulateParameterGradients, parameter gradients computed by a previous call are added to instead of being reset (sub-minibatches).
+    void Backprop(const ComputationNodeBasePtr rootNode, bool accumulateParameterGradients = false);
 
     template <class NODESET> // version that takes multiple nodes
     void ForwardProp(const NODESET& nodes)
@@ -164,7 +165,7 @@ public:
 
 private:
     void ValidateNetwork();
-    size_t ValidateNodes(list<ComputationNodeBasePtr> nodes, bool isFirstPass, bool isFinalValidationPass);
+    size_t ValidateNodes(const list<ComputationNodeBasePtr>& nodes, bool isFirstPass, bool isFinalValidationPass);
     bool ValidateNode(ComputationNodeBasePtr node, bool isFinalValidationPass) const;
     void MarkValueNonSharableNodes();
 
@@ -196,10 +197,10 @@ private:
     // This is part of the FormRecurrentLoops() process, and only called from there.
     void FormRecurrentLoops(const ComputationNodeBasePtr& rootNode);
     void DetermineSCCs(const ComputationNodeBasePtr& rootNode);
-    void DetermineSCCsR(ComputationNodeBasePtr cur, std::list<ComputationNodeBasePtr>& sccStack, size_t& index, size_t& loopId);
+    void DetermineSCCsR(ComputationNodeBasePtr cur, std::list<ComputationNodeBasePtr>& sccStack, std::unordered_set<ComputationNodeBasePtr>& loopSourceNodes, size_t& index, size_t& loopId);
+    void CloseRecurrentLoop(const ComputationNodeBasePtr& cur, std::list<ComputationNodeBasePtr>& sccStack, std::unordered_set<ComputationNodeBasePtr>& loopSourceNodes, size_t& loopId);
     void DetermineLoopForwardOrder(std::unordered_set<ComputationNodeBasePtr>& visited, std::unordered_set<ComputationNodeBasePtr>& recStack, std::list<ComputationNodeBasePtr>& nodesStack, ComputationNodeBasePtr cur);
-    void GatherLoopNodesR(const ComputationNodeBasePtr& rootNode, std::unordered_set<ComputationNodeBasePtr>& visited, std::map<int, std::list<ComputationNodeBasePtr>>& recurrentResult, std::list<ComputationNodeBasePtr>& noRecurrentResult);
-    void ReorderLoops(std::list<ComputationNodeBasePtr>& nodes, const std::map<int, std::list<ComputationNodeBasePtr>>& /*recurrentNodes*/, const std::list<ComputationNodeBasePtr>& /*noRecurrentNodes*/);
+    void ReorderLoops(std::list<ComputationNodeBasePtr>& nodes);
 
 public:
     // -----------------------------------------------------------------------
@@ -244,8 +245,12 @@ public:
 protected:
     class SEQTraversalFlowControlNode;
 
+    // maps every node that participates in a recurrent loop to that loop; nodes not in a loop are absent
+    typedef std::unordered_map<ComputationNodeBasePtr, std::shared_ptr<SEQTraversalFlowControlNode>> NodeToLoopMap;
+
 private:
-    static std::shared_ptr<SEQTraversalFlowControlNode> FindInRecurrentLoops(const std::vector<std::shared_ptr<SEQTraversalFlowControlNode>>& recurrentInfo, const ComputationNodeBasePtr& node);
+    static NodeToLoopMap MapNodesToRecurrentLoops(const std::vector<std::shared_ptr<SEQTraversalFlowControlNode>>& recurrentInfo);
+    static std::shared_ptr<SEQTraversalFlowControlNode> FindInRecurrentLoops(const NodeToLoopMap& loopOfNode, const ComputationNodeBasePtr& node);
 
 public:
     // -----------------------------------------------------------------------
@@ -539,6 +544,30 @@ public:
     template <class ElemType>
     void PerformSVDecomposition(const map<wstring, float>& SVDConfig, size_t AlignedSize);
 
+    // fold inference-mode BatchNormalization and PerDimMeanVarNormalization nodes into the weights and biases of adjacent Times/Convolution nodes
+    // If 'verify', the folding is first done on a copy whose outputs are compared against an unfolded copy on random input; nothing is folded if they deviate by more than 'tolerance'.
+    // Returns the number of normalization nodes that were folded.
+    template <class ElemType>
+    size_t FoldNormalizationIntoParameters(bool verify = true, double tolerance = 1e-3);
+
+    // independent copy of the network (nodes, values, links, and node groups); the copy is compiled but has no matrices allocated
+    ComputationNetworkPtr Clone();
+
+    // magnitude pruning: set the fraction 'sparsity' of smallest-magnitude elements of each weight matrix matching 'nodeNameRegex' (all if empty) to zero.
+    // Weight matrices are LearnableParameters whose consumers are all Times or TransposeTimes nodes that take them as their first input.
+    // On the CPU, a pruned matrix is stored as sparse (CSR) if its product with 'numSamples' random columns is at least 'minSparseSpeedup'
+    // times faster that way (0 = always sparse), so that the Times nodes run the sparse kernel. Such parameters are frozen (learning-rate multiplier 0).
+    // Returns the number of weight matrices pruned.
+    template <class ElemType>
+    size_t PruneParameters(double sparsity, const wstring& nodeNameRegex = L"", size_t numSamples = 256, double minSparseSpeedup = 1);
+
+    // evaluate the output nodes of two networks with the same inputs on the same random dense minibatch, and return the largest deviation
+    // relative to the largest output magnitude (absolute if below 1). Returns a negative value if the networks cannot be compared this way (e.g. sparse inputs).
+    // If 'seconds' and 'refSeconds' are given, they receive the time of one forward pass of the respective network.
+    template <class ElemType>
+    static double MaxOutputDeviation(const ComputationNetworkPtr& net, const ComputationNetworkPtr& refNet, size_t numSamples = 64, unsigned long randomSeed = 1,
+                                     double* seconds = nullptr, double* refSeconds = nullptr);
+
     template <class ElemType>
     void SaveToDbnFile(ComputationNetworkPtr net, const std::wstring& fileName) const;
 
@@ -794,6 +823,9 @@ protected:
         virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool);
         virtual bool IsOutOfDateWrtInputs() const override;
 
+    private:
+        bool SkipsGaps() const;
+
     public:
         // std::vector<ComputationNodeBasePtr> m_nestedNodes;               // all nodes involved in this loop, in evaluation order
         ComputationNodeBasePtr m_sourceNode; // one of the nodes of the loop   --TODO: What is the special meaning of this node? It seems to always be a delay node.
@@ -875,6 +907,10 @@ public:
     }
 
 private://protected:
+    // the folding itself, without verification (see FoldNormalizationIntoParameters())
+    template <class ElemType>
+    size_t FoldNormalizationNodes();
+
     DEVICEID_TYPE m_deviceId; // TODO: is this shared by all nodes?
     unsigned long m_randomSeedOffset;
 
@@ -112,21 +112,6 @@ void ComputationNetwork::FormRecurrentLoops(const ComputationNodeBasePtr& rootNo
 
     if (m_allSEQNodes.size() > 0)
     {
-        unordered_set<ComputationNodeBasePtr> visited;
-
-        // get set of all nodes in and outside loops hanging off rootNode
-        map<int, list<ComputationNodeBasePtr>> recurrentNodes;
-        list<ComputationNodeBasePtr> noRecurrentNodes;
-#if 1 // will soon no longer be allowed
-        if (rootNode)
-            GatherLoopNodesR(rootNode, visited, recurrentNodes, noRecurrentNodes);
-        else
-#endif
-        {
-            for (const auto& rootNode : m_allRoots)
-                GatherLoopNodesR(rootNode, visited, recurrentNodes, noRecurrentNodes);
-        }
-
         auto reorderedNodes = nodes;
 
         // first sort by the updated m_visitedOrder, which is identical for all nodes in a loop
@@ -135,7 +120,7 @@ void ComputationNetwork::FormRecurrentLoops(const ComputationNodeBasePtr& rootNo
                                 return lhs->m_visitedOrder < rhs->m_visitedOrder;
                             });
 
-        ReorderLoops(reorderedNodes, recurrentNodes, noRecurrentNodes); // group nodes in loops together
+        ReorderLoops(reorderedNodes); // group nodes in loops together
 
         UpdateEvalOrder(rootNode, reorderedNodes);
     }
@@ -178,52 +163,79 @@ void ComputationNetwork::DetermineSCCs(const ComputationNodeBasePtr& rootNode)
     list<ComputationNodeBasePtr> sccStack;
     size_t index = 0;
     size_t loopId = 0; // BUGBUG: I think this is currently buggy in an edge case, and not needed (use m_allSEQNodes.size() instead).
+    unordered_set<ComputationNodeBasePtr> loopSourceNodes; // m_sourceNode of all loops in m_allSEQNodes, to detect loops found again
+    for (const auto& iter : m_allSEQNodes)
+        loopSourceNodes.insert(iter->m_sourceNode);
 #if 1
     if (rootNode)
     {
         if (!rootNode->m_visited)
-            DetermineSCCsR(rootNode, sccStack, index, loopId);
+            DetermineSCCsR(rootNode, sccStack, loopSourceNodes, index, loopId);
         return;
     }
 #endif
     // traverse all root nodes (as if they were all children of a master root)
     for (auto& rootNode : m_allRoots)
         if (!rootNode->m_visited)
-            DetermineSCCsR(rootNode, sccStack, index, loopId);
+            DetermineSCCsR(rootNode, sccStack, loopSourceNodes, index, loopId);
 }
 
-// (recursive part of DetermineSCCs())
+// (depth-first part of DetermineSCCs())
+// This is Tarjan's algorithm with an explicit stack instead of recursion, since generated networks can be tens of thousands of nodes deep.
 void ComputationNetwork::DetermineSCCsR(ComputationNodeBasePtr cur,
                                         list<ComputationNodeBasePtr>& sccStack,
+                                        unordered_set<ComputationNodeBasePtr>& loopSourceNodes,
                                         size_t& index, size_t& loopId)
 {
     assert(!cur->m_visited);
 
-    // set the index (in order of visitation)
-    cur->m_index = index;    // TODO: can this be used as m_visitedOrder?
-    cur->m_minIndex = index; // also set m_minIndex
-    index++;
-
-    cur->m_visited = true;
-    sccStack.push_back(cur);
-    cur->m_inStack = true;
-
-    // set m_minIndex to min over m_lowLinks of children
-    for (int i = 0; i < cur->GetNumInputs(); i++)
+    vector<pair<ComputationNodeBasePtr, size_t>> dfsStack; // [depth] -> (node, index of next input to visit)
+    auto enter = [&](const ComputationNodeBasePtr& node)
     {
-        if (!cur->Input(i)->m_visited)
+        // set the index (in order of visitation)
+        node->m_index = index;    // TODO: can this be used as m_visitedOrder?
+        node->m_minIndex = index; // also set m_minIndex
+        index++;
+
+        node->m_visited = true;
+        sccStack.push_back(node);
+        node->m_inStack = true;
+        dfsStack.push_back(make_pair(node, 0));
+    };
+
+    enter(cur);
+    while (!dfsStack.empty())
+    {
+        // set m_minIndex to min over m_lowLinks of children
+        const auto node = dfsStack.back().first;
+        size_t i = dfsStack.back().second++;
+        if (i < node->GetNumInputs())
         {
-            DetermineSCCsR(cur->Input(i), sccStack, index, loopId);
-            cur->m_minIndex = min(cur->m_minIndex, cur->Input(i)->m_minIndex);
+            const auto& input = node->Input(i);
+            if (!input->m_visited)
+                enter(input); // m_minIndex gets propagated when it is done, see below
+            else if (input->m_inStack)
+                node->m_minIndex = min(node->m_minIndex, input->m_minIndex);
+            continue;
         }
-        else if (cur->Input(i)->m_inStack)
+
+        // all inputs done
+        CloseRecurrentLoop(node, sccStack, loopSourceNodes, loopId);
+        dfsStack.pop_back();
+        if (!dfsStack.empty())
         {
-            cur->m_minIndex = min(cur->m_minIndex, cur->Input(i)->m_minIndex);
+            const auto& parent = dfsStack.back().first;
+            parent->m_minIndex = min(parent->m_minIndex, node->m_minIndex);
         }
     }
+}
 
+// (part of DetermineSCCsR(), called when all inputs of 'cur' have been visited)
+void ComputationNetwork::CloseRecurrentLoop(const ComputationNodeBasePtr& cur, list<ComputationNodeBasePtr>& sccStack,
+                                            unordered_set<ComputationNodeBasePtr>& loopSourceNodes, size_t& loopId)
+{
     // if we closed a loop then create an entry in m_allSEQNodes
-    if (cur->m_minIndex == cur->m_index) // m_minIndex is still equal to m_index, as we set it at the start of this function: we closed a loop
+    if (cur->m_minIndex == cur->m_index) // m_minIndex is still equal to m_index, as DetermineSCCsR() set it upon entering 'cur': we closed a loop
     {
         // gather the list of all nodes in this loop
         vector<ComputationNodeBasePtr> nestedNodes;
@@ -251,16 +263,7 @@ void ComputationNetwork::DetermineSCCsR(ComputationNodeBasePtr cur,
             //  - the first root takes the first delay node's value, the second root that of the second delay node
             //    I.e. the depth-first tree traversals enter the loop at two different places (m_sourceNode).
             //  -> Are these two loops detected as identical? (determined by m_minIndex, but m_index depends on traversal from each root, so maybe not)
-            bool bFound = false; // find a dup  --TODO: check whether there is an STL algorithm for this
-            for (const auto& iter2 : m_allSEQNodes)
-            {
-                if (iter2->m_sourceNode == cur)
-                {
-                    bFound = true;
-                    break;
-                }
-            }
-            if (!bFound)
+            if (loopSourceNodes.insert(cur).second) // not a dup
             {
 #if 1
                 if (loopId != m_allSEQNodes.size())
@@ -305,45 +308,22 @@ void ComputationNetwork::DetermineLoopForwardOrder(unordered_set<ComputationNode
         LogicError("%ls %ls operation is part of an infinite loop that cannot be unrolled.", cur->NodeName().c_str(), cur->OperationName().c_str());
 }
 
-// traverse sub-graph feeding this node (which is a top-level node at start, e.g. training criterion) and list
-//  - all nodes that participate in a loop -> recurrentResult[loopId][]
-//  - all nodes that don't                 -> noRecurrentResult[]
-// in order of traversal (depth-first).
-// This is part of the FormRecurrentLoops() process, and only called from there from one place.
-void ComputationNetwork::GatherLoopNodesR(const ComputationNodeBasePtr& node, unordered_set<ComputationNodeBasePtr>& visited,
-                                          map<int, list<ComputationNodeBasePtr>>& recurrentResult,
-                                          list<ComputationNodeBasePtr>& noRecurrentResult)
-{
-    if (visited.find(node) != visited.end())
-        return; // do each node only once
-    visited.insert(node);
-
-    for (int i = 0; i < node->GetNumInputs(); i++)
-        GatherLoopNodesR(node->Input(i), visited, recurrentResult, noRecurrentResult);
-
-    if (node->m_loopId >= 0)
-        recurrentResult[node->m_loopId].push_back(node);
-    else
-        noRecurrentResult.push_back(node);
-}
-
 // takes a list of nodes and modifies it such that all nodes of the same loop are consecutive
 //  - 'nodes' is in some traversal order
 //  - that order is preserved for all nodes outside loops
 //  - each node that belongs to a loop is replaced by all nodes of that loop in loop order
 // Called only from FormRecurrentLoops().
-void ComputationNetwork::ReorderLoops(list<ComputationNodeBasePtr>& nodes,
-                                      const map<int, list<ComputationNodeBasePtr>>& /*recurrentNodes*/,
-                                      const list<ComputationNodeBasePtr>& /*noRecurrentNodes*/)
+void ComputationNetwork::ReorderLoops(list<ComputationNodeBasePtr>& nodes)
 {
     list<ComputationNodeBasePtr> newList;
 
     list<ComputationNodeBasePtr> vTmp;
     list<ComputationNodeBasePtr> vRecurrentTmp;
     vector<bool> accessed(m_allSEQNodes.size(), false);
+    const NodeToLoopMap loopOfNode = MapNodesToRecurrentLoops(m_allSEQNodes);
     for (auto nodeIter = nodes.begin(); nodeIter != nodes.end(); nodeIter++)
     {
-        const shared_ptr<SEQTraversalFlowControlNode> recInfo = FindInRecurrentLoops(m_allSEQNodes, *nodeIter);
+        const shared_ptr<SEQTraversalFlowControlNode> recInfo = FindInRecurrentLoops(loopOfNode, *nodeIter);
         if (recInfo)
         {
             int iId = recInfo->m_loopId;
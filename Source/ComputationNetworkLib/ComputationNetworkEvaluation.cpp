@@ -10,12 +10,15 @@
 #include "ComputationNetwork.h"
 #include "RecurrentNodes.h"
 #include "InputAndParamNodes.h"
+#include "NodeProfiler.h"
 #include <string>
 #include <vector>
 #include <list>
 #include <set>
 #include <algorithm>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
 
 using namespace std;
 
@@ -64,14 +67,27 @@ static bool SetGradientToScalarOne(ComputationNodeBasePtr nodep)
 //  - ForwardProp() for eval nodes
 //  - ForwardProp() for the training criterion (which will reuse computation results from the previous step)
 //  - Backprop() for the training criterion
-void ComputationNetwork::Backprop(const ComputationNodeBasePtr rootNode) // training criterion to compute the gradients for
+void ComputationNetwork::Backprop(const ComputationNodeBasePtr rootNode, bool accumulateParameterGradients) // training criterion to compute the gradients for
 {
     if (!Environment().IsTraining())
         LogicError("Backprop: Requires network is to be in training mode.");
 
+    // when accumulating, remember which parameters already have a valid gradient
+    std::vector<ComputationNodeBasePtr> accumulatingParameters;
+    if (accumulateParameterGradients)
+    {
+        for (auto& node : GetEvalOrder(rootNode))
+            if (node->IsParameterUpdateRequired() && node->IsGradientInitialized())
+                accumulatingParameters.push_back(node);
+    }
+
     // reset all gradients to zero (actually, internally, this is lazy, but we don't care here)
     ZeroGradients(rootNode);
 
+    // ...except for those, so that backprop adds the new gradient to them in place
+    for (auto& node : accumulatingParameters)
+        node->SetGradientInitialized(true);
+
     // initialize root gradient with a scalar value of 1.0
     if (!SetGradientToScalarOne<float>(rootNode) && !SetGradientToScalarOne<double>(rootNode))
         LogicError("Backprop: Training criterion is neither ComputationNode<float> nor ComputationNode<double>.");
@@ -86,6 +102,7 @@ void ComputationNetwork::FormNestedNetwork(const ComputationNodeBasePtr& rootNod
         fprintf(stderr, "FormNestedNetwork: WARNING: Was called twice for %ls %ls operation\n", rootNode->NodeName().c_str(), rootNode->OperationName().c_str());
 
     m_nestedNetworks[rootNode] = make_shared<PARTraversalFlowControlNode>(m_allSEQNodes, GetEvalOrder(rootNode));
+    m_nestedNetworks[rootNode]->SetEnvironment(m_environment); // for the NodeProfiler
 }
 
 ComputationNodeBasePtr ComputationNetwork::GetNestedNetwork(const ComputationNodeBasePtr& rootNode)
@@ -107,9 +124,10 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
 {
     // traverse the network in evaluation order and create a new list that replaces all recurrence by a SEQTraversalFlowControlNode
     set<shared_ptr<IComputationNode>> loopsSeen; // for consistency check only
+    const NodeToLoopMap loopOfNode = MapNodesToRecurrentLoops(recurrentInfo);
     for (auto nodeIter = allNodes.begin(); nodeIter != allNodes.end();)
     {
-        shared_ptr<SEQTraversalFlowControlNode> recInfo = FindInRecurrentLoops(recurrentInfo, *nodeIter); // check if this node participates in a recurrent loop
+        shared_ptr<SEQTraversalFlowControlNode> recInfo = FindInRecurrentLoops(loopOfNode, *nodeIter); // check if this node participates in a recurrent loop
         if (recInfo)                                                                                      // node is part of a SEQ loop: gather all of them. The nodes must be consecutive in 'allNodes'
         {
             // instead of the node itself, include the sentinel SEQTraversalFlowControlNode in our list
@@ -118,7 +136,7 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
             if (!loopsSeen.insert(recInfo).second)
                 LogicError("PARTraversalFlowControlNode: members of loop %ls are not consecutive in node list.", recInfo->NodeName().c_str());
             // consume all nodes that are part of the same loop (they are all consecutive)
-            while (nodeIter != allNodes.end() && (*nodeIter)->IsPartOfLoop() && FindInRecurrentLoops(recurrentInfo, *nodeIter) == recInfo)
+            while (nodeIter != allNodes.end() && (*nodeIter)->IsPartOfLoop() && FindInRecurrentLoops(loopOfNode, *nodeIter) == recInfo)
                 nodeIter++;
         }
         else // regular top-level node (non-looping, PAR)
@@ -128,12 +146,22 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
         }
     }
 }
+// recurrent loops show up in the PAR traversal as FlowControlNodes
+static bool IsLoop(const ComputationNodeBasePtr& node)
+{
+    return dynamic_cast<const FlowControlNode*>(node.get()) != nullptr;
+}
+
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::ForwardProp(const FrameRange& fr) /*override*/
 {
+    auto profiler = Environment().m_nodeProfiler.get();
     for (auto& node : m_nestedNodes)
     {
         if (node->IsOutOfDateWrtInputs())
         {
+            // a loop only goes into the trace; its nodes are accounted for individually by the SEQ traversal
+            NodeProfiler::Scope profile(profiler, node, NodeProfiler::Phase::forward, fr, /*withStats=*/profiler && !IsLoop(node));
+
             node->BeginForwardProp();
             node->ForwardProp(fr.WithLayout(node->GetMBLayout()));
             node->EndForwardProp();
@@ -146,10 +174,12 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
 /*virtual*/ void ComputationNetwork::PARTraversalFlowControlNode::Backprop(const FrameRange& fr, bool childrenInThisLoop, bool childrenInOuterLoop) /*override*/
 {
     childrenInThisLoop, childrenInOuterLoop; // TODO: think through what these mean when coming from PAR mode
+    auto profiler = Environment().m_nodeProfiler.get();
     // process nodes in pre-determined order
     for (auto pnode = m_nestedNodes.rbegin(); pnode != m_nestedNodes.rend(); pnode++) // iterate backwards over evaluation order
     {
         auto& node = *pnode;
+        NodeProfiler::Scope profile(profiler, node, NodeProfiler::Phase::backward, fr, /*withStats=*/profiler && !IsLoop(node));
 
         node->BeginBackprop();
         node->Backprop(fr.WithLayout(node->GetMBLayout()), true /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
@@ -210,12 +240,17 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
     // Note: Currently, this is limited to linear-time loops. But nothing stops the iteration below to, e.g., be a 2D iteration over an image
     // if we implement an according FrameRangeIteration.
     FrameRangeIteration range(GetMBLayout(), m_steppingDirection);
+    bool skipGaps = SkipsGaps();
+    NodeProfiler::Stopwatch stopwatch(m_nestedNodes[0]->Environment().m_nodeProfiler.get(), NodeProfiler::Phase::forward);
     for (auto t = range.begin(); t != range.end(); t++)
     {
+        if (skipGaps && GetMBLayout()->IsAllGaps(t.timeIdxInSeq))
+            continue;
         for (auto& node : m_nestedNodes)
         {
             node->ForwardProp(t);
             node->BumpEvalTimeStamp();
+            stopwatch.Lap(node, t);
         }
     }
 }
@@ -240,27 +275,42 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
     const auto& recurrentNodes = m_nestedNodes; // BUGBUG: -ForForward?? Does this mean we can remove non-ForForward?
     auto pMBLayout = recurrentNodes[0]->GetMBLayout();
     FrameRangeIteration range(pMBLayout, m_steppingDirection);
+    bool skipGaps = SkipsGaps();
+    NodeProfiler::Stopwatch stopwatch(recurrentNodes[0]->Environment().m_nodeProfiler.get(), NodeProfiler::Phase::backward);
     for (auto t = range.rbegin(); t != range.rend(); t++) // note: reverse iteration
     {
+        if (skipGaps && pMBLayout->IsAllGaps(t.timeIdxInSeq))
+            continue;
         for (auto nodeIter2 = recurrentNodes.rbegin(); nodeIter2 != recurrentNodes.rend(); ++nodeIter2)
         {
             auto& node2 = *nodeIter2;
             node2->Backprop(t, true /*childrenInThisLoop*/, false /*childrenInOuterLoop*/);
             // The above flags tell Backprop() to skip back-propagation from inside a node into
             // a node that is outside the loop, which is done later in EndBackprop() in PAR mode.
+            stopwatch.Lap(node2, t);
         }
     }
 }
 
+// with gap skipping, time steps that are gaps in all parallel sequences are not iterated over
+// No sequence spans such a step, so no recurrence reads it; its columns are left as they are, like any other gap.
+bool ComputationNetwork::SEQTraversalFlowControlNode::SkipsGaps() const
+{
+    return m_nestedNodes[0]->Environment().m_skipGaps && GetMBLayout()->HasGaps();
+}
+
 // called after last iteration step of ComputeGradient()
 /*virtual*/ void ComputationNetwork::SEQTraversalFlowControlNode::EndBackprop() /*override*/
 {
     // The following loop handles the case that a node inside the loop back-propagates a gradient into a node outside of the loop.
     // For efficiency, we perform this outside the loop in PAR mode. E.g., in one LSTM speech setup, we measured 12..14% overall speed-up.
+    auto profiler = m_nestedNodes[0]->Environment().m_nodeProfiler.get();
     for (auto nodeIter2 = m_nestedNodes.rbegin(); nodeIter2 != m_nestedNodes.rend(); ++nodeIter2)
     {
         auto& node2 = *nodeIter2;
-        node2->Backprop(FrameRange(m_nestedNodes[0]->GetMBLayout()), false /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
+        FrameRange fr(m_nestedNodes[0]->GetMBLayout());
+        NodeProfiler::Scope profile(profiler, node2, NodeProfiler::Phase::backward, fr, /*withStats=*/true, /*withTrace=*/false);
+        node2->Backprop(fr, false /*childrenInThisLoop*/, true /*childrenInOuterLoop*/);
     }
 
     // tell all nodes we are done for this iteraTion
@@ -296,16 +346,25 @@ ComputationNetwork::PARTraversalFlowControlNode::PARTraversalFlowControlNode(con
     }
 }
 
+// build the node -> loop map for FindInRecurrentLoops()
+// This is linear in the number of nodes in loops; callers that look up many nodes build it once.
+/*static*/ ComputationNetwork::NodeToLoopMap ComputationNetwork::MapNodesToRecurrentLoops(const std::vector<std::shared_ptr<SEQTraversalFlowControlNode>>& recurrentInfo)
+{
+    NodeToLoopMap loopOfNode;
+    for (auto& iter : recurrentInfo)
+        for (auto& node : iter->m_nestedNodes)
+            loopOfNode.insert(make_pair(node, iter)); // a node belongs to at most one loop; first one wins, as in the former linear search
+    return loopOfNode;
+}
+
 // find if node is part of a recurrent loop; and return the loop id
 // If found then return a pointer to the list of nodes of this loop.
-/*static*/ shared_ptr<ComputationNetwork::SEQTraversalFlowControlNode> ComputationNetwork::FindInRecurrentLoops(const std::vector<std::shared_ptr<SEQTraversalFlowControlNode>>& recurrentInfo, const ComputationNodeBasePtr& node)
+/*static*/ shared_ptr<ComputationNetwork::SEQTraversalFlowControlNode> ComputationNetwork::FindInRecurrentLoops(const NodeToLoopMap& loopOfNode, const ComputationNodeBasePtr& node)
 {
-    // look in all recurrent loops of the network
-    // TODO: Check for IsPartOfLoop(). Also why not store the loop id in the node for direct lookup?
-    for (auto& iter : recurrentInfo)
-        if (std::find(iter->m_nestedNodes.begin(), iter->m_nestedNodes.end(), node) != iter->m_nestedNodes.end()) // TODO: should this loop need to be a method of SEQTraversalFlowControlNode?
-            return iter;
-    return nullptr; // not part of a recurrent loop
+    auto iter = loopOfNode.find(node);
+    if (iter == loopOfNode.end())
+        return nullptr; // not part of a recurrent loop
+    return iter->second;
 }
 
 // check if any of the nodes in the recurrence IsOutOfDateWrtInputs(), with exception of delay nodes for which this check would fail and must be skipped
@@ -616,7 +675,7 @@ bool ComputationNetwork::ValidateNode(ComputationNodeBasePtr node, bool isFinalV
 
 // perform one pass of validation over the topologically-sorted node set
 // returns how many nodes either could not yet be validated yet or have changed and thus must be redone
-size_t ComputationNetwork::ValidateNodes(list<ComputationNodeBasePtr> nodes, bool isFirstPass, bool isFinalValidationPass)
+size_t ComputationNetwork::ValidateNodes(const list<ComputationNodeBasePtr>& nodes, bool isFirstPass, bool isFinalValidationPass)
 {
     size_t todo = 0;
     for (auto& node : nodes)
@@ -673,48 +732,49 @@ size_t ComputationNetwork::ValidateNodes(list<ComputationNodeBasePtr> nodes, boo
 void ComputationNetwork::MarkValueNonSharableNodes()
 {
     const auto& nodes = GetEvalOrder(nullptr);
-    std::map<wstring, bool> allLeafDescendentsAreParametersOrPreComputeNodes;
-    std::list<ComputationNodeBasePtr> allLearnableParameters = GetNodesWithType(OperationNameOf(LearnableParameter));
+    std::unordered_map<ComputationNodeBasePtr, bool> allLeafDescendentsAreParametersOrPreComputeNodes;
+    std::unordered_set<ComputationNodeBasePtr> allLearnableParameters;
+    for (const auto& node : GetNodesWithType(OperationNameOf(LearnableParameter)))
+        allLearnableParameters.insert(node);
     // note that: we cannot use m_learnableParameters because we need all parameters node, regardless whether it requires update or not
 
-    std::list<ComputationNodeBasePtr> allPreComputeNodes;
+    std::unordered_set<ComputationNodeBasePtr> allPreComputeNodes;
     for (const auto& node : nodes)
     {
         if (node->Is<IPreComputeNode>())
-            allPreComputeNodes.push_back(node);
+            allPreComputeNodes.insert(node);
     }
 
     for (auto& node : nodes)
     {
-        auto children = node->GetInputs();
-        wstring myname = node->NodeName();
+        const auto& children = node->GetInputs();
         bool allParametersOrPreComputeNodes = true;
 
         if (children.size()) // we don't do the check for leaf node, cause all the possible leaf nodes (input/parameters/precompute node) are marked as non-sharable already
         {
-            if (std::find(allPreComputeNodes.begin(), allPreComputeNodes.end(), node) == allPreComputeNodes.end())
+            if (allPreComputeNodes.find(node) == allPreComputeNodes.end())
             {
-                for (auto child : children)
+                for (const auto& child : children)
                 {
-                    wstring ChildName = child->NodeName();
-                    if (allLeafDescendentsAreParametersOrPreComputeNodes.find(ChildName) == allLeafDescendentsAreParametersOrPreComputeNodes.end())
+                    auto childIter = allLeafDescendentsAreParametersOrPreComputeNodes.find(child);
+                    if (childIter == allLeafDescendentsAreParametersOrPreComputeNodes.end())
                     {
                         // not found, means it is a leaf node (we are at eval order )
                         assert(child->IsLeaf() || child->IsPartOfLoop());
-                        if (std::find(allLearnableParameters.begin(), allLearnableParameters.end(), child) != allLearnableParameters.end())
+                        if (allLearnableParameters.find(child) != allLearnableParameters.end())
                         {
-                            allLeafDescendentsAreParametersOrPreComputeNodes[ChildName] = true;
+                            allLeafDescendentsAreParametersOrPreComputeNodes[child] = true;
                         }
                         else
                         {
                             allParametersOrPreComputeNodes = false;
-                            allLeafDescendentsAreParametersOrPreComputeNodes[ChildName] = false;
+                            allLeafDescendentsAreParametersOrPreComputeNodes[child] = false;
                             break;
                         }
                     }
                     else
                     {
-                        if (allLeafDescendentsAreParametersOrPreComputeNodes[ChildName] == false)
+                        if (childIter->second == false)
                         {
                             allParametersOrPreComputeNodes = false;
                             break;
@@ -723,7 +783,7 @@ void ComputationNetwork::MarkValueNonSharableNodes()
                 }
             }
 
-            allLeafDescendentsAreParametersOrPreComputeNodes[myname] = allParametersOrPreComputeNodes;
+            allLeafDescendentsAreParametersOrPreComputeNodes[node] = allParametersOrPreComputeNodes;
             if (allParametersOrPreComputeNodes)
                 node->MarkValueNonSharable();
         }
@@ -797,17 +857,19 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
     // nodes corresponding to each of our roots and then arranging them in the
     // relative order that they appear in the global evaluation order
     const std::list<ComputationNodeBasePtr>& allNodesEvalOrder = GetEvalOrder(nullptr);
-    std::list<ComputationNodeBasePtr> nodesForForwardPropRoots = ComputationNodeBase::EnumerateNodes(forwardPropRoots);
+    std::list<ComputationNodeBasePtr> nodesForForwardPropRootsList = ComputationNodeBase::EnumerateNodes(forwardPropRoots);
+    std::unordered_set<ComputationNodeBasePtr> nodesForForwardPropRoots(nodesForForwardPropRootsList.begin(), nodesForForwardPropRootsList.end());
     std::vector<ComputationNodeBasePtr> compositeForwardPropEvalOrder;
     for (auto& node : allNodesEvalOrder)
     {
-        if (std::find(nodesForForwardPropRoots.cbegin(), nodesForForwardPropRoots.cend(), node) != nodesForForwardPropRoots.cend())
+        if (nodesForForwardPropRoots.find(node) != nodesForForwardPropRoots.end())
         {
             compositeForwardPropEvalOrder.push_back(node);
         }
     }
 
-    set<ComputationNodeBasePtr> completedEvaluate;
+    const NodeToLoopMap loopOfNode = MapNodesToRecurrentLoops(m_allSEQNodes);
+    unordered_set<ComputationNodeBasePtr> completedEvaluate;
     for (auto& nodeIter : compositeForwardPropEvalOrder)
     {
         nodeIter->SetOutputNeededDuringBackprop(outputValueNeededDuringBackProp[nodeIter]);
@@ -815,7 +877,7 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
         if (nodeIter->IsPartOfLoop())
         {
             // TODO: use FormNestedNetwork() here to avoid completedEvaluate[] check
-            shared_ptr<SEQTraversalFlowControlNode> recInfo = FindInRecurrentLoops(m_allSEQNodes, nodeIter);
+            shared_ptr<SEQTraversalFlowControlNode> recInfo = FindInRecurrentLoops(loopOfNode, nodeIter);
             assert(recInfo != nullptr);
             if (completedEvaluate.insert(recInfo).second)
             {
@@ -841,7 +903,7 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
         std::list<ComputationNodeBasePtr>& backPropNodes = GetEvalOrder(trainRootNode);
 
         // now, simulate the gradient computation order to determine how to allocate matrices
-        set<ComputationNodeBasePtr> completedGradient;
+        unordered_set<ComputationNodeBasePtr> completedGradient;
 
         // we need to call it here since we always compute gradients for children and root node is not children of other node
         trainRootNode->RequestMatricesBeforeBackprop(m_matrixPool);
@@ -852,7 +914,7 @@ void ComputationNetwork::AllocateAllMatrices(const std::vector<ComputationNodeBa
             if (n->IsPartOfLoop())
             {
                 std::vector<ComputationNodeBasePtr> recurrentNodes;
-                shared_ptr<SEQTraversalFlowControlNode> recInfo = FindInRecurrentLoops(m_allSEQNodes, n);
+                shared_ptr<SEQTraversalFlowControlNode> recInfo = FindInRecurrentLoops(loopOfNode, n);
                 if (completedGradient.insert(recInfo).second)
                 {
                     // SEQ mode: allocate all in loop first, then deallocate again
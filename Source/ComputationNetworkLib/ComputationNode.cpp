@@ -356,24 +356,68 @@ template <class ElemType>
     }
 }
 
-// write out the content of a node in formatted/readable form
+// append 'value' to 'out' as printf() would format it with 'format', which is "%f" or "%.<precision>f", or else anything printf() accepts
+// The fixed-point formats, which are by far the most common, are formatted without printf(), giving identical results.
+static void AppendFormattedValue(std::string& out, const char* format, int precision, double value)
+{
+    static const double powersOf10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15};
+    // (the scaled value must stay below 2^52, where its rounding is decided by the rounded product and its error)
+    if (precision >= 0 && precision <= 15 && std::isfinite(value) && fabs(value) * powersOf10[precision] < 4e15)
+    {
+        // round value * 10^precision to the nearest integer like printf(), i.e. exactly, with ties to even
+        double scale = powersOf10[precision];
+        double scaled = fabs(value) * scale;
+        double residual = fma(fabs(value), scale, -scaled); // exact error of the product
+        double rounded = nearbyint(scaled);                 // (default rounding mode: ties to even)
+        if (fabs(scaled - floor(scaled) - 0.5) == 0 && residual != 0) // tie of the rounded product, but not of the exact one
+            rounded = residual > 0 ? ceil(scaled) : floor(scaled);
+        unsigned long long digits = (unsigned long long) rounded;
+
+        char buf[32];
+        char* end = buf + sizeof(buf);
+        char* p = end;
+        for (int i = 0; i < precision; i++, digits /= 10)
+            *--p = (char) ('0' + digits % 10);
+        if (precision > 0)
+            *--p = '.';
+        do
+        {
+            *--p = (char) ('0' + digits % 10);
+            digits /= 10;
+        } while (digits > 0);
+        if (signbit(value))
+            *--p = '-';
+        out.append(p, end);
+        return;
+    }
+    char buf[512];
+    int len = snprintf(buf, sizeof(buf), format, value);
+    out.append(buf, min((size_t) max(len, 0), sizeof(buf) - 1));
+}
+
+// format a minibatch that has been copied to the CPU ('matData', column by column) according to the options of WriteMinibatchWithFormatting()
+// For category labels, 'matData' gets modified in place.
 template <class ElemType>
-void ComputationNode<ElemType>::WriteMinibatchWithFormatting(FILE* f, size_t onlyUpToRow, size_t onlyUpToT, bool transpose, bool isCategoryLabel, 
-                                                             const std::vector<std::string>& labelMapping, const string& sequenceSeparator, 
-                                                             const string& sequencePrologue, const string& sequenceEpilogue,
-                                                             const string& elementSeparator, const string& sampleSeparator,
-                                                             const string& valueFormatString,
-                                                             bool outputGradient) const
+/*static*/ void ComputationNode<ElemType>::FormatMinibatch(std::string& out, ElemType* matData, size_t matRows, MBLayoutPtr pMBLayout,
+                                                          size_t onlyUpToRow, size_t onlyUpToT, bool transpose, bool isCategoryLabel,
+                                                          const std::vector<std::string>& labelMapping, const string& sequenceSeparator,
+                                                          const string& sequencePrologue, const string& sequenceEpilogue,
+                                                          const string& elementSeparator, const string& sampleSeparator,
+                                                          const string& valueFormatString)
 {
-    // get minibatch matrix -> matData, matRows, matStride
-    const Matrix<ElemType>& outputValues = outputGradient ? Gradient() : Value();
-    let matRows   = outputValues.GetNumRows();
     let matStride = matRows; // how to get from one column to the next
-    std::unique_ptr<ElemType[]> matDataPtr(outputValues.CopyToArray());
-    ElemType* matData = matDataPtr.get();
+
+    // "%f" and "%.<n>f" are formatted by AppendFormattedValue() itself
+    let formatChar = valueFormatString.back();
+    int precision = -1;
+    if (valueFormatString == "%f")
+        precision = 6;
+    else if (formatChar == 'f' && valueFormatString.size() > 3 && valueFormatString.compare(0, 2, "%.") == 0 &&
+             valueFormatString.find_first_not_of("0123456789", 2) == valueFormatString.size() - 1)
+        precision = atoi(valueFormatString.c_str() + 2);
+    char buf[512];
 
     // process all sequences one by one
-    MBLayoutPtr pMBLayout = GetMBLayout();
     if (!pMBLayout) // no MBLayout: We are printing aggregates (or LearnableParameters?)
     {
         pMBLayout = make_shared<MBLayout>();
@@ -397,16 +441,15 @@ void ComputationNode<ElemType>::WriteMinibatchWithFormatting(FILE* f, size_t onl
         let  seqStride = pMBLayout->GetNumParallelSequences() * matStride;
 
         if (s > 0)
-            fprintfOrDie(f, "%s", sequenceSeparator.c_str());
-        fprintfOrDie(f, "%s", sequencePrologue.c_str());
+            out += sequenceSeparator;
+        out += sequencePrologue;
 
         // output it according to our format specification
-        let formatChar = valueFormatString.back();
         if (isCategoryLabel) // if is category then find the max value and output its index (possibly mapped to a string)
         {
             if (formatChar == 's') // verify label dimension
             {
-                if (outputValues.GetNumRows() != labelMapping.size())
+                if (matRows != labelMapping.size())
                     InvalidArgument("write: Row dimension %d does not match number of entries %d in labelMappingFile", (int)seqRows, (int)labelMapping.size());
             }
             // update the matrix in-place from one-hot (or max) to index
@@ -438,41 +481,62 @@ void ComputationNode<ElemType>::WriteMinibatchWithFormatting(FILE* f, size_t onl
         for (size_t j = 0; j < jend; j++)
         {
             if (j > 0)
-                fprintfOrDie(f, "%s", sampleSeparator.c_str());
+                out += sampleSeparator;
             if (j == jstop)
             {
-                fprintf(f, "...+%d", (int)(jend - jstop)); // 'nuff said
+                sprintf(buf, "...+%d", (int)(jend - jstop)); // 'nuff said
+                out += buf;
                 break;
             }
             for (size_t i = 0; i < iend; i++)
             {
                 if (i > 0)
-                    fprintfOrDie(f, "%s", elementSeparator.c_str());
+                    out += elementSeparator;
                 if (i == istop)
                 {
-                    fprintf(f, "...+%d", (int)(iend - istop));
+                    sprintf(buf, "...+%d", (int)(iend - istop));
+                    out += buf;
                     break;
                 }
                 double dval = seqData[i * istride + j * jstride];
                 if (formatChar == 'f') // print as real number
                 {
-                    fprintfOrDie(f, valueFormatString.c_str(), dval);
+                    AppendFormattedValue(out, valueFormatString.c_str(), precision, dval);
                 }
                 else if (formatChar == 'u') // print category as integer index
                 {
-                    fprintfOrDie(f, valueFormatString.c_str(), (unsigned int)dval);
+                    int len = snprintf(buf, sizeof(buf), valueFormatString.c_str(), (unsigned int)dval);
+                    out.append(buf, min((size_t) max(len, 0), sizeof(buf) - 1));
                 }
                 else if (formatChar == 's') // print category as a label string
                 {
                     size_t uval = (size_t)dval;
                     assert(uval < labelMapping.size());
-                    const char * sval = labelMapping[uval].c_str();
-                    fprintfOrDie(f, valueFormatString.c_str(), sval);
+                    out += msra::strfun::_strprintf<char>(valueFormatString.c_str(), labelMapping[uval].c_str());
                 }
             }
         }
-        fprintfOrDie(f, "%s", sequenceEpilogue.c_str());
+        out += sequenceEpilogue;
     } // end loop over sequences
+}
+
+// write out the content of a node in formatted/readable form
+template <class ElemType>
+void ComputationNode<ElemType>::WriteMinibatchWithFormatting(FILE* f, size_t onlyUpToRow, size_t onlyUpToT, bool transpose, bool isCategoryLabel, 
+                                                             const std::vector<std::string>& labelMapping, const string& sequenceSeparator, 
+                                                             const string& sequencePrologue, const string& sequenceEpilogue,
+                                                             const string& elementSeparator, const string& sampleSeparator,
+                                                             const string& valueFormatString,
+                                                             bool outputGradient) const
+{
+    // get minibatch matrix -> matData, matRows
+    const Matrix<ElemType>& outputValues = outputGradient ? Gradient() : Value();
+    std::unique_ptr<ElemType[]> matDataPtr(outputValues.CopyToArray());
+
+    std::string out;
+    FormatMinibatch(out, matDataPtr.get(), outputValues.GetNumRows(), GetMBLayout(), onlyUpToRow, onlyUpToT, transpose, isCategoryLabel, labelMapping,
+                    sequenceSeparator, sequencePrologue, sequenceEpilogue, elementSeparator, sampleSeparator, valueFormatString);
+    fwriteOrDie(out.data(), 1, out.size(), f);
     fflushOrDie(f);
 }
 
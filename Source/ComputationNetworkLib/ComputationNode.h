@@ -23,6 +23,7 @@
 #include <algorithm>
 #include <assert.h>
 #include <atomic>
+#include <functional>
 
 #define DEFAULT_HIDDEN_ACTIVATION 0.1
 
@@ -587,6 +588,7 @@ public:
     // helper to access to element(0,0) without having to type-cast
     virtual double Get00Element() const = 0;
     virtual MatrixBasePtr ValuePtr() const = 0; // for use in readers that pass the agnostic object around
+    virtual void GetAllocatedBytes(size_t& valueBytes, size_t& gradientBytes) const = 0; // buffer sizes of value and gradient, for NodeProfiler
 
     // TODO: two sets of functions, choose one
     const std::wstring& NodeName() const { return m_nodeName; }
@@ -599,6 +601,8 @@ public:
     }
 
     bool NeedsGradient() const { return m_needsGradient; }
+    bool IsGradientInitialized() const { return m_gradientInitialized; }
+    void SetGradientInitialized(bool initialized) { m_gradientInitialized = initialized; } // true to keep and accumulate into the current gradient, see ComputationNetwork::Backprop()
 
     void SetLearningRateMultiplier(float f) 
     { 
@@ -739,7 +743,7 @@ public:
         std::unordered_set<ComputationNodeBasePtr> visited;
 
         for (const auto& root : allRoots)
-            root->EnumerateNodesRec(visited, nodes); // call into the recursive portion of this function below
+            root->EnumerateNodesRec(visited, nodes); // call into the depth-first portion of this function below
 
         return nodes;
     }
@@ -752,20 +756,33 @@ public:
 
 private:
 
-    // Recursive part of EnumerateNodes().
+    // Depth-first part of EnumerateNodes().
+    // This uses an explicit stack rather than recursion, since generated networks can be tens of thousands of nodes deep.
     void EnumerateNodesRec(std::unordered_set<ComputationNodeBasePtr>& visited, std::list<ComputationNodeBasePtr>& result) /*const*/ // const not working due to shared_from_this()
     {
-        if (visited.find(shared_from_this()) == visited.end()) // do not include a node twice
-        {
-            visited.insert(shared_from_this()); // have visited tagged here to avoid infinite loop over children, children's children, etc
-
-            // children first for function evaluation
-            for (int i = 0; i < m_inputs.size(); i++)
-                if (m_inputs[i])
-                    m_inputs[i]->EnumerateNodesRec(visited, result);
+        if (!visited.insert(shared_from_this()).second) // do not include a node twice
+            return;
 
-            // now that all children are in list before us, put ourselves
-            result.push_back(shared_from_this());
+        std::vector<std::pair<ComputationNodeBase*, size_t>> stack; // [depth] -> (node, index of next input to visit)
+        stack.push_back(std::make_pair(this, (size_t) 0));
+        while (!stack.empty())
+        {
+            auto node = stack.back().first;
+            size_t i = stack.back().second++;
+            if (i < node->m_inputs.size())
+            {
+                // children first for function evaluation
+                // visited is tagged here to avoid infinite loop over children, children's children, etc
+                const auto& input = node->m_inputs[i];
+                if (input && visited.insert(input).second)
+                    stack.push_back(std::make_pair(input.get(), (size_t) 0));
+            }
+            else
+            {
+                // now that all children are in list before us, put ourselves
+                result.push_back(node->shared_from_this());
+                stack.pop_back();
+            }
         }
     }
 
@@ -908,9 +925,18 @@ public:
         if (flags & CopyNodeFlags::copyNodeValue)
         {
             auto node = DownCast(nodeP);
-            node->m_value->SetValue(*m_value);
+            if (m_value) // non-leaf nodes have no value matrix until AllocateAllMatrices()
+            {
+                node->CreateMatrixIfNull(node->m_value);
+                node->m_value->SetValue(*m_value);
+            }
+            else
+                node->m_value = nullptr;
             if (m_gradient)
+            {
+                node->CreateMatrixIfNull(node->m_gradient);
                 node->m_gradient->SetValue(*m_gradient);
+            }
             else
                 node->m_gradient = nullptr;
         }
@@ -921,7 +947,7 @@ public:
     {
         const std::wstring& name = (newName == L"") ? NodeName() : newName;
         ComputationNodeBasePtr node(NewThis(m_deviceId, name)); // NewThis() is a virtual function that creates a new node of the actual type of 'this'
-        node->CopyTo(shared_from_this(), newName, flags);       // note: shared_from_this() is the base class, but CopyTo() up-casts it as needed
+        CopyTo(node, name, flags);                              // note: CopyTo() up-casts 'node' to the actual type as needed
         return node;
     }
 
@@ -1095,6 +1121,42 @@ public:
         MaskMissingColumnsTo(*m_gradient, m_pMBLayout, fr, Matrix<ElemType>::MakeNan(__LINE__));
     }
 
+    // -----------------------------------------------------------------------
+    // gap skipping
+    // -----------------------------------------------------------------------
+
+    // If gap skipping is enabled (ComputationEnvironment::m_skipGaps) and 'fr' is an entire minibatch with enough gaps,
+    // this returns a [1 x #valid frames] map of the non-gap columns of 'pMBLayout'. Nodes use it to compute on a compacted
+    // copy of the minibatch (Matrix::DoGatherColumnsOf()) and to expand the result back (Matrix::DoScatterColumnsOf()).
+    // Otherwise it returns nullptr, and the node computes on the full [S x T] grid as usual.
+    const Matrix<ElemType>* GetValidColumnMap(const MBLayoutPtr& pMBLayout, const FrameRange& fr)
+    {
+        if (!m_environment || !Environment().m_skipGaps || !pMBLayout || !fr.IsAllFrames() || fr.seqIndex != SIZE_MAX || !pMBLayout->HasGaps())
+            return nullptr;
+        // gather and scatter are extra passes over the data, which only pay off if a good part of the grid is gaps
+        if (pMBLayout->GetActualNumSamples() * 8 > pMBLayout->GetNumCols() * 7)
+            return nullptr;
+
+        const auto& validColumns = pMBLayout->GetValidColumnIndices();
+        if (!m_validColumnMap || validColumns != m_validColumnIndices) // layout differs from the last call: rebuild the map
+        {
+            m_validColumnIndices = validColumns;
+            vector<ElemType> map(validColumns.begin(), validColumns.end());
+            if (!m_validColumnMap)
+                m_validColumnMap = make_shared<Matrix<ElemType>>(m_deviceId);
+            m_validColumnMap->SetValue(1, map.size(), m_deviceId, map.data());
+        }
+        return m_validColumnMap.get();
+    }
+
+    // tensor view of a matrix that holds a compacted minibatch of this node's sample layout, one column per valid frame
+    TensorView<ElemType> CompactTensorFor(const Matrix<ElemType>& data, size_t numValidColumns) const
+    {
+        TensorShape tensorShape(GetSampleLayout().GetDims());
+        tensorShape.AppendInPlace(tensorShape.GetRank(), numValidColumns);
+        return TensorView<ElemType>(data, tensorShape);
+    }
+
     // -----------------------------------------------------------------------
     // accessors for value and gradient
     // -----------------------------------------------------------------------
@@ -1105,6 +1167,12 @@ public:
     MatrixBasePtr ValuePtr() const override final { return m_value; }    // readers want this as a shared_ptr straight
     // Note: We cannot return a const& since returning m_value as a MatrixBasePtr is a type cast that generates a temporary. Interesting.
 
+    void GetAllocatedBytes(size_t& valueBytes, size_t& gradientBytes) const override final
+    {
+        valueBytes    = m_value    ? m_value->BufferSize()    : 0;
+        gradientBytes = m_gradient ? m_gradient->BufferSize() : 0;
+    }
+
     const Matrix<ElemType>& Gradient() const { return *m_gradient; }
     Matrix<ElemType>&       Gradient()       { return *m_gradient; }
 
@@ -1471,6 +1539,10 @@ public:
                                       const std::string& sequencePrologue, const std::string& sequenceEpilogue, const std::string& elementSeparator,
                                       const std::string& sampleSeparator, const std::string& valueFormatString,
                                       bool outputGradient = false) const;
+    static void FormatMinibatch(std::string& out, ElemType* matData, size_t matRows, MBLayoutPtr pMBLayout, size_t onlyUpToRow, size_t onlyUpToT,
+                                bool transpose, bool isCategoryLabel, const std::vector<std::string>& labelMapping, const std::string& sequenceSeparator,
+                                const std::string& sequencePrologue, const std::string& sequenceEpilogue, const std::string& elementSeparator,
+                                const std::string& sampleSeparator, const std::string& valueFormatString);
 
     void Trace()
     {
@@ -1594,6 +1666,10 @@ protected:
 
     shared_ptr<Matrix<ElemType>> m_value, m_gradient;
 
+    // cache for GetValidColumnMap()
+    shared_ptr<Matrix<ElemType>> m_validColumnMap;
+    vector<size_t> m_validColumnIndices;
+
     static std::map<size_t, std::map<size_t, Matrix<ElemType>*>> s_constOnes;
 };
 
@@ -1684,6 +1760,7 @@ public:
     virtual bool RequiresPreCompute() const override { return false; } // return true if the node's value should be computed before the normal training. e.g., mean and invStd of input features.
     virtual std::string FormatOperationPrototype(const std::string& extraArgs) const override { return ""; }
     virtual void DumpNodeInfo(const bool /*printValues*/, const bool /*printMetadata*/, File& fstream) const override {}
+    virtual void GetAllocatedBytes(size_t& valueBytes, size_t& gradientBytes) const override { valueBytes = gradientBytes = 0; } // nested nodes are accounted for individually
 
 protected: public:                                     // needed in ComputationNetwork::FindInRecurrentLoops(), which really should be part of SEQTraversalFlowControlNode
     std::vector<ComputationNodeBasePtr> m_nestedNodes; // nodes tucked away in this node, in evaluation order
@@ -1740,6 +1817,9 @@ struct IPreComputeNode
     // call this with 'false' at start and with 'true' at end
     // This is used for resetting and updating from accumulators.
     virtual void MarkComputed(const bool hasComputed) = 0;
+    // distributed precomputation: when each worker has accumulated over its share of the data, merge the accumulators
+    // of all workers before calling MarkComputed(true). 'allReduce' sums an array element-wise across all workers, in place.
+    virtual void AggregateAccumulators(const std::function<void(double*, size_t)>& allReduce) = 0;
 };
 
 // =======================================================================
@@ -1759,6 +1839,7 @@ struct IPreComputeNode
 protected:                                                                                                                                               \
     typedef shared_ptr<ComputationNode<ElemType>> ComputationNodePtr;                                                                                    \
     using Base::BackpropTo;                                                                                                                              \
+    using Base::CompactTensorFor;                                                                                                                        \
     using Base::ConstOnes;                                                                                                                               \
     using Base::CopyTo;                                                                                                                                  \
     using Base::CreateMatrixIfNull;                                                                                                                      \
@@ -1786,6 +1867,7 @@ protected:
     using Base::GetSampleMatrixNumRows;                                                                                                                  \
     using Base::GetTensorShape;                                                                                                                          \
     using Base::GetTensorSliceFor;                                                                                                                       \
+    using Base::GetValidColumnMap;                                                                                                                       \
     using Base::Gradient;                                                                                                                                \
     using Base::GradientAsMatrix;                                                                                                                        \
     using Base::GradientFor;                                                                                                                             \
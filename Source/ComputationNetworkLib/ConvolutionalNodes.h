@@ -277,6 +277,11 @@ public:
         m_maxTempMemSizeInSamples = maxTempMemSizeInSamples;
     }
 
+    ImageLayoutKind GetImageLayoutKind() const
+    {
+        return m_imageLayoutKind;
+    }
+
     // request matrices needed to do node function value evaluation
     void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override
     {
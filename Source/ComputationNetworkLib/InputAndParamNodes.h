@@ -262,6 +262,13 @@ public:
         LogicError("%ls %ls operation is a leaf node. BackpropTo() should never be called.", NodeName().c_str(), OperationName().c_str());
     }
 
+    // The gradient is not taken from the pool: a pooled matrix is still referenced by the node that released it,
+    // which would overwrite it in the next Backprop(). Sub-minibatch accumulation needs it to survive intact.
+    virtual void RequestMatricesBeforeBackprop(MatrixPool& /*matrixPool*/) override
+    {
+        CreateGradientMatrixIfNull();
+    }
+
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
     {
         Base::Validate(isFinalValidationPass);
@@ -624,6 +631,10 @@ public:
     {
         if (inputIndex == 0) // left derivative (embedding matrix)
         {
+            // If input data is sparse, then gradient is block sparse: only the looked-up columns are kept, and updated by SGD.
+            if (Input(1)->Value().GetMatrixType() == SPARSE && Input(0)->Gradient().GetMatrixType() == DENSE && Gradient().GetMatrixType() == DENSE)
+                Input(0)->Gradient().SwitchToMatrixType(SPARSE, MatrixFormat::matrixFormatSparseBlockCol, false);
+
             // This is a reduction operation, hence we need to mask out gaps.
             Matrix<ElemType> sliceInput1Value = Input(1)->MaskedValueFor(t);
             Matrix<ElemType> sliceOutputGrad = MaskedGradientFor(t);
@@ -706,6 +717,18 @@ public:
         SetDims(TensorShape(Input(0)->GetAsMatrixNumRows() * wordsInEachSample), true);
     }
 
+    virtual void AllocateGradientMatricesForInputs(MatrixPool& matrixPool) override
+    {
+        // same as TimesNode: a sparse input makes the embedding gradient block sparse, which must not come from the pool
+        if (Input(0)->NeedsGradient() && Input(1)->Value().GetMatrixType() == SPARSE)
+        {
+            Input(0)->CreateGradientMatrixIfNull();
+            Input(0)->Gradient().SwitchToMatrixType(SPARSE, MatrixFormat::matrixFormatSparseBlockCol, false);
+        }
+
+        Base::AllocateGradientMatricesForInputs(matrixPool);
+    }
+
     bool UnitTest()
     {
         try
@@ -199,6 +199,20 @@ public:
 
     virtual void /*ComputationNode::*/ ForwardProp(const FrameRange& fr) override
     {
+        // with gap skipping, only the valid columns are multiplied, and the gaps of the output are set to zero
+        if (auto validColumnMap = GetValidColumnMapForProduct(fr))
+        {
+            size_t numValidColumns = validColumnMap->GetNumCols();
+            m_compactInput1->DoGatherColumnsOf(0, *validColumnMap, Input(1)->Value(), 1);
+            m_compactOutput->Resize(GetSampleMatrixNumRows(), numValidColumns);
+            auto output =           CompactTensorFor(*m_compactOutput, numValidColumns);
+            auto input0 = Input(0)->ValueTensorFor(Input(0)->GetSampleLayout().GetRank(), FrameRange(/*select entire object*/));
+            auto input1 = Input(1)->CompactTensorFor(*m_compactInput1, numValidColumns);
+            output.AssignMatrixProductOf(false/*transC*/, input0, m_transpose/*transA*/, input1, false/*transB*/);
+            Value().DoScatterColumnsOf(0, *validColumnMap, *m_compactOutput, 1);
+            return;
+        }
+
         // TensorView::DoMatrixProductOf() will reduce each tensor object into a 2D tensor (or fail if it cannot)
         // and recreate actual Matrix objects (in case of sparse, they must be identical to the original tensor storage object).
         // Transposition is applied after flattening into 2D.
@@ -210,6 +224,33 @@ public:
 
     virtual void /*ComputationNode::*/ BackpropTo(const size_t inputIndex, const FrameRange& fr) override
     {
+        // with gap skipping, the products run over the valid columns only, so no masking is needed
+        auto validColumnMap = GetValidColumnMapForProduct(fr);
+        if (validColumnMap && inputIndex == 0 && Input(0)->Gradient().GetMatrixType() == DENSE)
+        {
+            size_t numValidColumns = validColumnMap->GetNumCols();
+            m_compactInput1->DoGatherColumnsOf(0, *validColumnMap, Input(1)->Value(), 1);
+            m_compactOutput->DoGatherColumnsOf(0, *validColumnMap, Gradient(), 1);
+            auto outputGradient =           CompactTensorFor(*m_compactOutput, numValidColumns);
+            auto input0Gradient = Input(0)->GradientTensorFor(Input(0)->GetSampleLayout().GetRank(), FrameRange(/*select entire object*/));
+            auto input1         = Input(1)->CompactTensorFor(*m_compactInput1, numValidColumns);
+            input0Gradient.AddMatrixProductOf(m_transpose/*transC*/, outputGradient, false/*transA*/, input1, true/*transB*/);
+            return;
+        }
+        else if (validColumnMap && inputIndex == 1)
+        {
+            // the input gradient is computed compacted in m_compactInput1 and then added to the valid columns
+            size_t numValidColumns = validColumnMap->GetNumCols();
+            m_compactOutput->DoGatherColumnsOf(0, *validColumnMap, Gradient(), 1);
+            m_compactInput1->Resize(Input(1)->GetSampleMatrixNumRows(), numValidColumns);
+            auto outputGradient =           CompactTensorFor(*m_compactOutput, numValidColumns);
+            auto input0         = Input(0)->   ValueTensorFor(Input(0)->GetSampleLayout().GetRank(), FrameRange(/*select entire object*/));
+            auto input1Gradient = Input(1)->CompactTensorFor(*m_compactInput1, numValidColumns);
+            input1Gradient.AssignMatrixProductOf(false/*transC*/, input0, !m_transpose/*transA*/, outputGradient, false/*transB*/);
+            Input(1)->Gradient().DoScatterColumnsOf(1, *validColumnMap, *m_compactInput1, 1);
+            return;
+        }
+
         if (inputIndex == 0) // left derivative
         {
             // currently we only support one combination when the input is sparse
@@ -237,6 +278,22 @@ public:
     virtual bool OutputUsedInComputingInputNodesGradients() const override { return false; }
     // but both inputs are
 
+    // request matrices needed to do node function value evaluation
+    virtual void RequestMatricesBeforeForwardProp(MatrixPool& matrixPool) override
+    {
+        Base::RequestMatricesBeforeForwardProp(matrixPool);
+        RequestMatrixFromPool(m_compactInput1, matrixPool);
+        RequestMatrixFromPool(m_compactOutput, matrixPool);
+    }
+
+    // release gradient and temp matrices that no longer needed after all the children's gradients are computed.
+    virtual void ReleaseMatricesAfterBackprop(MatrixPool& matrixPool) override
+    {
+        Base::ReleaseMatricesAfterBackprop(matrixPool);
+        ReleaseMatrixToPool(m_compactInput1, matrixPool);
+        ReleaseMatrixToPool(m_compactOutput, matrixPool);
+    }
+
     virtual void /*ComputationNodeBase::*/ Validate(bool isFinalValidationPass) override
     {
         Base::Validate(isFinalValidationPass);
@@ -354,7 +411,19 @@ public:
     }
 
 private:
+    // map of the valid columns if gap skipping applies; sparse right operands are multiplied in place as before
+    const Matrix<ElemType>* GetValidColumnMapForProduct(const FrameRange& fr)
+    {
+        if (!Input(1)->HasMBLayout() || Input(1)->Value().GetMatrixType() == SPARSE)
+            return nullptr;
+        return GetValidColumnMap(Input(1)->GetMBLayout(), fr);
+    }
+
     size_t m_outputRank;
+
+    // temp matrices for gap skipping: compacted right operand (or its gradient) and compacted output (or its gradient)
+    shared_ptr<Matrix<ElemType>> m_compactInput1;
+    shared_ptr<Matrix<ElemType>> m_compactOutput;
 };
 
 // -----------------------------------------------------------------------
@@ -0,0 +1,172 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS // "secure" CRT not available on all platforms  --add this at the top of all CPP files that give "function or variable may be unsafe" warnings
+
+#include "Basics.h"
+#include "NodeProfiler.h"
+#include "fileutil.h"
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+NodeProfiler::NodeProfiler(bool withStats, const wstring& traceFilePath, size_t maxTraceEvents)
+    : m_withStats(withStats), m_startTime(Clock::now()), m_traceFile(nullptr), m_numTraceEvents(0), m_maxTraceEvents(maxTraceEvents)
+{
+    if (!traceFilePath.empty())
+    {
+        m_traceFile = fopenOrDie(traceFilePath, L"w");
+        fputs("[\n", m_traceFile);
+    }
+}
+
+NodeProfiler::~NodeProfiler()
+{
+    if (m_traceFile)
+    {
+        fputs("\n]\n", m_traceFile);
+        fclose(m_traceFile);
+    }
+}
+
+// a string as JSON string contents, UTF-8 with quotes, backslashes, and control characters escaped
+static string JsonEscape(const wstring& str)
+{
+    string escaped;
+    for (char c : msra::strfun::utf8(str))
+    {
+        if (c == '"' || c == '\\')
+            escaped += '\\';
+        if ((unsigned char) c < 0x20)
+            escaped += msra::strfun::strprintf("\\u%04x", (int) c);
+        else
+            escaped += c;
+    }
+    return escaped;
+}
+
+// number of matrix columns a node call operates on: the whole minibatch, or one time step of all or one parallel sequence
+/*static*/ size_t NodeProfiler::GetNumColumns(const ComputationNodeBase& node, const FrameRange& fr)
+{
+    if (!node.HasMBLayout())
+        return 1;
+    const auto& pMBLayout = node.GetMBLayout();
+    if (fr.IsAllFrames())
+        return pMBLayout->GetNumCols();
+    return fr.seqIndex == SIZE_MAX ? pMBLayout->GetNumParallelSequences() : 1;
+}
+
+// rough number of floating-point operations per column of a node call
+// Matrix products count 2 per multiply-add (the backward pass has two of them); all other nodes count one per output element.
+/*static*/ double NodeProfiler::EstimateFlopsPerColumn(const ComputationNodeBase& node, Phase phase)
+{
+    if (node.IsLeaf()) // inputs and parameters do not compute anything
+        return 0;
+    const auto operationName = node.OperationName();
+    if ((operationName == L"Times" || operationName == L"TransposeTimes") && node.GetNumInputs() == 2)
+    {
+        // [M x K] * [K x N] with the left operand not being minibatch data: 2 * M * K flops per column
+        double flops = 2.0 * node.GetInputs()[0]->GetSampleLayout().GetNumElements();
+        return phase == Phase::backward ? 2 * flops : flops;
+    }
+    return (double) node.GetSampleLayout().GetNumElements();
+}
+
+// add 'numCalls' calls over a total of 'numColumns' columns to the statistics of a node
+void NodeProfiler::AddCalls(const ComputationNodeBase& node, Phase phase, size_t numCalls, size_t numColumns, double seconds)
+{
+    if (!m_withStats)
+        return;
+    const int p = (int) phase;
+    auto iter = m_stats.find(&node);
+    if (iter == m_stats.end())
+    {
+        NodeStats stats = {};
+        stats.nodeName = node.NodeName();
+        stats.operationName = node.OperationName();
+        stats.flopsPerColumn[(int) Phase::forward]  = EstimateFlopsPerColumn(node, Phase::forward);
+        stats.flopsPerColumn[(int) Phase::backward] = EstimateFlopsPerColumn(node, Phase::backward);
+        iter = m_stats.insert(make_pair(&node, stats)).first;
+    }
+    auto& stats = iter->second;
+    stats.seconds[p] += seconds;
+    stats.numCalls[p] += numCalls;
+    stats.flops += stats.flopsPerColumn[p] * numColumns;
+    size_t valueBytes, gradientBytes;
+    node.GetAllocatedBytes(valueBytes, gradientBytes);
+    stats.valueBytes = max(stats.valueBytes, valueBytes);
+    stats.gradientBytes = max(stats.gradientBytes, gradientBytes);
+}
+
+void NodeProfiler::Record(const ComputationNodeBase& node, Phase phase, size_t numColumns, Clock::time_point begin, Clock::time_point end, bool withStats, bool withTrace)
+{
+    const double seconds = chrono::duration<double>(end - begin).count();
+    const int p = (int) phase;
+
+    if (withStats)
+        AddCalls(node, phase, 1, numColumns, seconds);
+
+    if (withTrace && m_traceFile)
+    {
+        if (m_numTraceEvents == m_maxTraceEvents)
+        {
+            fprintf(stderr, "NodeProfiler: Trace reached %d events, further node calls are not traced.\n", (int) m_maxTraceEvents);
+            fputs("\n]\n", m_traceFile);
+            fclose(m_traceFile);
+            m_traceFile = nullptr;
+            return;
+        }
+        // Chrome trace 'complete' event; timestamps and durations are in microseconds
+        const double ts = chrono::duration<double, micro>(begin - m_startTime).count();
+        fprintf(m_traceFile, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%d,\"args\":{\"op\":\"%s\",\"columns\":%d}}",
+                m_numTraceEvents > 0 ? ",\n" : "", JsonEscape(node.NodeName()).c_str(), phase == Phase::forward ? "forward" : "backward",
+                ts, seconds * 1e6, p, JsonEscape(node.OperationName()).c_str(), (int) numColumns);
+        m_numTraceEvents++;
+    }
+}
+
+void NodeProfiler::WriteReport(FILE* f, const string& title)
+{
+    if (m_traceFile)
+        fflush(m_traceFile);
+    if (!m_withStats)
+        return;
+
+    vector<const NodeStats*> sorted;
+    double totalSeconds[2] = {0, 0};
+    for (const auto& entry : m_stats)
+    {
+        sorted.push_back(&entry.second);
+        totalSeconds[0] += entry.second.seconds[0];
+        totalSeconds[1] += entry.second.seconds[1];
+    }
+    sort(sorted.begin(), sorted.end(), [](const NodeStats* a, const NodeStats* b)
+         {
+             return a->seconds[0] + a->seconds[1] > b->seconds[0] + b->seconds[1];
+         });
+
+    fprintf(f, "\nNode profile %s: forward %.3f s, backward %.3f s\n", title.c_str(), totalSeconds[0], totalSeconds[1]);
+    fprintf(f, "  %%time  forward ms   calls  backward ms   calls   GFlop/s  value MB   grad MB  node\n");
+    const double totalTime = totalSeconds[0] + totalSeconds[1];
+    for (const auto* stats : sorted)
+    {
+        const double seconds = stats->seconds[0] + stats->seconds[1];
+        fprintf(f, "%7.2f %11.3f %7d %12.3f %7d %9.3f %9.2f %9.2f  %ls = %ls\n",
+                totalTime > 0 ? 100 * seconds / totalTime : 0.0,
+                stats->seconds[0] * 1e3, (int) stats->numCalls[0],
+                stats->seconds[1] * 1e3, (int) stats->numCalls[1],
+                seconds > 0 ? stats->flops / seconds / 1e9 : 0.0,
+                stats->valueBytes / 1048576.0, stats->gradientBytes / 1048576.0,
+                stats->nodeName.c_str(), stats->operationName.c_str());
+    }
+    fflush(f);
+
+    m_stats.clear();
+}
+
+}}}
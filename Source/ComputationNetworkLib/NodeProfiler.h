@@ -0,0 +1,156 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNode.h"
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// ===========================================================================
+// NodeProfiler -- opt-in per-node instrumentation of ForwardProp() and Backprop()
+//
+// When set as ComputationEnvironment::m_nodeProfiler, the PAR and SEQ traversals time every node call.
+// Per node, it accumulates wall time, call count, a FLOP estimate, and the peak Value/Gradient bytes.
+// WriteReport() prints these sorted by time and starts over, e.g. once per epoch.
+// Optionally, every top-level node call is also written as an event to a Chrome-trace JSON file
+// (load in chrome://tracing). Recurrent loops appear there as one event per loop. Events are written as they
+// happen, up to a maximum number, after which the trace is closed. Either part can be used without the other.
+//
+// Times are host wall times; with a GPU, kernels run asynchronously and are attributed to whichever node waits for them.
+// ===========================================================================
+
+class NodeProfiler
+{
+    typedef std::chrono::steady_clock Clock;
+
+public:
+    enum class Phase
+    {
+        forward,
+        backward
+    };
+
+    // statistics are only gathered and reported if 'withStats'; trace events are only written if a path is given
+    NodeProfiler(bool withStats, const std::wstring& traceFilePath = L"", size_t maxTraceEvents = 1000000);
+    ~NodeProfiler(); // closes the trace file
+
+    // RAII helper to time one node call; does nothing if no profiler is given
+    // 'withStats' and 'withTrace' select whether the call goes into the per-node statistics and the trace, respectively.
+    class Scope
+    {
+    public:
+        Scope(NodeProfiler* profiler, const ComputationNodeBasePtr& node, Phase phase, const FrameRange& fr, bool withStats = true, bool withTrace = true)
+            : m_profiler(profiler), m_node(node.get()), m_phase(phase), m_withStats(withStats), m_withTrace(withTrace)
+        {
+            if (!m_profiler)
+                return;
+            m_numColumns = GetNumColumns(*m_node, fr);
+            m_begin = Clock::now();
+        }
+        ~Scope()
+        {
+            if (m_profiler)
+                m_profiler->Record(*m_node, m_phase, m_numColumns, m_begin, Clock::now(), m_withStats, m_withTrace);
+        }
+
+    private:
+        NodeProfiler* m_profiler;
+        const ComputationNodeBase* m_node;
+        Phase m_phase;
+        size_t m_numColumns;
+        bool m_withStats, m_withTrace;
+        Clock::time_point m_begin;
+    };
+
+    // times node calls that follow each other back to back, as in the time steps of a loop, with one clock reading per call:
+    // each Lap() accounts the time since the previous one (or since construction) to the node that was just called
+    // Laps are summed up per node and go into the statistics upon destruction; the loop appears in the trace as a whole.
+    class Stopwatch
+    {
+    public:
+        Stopwatch(NodeProfiler* profiler, Phase phase)
+            : m_profiler(profiler), m_phase(phase), m_next(0)
+        {
+            if (m_profiler)
+                m_last = Clock::now();
+        }
+        ~Stopwatch()
+        {
+            if (m_profiler)
+                for (const auto& lap : m_laps)
+                    m_profiler->AddCalls(*lap.node, m_phase, lap.numCalls, lap.numColumns, std::chrono::duration<double>(lap.duration).count());
+        }
+        void Lap(const ComputationNodeBasePtr& node, const FrameRange& fr)
+        {
+            if (!m_profiler)
+                return;
+            auto now = Clock::now();
+            // the nodes of a loop are called in the same order in every time step, so the next entry is usually the one
+            if (m_next == m_laps.size() || m_laps[m_next].node != node.get())
+            {
+                for (m_next = 0; m_next < m_laps.size() && m_laps[m_next].node != node.get(); m_next++)
+                    ;
+                if (m_next == m_laps.size())
+                    m_laps.push_back(Laps{node.get(), 0, 0, Clock::duration::zero()});
+            }
+            auto& lap = m_laps[m_next];
+            lap.numCalls++;
+            lap.numColumns += GetNumColumns(*node, fr);
+            lap.duration += now - m_last;
+            m_last = now;
+            m_next = (m_next + 1) % m_laps.size();
+        }
+
+    private:
+        struct Laps
+        {
+            const ComputationNodeBase* node;
+            size_t numCalls;
+            size_t numColumns;
+            Clock::duration duration;
+        };
+        NodeProfiler* m_profiler;
+        Phase m_phase;
+        std::vector<Laps> m_laps;
+        size_t m_next; // index into m_laps of the expected next node
+        Clock::time_point m_last;
+    };
+
+    // print the statistics gathered since the last call, sorted by total time, and reset them; also flushes the trace
+    void WriteReport(FILE* f, const std::string& title);
+
+private:
+    void Record(const ComputationNodeBase& node, Phase phase, size_t numColumns, Clock::time_point begin, Clock::time_point end, bool withStats, bool withTrace);
+    void AddCalls(const ComputationNodeBase& node, Phase phase, size_t numCalls, size_t numColumns, double seconds);
+    static size_t GetNumColumns(const ComputationNodeBase& node, const FrameRange& fr);
+    static double EstimateFlopsPerColumn(const ComputationNodeBase& node, Phase phase);
+
+    struct NodeStats
+    {
+        std::wstring nodeName;
+        std::wstring operationName;
+        double flopsPerColumn[2]; // [phase] estimate, determined upon the first call
+        double seconds[2];        // [phase]
+        size_t numCalls[2];       // [phase]
+        double flops;
+        size_t valueBytes;    // peak
+        size_t gradientBytes; // peak
+    };
+    bool m_withStats;
+    std::unordered_map<const ComputationNodeBase*, NodeStats> m_stats;
+
+    Clock::time_point m_startTime; // trace timestamps are relative to this
+    FILE* m_traceFile;
+    size_t m_numTraceEvents;
+    size_t m_maxTraceEvents;
+};
+
+}}}
@@ -51,6 +51,12 @@ public:
         m_hasComputed = hasComputed;
     }
 
+    // only nodes whose accumulators can be merged support distributed precomputation
+    virtual void /*IPreComputeNode::*/ AggregateAccumulators(const std::function<void(double*, size_t)>& /*allReduce*/) override
+    {
+        LogicError("%ls %ls operation: Distributed precomputation is not supported.", NodeName().c_str(), OperationName().c_str());
+    }
+
     virtual bool RequiresPreCompute() const override { return true; }
 
     virtual void Save(File& fstream) const override
@@ -190,6 +196,51 @@ public:
     }
 
 protected:
+    // merge the partial mean (and optionally variance) accumulated by each worker into the statistics over all workers' samples
+    // This is the parallel-variance formula of Chan et al.: with N = sum_i n_i and mean = sum_i n_i mean_i / N,
+    //   var = sum_i n_i (var_i + (mean_i - mean)^2) / N
+    // Unlike summing up squares, it does not lose precision when the mean is large compared to the standard deviation.
+    // The sums are formed in double precision. Afterwards, m_numSamples is the total over all workers.
+    void AggregateMeanAndVariance(const std::function<void(double*, size_t)>& allReduce, Matrix<ElemType>& mean, Matrix<ElemType>* var)
+    {
+        if (!IsAccumulating())
+            LogicError("%ls %ls operation: AggregateAccumulators() called while not accumulating.", NodeName().c_str(), OperationName().c_str());
+
+        const size_t dim = mean.GetNumElements();
+        std::unique_ptr<ElemType[]> localMean(mean.CopyToArray());
+        std::vector<ElemType> globalMean(dim);
+
+        // first pass: total sample count and mean
+        const double numSamples = (double) m_numSamples;
+        std::vector<double> sums(1 + dim);
+        sums[0] = numSamples;
+        for (size_t j = 0; j < dim; j++)
+            sums[1 + j] = numSamples * localMean[j];
+        allReduce(sums.data(), sums.size());
+        const double totalNumSamples = sums[0];
+        for (size_t j = 0; j < dim; j++)
+            globalMean[j] = (ElemType) (totalNumSamples > 0 ? sums[1 + j] / totalNumSamples : 0);
+
+        // second pass: variance, including each worker's deviation of its mean from the global one
+        if (var)
+        {
+            std::unique_ptr<ElemType[]> localVar(var->CopyToArray());
+            sums.resize(dim);
+            for (size_t j = 0; j < dim; j++)
+            {
+                const double meanDelta = (double) localMean[j] - globalMean[j];
+                sums[j] = numSamples * (localVar[j] + meanDelta * meanDelta);
+            }
+            allReduce(sums.data(), sums.size());
+            for (size_t j = 0; j < dim; j++)
+                localVar[j] = (ElemType) (totalNumSamples > 0 ? sums[j] / totalNumSamples : 0);
+            var->SetValue(var->GetNumRows(), var->GetNumCols(), var->GetDeviceId(), localVar.get());
+        }
+
+        mean.SetValue(mean.GetNumRows(), mean.GetNumCols(), mean.GetDeviceId(), globalMean.data());
+        m_numSamples = (size_t) totalNumSamples;
+    }
+
     size_t m_numSamples; // (SIZE_MAX while outside accumulation state)
     bool IsAccumulating() const { return m_numSamples != SIZE_MAX; }
 };
@@ -198,7 +249,8 @@ protected:
     ComputationNodeBoilerplate;               \
     UsingPreComputedNodeMembers;              \
     using Base::m_numSamples;                 \
-    using Base::IsAccumulating
+    using Base::IsAccumulating;               \
+    using Base::AggregateMeanAndVariance
 
 // -----------------------------------------------------------------------
 // MeanNode (features)
@@ -232,6 +284,11 @@ public:
         // no else branch because ForwardPropNonLooping() already leaves a valid mean in m_value
     }
 
+    virtual void /*IPreComputeNode::*/ AggregateAccumulators(const std::function<void(double*, size_t)>& allReduce) override
+    {
+        AggregateMeanAndVariance(allReduce, Value(), nullptr);
+    }
+
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
     {
         FrameRange fr(Input(0)->GetMBLayout());
@@ -313,6 +370,11 @@ public:
         }
     }
 
+    virtual void /*IPreComputeNode::*/ AggregateAccumulators(const std::function<void(double*, size_t)>& allReduce) override
+    {
+        AggregateMeanAndVariance(allReduce, m_mean, &m_var);
+    }
+
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override
     {
         FrameRange fr(Input(0)->GetMBLayout());
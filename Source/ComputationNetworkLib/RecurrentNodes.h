@@ -392,8 +392,9 @@ public:
     virtual NodeStatePtr /*IStatefulNode::*/ ExportState() override
     {
         NodeStatePtr pExportedState;
-        size_t nT = m_pMBLayout->GetNumTimeSteps();
-        size_t nU = m_pMBLayout->GetNumParallelSequences();
+        // (m_delayedActivationMBLayout equals m_pMBLayout after a minibatch, unless the state was reshaped by GatherDelayedValue())
+        size_t nT = m_delayedActivationMBLayout->GetNumTimeSteps();
+        size_t nU = m_delayedActivationMBLayout->GetNumParallelSequences();
         int dir = direction;
         if (m_timeStep != 1)
         {
@@ -402,7 +403,7 @@ public:
         }
         if (dir == -1) // we look into past
         {
-            if (!m_pMBLayout->HasSequenceBeyondEnd()) // only need to export state if anything crosses the MB boundary
+            if (!m_delayedActivationMBLayout->HasSequenceBeyondEnd()) // only need to export state if anything crosses the MB boundary
             {
                 auto pState = make_shared<DelayedValueNodeState<ElemType>>(m_deviceId);
                 pState->CacheDelayedMBLayout(m_delayedActivationMBLayout);
@@ -418,7 +419,7 @@ public:
         }
         else if (dir == 1) // we look into future
         {
-            if (!m_pMBLayout->HasSequenceBeyondBegin()) // only need to export state if anything crosses the MB boundary
+            if (!m_delayedActivationMBLayout->HasSequenceBeyondBegin()) // only need to export state if anything crosses the MB boundary
             {
                 auto pState = make_shared<DelayedValueNodeState<ElemType>>(m_deviceId);
                 pState->CacheDelayedMBLayout(m_delayedActivationMBLayout);
@@ -446,6 +447,8 @@ public:
         if (!pState)
             LogicError("Expecting DelayValueNodeState after downcasting");
 
+        if (!m_delayedActivationMBLayout) // (state imported before the first minibatch, e.g. to resume a stream)
+            m_delayedActivationMBLayout = make_shared<MBLayout>();
         pState->ExportDelayedMBLayout(m_delayedActivationMBLayout); // pstate copy to m_delayedActivationMBLayout
         if (pState->IsEmpty())
         {
@@ -455,6 +458,7 @@ public:
         const Matrix<ElemType>& delayedActivation = pState->ExportCachedActivity();
         size_t nT = m_delayedActivationMBLayout->GetNumTimeSteps();
         size_t nU = m_delayedActivationMBLayout->GetNumParallelSequences();
+        m_delayedValue.Resize(delayedActivation.GetNumRows(), nT * nU); // the imported layout may differ from that of the last minibatch
 
         int dir = direction;
         if (dir == -1) // looking backward
@@ -465,6 +469,26 @@ public:
             LogicError("Unrecognized direction in DelayedValueNodeBase");
     }
 
+    int TimeStep() const { return m_timeStep; }
+
+    // Replace the carried-over state by a selection of its columns, e.g. to reorder and replicate hypotheses after beam-search pruning.
+    // 'columnMap' is a row vector of column indices into the last minibatch. Each selected column continues as a single-frame
+    // parallel sequence of the next minibatch, which must have one parallel sequence per entry of 'columnMap' and a single time step.
+    void GatherDelayedValue(const Matrix<ElemType>& columnMap)
+    {
+        if (m_timeStep != 1)
+            RuntimeError("%ls %ls operation: Gathering the delayed state is only supported for timeStep=1.", NodeName().c_str(), OperationName().c_str());
+
+        Matrix<ElemType> gathered(m_deviceId);
+        gathered.DoGatherColumnsOf(0, columnMap, m_delayedValue, 1);
+        m_delayedValue.SetValue(gathered);
+
+        size_t numSequences = columnMap.GetNumCols();
+        m_delayedActivationMBLayout = make_shared<MBLayout>(numSequences, 1);
+        for (size_t s = 0; s < numSequences; s++)
+            m_delayedActivationMBLayout->AddSequence(NEW_SEQUENCE_ID, s, -1, 2); // started before and continues after this frame
+    }
+
 protected:
     ElemType m_initialActivationValue;       // starting value for hidden activation vector at boundary
     Matrix<ElemType> m_delayedValue;         // saves the activation of the previous step that this node points to
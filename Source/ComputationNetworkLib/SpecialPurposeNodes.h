@@ -23,12 +23,15 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
 // -----------------------------------------------------------------------
 // GMMLogLikelihoodNode (unnormedPrior, means, logStdDevs, features) -- GMM log LL over input vector(s)
-// calculates the log likelihood of a feature given parameters of a Gaussian mixture model (GMM) with shared diagonal variance
+// calculates the log likelihood of a feature given parameters of a Gaussian mixture model (GMM) with diagonal covariances
 //  - unnormedPrior: mix weights, #rows = #mixture components
 //  - means: means, all mix means concatenated  (i.e. dim = feature dim x prior dim)
-//  - logStdDevs: std deviations, pooled across mix (i.e. same dim as features)
+//  - logStdDevs: log std deviations, either one per component (isotropic, dim = prior dim)
+//    or one per component and feature dimension (diagonal, same dim as means)
 // UnnormedPrior, means, and logStdDevs can be either a single column or one per sample, e.g.
 // when parameters are computed by other nodes.
+// On the CPU, value and gradients are computed by fused kernels (Matrix::GMMLogLikelihood()); elsewhere, by
+// the chain of matrix operations below, which supports isotropic components only.
 // -----------------------------------------------------------------------
 
 template <class ElemType>
@@ -56,6 +59,27 @@ public:
         Matrix<ElemType> sliceGradientValue = DataFor(*m_gradient, fr);
         Matrix<ElemType> slicePosterior = DataFor(*m_posterior, fr);
 
+        if (m_deviceId == CPUDEVICE)
+        {
+            if (inputIndex > 3)
+                InvalidArgument("GMMLogLikelihoodNode criterion only takes four inputs.");
+            Matrix<ElemType> sliceFeature = Input(3)->ValueFor(fr);
+            if (colsPrior == 1 && inputIndex < 3) // shared parameters: gradients are summed over the frames
+                Matrix<ElemType>::GMMLogLikelihoodGradient(inputIndex, sliceGradientValue, slicePosterior, Input(0)->Value(), Input(1)->Value(), Input(2)->Value(),
+                                                           sliceFeature, Input(inputIndex)->Gradient());
+            else
+            {
+                Matrix<ElemType> sliceInputGradient = Input(inputIndex)->GradientFor(fr);
+                if (colsPrior == 1)
+                    Matrix<ElemType>::GMMLogLikelihoodGradient(inputIndex, sliceGradientValue, slicePosterior, Input(0)->Value(), Input(1)->Value(), Input(2)->Value(),
+                                                               sliceFeature, sliceInputGradient);
+                else
+                    Matrix<ElemType>::GMMLogLikelihoodGradient(inputIndex, sliceGradientValue, slicePosterior, Input(0)->ValueFor(fr), Input(1)->ValueFor(fr), Input(2)->ValueFor(fr),
+                                                               sliceFeature, sliceInputGradient);
+            }
+            return;
+        }
+
         switch (inputIndex)
         {
         case 0:
@@ -85,12 +109,13 @@ public:
         case 2:
         {
             Matrix<ElemType> sliceNormedDeviation = DataFor(*m_normedDeviation, fr);
+            const size_t featureDim = Input(3)->GetSampleMatrixNumRows();
             if (colsPrior == 1)
-                BackpropToLogStddev(Input(2)->Gradient(), sliceGradientValue, sliceNormedDeviation, slicePosterior, *m_temp);
+                BackpropToLogStddev(Input(2)->Gradient(), sliceGradientValue, sliceNormedDeviation, slicePosterior, *m_temp, featureDim);
             else
             {
                 Matrix<ElemType> sliceLotStddevGradient = Input(2)->GradientFor(fr);
-                BackpropToLogStddev(sliceLotStddevGradient, sliceGradientValue, sliceNormedDeviation, slicePosterior, *m_temp);
+                BackpropToLogStddev(sliceLotStddevGradient, sliceGradientValue, sliceNormedDeviation, slicePosterior, *m_temp, featureDim);
             }
         }
         break;
@@ -149,12 +174,11 @@ public:
     }
 
     void BackpropToLogStddev(Matrix<ElemType>& logStddevGradientValues, const Matrix<ElemType>& gradientValues, const Matrix<ElemType>& normedDeviation,
-                             const Matrix<ElemType>& posterior, Matrix<ElemType>& temp)
+                             const Matrix<ElemType>& posterior, Matrix<ElemType>& temp, size_t featureDim)
     {
-        size_t numComponent = posterior.GetNumRows();
         size_t numSamples = posterior.GetNumCols();
 
-        temp.AssignDifferenceOf(normedDeviation, (ElemType) numComponent);
+        temp.AssignDifferenceOf(normedDeviation, (ElemType) featureDim); // d/dlogstddev of -||x-u_c||^2/(stddev^2)/2 - featureDim log stddev
         temp.ElementMultiplyWith(posterior);
         temp.RowElementMultiplyWith(gradientValues);
         if (logStddevGradientValues.GetNumCols() == numSamples)
@@ -196,7 +220,7 @@ public:
         size_t featureSize = Input(3)->GetSampleMatrixNumRows();
 
         m_prior->Resize(numComponents, colsPrior);
-        m_stddev->Resize(numComponents, colsPrior);
+        m_stddev->Resize(Input(2)->GetSampleMatrixNumRows(), colsPrior);
         m_normedDeviation->Resize(numComponents, numCols);
         m_normedDeviationVectors->Resize(numComponents * featureSize, numCols);
         m_posterior->Resize(numComponents, numCols);
@@ -211,9 +235,21 @@ public:
         // get the right slice
         Matrix<ElemType> sliceOutputValue = ValueFor(fr);
         Matrix<ElemType> sliceFeature = Input(3)->ValueFor(fr);
+        Matrix<ElemType> slicePosterior = DataFor(*m_posterior, fr);
+
+        if (m_deviceId == CPUDEVICE)
+        {
+            if (colsPrior == 1)
+                Matrix<ElemType>::GMMLogLikelihood(Input(0)->Value(), Input(1)->Value(), Input(2)->Value(), sliceFeature, sliceOutputValue, slicePosterior);
+            else if (colsPrior == numSamples)
+                Matrix<ElemType>::GMMLogLikelihood(Input(0)->ValueFor(fr), Input(1)->ValueFor(fr), Input(2)->ValueFor(fr), sliceFeature, sliceOutputValue, slicePosterior);
+            else
+                RuntimeError("GMMLogLikelihoodNode: UnnormedPrior should either have same number of columns as the features or have only one column.");
+            return;
+        }
+
         Matrix<ElemType> sliceNormedDeviation = DataFor(*m_normedDeviation, fr);
         Matrix<ElemType> sliceNormedDeviationVectors = DataFor(*m_normedDeviationVectors, fr);
-        Matrix<ElemType> slicePosterior = DataFor(*m_posterior, fr);
 
         if (colsPrior == 1)
         {
@@ -245,6 +281,8 @@ public:
         int numComponent = unnormedPrior.GetNumRows();
         size_t numSamples = feature.GetNumCols();
         size_t featureDim = feature.GetNumRows();
+        if (logstddev.GetNumRows() != numComponent)
+            RuntimeError("GMMLogLikelihoodNode: Components with diagonal covariances are only supported on the CPU.");
 
         // compute prior which is softmax of unnormedPrior
         prior.AssignLogSoftmaxOf(unnormedPrior, true); // log prior
@@ -282,9 +320,9 @@ public:
         // compute per-component likelihood
         posterior.AssignProductOf(-0.5f, normedDeviation); // posterior  <-- -||x-u_c||^2/(stddev^2)/2 and in (1, numSamples* numComponent) dim
         temp.InplaceLog();
-        temp *= ((ElemType) numComponent / 2.0f);                   // temp <-- stddev^c and in (1, numSamples* numComponent) dim
-        posterior -= temp;                                          // posterior  <-- exp[-||x-u_c||^2/(stddev^2)/2]/(stddev^c)
-        posterior -= (ElemType)(numComponent / 2.0f * log(TWO_PI)); // likelihood for each component and sample is now computed and stored in posterior
+        temp *= ((ElemType) featureDim / 2.0f);                   // temp <-- log stddev^featureDim and in (1, numSamples* numComponent) dim
+        posterior -= temp;                                        // posterior  <-- -||x-u_c||^2/(stddev^2)/2 - log stddev^featureDim
+        posterior -= (ElemType)(featureDim / 2.0f * log(TWO_PI)); // log likelihood for each component and sample is now computed and stored in posterior
         posterior.InplaceExp();                                     // posterior  <-- exp(-||x-u_c||^2/(stddev^2)/2)
 
         normedDeviation.Reshape(numComponent, numSamples); // reshape back
@@ -328,8 +366,8 @@ public:
             if (Input(0)->GetMBLayout() != Input(1)->GetMBLayout() || Input(0)->GetMBLayout() != Input(2)->GetMBLayout())
                 InvalidArgument("GMMLogLikelihoodNode: First three arguments must have the same MBLayout (which may be none).");
 
-            if (rows[0] != rows[2])
-                LogicError("GMMLogLikelihoodNode: UnnormedPrior (first input) should have same dimension as logStddev (third input), i.e., all dimensions in each Gaussian component share the same stddev.");
+            if (rows[2] != rows[0] && rows[2] != rows[1])
+                LogicError("GMMLogLikelihoodNode: logStddev (third input) should have the dimension of either unnormedPrior (first input, one stddev per Gaussian component) or mean (second input, one stddev per component and feature dimension).");
 
             if (rows[1] != rows[0] * rows[3])
                 LogicError("GMMLogLikelihoodNode: the number of rows in mean (second input) should equal rows(unnormedPrior(first input) * rows(feature(fourth input)).");
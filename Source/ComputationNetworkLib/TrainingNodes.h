@@ -183,13 +183,30 @@ public:
     virtual void /*ComputationNodeNonLooping::*/ ForwardPropNonLooping() override // -sum(left_i * log(softmax_i(right)))
     {
         FrameRange fr(Input(0)->GetMBLayout());
-        // first compute the softmax (column-wise)
-        // Note that we need both log and non-log for gradient computation.
-        m_logSoftmaxOfRight->AssignLogSoftmaxOf(Input(1)->ValueFor(fr), true);
-        m_softmaxOfRight->SetValue(*m_logSoftmaxOfRight);
-        m_softmaxOfRight->InplaceExp();
-        // flatten all gaps to zero, such that gaps will contribute zero to the sum
-        MaskMissingColumnsToZero(*m_logSoftmaxOfRight, Input(1)->GetMBLayout(), fr);
+        if (auto validColumnMap = GetValidColumnMap(Input(1)->GetMBLayout(), fr))
+        {
+            // gap skipping: compute the softmax of the valid columns only, and scatter it back into zeroed full-size
+            // matrices; the gaps are left zero, like MaskMissingColumnsToZero() does below
+            m_compactRight->DoGatherColumnsOf(0, *validColumnMap, Input(1)->Value(), 1);
+            m_compactRight->InplaceLogSoftmax(true);
+            m_logSoftmaxOfRight->Resize(Input(1)->Value());
+            m_logSoftmaxOfRight->SetValue(0);
+            m_logSoftmaxOfRight->DoScatterColumnsOf(1, *validColumnMap, *m_compactRight, 1);
+            m_compactRight->InplaceExp();
+            m_softmaxOfRight->Resize(Input(1)->Value());
+            m_softmaxOfRight->SetValue(0);
+            m_softmaxOfRight->DoScatterColumnsOf(1, *validColumnMap, *m_compactRight, 1);
+        }
+        else
+        {
+            // first compute the softmax (column-wise)
+            // Note that we need both log and non-log for gradient computation.
+            m_logSoftmaxOfRight->AssignLogSoftmaxOf(Input(1)->ValueFor(fr), true);
+            m_softmaxOfRight->SetValue(*m_logSoftmaxOfRight);
+            m_softmaxOfRight->InplaceExp();
+            // flatten all gaps to zero, such that gaps will contribute zero to the sum
+            MaskMissingColumnsToZero(*m_logSoftmaxOfRight, Input(1)->GetMBLayout(), fr);
+        }
         // reduce over all frames
         Value().AssignInnerProductOfMatrices(Input(0)->MaskedValueFor(fr), *m_logSoftmaxOfRight);
         Value() *= -1;
@@ -223,11 +240,20 @@ public:
         Base::RequestMatricesBeforeForwardProp(matrixPool);
         RequestMatrixFromPool(m_logSoftmaxOfRight, matrixPool);
         RequestMatrixFromPool(m_softmaxOfRight, matrixPool);
+        RequestMatrixFromPool(m_compactRight, matrixPool);
+    }
+
+    // release temp matrices that are only used by forward computation
+    virtual void ReleaseMatricesAfterForwardProp(MatrixPool& matrixPool)
+    {
+        Base::ReleaseMatricesAfterForwardProp(matrixPool);
+        ReleaseMatrixToPool(m_compactRight, matrixPool);
     }
 
 protected:
     shared_ptr<Matrix<ElemType>> m_logSoftmaxOfRight;
     shared_ptr<Matrix<ElemType>> m_softmaxOfRight;
+    shared_ptr<Matrix<ElemType>> m_compactRight; // valid columns of the right input, for gap skipping
 };
 
 template class CrossEntropyWithSoftmaxNode<float>;
@@ -719,10 +745,18 @@ public:
           m_softMax(deviceId),
           m_grdToSoftMaxInput(deviceId),
           m_clsLogSoftmax(deviceId),
-          m_clsSoftmax(deviceId)
+          m_clsSoftmax(deviceId),
+          m_bucketFrameMap(deviceId),
+          m_bucketInput(deviceId),
+          m_bucketInputGrad(deviceId),
+          m_batched(false),
+          m_allowBatched(true)
     {
     }
 
+    // the batched CPU path can be disabled to fall back to the per-frame computation (e.g. to compare the two)
+    void EnableBatchedCPUPath(bool enable) { m_allowBatched = enable; }
+
 private:
     // iterate over a large workspace that contains all class-conditioned probs concatenated
     // 'sz' is the offset into that vector. We will iterate over these vectors at a few places. Always use this same boilerplate code.
@@ -763,6 +797,12 @@ private:
 
         ComputeSoftMaxPartial(); // Note: Flag m_needRecomputeGradientToSoftmaxInput guards so that this computes only once.
 
+        if (m_batched && inputIndex != 3)
+        {
+            BackpropToBatched(inputIndex);
+            return;
+        }
+
         ForColumnsWithClass([&](size_t /*s*/, size_t /*t*/, const FrameRange& fr, size_t /*y_t*/, size_t c_t, size_t sz, size_t lft_bnd, size_t nbr_wrd)
         {
             // compute prb - 1 and prb
@@ -809,7 +849,18 @@ private:
     // gradient of cross entropy w.r.t. to input to softmax
     void ComputeSoftMaxPartial()
     {
-        if (m_needRecomputeGradientToSoftmaxInput)
+        if (m_needRecomputeGradientToSoftmaxInput && m_batched)
+        {
+            // buckets are stored as [nbr_wrd x numFrames] blocks, so 'prb - 1' is a single element per frame
+            m_grdToSoftMaxInput.SetValue(m_softMax);
+            for (const auto& bucket : m_buckets)
+                for (size_t f = 0; f < bucket.numFrames; f++)
+                    m_grdToSoftMaxInput(0, bucket.sz + f * bucket.nbr_wrd + m_bucketWordIndex[bucket.firstFrame + f]) -= 1;
+            Matrix<ElemType>::Scale(Gradient(), m_grdToSoftMaxInput);
+
+            m_needRecomputeGradientToSoftmaxInput = false;
+        }
+        else if (m_needRecomputeGradientToSoftmaxInput)
         {
             m_grdToSoftMaxInput.Resize(1, m_totalNbrWords); // buffer that contains a concatenation of class-conditional values
 
@@ -827,6 +878,129 @@ private:
         }
     }
 
+    // Batched CPU path: frames are grouped by the word range of their class, so that each class costs one GEMM
+    // for the whole minibatch instead of one small product per frame.
+    // The concatenated buffers then hold one [nbr_wrd x numFrames] block per bucket instead of one vector per frame.
+    struct ClassBucket
+    {
+        size_t lft_bnd;    // index of first word of the class
+        size_t nbr_wrd;    // number of words in the class
+        size_t firstFrame; // first entry of this bucket in m_bucketFrameMap
+        size_t numFrames;  // number of frames whose label falls into this class
+        size_t sz;         // offset of the bucket's block in the concatenated buffers
+    };
+
+    void GroupColumnsByClass()
+    {
+        struct FrameEntry
+        {
+            size_t lft_bnd, nbr_wrd, col, idx_in_class, c_t;
+        };
+        std::vector<FrameEntry> frames;
+        const size_t nS = Input(LABELDATA)->GetNumParallelSequences();
+        ForColumnsWithClass([&](size_t s, size_t t, const FrameRange& /*fr*/, size_t y_t, size_t c_t, size_t /*sz*/, size_t lft_bnd, size_t nbr_wrd)
+        {
+            frames.push_back(FrameEntry{ lft_bnd, nbr_wrd, t * nS + s, y_t - lft_bnd, c_t });
+        });
+        std::stable_sort(frames.begin(), frames.end(), [](const FrameEntry& a, const FrameEntry& b)
+        {
+            return a.lft_bnd < b.lft_bnd || (a.lft_bnd == b.lft_bnd && a.nbr_wrd < b.nbr_wrd);
+        });
+
+        m_buckets.clear();
+        m_bucketWordIndex.resize(frames.size());
+        m_bucketClassIndex.resize(frames.size());
+        m_bucketColumn.resize(frames.size());
+        std::vector<ElemType> frameMap(frames.size());
+        size_t sz = 0;
+        for (size_t k = 0; k < frames.size(); k++)
+        {
+            const auto& frame = frames[k];
+            if (m_buckets.empty() || m_buckets.back().lft_bnd != frame.lft_bnd || m_buckets.back().nbr_wrd != frame.nbr_wrd)
+                m_buckets.push_back(ClassBucket{ frame.lft_bnd, frame.nbr_wrd, k, 0, sz });
+            m_buckets.back().numFrames++;
+            sz += frame.nbr_wrd;
+
+            frameMap[k] = (ElemType) frame.col;
+            m_bucketWordIndex[k] = frame.idx_in_class;
+            m_bucketClassIndex[k] = frame.c_t;
+            m_bucketColumn[k] = frame.col;
+        }
+        assert(sz == m_totalNbrWords);
+        m_bucketFrameMap.SetValue(1, frames.size(), m_deviceId, frameMap.data());
+    }
+
+    Matrix<ElemType> BucketBlock(Matrix<ElemType>& buffer, const ClassBucket& bucket)
+    {
+        return buffer.ColumnSlice(bucket.sz, bucket.nbr_wrd * bucket.numFrames).Reshaped(bucket.nbr_wrd, bucket.numFrames);
+    }
+
+    void ForwardPropBatched(Matrix<ElemType>& functionValues)
+    {
+        GroupColumnsByClass();
+        if (m_buckets.empty())
+        {
+            functionValues.SetValue(0);
+            return;
+        }
+
+        // gather the hidden activations in bucket order
+        m_bucketInput.DoGatherColumnsOf(0, m_bucketFrameMap, Input(INPUTDATA)->Value(), 1);
+
+        ElemType logLikelihood = 0;
+        for (const auto& bucket : m_buckets)
+        {
+            Matrix<ElemType> weightForClass = Input(EMBEDDINGMATRIX)->ValueAsMatrix().ColumnSlice(bucket.lft_bnd, bucket.nbr_wrd); // [hdSize x nbr_wrd]
+            Matrix<ElemType> obs = m_bucketInput.ColumnSlice(bucket.firstFrame, bucket.numFrames);                                // [hdSize x numFrames]
+            Matrix<ElemType> logSoftMax = BucketBlock(m_logSoftmax, bucket);
+            Matrix<ElemType> softMax = BucketBlock(m_softMax, bucket);
+
+            // log softmax(W' x) for all frames of the bucket at once -> [nbr_wrd x numFrames]
+            logSoftMax.AssignProductOf(weightForClass, true, obs, false);
+            logSoftMax.InplaceLogSoftmax(true);
+            softMax.AssignExpOf(logSoftMax);
+
+            // add the words' class-conditional log posteriors
+            for (size_t f = 0; f < bucket.numFrames; f++)
+                logLikelihood += logSoftMax.GetValue(m_bucketWordIndex[bucket.firstFrame + f], f);
+        }
+
+        // add the class log posterior probabilities
+        for (size_t k = 0; k < m_bucketColumn.size(); k++)
+            logLikelihood += m_clsLogSoftmax.GetValue(m_bucketClassIndex[k], m_bucketColumn[k]);
+
+        functionValues.SetValue(-logLikelihood);
+    }
+
+    void BackpropToBatched(size_t inputIndex)
+    {
+        if (m_buckets.empty())
+            return;
+
+        if (inputIndex == 1)
+        {
+            // gradient to input, computed in bucket order and then scattered back to the frames
+            m_bucketInputGrad.Resize(Input(INPUTDATA)->GetSampleMatrixNumRows(), m_bucketColumn.size());
+            for (const auto& bucket : m_buckets)
+            {
+                Matrix<ElemType> weightForClass = Input(EMBEDDINGMATRIX)->ValueAsMatrix().ColumnSlice(bucket.lft_bnd, bucket.nbr_wrd);
+                Matrix<ElemType> grd = m_bucketInputGrad.ColumnSlice(bucket.firstFrame, bucket.numFrames);
+                grd.AssignProductOf(weightForClass, false, BucketBlock(m_grdToSoftMaxInput, bucket), false);
+            }
+            Input(INPUTDATA)->Gradient().DoScatterColumnsOf(1, m_bucketFrameMap, m_bucketInputGrad, 1);
+        }
+        else if (inputIndex == 2)
+        {
+            // gradient to input weight: one [hdSize x numFrames] x [numFrames x nbr_wrd] product per class
+            for (const auto& bucket : m_buckets)
+            {
+                Matrix<ElemType> grd_to_wgt = Input(EMBEDDINGMATRIX)->GradientAsMatrix().ColumnSlice(bucket.lft_bnd, bucket.nbr_wrd);
+                Matrix<ElemType> obs = m_bucketInput.ColumnSlice(bucket.firstFrame, bucket.numFrames);
+                Matrix<ElemType>::MultiplyAndAdd(obs, false, BucketBlock(m_grdToSoftMaxInput, bucket), true, grd_to_wgt);
+            }
+        }
+    }
+
 public:
     virtual void UpdateFunctionMBSize() override
     {
@@ -863,6 +1037,15 @@ public:
         m_softMax.Resize(1, m_totalNbrWords);
         m_logSoftmax.Resize(1, m_totalNbrWords);
 
+        // on the CPU, batch the per-frame products by class
+        m_batched = m_allowBatched && (m_deviceId == CPUDEVICE);
+        if (m_batched)
+        {
+            ForwardPropBatched(functionValues);
+            m_needRecomputeGradientToSoftmaxInput = true;
+            return;
+        }
+
         // accumulate objective
         functionValues.SetValue(0);
         ForColumnsWithClass([&](size_t s, size_t t, const FrameRange& fr, size_t y_t, size_t c_t, size_t sz, size_t lft_bnd, size_t nbr_wrd)
@@ -943,6 +1126,17 @@ protected:
 
     size_t m_nbrCls;
     size_t m_totalNbrWords;
+
+    // batched CPU path
+    std::vector<ClassBucket> m_buckets;
+    std::vector<size_t> m_bucketWordIndex;  // per bucketed frame: index of the label word within its class
+    std::vector<size_t> m_bucketClassIndex; // per bucketed frame: class index
+    std::vector<size_t> m_bucketColumn;     // per bucketed frame: minibatch column
+    Matrix<ElemType> m_bucketFrameMap;      // [1 x #frames] minibatch column of each bucketed frame, as gather/scatter map
+    Matrix<ElemType> m_bucketInput;         // [hdSize x #frames] hidden activations in bucket order
+    Matrix<ElemType> m_bucketInputGrad;     // [hdSize x #frames] gradient to the hidden activations in bucket order
+    bool m_batched;
+    bool m_allowBatched;
 };
 
 template class ClassBasedCrossEntropyWithSoftmaxNode<float>;
@@ -1831,6 +2025,14 @@ public:
     {
         m_eval = bnEvalMode;
     }
+    bool IsEvalMode() const
+    {
+        return m_eval;
+    }
+    bool IsSpatial() const
+    {
+        return m_spatial;
+    }
 
 private:
     struct VersionInfo
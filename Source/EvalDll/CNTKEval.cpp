@@ -48,6 +48,9 @@ void CNTKEval<ElemType>::Init(const std::string& config)
     m_config.Parse(config);
     size_t nThreads = m_config("numCPUThreads", "1");
     CPUMatrix<ElemType>::SetNumThreads(nThreads);
+    bool numaAffinity = m_config(L"numaAffinity", false);
+    if (numaAffinity)
+        CPUMatrix<ElemType>::SetNumaAffinity(true);
 
     g_shareNodeValueMatrices = m_config(L"shareNodeValueMatrices", false);
 }
@@ -58,6 +61,8 @@ template <class ElemType>
 void CNTKEval<ElemType>::Destroy()
 {
     // cleanup everything
+    m_decoder.reset();
+    m_streamingEvaluator.reset();
     m_net.reset();
     delete m_reader;
     delete m_writer;
@@ -79,6 +84,11 @@ void CNTKEval<ElemType>::CreateNetwork(const std::string& networkDescription)
     {
         LogicError("Unable to construct network from description");
     }
+
+    // optionally fold BatchNormalization and mean/variance normalization into the weights, verified against the unfolded network
+    bool foldNormalization = config(L"foldNormalization", false);
+    if (foldNormalization)
+        m_net->FoldNormalizationIntoParameters<ElemType>();
 }
 
 // GetNodeDimensions - Get the node dimensions of the specified nodes
@@ -201,6 +211,100 @@ void CNTKEval<ElemType>::Evaluate(std::map<std::wstring, std::vector<ElemType>*>
     eval.WriteOutput(*m_writer, outNodeNames);
 }
 
+// BeamSearch - continue each prompt by beam search, decoding all prompts together as one batch
+// prompts - token ids of each prompt, fed one-hot into the token input node
+// nbest - for each prompt, the best continuations (token ids without the end symbol) and their log probabilities, best first
+template <class ElemType>
+void CNTKEval<ElemType>::BeamSearch(const std::vector<std::vector<size_t>>& prompts, std::vector<std::vector<std::pair<std::vector<size_t>, double>>>& nbest)
+{
+    if (m_decoder == nullptr)
+    {
+        wstring tokenInputNodeName = m_config(L"tokenInputNodeName");
+        wstring outputNodeName = m_config(L"outputNodeName");
+        size_t endSymbol = m_config(L"endSymbol");
+        size_t beamWidth = m_config(L"beamWidth", (size_t) 5);
+        size_t maxLength = m_config(L"maxLength", (size_t) 100);
+        size_t numBest = m_config(L"numBest", (size_t) 1);
+        m_decoder = make_shared<BeamSearchDecoder<ElemType>>(m_net, tokenInputNodeName, outputNodeName, beamWidth, maxLength, endSymbol, numBest);
+    }
+
+    std::vector<std::vector<typename BeamSearchDecoder<ElemType>::Hypothesis>> results;
+    m_decoder->SetPrompts(prompts);
+    m_decoder->Decode(results);
+
+    nbest.resize(results.size());
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        nbest[i].clear();
+        for (auto& hypothesis : results[i])
+            nbest[i].push_back(make_pair(move(hypothesis.tokens), hypothesis.logProbability));
+    }
+}
+
+// GetStreamingEvaluator - create the streaming evaluator on first use
+// Its outputs are the network's output nodes (outputNodeNames in the network description).
+template <class ElemType>
+StreamingEvaluator<ElemType>& CNTKEval<ElemType>::GetStreamingEvaluator()
+{
+    if (m_streamingEvaluator == nullptr)
+    {
+        if (m_net == nullptr)
+            LogicError("EvaluateChunk: No network has been created.");
+        m_streamingEvaluator = make_shared<StreamingEvaluator<ElemType>>(m_net);
+    }
+    return *m_streamingEvaluator;
+}
+
+// EvaluateChunk - evaluate the next chunk of frames of several streams as one minibatch, carrying over each stream's state
+// inputs - map from stream id to map from node name to the chunk's input frames
+// outputs - map from stream id to map from node name to output vector, sized during evaluation
+template <class ElemType>
+void CNTKEval<ElemType>::EvaluateChunk(std::map<size_t, std::map<std::wstring, std::vector<ElemType>*>>& inputs, std::map<size_t, std::map<std::wstring, std::vector<ElemType>*>>& outputs)
+{
+    GetStreamingEvaluator().EvaluateChunk(inputs, outputs);
+}
+
+// EndStream - release the state of a stream
+template <class ElemType>
+void CNTKEval<ElemType>::EndStream(size_t streamId)
+{
+    if (m_streamingEvaluator != nullptr)
+        m_streamingEvaluator->EndStream(streamId);
+}
+
+// ExportStreamState - get the state of a stream after its last chunk, as map from PastValue node name to state vector
+template <class ElemType>
+void CNTKEval<ElemType>::ExportStreamState(size_t streamId, std::map<std::wstring, std::vector<ElemType>>& state)
+{
+    std::map<std::wstring, NodeStatePtr> nodeStates;
+    GetStreamingEvaluator().ExportStreamState(streamId, nodeStates);
+
+    state.clear();
+    for (const auto& iter : nodeStates)
+    {
+        const auto& value = dynamic_pointer_cast<DelayedValueNodeState<ElemType>>(iter.second)->ExportCachedActivity();
+        auto& values = state[iter.first];
+        values.resize(value.GetNumElements());
+        value.CopySection(value.GetNumRows(), value.GetNumCols(), values.data(), value.GetNumRows());
+    }
+}
+
+// ImportStreamState - continue a stream from a state obtained from ExportStreamState()
+template <class ElemType>
+void CNTKEval<ElemType>::ImportStreamState(size_t streamId, const std::map<std::wstring, std::vector<ElemType>>& state)
+{
+    std::map<std::wstring, NodeStatePtr> nodeStates;
+    for (const auto& iter : state)
+    {
+        auto nodeState = make_shared<DelayedValueNodeState<ElemType>>(m_net->GetDeviceId());
+        std::vector<ElemType> values = iter.second; // (the Matrix constructor takes a non-const pointer)
+        Matrix<ElemType> value(values.size(), 1, values.data(), m_net->GetDeviceId(), matrixFlagNormal);
+        nodeState->CacheState(value);
+        nodeStates[iter.first] = nodeState;
+    }
+    GetStreamingEvaluator().ImportStreamState(streamId, nodeStates);
+}
+
 // ResetState - Reset the cell state when we get start of an utterance
 template <class ElemType>
 void CNTKEval<ElemType>::ResetState()
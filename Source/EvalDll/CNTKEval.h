@@ -15,6 +15,8 @@
 #include "EvalWriter.h"
 
 #include "ComputationNetwork.h"
+#include "BeamSearchDecoder.h"
+#include "StreamingEvaluator.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -28,6 +30,10 @@ class CNTKEval : public IEvaluateModel<ElemType>
     ComputationNetworkPtr m_net;
     std::map<std::wstring, size_t> m_dimensions;
     size_t m_start;
+    std::shared_ptr<BeamSearchDecoder<ElemType>> m_decoder; // created on first BeamSearch() call
+    std::shared_ptr<StreamingEvaluator<ElemType>> m_streamingEvaluator; // created on first use of the streaming API
+
+    StreamingEvaluator<ElemType>& GetStreamingEvaluator();
 
 public:
     // constructor
@@ -58,6 +64,23 @@ public:
     // outputs - map from node name to output vector, outputs vectors need to be preallocated by caller, sizing will happen during evaluation
     virtual void Evaluate(std::map<std::wstring, std::vector<ElemType>*>& outputs);
 
+    // BeamSearch - continue each prompt by beam search, decoding all prompts together as one batch
+    // prompts - token ids of each prompt
+    // nbest - for each prompt, the best continuations and their log probabilities, best first
+    virtual void BeamSearch(const std::vector<std::vector<size_t>>& prompts, std::vector<std::vector<std::pair<std::vector<size_t>, double>>>& nbest);
+
+    // EvaluateChunk - evaluate the next chunk of frames of several streams as one minibatch, carrying over each stream's state
+    // inputs - map from stream id to map from node name to the chunk's input frames
+    // outputs - map from stream id to map from node name to output vector, sized during evaluation
+    virtual void EvaluateChunk(std::map<size_t, std::map<std::wstring, std::vector<ElemType>*>>& inputs, std::map<size_t, std::map<std::wstring, std::vector<ElemType>*>>& outputs);
+
+    // EndStream - release the state of a stream
+    virtual void EndStream(size_t streamId);
+
+    // ExportStreamState/ImportStreamState - get or set the state of a stream, as map from PastValue node name to state vector
+    virtual void ExportStreamState(size_t streamId, std::map<std::wstring, std::vector<ElemType>>& state);
+    virtual void ImportStreamState(size_t streamId, const std::map<std::wstring, std::vector<ElemType>>& state);
+
     virtual void Init(const std::string& config);
     virtual void Destroy();
     virtual void ResetState();
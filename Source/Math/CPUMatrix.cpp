@@ -27,6 +27,7 @@
 #else
 #include <cfloat>
 #endif
+#include "numahelpers.h" // for NUMA affinity
 
 #ifdef LEAKDETECT
 #include <vld.h>
@@ -132,12 +133,30 @@ CPUMatrix<ElemType>::CPUMatrix()
     ZeroInit();
 }
 
+// NUMA affinity mode, see SetNumaAffinity(); shared across all ElemTypes
+static bool g_numaAffinity = false;
+static size_t g_masterNumaNode = 0; // node the master thread is pinned to while g_numaAffinity is set
+
+// below this many bytes, first-touching in parallel is not worth the thread fork
+static const size_t numaFirstTouchMinBytes = 256 * 1024;
+
 // helper to allocate an array of ElemType
 // Use this instead of new[] to get NaN initialization for debugging.
+// In NUMA affinity mode, large arrays are zeroed by the pinned OpenMP threads with the same static
+// partitioning that the element-wise loops use, so that pages get first-touched on the node that works on them.
 template <class ElemType>
 static ElemType* NewArray(size_t n)
 {
-    ElemType* p = new ElemType[n]();
+    ElemType* p;
+    if (g_numaAffinity && n * sizeof(ElemType) >= numaFirstTouchMinBytes)
+    {
+        p = new ElemType[n];
+#pragma omp parallel for schedule(static)
+        for (long i = 0; i < (long) n; i++)
+            p[i] = 0;
+    }
+    else
+        p = new ElemType[n]();
 #if 0 // _DEBUG
         ElemType nan = Matrix<ElemType>::MakeNan(__LINE__);
         for (size_t i = 0; i < n; i++)
@@ -343,6 +362,43 @@ void CPUMatrix<ElemType>::CopyColumnsStrided(const CPUMatrix<ElemType>& fromMatr
     }
 }
 
+// -----------------------------------------------------------------------
+// parallel partitioning of column-wise data movement (row slices, gather/scatter, repeat)
+// Work items are (column, row block) pairs. Columns are split into row blocks only if there are fewer columns
+// than threads, so that a few tall columns still use all threads. Small matrices are done by a single thread,
+// since forking costs more than copying them.
+// -----------------------------------------------------------------------
+
+class ColumnBlockPartition
+{
+public:
+    ColumnBlockPartition(size_t numRows, size_t numCols, size_t numColsPerItem = 1 /*for kernels that sweep several columns per work item*/)
+        : m_numRows(numRows), m_numCols(numCols), m_numRowBlocks(1)
+    {
+        const size_t minElementsPerThread = 4096;
+        const size_t minRowsPerBlock = 64;
+        m_isParallel = numRows * numCols * numColsPerItem >= 2 * minElementsPerThread;
+        const size_t numThreads = (size_t) omp_get_max_threads();
+        if (m_isParallel && numCols < numThreads)
+            m_numRowBlocks = max((size_t) 1, min((numThreads + numCols - 1) / numCols, numRows / minRowsPerBlock));
+    }
+    bool IsParallel() const { return m_isParallel; }
+    long NumItems() const { return (long) (m_numCols * m_numRowBlocks); }
+    // item -> column index and row range
+    void Get(long item, size_t& j, size_t& rowBegin, size_t& numRows) const
+    {
+        j = (size_t) item / m_numRowBlocks;
+        const size_t b = (size_t) item % m_numRowBlocks;
+        rowBegin = m_numRows * b / m_numRowBlocks;
+        numRows = m_numRows * (b + 1) / m_numRowBlocks - rowBegin;
+    }
+
+private:
+    size_t m_numRows, m_numCols;
+    size_t m_numRowBlocks;
+    bool m_isParallel;
+};
+
 //for each column of a, we add all rows of a to this starting from startIndex
 template <class ElemType>
 CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignToRowSliceValuesOf(const CPUMatrix<ElemType>& a, const size_t startIndex, const size_t numRows)
@@ -356,26 +412,15 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignToRowSliceValuesOf(const CPUMatr
     if (a.GetNumCols() != GetNumCols())
         LogicError("AddToRowSliceValuesOf: columns does not match.");
 
-    long n = (long) a.GetNumCols(), m = (long) numRows;
-
     auto& us = *this;
 
-#pragma omp parallel for
-    for (long j = 0; j < n; j++)
+    ColumnBlockPartition partition(numRows, GetNumCols());
+#pragma omp parallel for if (partition.IsParallel())
+    for (long item = 0; item < partition.NumItems(); item++)
     {
-        // four-way unrolling
-        for (size_t i = 0, startRow = startIndex; i < (m & ~3); i += 4, startRow += 4)
-        {
-            us(startRow, j) = a(i, j);
-            us(startRow + 1, j) = a(i + 1, j);
-            us(startRow + 2, j) = a(i + 2, j);
-            us(startRow + 3, j) = a(i + 3, j);
-        }
-        // handle remaining stuffs
-        for (size_t i = m & ~3, startRow = startIndex + (m & ~3); i < m; i++, startRow++)
-        {
-            us(startRow, j) = a(i, j);
-        }
+        size_t j, i0, blockRows;
+        partition.Get(item, j, i0, blockRows);
+        memcpy(&us(startIndex + i0, j), &a(i0, j), sizeof(ElemType) * blockRows);
     }
 
     return *this;
@@ -390,28 +435,15 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignRowSliceValuesOf(const CPUMatrix
 
     Resize(numRows, a.GetNumCols());
 
-    long n = (long) a.GetNumCols(); // note: OpenMP requires loop indices to be long, not size_t
-    long k = (long) a.GetNumRows();
+    auto& us = *this;
 
-#pragma omp parallel for
-    for (long j = 0; j < n; j++)
+    ColumnBlockPartition partition(numRows, GetNumCols());
+#pragma omp parallel for if (partition.IsParallel())
+    for (long item = 0; item < partition.NumItems(); item++)
     {
-        // memory copy might be faster?
-        memcpy(m_pArray + j * numRows, a.m_pArray + j * k + startIndex, sizeof(ElemType) * numRows);
-
-        // //four-way unrolling
-        // for (long i=0, startRow = startIndex; i<(m & ~3); i+=4, startRow+=4)
-        // {
-        //    us(i,j) = a(startRow,j);
-        //    us(i+1,j) = a(startRow+1,j);
-        //    us(i+2,j) = a(startRow+2,j);
-        //    us(i+3,j) = a(startRow+3,j);
-        // }
-        // //handle remaining stuffs
-        // for (long i=m & ~3, startRow = startIndex+(m & ~3); i<m; i++, startRow++)
-        // {
-        //    us(i,j) = a(startRow,j);
-        // }
+        size_t j, i0, blockRows;
+        partition.Get(item, j, i0, blockRows);
+        memcpy(&us(i0, j), &a(startIndex + i0, j), sizeof(ElemType) * blockRows);
     }
 
     return *this;
@@ -433,26 +465,18 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AddToRowSliceValuesOf(const CPUMatrix<
     if (a.GetNumCols() != GetNumCols())
         LogicError("AddToRowSliceValuesOf: columns does not match.");
 
-    long n = (long) a.GetNumCols(), m = (long) numRows;
-
     auto& us = *this;
 
-#pragma omp parallel for
-    for (long j = 0; j < n; j++)
+    ColumnBlockPartition partition(numRows, GetNumCols());
+#pragma omp parallel for if (partition.IsParallel())
+    for (long item = 0; item < partition.NumItems(); item++)
     {
-        // four-way unrolling
-        for (long i = 0, startRow = (long) startIndex; i < (m & ~3); i += 4, startRow += 4)
-        {
-            us(startRow, j) += a(i, j);
-            us(startRow + 1, j) += a(i + 1, j);
-            us(startRow + 2, j) += a(i + 2, j);
-            us(startRow + 3, j) += a(i + 3, j);
-        }
-        // handle remaining stuffs
-        for (long i = m & ~3, startRow = (long) startIndex + (m & ~3); i < m; i++, startRow++)
-        {
-            us(startRow, j) += a(i, j);
-        }
+        size_t j, i0, blockRows;
+        partition.Get(item, j, i0, blockRows);
+        ElemType* dst = &us(startIndex + i0, j);
+        const ElemType* src = &a(i0, j);
+        for (size_t i = 0; i < blockRows; i++) // (contiguous, vectorized by the compiler)
+            dst[i] += src[i];
     }
 
     return *this;
@@ -537,35 +561,20 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignRepeatOf(const CPUMatrix<ElemTyp
         LogicError("AssignRepeatOf: Matrix a is empty.");
 
     Resize(a.GetNumRows() * numRowRepeats, a.GetNumCols() * numColRepeats);
-    long n = (long) a.GetNumCols(), m = (long) a.GetNumRows();
+    const size_t n = a.GetNumCols(), m = a.GetNumRows();
     auto& us = *this;
 
-#pragma omp parallel for
-    for (long q = 0; q < numColRepeats; q++)
+    // each target column consists of numRowRepeats copies of one source column
+    // We parallelize over target columns rather than over column repeats, which are usually few.
+    ColumnBlockPartition partition(m, GetNumCols());
+#pragma omp parallel for if (partition.IsParallel())
+    for (long item = 0; item < partition.NumItems(); item++)
     {
-        for (long p = 0; p < numRowRepeats; p++)
-        {
-            long colOffset = q * n;
-
-            for (long j = 0; j < n; j++, colOffset++)
-            {
-                long rowOffset = p * m;
-
-                // four-way unrolling
-                for (long i = 0; i < (m & ~3); i += 4, rowOffset += 4)
-                {
-                    us(rowOffset, colOffset) = a(i, j);
-                    us(rowOffset + 1, colOffset) = a(i + 1, j);
-                    us(rowOffset + 2, colOffset) = a(i + 2, j);
-                    us(rowOffset + 3, colOffset) = a(i + 3, j);
-                }
-                // handle remaining stuffs
-                for (long i = m & ~3; i < m; i++, rowOffset++)
-                {
-                    us(rowOffset, colOffset) = a(i, j);
-                }
-            }
-        }
+        size_t jOut, i0, blockRows;
+        partition.Get(item, jOut, i0, blockRows);
+        const ElemType* src = &a(i0, jOut % n);
+        for (size_t p = 0; p < numRowRepeats; p++)
+            memcpy(&us(p * m + i0, jOut), src, sizeof(ElemType) * blockRows);
     }
 
     return *this;
@@ -656,21 +665,26 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignTransposeOf(const CPUMatrix<Elem
 
     auto& us = *this;
 
-#pragma omp parallel for
-    for (long j = 0; j < n; j++)
+    // Transpose in square tiles that fit into L1 together with their transposed copy. Within a tile, we write
+    // contiguous target columns and read with stride from a set of source columns that stays in cache,
+    // instead of missing the cache on every write as a column-by-column transpose does.
+    // Tiles are numbered such that consecutive tiles read the same source columns.
+    const long tileSize = 32;
+    const long numRowTiles = (m + tileSize - 1) / tileSize;
+    const long numColTiles = (n + tileSize - 1) / tileSize;
+    const ElemType* src = a.m_pArray;
+    ElemType* dst = us.m_pArray;
+#pragma omp parallel for if (m * n >= 8192)
+    for (long tile = 0; tile < numRowTiles * numColTiles; tile++)
     {
-        // four-way unrolling
-        for (long i = 0; i < (m & ~3); i += 4)
+        const long i0 = (tile % numRowTiles) * tileSize, i1 = min(i0 + tileSize, m);
+        const long j0 = (tile / numRowTiles) * tileSize, j1 = min(j0 + tileSize, n);
+        for (long i = i0; i < i1; i++) // target column i = source row i
         {
-            us(j, i) = a(i, j);
-            us(j, i + 1) = a(i + 1, j);
-            us(j, i + 2) = a(i + 2, j);
-            us(j, i + 3) = a(i + 3, j);
-        }
-        // handle remaining stuffs
-        for (long i = m & ~3; i < m; i++)
-        {
-            us(j, i) = a(i, j);
+            ElemType* dstCol = dst + i * n;
+            const ElemType* srcRow = src + i;
+            for (long j = j0; j < j1; j++)
+                dstCol[j] = srcRow[j * m];
         }
     }
 
@@ -709,16 +723,25 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::DoGatherColumnsOf(ElemType beta, const
         Resize(a.GetNumRows(), m.GetNumCols());
 
     auto& us = *this;
-#pragma omp parallel for // TODO: Depending in circumstance, it may be more efficient to parallelize over rows.
+
+    // validate the map upfront; we cannot throw from inside the parallel loop
     foreach_column(jOut, us)
     {
+        auto jInF = m(0, jOut);
+        if (jInF >= 0 && (size_t) jInF >= a.GetNumCols())
+            InvalidArgument("DoGatherColumnsOf: Map out of bounds.");
+    }
+
+    ColumnBlockPartition partition(us.GetNumRows(), us.GetNumCols());
+#pragma omp parallel for if (partition.IsParallel())
+    for (long item = 0; item < partition.NumItems(); item++)
+    {
+        size_t jOut, i0, blockRows;
+        partition.Get(item, jOut, i0, blockRows);
         auto jInF = m(0, jOut); // this is the column we need to get
         if (jInF < 0)           // negative index means gap
             continue;
-        size_t jIn = (size_t)jInF;
-        if (jIn >= a.GetNumCols())
-            InvalidArgument("DoGatherColumnsOf: Map out of bounds.");
-        ScaleAndAddColumn(beta, &us(0,jOut), &a(0,jIn), us.GetNumRows(), alpha);
+        ScaleAndAddColumn(beta, &us(i0, jOut), &a(i0, (size_t) jInF), blockRows, alpha);
     }
 
     return *this;
@@ -741,16 +764,37 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::DoScatterColumnsOf(ElemType beta, cons
     // Scatter may add more than one source column to the same target, so we must pre-scale with beta, and then just keep adding.
     Scale(beta, us); // if beta is 0, then this will be a memset()
 
-#pragma omp parallel for // TODO: Depending in circumstance, it may be more efficient to parallelize over rows.
+    // validate the map upfront, and determine whether several source columns go to the same target
+    vector<char> isTarget(GetNumCols(), 0);
+    bool hasDuplicateTargets = false;
     foreach_column(jIn, a)
     {
-        auto jOutF = m(0, jIn); // this is the column we copy/add into
-        if (jOutF < 0)          // negative index means gap
+        auto jOutF = m(0, jIn);
+        if (jOutF < 0)
             continue;
-        size_t jOut = (size_t)jOutF;
-        if (jOut >= GetNumCols())
-            InvalidArgument("DoGatherColumnsOf: Map out of bounds.");
-        ScaleAndAddColumn(/*beta=*/(ElemType)1, &us(0, jOut), &a(0, jIn), us.GetNumRows(), alpha);
+        if ((size_t) jOutF >= GetNumCols())
+            InvalidArgument("DoScatterColumnsOf: Map out of bounds.");
+        hasDuplicateTargets |= isTarget[(size_t) jOutF] != 0;
+        isTarget[(size_t) jOutF] = 1;
+    }
+
+    // Targets with several sources would be updated concurrently if we parallelized over columns.
+    // In that case, we parallelize over row blocks only, each of which is owned by one thread.
+    const size_t numRows = us.GetNumRows();
+    const size_t numColsPerItem = hasDuplicateTargets ? a.GetNumCols() : 1;
+    ColumnBlockPartition partition(numRows, hasDuplicateTargets ? 1 : a.GetNumCols(), numColsPerItem);
+#pragma omp parallel for if (partition.IsParallel())
+    for (long item = 0; item < partition.NumItems(); item++)
+    {
+        size_t jBegin, i0, blockRows;
+        partition.Get(item, jBegin, i0, blockRows);
+        for (size_t jIn = jBegin; jIn < jBegin + numColsPerItem; jIn++)
+        {
+            auto jOutF = m(0, jIn); // this is the column we copy/add into
+            if (jOutF < 0)          // negative index means gap
+                continue;
+            ScaleAndAddColumn(/*beta=*/(ElemType) 1, &us(i0, (size_t) jOutF), &a(i0, jIn), blockRows, alpha);
+        }
     }
 
     return *this;
@@ -917,8 +961,8 @@ void CPUMatrix<ElemType>::SetValue(const size_t numRows, const size_t numCols, E
     // if it's externally managed, then populate the structure
     if (matrixFlags & matrixFlagDontOwnBuffer)
     {
-        // free previous array allocation if any before overwriting
-        if (m_pArray != nullptr)
+        // free previous array allocation if any before overwriting (but not a buffer we were only viewing)
+        if (m_pArray != nullptr && OwnBuffer())
             delete[] m_pArray;
 
         m_pArray = pArray;
@@ -1486,10 +1530,14 @@ size_t CPUMatrix<ElemType>::CopyToArray(ElemType*& arrayCopyTo, size_t& currentA
 }
 
 template <typename ElemType>
-void CPUMatrix<ElemType>::CopySection(size_t /*numRows*/, size_t /*numCols*/, ElemType* /*dst*/, size_t /*colStride*/) const
+void CPUMatrix<ElemType>::CopySection(size_t numRows, size_t numCols, ElemType* dst, size_t colStride) const
 {
-    // REVIEW alexeyk: currently not used by CPU, but implement when possible.
-    RuntimeError("Not implemented.");
+    if (numRows > m_numRows || numCols > m_numCols || numRows > colStride)
+        InvalidArgument("CopySection: The section [%d x %d] exceeds the matrix [%d x %d] or the column stride %d.",
+                        (int) numRows, (int) numCols, (int) m_numRows, (int) m_numCols, (int) colStride);
+
+    for (size_t j = 0; j < numCols; j++)
+        memcpy(dst + j * colStride, m_pArray + LocateColumn(j), sizeof(ElemType) * numRows);
 }
 
 template <class ElemType>
@@ -4318,6 +4366,36 @@ void CPUMatrix<ElemType>::AssignNCEUnnormalizedEval(const CPUMatrix<ElemType>& a
     c(0, 0) = -log_likelihood;
 }
 
+// When the reader shares the noise samples across the minibatch (LMSequenceReader option noise_shared), the noise
+// word ids in rows 2, 4, ... of 'samples' are the same in every column; only the target word in row 0 differs.
+// Then it is much cheaper to score the noise words against all instances with one GEMM than to compute one
+// scattered dot product per (instance, sample) pair. The check stops at the first column that differs from the
+// first one, so it costs next to nothing when samples are drawn per instance.
+template <class ElemType>
+static bool HasSharedNCENoiseSamples(const CPUMatrix<ElemType>& samples)
+{
+    size_t sample_size = samples.GetNumRows() / 2;
+    size_t batch_size = samples.GetNumCols();
+    if (sample_size < 2 || batch_size < 2)
+        return false;
+    for (size_t instance_id = 1; instance_id < batch_size; instance_id++)
+        for (size_t sample_id = 1; sample_id < sample_size; sample_id++)
+            if (samples(2 * sample_id, instance_id) != samples(2 * sample_id, 0))
+                return false;
+    return true;
+}
+
+// gather the embedding columns of the shared noise words -> [hdSize x #noise samples]
+template <class ElemType>
+static void GatherNCENoiseEmbeddings(const CPUMatrix<ElemType>& samples, const CPUMatrix<ElemType>& b, CPUMatrix<ElemType>& embeddings)
+{
+    size_t num_noise_samples = samples.GetNumRows() / 2 - 1;
+    embeddings.Resize(b.GetNumRows(), num_noise_samples);
+#pragma omp parallel for
+    for (long k = 0; k < (long) num_noise_samples; k++)
+        memcpy(&embeddings(0, k), &b(0, (size_t) samples(2 * (k + 1), 0)), sizeof(ElemType) * b.GetNumRows());
+}
+
 //samples+prob                         gradient           hidden               embedding          embedding/hidden
 //a.m_CPUMatrix->AssignNCEDerivative(*tmp.m_CPUMatrix, *a.m_CPUMatrix, *b.m_CPUMatrix, inputIndex, *c.m_CPUMatrix);
 template <class ElemType>
@@ -4325,6 +4403,59 @@ CPUMatrix<ElemType>& CPUMatrix<ElemType>::AssignNCEDerivative(const CPUMatrix<El
 {
     size_t sample_size = this->GetNumRows() / 2;
     size_t batch_size = this->GetNumCols();
+
+    if (HasSharedNCENoiseSamples(*this))
+    {
+        // the noise samples' gradients as [#noise samples x batch_size]; the target words are handled per instance
+        size_t num_noise_samples = sample_size - 1;
+        CPUMatrix<ElemType> noiseGrad(num_noise_samples, batch_size);
+#pragma omp parallel for
+        for (long instance_id = 0; instance_id < (long) batch_size; instance_id++)
+            memcpy(&noiseGrad(0, instance_id), &tmp(1, instance_id), sizeof(ElemType) * num_noise_samples);
+
+        if (inputIndex == 1)
+        {
+            CPUMatrix<ElemType> embeddings;
+            GatherNCENoiseEmbeddings(*this, b, embeddings);
+            MultiplyAndWeightedAdd(-1, embeddings, false, noiseGrad, false, 1, c);
+#pragma omp parallel for
+            for (long instance_id = 0; instance_id < (long) batch_size; instance_id++)
+            {
+                size_t target = (size_t) (*this)(0, instance_id);
+                for (size_t dim = 0; dim < b.GetNumRows(); dim++)
+                    c(dim, instance_id) -= b(dim, target) * tmp(0, instance_id);
+            }
+        }
+        else if (inputIndex == 2)
+        {
+            CPUMatrix<ElemType> embeddingsGrad(a.GetNumRows(), num_noise_samples);
+            Multiply(a, false, noiseGrad, true, embeddingsGrad);
+            // parallel over dimensions, since a word may occur several times among the samples
+#pragma omp parallel for
+            for (long dim = 0; dim < (long) a.GetNumRows(); dim++)
+            {
+                for (size_t k = 0; k < num_noise_samples; k++)
+                    c(dim, (size_t) (*this)(2 * (k + 1), 0)) -= embeddingsGrad(dim, k);
+                for (size_t instance_id = 0; instance_id < batch_size; instance_id++)
+                    c(dim, (size_t) (*this)(0, instance_id)) -= a(dim, instance_id) * tmp(0, instance_id);
+            }
+        }
+        else
+        {
+            assert(inputIndex == 3);
+            for (size_t k = 0; k < num_noise_samples; k++)
+            {
+                ElemType sum = 0;
+                for (size_t instance_id = 0; instance_id < batch_size; instance_id++)
+                    sum += noiseGrad(k, instance_id);
+                c(0, (size_t) (*this)(2 * (k + 1), 0)) -= sum;
+            }
+            for (size_t instance_id = 0; instance_id < batch_size; instance_id++)
+                c(0, (size_t) (*this)(0, instance_id)) -= tmp(0, instance_id);
+        }
+        return *this;
+    }
+
     if (inputIndex == 1)
     {
 #pragma omp parallel for
@@ -4381,14 +4512,29 @@ void CPUMatrix<ElemType>::AssignNoiseContrastiveEstimation(const CPUMatrix<ElemT
     size_t batch_size = this->GetNumCols();
     size_t num_noise_samples = sample_size - 1;
     double log_num_noise_samples = std::log(num_noise_samples);
+
+    // with shared noise samples, score the noise words against all instances at once: [#noise samples x hdSize] x [hdSize x batch_size]
+    CPUMatrix<ElemType> noiseScores;
+    bool shared = HasSharedNCENoiseSamples(*this);
+    if (shared)
+    {
+        CPUMatrix<ElemType> embeddings;
+        GatherNCENoiseEmbeddings(*this, b, embeddings);
+        noiseScores.Resize(num_noise_samples, batch_size);
+        Multiply(embeddings, true, a, false, noiseScores);
+    }
+
 #pragma omp parallel for reduction(+ : log_likelihood)
     for (int instance_id = 0; instance_id < batch_size; instance_id++)
         for (int sample_id = 0; sample_id < sample_size; sample_id++)
         {
             int sample = (int) (*this)(2 * sample_id, instance_id);
             double score = bias(0, sample);
-            for (int dim = 0; dim < b.GetNumRows(); dim++)
-                score += a(dim, instance_id) * b(dim, sample);
+            if (shared && sample_id > 0)
+                score += noiseScores(sample_id - 1, instance_id);
+            else
+                for (int dim = 0; dim < b.GetNumRows(); dim++)
+                    score += a(dim, instance_id) * b(dim, sample);
             double sample_prob = -(*this)(2 * sample_id + 1, instance_id);
             if (sample_id == 0)
                 sample_prob = -sample_prob;
@@ -5558,6 +5704,307 @@ void CPUMatrix<ElemType>::_rcrfTransGrdCompute(size_t i,
         }
     }
 };
+
+// -----------------------------------------------------------------------
+// Gaussian mixture log-likelihood, for GMMLogLikelihoodNode
+//  - unnormedPrior: [K x P] mixture weights before softmax
+//  - mean: [D*K x P] component means, concatenated
+//  - logStdDev: [K x P] log standard deviation per component, or [D*K x P] per component and dimension (diagonal covariance)
+//  - feature: [D x T]
+// P is 1 if the parameters are shared by all frames, otherwise T.
+// With shared parameters, the Mahalanobis distances are expanded such that all frames are handled by two matrix
+// products: -1/2 sum_d lambda_cd (x_d - mu_cd)^2 = sum_d lambda_cd mu_cd x_d - 1/2 sum_d lambda_cd x_d^2 - 1/2 sum_d lambda_cd mu_cd^2,
+// where lambda = 1/stddev^2. With isotropic components, the second product is just the squared norm of each frame.
+// The log-sum-exp over the components and the posteriors are computed in the same sweep over each frame.
+// -----------------------------------------------------------------------
+
+// per-component parameters of parameter column p: precisions lambda_cd and means mu_cd as [D x K], and the frame-
+// independent part of the component log-likelihoods, log prior_c - sum_d log stddev_cd - D/2 log(2 pi)
+static const double logTwoPi = 1.83787706640934548356; // log(2 pi); TWO_PI is only float precision
+template <class ElemType>
+static void GMMComponentParameters(const CPUMatrix<ElemType>& unnormedPrior, const CPUMatrix<ElemType>& mean, const CPUMatrix<ElemType>& logStdDev, size_t p,
+                                   size_t D, ElemType* precisions, ElemType* means, ElemType* logPriors, ElemType* logNorms)
+{
+    const size_t K = unnormedPrior.GetNumRows();
+    const bool diagonal = logStdDev.GetNumRows() != K;
+    ElemType maxPrior = unnormedPrior(0, p);
+    for (size_t c = 1; c < K; c++)
+        maxPrior = max(maxPrior, unnormedPrior(c, p));
+    ElemType sumExp = 0;
+    for (size_t c = 0; c < K; c++)
+        sumExp += exp(unnormedPrior(c, p) - maxPrior);
+    const ElemType logSumExp = maxPrior + log(sumExp);
+    for (size_t c = 0; c < K; c++)
+    {
+        logPriors[c] = unnormedPrior(c, p) - logSumExp;
+        logNorms[c] = logPriors[c] - (ElemType)(D / 2.0 * logTwoPi);
+        for (size_t d = 0; d < D; d++)
+        {
+            const ElemType logStdDevCD = logStdDev(diagonal ? c * D + d : c, p);
+            precisions[c * D + d] = exp(-2 * logStdDevCD);
+            means[c * D + d] = mean(c * D + d, p);
+            logNorms[c] -= logStdDevCD;
+        }
+    }
+}
+
+// log-sum-exp over the K component log-likelihoods of a frame, which are replaced by the posteriors
+template <class ElemType>
+static ElemType GMMLogSumExpToPosteriors(ElemType* componentLogLikelihoods, size_t K)
+{
+    ElemType maxLogLikelihood = componentLogLikelihoods[0];
+    for (size_t c = 1; c < K; c++)
+        maxLogLikelihood = max(maxLogLikelihood, componentLogLikelihoods[c]);
+    ElemType sumExp = 0;
+    for (size_t c = 0; c < K; c++)
+    {
+        componentLogLikelihoods[c] = exp(componentLogLikelihoods[c] - maxLogLikelihood);
+        sumExp += componentLogLikelihoods[c];
+    }
+    for (size_t c = 0; c < K; c++)
+        componentLogLikelihoods[c] /= sumExp;
+    return maxLogLikelihood + log(sumExp);
+}
+
+template <class ElemType>
+static void VerifyGMMDimensions(const CPUMatrix<ElemType>& unnormedPrior, const CPUMatrix<ElemType>& mean, const CPUMatrix<ElemType>& logStdDev, const CPUMatrix<ElemType>& feature)
+{
+    const size_t K = unnormedPrior.GetNumRows(), D = feature.GetNumRows(), P = unnormedPrior.GetNumCols();
+    if (K == 0 || D == 0 || feature.GetNumCols() == 0)
+        LogicError("GMMLogLikelihood: one of the input matrices is empty.");
+    if (mean.GetNumRows() != K * D || (logStdDev.GetNumRows() != K && logStdDev.GetNumRows() != K * D))
+        InvalidArgument("GMMLogLikelihood: means must have %d rows, and log standard deviations %d or %d.", (int) (K * D), (int) K, (int) (K * D));
+    if ((P != 1 && P != feature.GetNumCols()) || mean.GetNumCols() != P || logStdDev.GetNumCols() != P)
+        InvalidArgument("GMMLogLikelihood: prior, means and log standard deviations must have one column, or one per frame.");
+}
+
+// logLikelihood = log sum_c prior_c N(feature; mean_c, stddev_c), posterior = the component posteriors
+template <class ElemType>
+void CPUMatrix<ElemType>::GMMLogLikelihood(const CPUMatrix<ElemType>& unnormedPrior, const CPUMatrix<ElemType>& mean, const CPUMatrix<ElemType>& logStdDev,
+                                           const CPUMatrix<ElemType>& feature, CPUMatrix<ElemType>& logLikelihood, CPUMatrix<ElemType>& posterior)
+{
+    VerifyGMMDimensions(unnormedPrior, mean, logStdDev, feature);
+    const size_t K = unnormedPrior.GetNumRows(), D = feature.GetNumRows(), T = feature.GetNumCols();
+    const bool diagonal = logStdDev.GetNumRows() != K;
+    logLikelihood.Resize(1, T);
+    posterior.Resize(K, T);
+    const ElemType* x = feature.BufferPointer();
+    ElemType* logLikelihoods = logLikelihood.BufferPointer();
+    ElemType* posteriors = posterior.BufferPointer();
+
+    if (unnormedPrior.GetNumCols() == 1) // shared parameters: matrix products over all frames
+    {
+        CPUMatrix<ElemType> precisions(D, K), scaledMeans(D, K), logPriors(K, 1), constants(K, 1);
+        GMMComponentParameters(unnormedPrior, mean, logStdDev, 0, D, precisions.BufferPointer(), scaledMeans.BufferPointer(), logPriors.BufferPointer(), constants.BufferPointer());
+        for (size_t c = 0; c < K; c++)
+        {
+            for (size_t d = 0; d < D; d++)
+            {
+                const ElemType mu = scaledMeans(d, c);
+                scaledMeans(d, c) *= precisions(d, c);
+                constants(c, 0) -= scaledMeans(d, c) * mu / 2;
+            }
+        }
+
+        // posterior = scaledMeans' * feature - 1/2 precisions' * feature.^2, the latter per frame if isotropic
+        MultiplyAndWeightedAdd(1, scaledMeans, true, feature, false, 0, posterior);
+        CPUMatrix<ElemType> squares(diagonal ? D : 1, T);
+        ElemType* sq = squares.BufferPointer();
+#pragma omp parallel for
+        for (long t = 0; t < (long) T; t++)
+        {
+            const ElemType* xt = x + t * D;
+            if (diagonal)
+            {
+                for (size_t d = 0; d < D; d++)
+                    sq[t * D + d] = xt[d] * xt[d];
+            }
+            else
+            {
+                ElemType sqNorm = 0;
+                for (size_t d = 0; d < D; d++)
+                    sqNorm += xt[d] * xt[d];
+                sq[t] = sqNorm;
+            }
+        }
+        if (diagonal)
+            MultiplyAndWeightedAdd(-0.5, precisions, true, squares, false, 1, posterior);
+
+#pragma omp parallel for
+        for (long t = 0; t < (long) T; t++)
+        {
+            ElemType* lt = posteriors + t * K;
+            for (size_t c = 0; c < K; c++)
+            {
+                lt[c] += constants(c, 0);
+                if (!diagonal)
+                    lt[c] -= precisions(0, c) * sq[t] / 2;
+            }
+            logLikelihoods[t] = GMMLogSumExpToPosteriors(lt, K);
+        }
+    }
+    else // parameters per frame
+    {
+#pragma omp parallel for
+        for (long t = 0; t < (long) T; t++)
+        {
+            vector<ElemType> precisions(D * K), means(D * K), logPriors(K);
+            ElemType* lt = posteriors + t * K;
+            GMMComponentParameters(unnormedPrior, mean, logStdDev, t, D, precisions.data(), means.data(), logPriors.data(), lt);
+            const ElemType* xt = x + t * D;
+            for (size_t c = 0; c < K; c++)
+            {
+                ElemType distance = 0;
+                for (size_t d = 0; d < D; d++)
+                {
+                    const ElemType deviation = xt[d] - means[c * D + d];
+                    distance += precisions[c * D + d] * deviation * deviation;
+                }
+                lt[c] -= distance / 2;
+            }
+            logLikelihoods[t] = GMMLogSumExpToPosteriors(lt, K);
+        }
+    }
+}
+
+// inputGradient += gradient of sum_t gradient_t * logLikelihood_t w.r.t. input inputIndex (0 = unnormedPrior, 1 = mean, 2 = logStdDev, 3 = feature),
+// given the posteriors computed by GMMLogLikelihood()
+// With shared parameters, the sums over frames are again matrix products with the posteriors weighted by the gradient.
+template <class ElemType>
+void CPUMatrix<ElemType>::GMMLogLikelihoodGradient(size_t inputIndex, const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& posterior,
+                                                   const CPUMatrix<ElemType>& unnormedPrior, const CPUMatrix<ElemType>& mean, const CPUMatrix<ElemType>& logStdDev,
+                                                   const CPUMatrix<ElemType>& feature, CPUMatrix<ElemType>& inputGradient)
+{
+    VerifyGMMDimensions(unnormedPrior, mean, logStdDev, feature);
+    const size_t K = unnormedPrior.GetNumRows(), D = feature.GetNumRows(), T = feature.GetNumCols();
+    const bool diagonal = logStdDev.GetNumRows() != K;
+    if (inputIndex > 3)
+        InvalidArgument("GMMLogLikelihoodGradient: there are only four inputs.");
+    const CPUMatrix<ElemType>& input = inputIndex == 0 ? unnormedPrior : inputIndex == 1 ? mean : inputIndex == 2 ? logStdDev : feature;
+    if (posterior.GetNumRows() != K || posterior.GetNumCols() != T || gradient.GetNumElements() != T)
+        InvalidArgument("GMMLogLikelihoodGradient: gradient or posteriors do not match the frames.");
+    inputGradient.VerifySize(input.GetNumRows(), input.GetNumCols());
+
+    // weights = posterior .* gradient, per frame
+    CPUMatrix<ElemType> weights(K, T);
+#pragma omp parallel for
+    for (long t = 0; t < (long) T; t++)
+    {
+        for (size_t c = 0; c < K; c++)
+            weights(c, t) = posterior(c, t) * gradient.BufferPointer()[t];
+    }
+
+    if (unnormedPrior.GetNumCols() == 1) // shared parameters
+    {
+        CPUMatrix<ElemType> precisions(D, K), means(D, K), logPriors(K, 1), logNorms(K, 1);
+        GMMComponentParameters(unnormedPrior, mean, logStdDev, 0, D, precisions.BufferPointer(), means.BufferPointer(), logPriors.BufferPointer(), logNorms.BufferPointer());
+        CPUMatrix<ElemType> sumWeights(K, 1); // S0_c = sum_t weights_ct
+        for (size_t c = 0; c < K; c++)
+        {
+            ElemType sum = 0;
+            for (size_t t = 0; t < T; t++)
+                sum += weights(c, t);
+            sumWeights(c, 0) = sum;
+        }
+
+        if (inputIndex == 0) // d/du_c = posterior_c - prior_c
+        {
+            ElemType sumGradient = 0;
+            for (size_t t = 0; t < T; t++)
+                sumGradient += gradient.BufferPointer()[t];
+            for (size_t c = 0; c < K; c++)
+                inputGradient(c, 0) += sumWeights(c, 0) - exp(logPriors(c, 0)) * sumGradient;
+        }
+        else if (inputIndex == 1 || inputIndex == 2)
+        {
+            // S1 = feature * weights' (sum_t weights_ct x_dt), for the log stddevs also S2 = feature.^2 * weights'
+            CPUMatrix<ElemType> weightedFeatures(D, K), weightedSquares;
+            MultiplyAndWeightedAdd(1, feature, false, weights, true, 0, weightedFeatures);
+            if (inputIndex == 2)
+            {
+                CPUMatrix<ElemType> squares(feature);
+                squares.ElementMultiplyWith(feature);
+                weightedSquares.Resize(D, K);
+                MultiplyAndWeightedAdd(1, squares, false, weights, true, 0, weightedSquares);
+            }
+            for (size_t c = 0; c < K; c++)
+            {
+                ElemType isotropicSum = 0;
+                for (size_t d = 0; d < D; d++)
+                {
+                    const ElemType lambda = precisions(d, c), mu = means(d, c), s0 = sumWeights(c, 0), s1 = weightedFeatures(d, c);
+                    if (inputIndex == 1) // d/dmu_cd = lambda_cd (x_d - mu_cd) posterior_c
+                        inputGradient(c * D + d, 0) += lambda * (s1 - mu * s0);
+                    else // d/dlog stddev_cd = (lambda_cd (x_d - mu_cd)^2 - 1) posterior_c
+                    {
+                        const ElemType g = lambda * (weightedSquares(d, c) - 2 * mu * s1 + mu * mu * s0) - s0;
+                        if (diagonal)
+                            inputGradient(c * D + d, 0) += g;
+                        else
+                            isotropicSum += g;
+                    }
+                }
+                if (inputIndex == 2 && !diagonal)
+                    inputGradient(c, 0) += isotropicSum;
+            }
+        }
+        else // d/dx_d = -sum_c lambda_cd (x_d - mu_cd) posterior_c = (lambda .* mu) * posterior - x_d (lambda * posterior)_d
+        {
+            CPUMatrix<ElemType> scaledMeans(precisions);
+            scaledMeans.ElementMultiplyWith(means);
+            MultiplyAndWeightedAdd(1, scaledMeans, false, weights, false, 1, inputGradient);
+            CPUMatrix<ElemType> weightedPrecisions(diagonal ? D : 1, T); // lambda * weights, per frame if isotropic
+            if (diagonal)
+                MultiplyAndWeightedAdd(1, precisions, false, weights, false, 0, weightedPrecisions);
+            else
+            {
+                CPUMatrix<ElemType> componentPrecisions(1, K);
+                for (size_t c = 0; c < K; c++)
+                    componentPrecisions(0, c) = precisions(0, c);
+                MultiplyAndWeightedAdd(1, componentPrecisions, false, weights, false, 0, weightedPrecisions);
+            }
+#pragma omp parallel for
+            for (long t = 0; t < (long) T; t++)
+            {
+                for (size_t d = 0; d < D; d++)
+                    inputGradient(d, t) -= feature(d, t) * weightedPrecisions(diagonal ? d : 0, t);
+            }
+        }
+    }
+    else // parameters per frame
+    {
+#pragma omp parallel for
+        for (long t = 0; t < (long) T; t++)
+        {
+            vector<ElemType> precisions(D * K), means(D * K), logPriors(K), logNorms(K);
+            GMMComponentParameters(unnormedPrior, mean, logStdDev, t, D, precisions.data(), means.data(), logPriors.data(), logNorms.data());
+            for (size_t c = 0; c < K; c++)
+            {
+                const ElemType w = weights(c, t);
+                if (inputIndex == 0)
+                {
+                    inputGradient(c, t) += w - exp(logPriors[c]) * gradient.BufferPointer()[t];
+                    continue;
+                }
+                ElemType isotropicSum = 0;
+                for (size_t d = 0; d < D; d++)
+                {
+                    const ElemType lambda = precisions[c * D + d], deviation = feature(d, t) - means[c * D + d];
+                    if (inputIndex == 1)
+                        inputGradient(c * D + d, t) += w * lambda * deviation;
+                    else if (inputIndex == 3)
+                        inputGradient(d, t) -= w * lambda * deviation;
+                    else if (diagonal)
+                        inputGradient(c * D + d, t) += w * (lambda * deviation * deviation - 1);
+                    else
+                        isotropicSum += w * (lambda * deviation * deviation - 1);
+                }
+                if (inputIndex == 2 && !diagonal)
+                    inputGradient(c, t) += isotropicSum;
+            }
+        }
+    }
+}
 template <class ElemType>
 CPUMatrix<ElemType>& CPUMatrix<ElemType>::DropFrame(const CPUMatrix<ElemType>& label, const CPUMatrix<ElemType>& gamma, const ElemType& threshhold)
 {
@@ -5628,6 +6075,68 @@ int CPUMatrix<ElemType>::SetNumThreads(int numThreads)
     return numThreads;
 }
 
+// pin OpenMP worker threads to NUMA nodes and first-touch new buffers from them
+// Only nodes the process may run on (per its initial affinity, e.g. a cgroup cpuset) are used. Threads are
+// assigned to them in contiguous blocks (thread t goes to the t * nodes / threads-th node), which matches the
+// static schedule of our 'omp parallel for' loops, so that each socket keeps working on the same columns of a
+// matrix. The node list starts with the master thread's current node, so the master stays where it runs.
+// Disabling restores the affinity the threads started with.
+// note: this function does not depend on the <ElemType> parameter
+template <class ElemType>
+bool CPUMatrix<ElemType>::SetNumaAffinity(bool enable)
+{
+    if (enable == g_numaAffinity)
+        return g_numaAffinity;
+#ifdef _OPENMP
+    vector<size_t> nodes;
+    const size_t masterNode = msra::numa::getcurrentnode();
+    if (msra::numa::isnodeallowed(masterNode))
+        nodes.push_back(masterNode);
+    for (size_t node = 0; node < msra::numa::getnumnodes(); node++)
+        if (node != masterNode && msra::numa::isnodeallowed(node))
+            nodes.push_back(node);
+    const size_t numNodes = nodes.size();
+    bool success = numNodes > 0;
+#pragma omp parallel reduction(&& : success)
+    {
+        if (enable)
+        {
+            if (numNodes > 0)
+                success = msra::numa::bindcurrentthreadtonode(nodes[(size_t) omp_get_thread_num() * numNodes / (size_t) omp_get_num_threads()]);
+        }
+        else
+            msra::numa::unbindcurrentthread();
+    }
+    if (enable && !success)
+    {
+        fprintf(stderr, "SetNumaAffinity: Failed to pin threads to NUMA nodes, NUMA affinity not enabled.\n");
+#pragma omp parallel
+        msra::numa::unbindcurrentthread();
+        return false;
+    }
+    if (enable)
+        fprintf(stderr, "SetNumaAffinity: Pinned %d threads across %d NUMA nodes.\n", omp_get_max_threads(), (int) numNodes);
+    g_masterNumaNode = enable ? nodes.front() : 0;
+    g_numaAffinity = enable;
+#endif
+    return g_numaAffinity;
+}
+
+template <class ElemType>
+bool CPUMatrix<ElemType>::GetNumaAffinity()
+{
+    return g_numaAffinity;
+}
+
+// pin the calling (non-OpenMP) thread, e.g. a reader prefetch thread, to the NUMA node of the master thread,
+// so that the buffers it fills end up close to the consumer. No-op unless NUMA affinity is enabled.
+template <class ElemType>
+void CPUMatrix<ElemType>::BindToMasterNumaNode()
+{
+    if (g_numaAffinity)
+        msra::numa::bindcurrentthreadtonode(g_masterNumaNode);
+}
+
 // =======================================================================
 // TensorView support
 // =======================================================================
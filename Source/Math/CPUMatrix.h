@@ -319,6 +319,9 @@ public:
 
 public:
     static int SetNumThreads(int numThreads); // note: this does not depend on <ElemType>, i.e. you can call it on any <ElemType>
+    static bool SetNumaAffinity(bool enable); // pin threads per NUMA node and first-touch buffers there; also does not depend on <ElemType>
+    static bool GetNumaAffinity();
+    static void BindToMasterNumaNode();
 
     // static BLAS functions
     static void SVD(const CPUMatrix<ElemType>& A, CPUMatrix<ElemType>& SIGMA, CPUMatrix<ElemType>& U, CPUMatrix<ElemType>& VT, CPUMatrix<ElemType>& W);
@@ -394,13 +397,11 @@ public:
         size_t numRows, numCols;
         int format;
         stream >> matrixName >> format >> numRows >> numCols;
-        ElemType* d_array = new ElemType[numRows * numCols];
-        for (size_t i = 0; i < numRows * numCols; ++i)
-            stream >> d_array[i];
+        us.m_format = matrixFormatDense;
+        us.m_computeDevice = CPUDEVICE;
+        us.Resize(numRows, numCols);
+        stream.ReadArray(us.m_pArray, numRows * numCols); // directly into our buffer
         stream.GetMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
-        us.SetValue(numRows, numCols, d_array, matrixFlagNormal);
-
-        delete[] d_array;
         return stream;
     }
     friend File& operator<<(File& stream, const CPUMatrix<ElemType>& us)
@@ -413,8 +414,7 @@ public:
         stream << s << format;
 
         stream << us.m_numRows << us.m_numCols;
-        for (size_t i = 0; i < us.GetNumElements(); ++i)
-            stream << us.m_pArray[i];
+        stream.WriteArray(us.m_pArray, us.GetNumElements());
         stream.PutMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
         return stream;
     }
@@ -446,6 +446,14 @@ public:
                                      const size_t tPos // position
                                      );
 
+public:
+    // for GMMLogLikelihoodNode
+    static void GMMLogLikelihood(const CPUMatrix<ElemType>& unnormedPrior, const CPUMatrix<ElemType>& mean, const CPUMatrix<ElemType>& logStdDev,
+                                 const CPUMatrix<ElemType>& feature, CPUMatrix<ElemType>& logLikelihood, CPUMatrix<ElemType>& posterior);
+    static void GMMLogLikelihoodGradient(size_t inputIndex, const CPUMatrix<ElemType>& gradient, const CPUMatrix<ElemType>& posterior,
+                                         const CPUMatrix<ElemType>& unnormedPrior, const CPUMatrix<ElemType>& mean, const CPUMatrix<ElemType>& logStdDev,
+                                         const CPUMatrix<ElemType>& feature, CPUMatrix<ElemType>& inputGradient);
+
 protected:
     size_t LocateElement(const size_t i, const size_t j) const;
     size_t LocateColumn(const size_t j) const;
@@ -374,7 +374,9 @@ CPUSparseMatrix<ElemType> CPUSparseMatrix<ElemType>::ColumnSlice(size_t startCol
     if (startColumn + numCols > m_numCols)
         InvalidArgument("The slice (%d+%d) is out of range of the source matrix (%d).", (int) startColumn, (int) numCols, (int) m_numCols);
 
-    if (m_format != MatrixFormat::matrixFormatSparseCSC && m_format != MatrixFormat::matrixFormatSparseBlockCol)
+    // CSR matrices can only be sliced as a whole, e.g. when a sparse parameter is viewed as a tensor
+    bool isCSRView = m_format == MatrixFormat::matrixFormatSparseCSR && startColumn == 0 && numCols == m_numCols;
+    if (m_format != MatrixFormat::matrixFormatSparseCSC && m_format != MatrixFormat::matrixFormatSparseBlockCol && !isCSRView)
         NOT_IMPLEMENTED;
 
     CPUSparseMatrix<ElemType> slice(m_format);
@@ -438,6 +440,16 @@ CPUSparseMatrix<ElemType> CPUSparseMatrix<ElemType>::ColumnSlice(size_t startCol
 
         slice.m_nz           = slice.m_blockSize * m_numRows;
     }
+    else if (isCSRView)
+    {
+        slice.m_pArray            = m_pArray;
+        slice.m_nzValues          = m_nzValues;
+        slice.m_unCompIndex       = m_unCompIndex;
+        slice.m_compIndex         = m_compIndex;
+        slice.m_compIndexSize     = m_compIndexSize;
+        slice.m_nz                = m_nz;
+        slice.m_elemSizeAllocated = m_nz;
+    }
 
     return slice;
 }
@@ -517,6 +529,22 @@ void CPUSparseMatrix<ElemType>::SetMatrixFromCSCFormat(const CPUSPARSE_INDEX_TYP
     memcpy(NzValues(), h_Val, NzSize());
 }
 
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::SetMatrixFromCSRFormat(const CPUSPARSE_INDEX_TYPE* h_CSRRow, const CPUSPARSE_INDEX_TYPE* h_Col, const ElemType* h_Val,
+                                                       const size_t nz, const size_t numRows, const size_t numCols)
+{
+    if (!OwnBuffer())
+        LogicError("Cannot modify since the buffer is managed externally.");
+
+    m_format = matrixFormatSparseCSR;
+    Resize(numRows, numCols, nz, true, false);
+    this->SetNzCount(nz);
+
+    memcpy(RowLocation(), h_CSRRow, RowSize());
+    memcpy(ColLocation(), h_Col, ColSize());
+    memcpy(NzValues(), h_Val, NzSize());
+}
+
 template <class ElemType>
 ElemType* CPUSparseMatrix<ElemType>::BufferPointer() const
 {
@@ -608,8 +636,84 @@ void CPUSparseMatrix<ElemType>::Reset()
     m_blockIdShift = 0;
 }
 
+// y += a * x over n contiguous elements
+template <class ElemType>
+static inline void ScaleAndAddContiguous(ElemType a, const ElemType* x, ElemType* y, long n)
+{
+#ifndef _MSC_VER // VS only supports OpenMP 2.0
+#pragma omp simd // without it, gcc may vectorize an enclosing loop over nonzeros instead, keeping y in memory
+#endif
+    for (long j = 0; j < n; j++)
+        y[j] += a * x[j];
+}
+
+// Regroups the nonzeros of numSlices compressed slices by their uncompressed index in [0, numTargets), i.e. converts
+// CSC to CSR and vice versa. The result is against index 0 and sorted within each target slice.
+template <class ElemType>
+static void TransposeCompressedSlices(const CPUSPARSE_INDEX_TYPE* compIndex, const CPUSPARSE_INDEX_TYPE* unCompIndex, const ElemType* values, size_t numSlices, size_t numTargets,
+                                      vector<CPUSPARSE_INDEX_TYPE>& targetCompIndex, vector<CPUSPARSE_INDEX_TYPE>& targetUnCompIndex, vector<ElemType>& targetValues)
+{
+    const CPUSPARSE_INDEX_TYPE begin = compIndex[0], end = compIndex[numSlices];
+    targetCompIndex.assign(numTargets + 1, 0);
+    for (CPUSPARSE_INDEX_TYPE p = begin; p < end; p++)
+        targetCompIndex[unCompIndex[p] + 1]++;
+    for (size_t t = 0; t < numTargets; t++)
+        targetCompIndex[t + 1] += targetCompIndex[t];
+
+    targetUnCompIndex.resize(end - begin);
+    targetValues.resize(end - begin);
+    vector<CPUSPARSE_INDEX_TYPE> next(targetCompIndex.begin(), targetCompIndex.end() - 1);
+    for (size_t s = 0; s < numSlices; s++)
+    {
+        for (CPUSPARSE_INDEX_TYPE p = compIndex[s]; p < compIndex[s + 1]; p++)
+        {
+            CPUSPARSE_INDEX_TYPE q = next[unCompIndex[p]]++;
+            targetUnCompIndex[q] = (CPUSPARSE_INDEX_TYPE) s;
+            targetValues[q] = values[p];
+        }
+    }
+}
+
+// Splits the target columns of a dense x sparse product into ranges of about equal work, given where the nonzeros
+// of each column start. A column costs numRows for its initialization plus numRows per nonzero, so a few frequent
+// words or long documents do not leave the other threads idle. Small products stay on one thread.
+class NonzeroBalancedPartition
+{
+public:
+    NonzeroBalancedPartition(const CPUSPARSE_INDEX_TYPE* offsets, size_t numCols, size_t numRows)
+    {
+        const size_t minElementsPerThread = 4096;
+        const size_t numThreads = (size_t) omp_get_max_threads();
+        const size_t totalWork = offsets[numCols] - offsets[0] + numCols; // in units of numRows
+        const size_t numItems = max((size_t) 1, min(min(numCols, 4 * numThreads), totalWork * numRows / minElementsPerThread));
+        m_isParallel = numItems > 1;
+        m_begins.push_back(0);
+        for (size_t j = 0; j < numCols && m_begins.size() < numItems; j++)
+        {
+            size_t workBefore = offsets[j + 1] - offsets[0] + j + 1; // including column j
+            if (workBefore * numItems >= m_begins.size() * totalWork)
+                m_begins.push_back(j + 1);
+        }
+        m_begins.push_back(numCols);
+    }
+    bool IsParallel() const { return m_isParallel; }
+    long NumItems() const { return (long) m_begins.size() - 1; }
+    void Get(long item, size_t& begin, size_t& end) const
+    {
+        begin = m_begins[item];
+        end = m_begins[item + 1];
+    }
+
+private:
+    vector<size_t> m_begins;
+    bool m_isParallel;
+};
+
 // c = alpha*op(lhs) * op(rhs) + beta*c
 // dense x sparse = dense
+// Each target column is a weighted sum of columns of op(lhs), accumulated by one thread with a vectorized loop.
+// If the compressed slices of rhs are rows of op(rhs), e.g. for the gradient dW = dY * X^T of a sparse input X, the
+// nonzeros are first regrouped by target column, so that the accumulation still needs no atomics.
 template <class ElemType>
 void CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const CPUMatrix<ElemType>& lhs, const bool transposeA,
                                                        const CPUSparseMatrix<ElemType>& rhs, const bool transposeB, ElemType beta, CPUMatrix<ElemType>& c)
@@ -617,87 +721,182 @@ void CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const CPU
     if (lhs.IsEmpty() || rhs.IsEmpty())
         LogicError("MultiplyAndWeightedAdd:  one of the input matrix is empty.");
 
-    int m = transposeA ? (int) lhs.GetNumCols() : (int) lhs.GetNumRows();
-    int k = transposeA ? (int) lhs.GetNumRows() : (int) lhs.GetNumCols();
-    int l = transposeB ? (int) rhs.GetNumCols() : (int) rhs.GetNumRows();
-    int n = transposeB ? (int) rhs.GetNumRows() : (int) rhs.GetNumCols();
+    if (rhs.GetFormat() != matrixFormatSparseCSC && rhs.GetFormat() != matrixFormatSparseCSR)
+        NOT_IMPLEMENTED;
 
-    assert(m > 0 && k > 0 && l > 0 && n > 0); // converting from size_t to int may cause overflow
-    assert(k == l);
+    long m = transposeA ? (long) lhs.GetNumCols() : (long) lhs.GetNumRows();
+    long k = transposeA ? (long) lhs.GetNumRows() : (long) lhs.GetNumCols();
+    long l = transposeB ? (long) rhs.GetNumCols() : (long) rhs.GetNumRows();
+    long n = transposeB ? (long) rhs.GetNumRows() : (long) rhs.GetNumCols();
+
+    assert(m > 0 && k > 0 && l > 0 && n > 0); // converting from size_t to long may cause overflow
     if (k != l)
-    {
         InvalidArgument("CPUSparseMatrix::MultiplyAndWeightedAdd: The inner dimensions of a and b must match.");
-    }
 
     if (beta == 0)
         c.Resize(m, n);
     else
         c.VerifySize(m, n); // Can't resize if beta != 0
 
-    if (beta == 0)
+    // columns of op(lhs) must be contiguous
+    CPUMatrix<ElemType> lhsTransposed;
+    if (transposeA)
+        lhsTransposed.AssignTransposeOf(lhs);
+    const ElemType* lhsData = transposeA ? lhsTransposed.BufferPointer() : lhs.BufferPointer();
+
+    // nonzeros of op(rhs) grouped by column
+    const CPUSPARSE_INDEX_TYPE* colStarts = rhs.m_compIndex; // note: m_compIndex is always against m_pArray
+    const CPUSPARSE_INDEX_TYPE* rowIndices = rhs.m_unCompIndex;
+    const ElemType* values = rhs.m_pArray;
+    vector<CPUSPARSE_INDEX_TYPE> transposedColStarts, transposedRowIndices;
+    vector<ElemType> transposedValues;
+    if ((rhs.GetFormat() == matrixFormatSparseCSC) == transposeB) // compressed slices are rows of op(rhs)
     {
-        memset(c.GetArray(), 0, sizeof(ElemType) * c.GetNumElements());
+        TransposeCompressedSlices(rhs.m_compIndex, rhs.m_unCompIndex, rhs.m_pArray, k, n, transposedColStarts, transposedRowIndices, transposedValues);
+        colStarts = transposedColStarts.data();
+        rowIndices = transposedRowIndices.data();
+        values = transposedValues.data();
     }
-    else if (beta != 1)
+
+    ElemType* cData = c.BufferPointer();
+    NonzeroBalancedPartition partition(colStarts, n, m);
+#pragma omp parallel for if (partition.IsParallel())
+    for (long item = 0; item < partition.NumItems(); item++)
     {
-#pragma omp parallel for
-        foreach_coord (i, j, c)
+        size_t begin, end;
+        partition.Get(item, begin, end);
+        for (size_t j = begin; j < end; j++)
         {
-            c(i, j) = beta * c(i, j);
+            ElemType* cCol = cData + j * m;
+            if (beta == 0)
+                memset(cCol, 0, sizeof(ElemType) * m);
+            else if (beta != 1)
+            {
+                for (long i = 0; i < m; i++)
+                    cCol[i] *= beta;
+            }
+            for (CPUSPARSE_INDEX_TYPE p = colStarts[j]; p < colStarts[j + 1]; p++)
+                ScaleAndAddContiguous(alpha * values[p], lhsData + rowIndices[p] * m, cCol, m);
         }
     }
+}
+
+// Sparse x dense products process the dense matrix in blocks of this many columns, copied such that the elements of a
+// row of the block are contiguous. A packed block of a few hundred rows still fits into L1.
+static const long packedBlockWidth = 16;
 
-    if (rhs.GetFormat() != matrixFormatSparseCSC)
+// y += a * x over a row of a packed block, n <= packedBlockWidth
+// A constant trip count for full blocks makes the vectorized loop much faster.
+template <class ElemType>
+static inline void ScaleAndAddRow(ElemType a, const ElemType* x, ElemType* y, long n)
+{
+    if (n == packedBlockWidth)
+        ScaleAndAddContiguous(a, x, y, packedBlockWidth);
+    else
+        ScaleAndAddContiguous(a, x, y, n);
+}
+
+// c = alpha*op(lhs) * op(rhs) + beta*c
+// sparse x dense = dense
+// Each compressed slice (column of CSC, row of CSR) of lhs is a row of op(lhs) if the format and transposition disagree,
+// otherwise a column. rhs is packed block by block; each nonzero of lhs then updates a contiguous row of accumulators
+// from a contiguous row of the block. Rows of op(lhs) give independent output rows, so blocks of rows and columns are
+// computed in parallel; columns of op(lhs) are scattered into all output rows, so only the column blocks are.
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const CPUSparseMatrix<ElemType>& lhs, const bool transposeA,
+                                                       const CPUMatrix<ElemType>& rhs, const bool transposeB, ElemType beta, CPUMatrix<ElemType>& c)
+{
+    if (lhs.IsEmpty() || rhs.IsEmpty())
+        LogicError("MultiplyAndWeightedAdd:  one of the input matrix is empty.");
+
+    if (lhs.GetFormat() != matrixFormatSparseCSC && lhs.GetFormat() != matrixFormatSparseCSR)
         NOT_IMPLEMENTED;
 
-    if (!transposeA && !transposeB)
+    long m = transposeA ? (long) lhs.GetNumCols() : (long) lhs.GetNumRows();
+    long k = transposeA ? (long) lhs.GetNumRows() : (long) lhs.GetNumCols();
+    long l = transposeB ? (long) rhs.GetNumCols() : (long) rhs.GetNumRows();
+    long n = transposeB ? (long) rhs.GetNumRows() : (long) rhs.GetNumCols();
+
+    assert(m > 0 && k > 0 && l > 0 && n > 0); // converting from size_t to long may cause overflow
+    if (k != l)
+        InvalidArgument("CPUSparseMatrix::MultiplyAndWeightedAdd: The inner dimensions of a and b must match.");
+
+    if (beta == 0)
+        c.Resize(m, n);
+    else
+        c.VerifySize(m, n); // Can't resize if beta != 0
+
+    const CPUSPARSE_INDEX_TYPE* compIndex = lhs.m_compIndex; // note: m_compIndex is always against m_pArray
+    const CPUSPARSE_INDEX_TYPE* unCompIndex = lhs.m_unCompIndex;
+    const ElemType* values = lhs.m_pArray;
+    const ElemType* rhsData = rhs.BufferPointer();
+    ElemType* cData = c.BufferPointer();
+
+    const long colBlockSize = min(n, packedBlockWidth);
+    const long numColBlocks = (n + colBlockSize - 1) / colBlockSize;
+    // copy columns [j0, j1) of op(rhs) into a [colBlockSize x k] row-major block
+    auto packColumns = [&](long j0, long j1, vector<ElemType>& packed)
     {
-        for (size_t j = 0; j < rhs.GetNumCols(); j++)
+        packed.assign(k * colBlockSize, 0);
+        for (long j = j0; j < j1; j++)
+            for (long h = 0; h < k; h++)
+                packed[h * colBlockSize + j - j0] = transposeB ? rhsData[h * n + j] : rhsData[j * k + h];
+    };
+    auto storeRow = [&](long i, long j0, long j1, const ElemType* acc)
+    {
+        for (long j = j0; j < j1; j++)
         {
-            size_t start = rhs.m_compIndex[j]; // ColLocation
-            size_t end = rhs.m_compIndex[j + 1];
-            for (size_t p = start; p < end; p++)
-            {
-                size_t i = rhs.m_unCompIndex[p]; // RowLocation
-                ElemType val = rhs.m_pArray[p];
+            ElemType& cij = cData[j * m + i];
+            cij = beta == 0 ? alpha * acc[j - j0] : alpha * acc[j - j0] + beta * cij;
+        }
+    };
 
-                for (size_t h = 0; h < lhs.GetNumRows(); h++)
-                {
-                    c(h, j) += alpha * lhs(h, i) * val;
-                }
+    if ((lhs.GetFormat() == matrixFormatSparseCSR) != transposeA) // compressed slices are rows of op(lhs)
+    {
+        const long rowBlockSize = 256;
+        const long numRowBlocks = (m + rowBlockSize - 1) / rowBlockSize;
+#pragma omp parallel for
+        for (long block = 0; block < numRowBlocks * numColBlocks; block++)
+        {
+            long i0 = (block % numRowBlocks) * rowBlockSize, i1 = min(i0 + rowBlockSize, m);
+            long j0 = (block / numRowBlocks) * colBlockSize, j1 = min(j0 + colBlockSize, n);
+            vector<ElemType> packed;
+            packColumns(j0, j1, packed);
+            ElemType acc[packedBlockWidth];
+            for (long i = i0; i < i1; i++)
+            {
+                for (long jj = 0; jj < colBlockSize; jj++)
+                    acc[jj] = 0;
+                for (CPUSPARSE_INDEX_TYPE p = compIndex[i]; p < compIndex[i + 1]; p++)
+                    ScaleAndAddRow(values[p], packed.data() + unCompIndex[p] * colBlockSize, acc, colBlockSize);
+                storeRow(i, j0, j1, acc);
             }
         }
     }
-    else if (!transposeA && transposeB)
+    else // compressed slices are columns of op(lhs)
     {
-        for (size_t j = 0; j < rhs.GetNumCols(); j++)
+#pragma omp parallel for
+        for (long block = 0; block < numColBlocks; block++)
         {
-            size_t start = rhs.m_compIndex[j];
-            size_t end = rhs.m_compIndex[j + 1];
-
-            for (size_t p = start; p < end; p++)
+            long j0 = block * colBlockSize, j1 = min(j0 + colBlockSize, n);
+            vector<ElemType> packed, acc(m * colBlockSize, 0);
+            packColumns(j0, j1, packed);
+            for (long h = 0; h < k; h++)
             {
-                size_t i = rhs.m_unCompIndex[p];
-                ElemType val = rhs.m_pArray[p];
-                for (size_t h = 0; h < lhs.GetNumRows(); h++)
-                {
-                    c(h, i) += alpha * lhs(h, j) * val;
-                }
+                const ElemType* packedRow = packed.data() + h * colBlockSize;
+                for (CPUSPARSE_INDEX_TYPE p = compIndex[h]; p < compIndex[h + 1]; p++)
+                    ScaleAndAddRow(values[p], packedRow, acc.data() + unCompIndex[p] * colBlockSize, colBlockSize);
             }
+            for (long i = 0; i < m; i++)
+                storeRow(i, j0, j1, acc.data() + i * colBlockSize);
         }
     }
-    else if (transposeA && !transposeB)
-    {
-        NOT_IMPLEMENTED;
-    }
-    else
-    {
-        NOT_IMPLEMENTED;
-    }
 }
 
 // dense x sparse = sparse
-// c = alpha * op(lhs) * op(rhs)
+// c += alpha * op(lhs) * op(rhs)
+// If c already holds a block-column product of the same shape, new columns are merged into it; otherwise c is reset first.
+// The blocks are accumulated in parallel like the columns of the dense x sparse = dense product.
 template <class ElemType>
 void CPUSparseMatrix<ElemType>::MultiplyAndAdd(ElemType alpha, const CPUMatrix<ElemType>& lhs, const bool transposeA,
                                                const CPUSparseMatrix<ElemType>& rhs, const bool transposeB, CPUSparseMatrix<ElemType>& c)
@@ -722,7 +921,9 @@ void CPUSparseMatrix<ElemType>::MultiplyAndAdd(ElemType alpha, const CPUMatrix<E
         InvalidArgument("CPUSparseMatrix::MultiplyAndAdd: The inner dimensions of a and b must match.");
     }
 
-    c.Reset();
+    bool accumulate = c.GetFormat() == matrixFormatSparseBlockCol && c.GetNumRows() == m && c.GetNumCols() == n && c.m_blockIdShift == 0;
+    if (!accumulate)
+        c.Reset();
 
     if (!transposeA && !transposeB)
     {
@@ -733,46 +934,52 @@ void CPUSparseMatrix<ElemType>::MultiplyAndAdd(ElemType alpha, const CPUMatrix<E
         if (rhs.GetFormat() != matrixFormatSparseCSC)
             NOT_IMPLEMENTED;
 
-        // allocate enough memory
+        // allocate enough memory, keeping the blocks already accumulated
+        size_t numExistingBlocks = c.m_blockSize;
         c.SetFormat(matrixFormatSparseBlockCol);
-        c.Resize(m, n, m * min(n, rhs.m_nz), true, false);
-
-        map<size_t, size_t> w2Id;
-        for (size_t j = 0; j < rhs.GetNumCols(); j++)
-        { // j ranges over batches
-            size_t start = rhs.m_compIndex[j];
-            size_t end = rhs.m_compIndex[j + 1];
-
-            for (size_t p = start; p < end; p++)
+        c.Resize(m, n, m * min(n, numExistingBlocks + rhs.m_nz), true, numExistingBlocks > 0);
+
+        // assign each word (row of rhs) its block, and group the nonzeros by block, such that each block is
+        // accumulated by one thread (transposed accumulation, no atomics)
+        unordered_map<size_t, size_t> w2Id;
+        for (size_t b = 0; b < numExistingBlocks; b++)
+            w2Id[c.m_blockIds[b]] = b;
+        const CPUSPARSE_INDEX_TYPE begin = rhs.m_compIndex[0], end = rhs.m_compIndex[rhs.GetNumCols()];
+        vector<CPUSPARSE_INDEX_TYPE> blockOfNonzero(end - begin);
+        for (CPUSPARSE_INDEX_TYPE p = begin; p < end; p++)
+        {
+            size_t i = rhs.m_unCompIndex[p]; // i ranges over words
+            auto iter = w2Id.find(i);
+            if (iter == w2Id.end())
+            {
+                iter = w2Id.insert(make_pair(i, c.m_blockSize)).first;
+                c.m_blockIds[c.m_blockSize] = i;
+                c.m_blockSize++;
+            }
+            blockOfNonzero[p - begin] = (CPUSPARSE_INDEX_TYPE) iter->second;
+        }
+        vector<CPUSPARSE_INDEX_TYPE> batchCompIndex(rhs.GetNumCols() + 1);
+        for (size_t j = 0; j <= rhs.GetNumCols(); j++)
+            batchCompIndex[j] = rhs.m_compIndex[j] - begin;
+        vector<CPUSPARSE_INDEX_TYPE> blockStarts, batchIndices; // j of the nonzeros of each block
+        vector<ElemType> blockValues;
+        TransposeCompressedSlices(batchCompIndex.data(), blockOfNonzero.data(), rhs.m_pArray + begin, rhs.GetNumCols(), c.m_blockSize,
+                                  blockStarts, batchIndices, blockValues);
+
+        const ElemType* lhsData = lhs.BufferPointer();
+        NonzeroBalancedPartition partition(blockStarts.data(), c.m_blockSize, m);
+#pragma omp parallel for if (partition.IsParallel())
+        for (long item = 0; item < partition.NumItems(); item++)
+        {
+            size_t blockBegin, blockEnd;
+            partition.Get(item, blockBegin, blockEnd);
+            for (size_t b = blockBegin; b < blockEnd; b++)
             {
-                size_t i = rhs.m_unCompIndex[p]; // i ranges over words
-                ElemType val = rhs.m_pArray[p];  // 1 for(i, j)
-
-                bool first = true;
-                if (w2Id.find(i) == w2Id.end())
-                {
-                    size_t id = w2Id.size();
-                    w2Id[i] = id;
-                    c.m_blockIds[c.m_blockSize] = i;
-                    c.m_blockSize++;
-                }
-                else
-                {
-                    first = false;
-                }
-                size_t pos = w2Id[i] * lhs.GetNumRows();
-                for (size_t h = 0; h < lhs.GetNumRows(); h++)
-                { // h range over hidden layer
-                    if (first == true)
-                    {
-                        c.m_pArray[pos] = alpha * lhs(h, j) * val;
-                    }
-                    else
-                    {
-                        c.m_pArray[pos] += alpha * lhs(h, j) * val;
-                    }
-                    pos++;
-                }
+                ElemType* block = c.m_pArray + b * m;
+                if (b >= numExistingBlocks)
+                    memset(block, 0, sizeof(ElemType) * m);
+                for (CPUSPARSE_INDEX_TYPE q = blockStarts[b]; q < blockStarts[b + 1]; q++) // j ranges over batches
+                    ScaleAndAddContiguous(alpha * blockValues[q], lhsData + batchIndices[q] * m, block, (long) m);
             }
         }
         c.m_nz = c.m_blockSize * m;
@@ -885,7 +1092,9 @@ void CPUSparseMatrix<ElemType>::NormalGrad(CPUMatrix<ElemType>& c, const ElemTyp
 
     if (m_format == MatrixFormat::matrixFormatSparseBlockCol || m_format == MatrixFormat::matrixFormatSparseBlockRow)
     {
-        for (size_t j = 0; j < m_blockSize; j++)
+        // blocks cover distinct columns (rows), so they can be updated in parallel
+#pragma omp parallel for
+        for (long j = 0; j < (long) m_blockSize; j++)
         {
             size_t i = m_blockIds[j] - m_blockIdShift;
             size_t len = (m_format == MatrixFormat::matrixFormatSparseBlockCol) ? GetNumRows() : GetNumCols();
@@ -948,12 +1157,13 @@ ElemType CPUSparseMatrix<ElemType>::Adagrad(CPUMatrix<ElemType>& c, const bool n
     else if (m_format == MatrixFormat::matrixFormatSparseBlockCol || m_format == MatrixFormat::matrixFormatSparseBlockRow)
     {
         size_t len = (m_format == MatrixFormat::matrixFormatSparseBlockCol) ? GetNumRows() : GetNumCols();
-        size_t p = 0;
-        for (long j = 0; j < m_blockSize; j++)
+#pragma omp parallel for reduction(+ : aveMultiplier)
+        for (long j = 0; j < (long) m_blockSize; j++)
         {
             size_t colOrRow = m_blockIds[j] - m_blockIdShift;
-            for (long i = 0; i < len; i++, p++)
+            for (long i = 0; i < (long) len; i++)
             {
+                size_t p = j * len + i;
                 ElemType val = m_pArray[p];
 
                 size_t row = (m_format == MatrixFormat::matrixFormatSparseBlockCol) ? i : colOrRow;
@@ -974,6 +1184,141 @@ ElemType CPUSparseMatrix<ElemType>::Adagrad(CPUMatrix<ElemType>& c, const bool n
         return 1;
 }
 
+// FSAdagrad update of functionValues from block-sparse gradients (this), with smoothed state c = [ada | momentum]
+// Unlike the dense version, state of columns (rows) absent from this minibatch is not decayed.
+template <class ElemType>
+void CPUSparseMatrix<ElemType>::FSAdagrad(CPUMatrix<ElemType>& c, CPUMatrix<ElemType>& functionValues, ElemType learnRatePerSample, ElemType momentum, ElemType adaWeight, ElemType adaMul)
+{
+    if (m_format != MatrixFormat::matrixFormatSparseBlockCol && m_format != MatrixFormat::matrixFormatSparseBlockRow)
+        RuntimeError("CPUSparseMatrix::FSAdagrad() only supports block sparse format");
+
+    size_t numColsNeeded = 2 * GetNumCols();
+    if (c.IsEmpty() || c.GetNumCols() < numColsNeeded)
+    {
+        c.Resize(GetNumRows(), numColsNeeded);
+        c.SetValue(0.0);
+    }
+
+    assert(c.GetNumRows() == GetNumRows() && c.GetNumCols() == numColsNeeded);
+    assert(functionValues.GetNumRows() == GetNumRows() && functionValues.GetNumCols() == GetNumCols());
+
+    const bool blockCol = (m_format == MatrixFormat::matrixFormatSparseBlockCol);
+    const size_t len = blockCol ? GetNumRows() : GetNumCols();
+    const size_t stride = blockCol ? 1 : GetNumRows(); // distance between consecutive block elements in the dense matrices
+    size_t n = GetNumRows() * GetNumCols();
+    ElemType* smoothAda = c.BufferPointer();
+    ElemType* smoothMom = c.BufferPointer() + n;
+    ElemType* val = functionValues.BufferPointer();
+
+#pragma omp parallel for
+    for (long j = 0; j < (long) m_blockSize; j++)
+    {
+        size_t colOrRow = m_blockIds[j] - m_blockIdShift;
+        size_t base = blockCol ? colOrRow * GetNumRows() : colOrRow;
+        const ElemType* grad = m_pArray + j * len;
+        for (size_t i = 0; i < len; i++)
+        {
+            size_t k = base + i * stride;
+            ElemType g = grad[i];
+            ElemType adaSqr = adaWeight * smoothAda[k] + (1.0f - adaWeight) * g * g;
+            smoothAda[k] = adaSqr;
+            if (adaSqr != 0.0f)
+            {
+                ElemType ada = sqrt(adaSqr);
+                ElemType w = adaMul * ((ElemType) 1.0 / ada);
+
+                if (w > 10.0f)
+                    w = 10.0f;
+                g *= w;
+            }
+
+            if (momentum > 0.0f)
+            {
+                g = momentum * smoothMom[k] + (1.0f - momentum) * g;
+                smoothMom[k] = g;
+            }
+
+            g *= learnRatePerSample;
+            val[k] -= g;
+        }
+    }
+}
+
+// RmsProp scaling of block-sparse gradients (this), with smoothed state c = [avars | signs | steps]
+// Only the active columns (rows) are touched, so the average multiplier is taken over the non-zeros.
+template <class ElemType>
+ElemType CPUSparseMatrix<ElemType>::RmsProp(CPUMatrix<ElemType>& c,
+                                            ElemType RMS_GAMMA,
+                                            ElemType RMS_WGT_INC,
+                                            ElemType RMS_WGT_MAX,
+                                            ElemType RMS_WGT_DEC,
+                                            ElemType RMS_WGT_MIN,
+                                            const bool needAveMultiplier)
+{
+    if (m_format != MatrixFormat::matrixFormatSparseBlockCol && m_format != MatrixFormat::matrixFormatSparseBlockRow)
+        RuntimeError("CPUSparseMatrix::RmsProp() only supports block sparse format");
+
+    const ElemType floor = 1e-6f;
+    size_t n = GetNumRows() * GetNumCols();
+
+    bool initialize = c.IsEmpty() || c.GetNumCols() < GetNumCols() * 3;
+    if (initialize)
+    {
+        c.Resize(GetNumRows(), GetNumCols() * 3);
+        c.SetValue(0.0);
+
+        // initialize starting step size
+        ElemType* steps = c.BufferPointer() + 2 * n;
+        for (long i = 0; i < (long) n; i++)
+            steps[i] = ElemType(0.02);
+    }
+
+    assert(c.GetNumRows() == GetNumRows() && c.GetNumCols() == GetNumCols() * 3);
+
+    const bool blockCol = (m_format == MatrixFormat::matrixFormatSparseBlockCol);
+    const size_t len = blockCol ? GetNumRows() : GetNumCols();
+    const size_t stride = blockCol ? 1 : GetNumRows();
+    ElemType* avars = c.BufferPointer();         // accumulated variances for RMS scaling
+    ElemType* signs = c.BufferPointer() + n;     // sign of previous gradient
+    ElemType* steps = c.BufferPointer() + 2 * n; // current step size
+
+    ElemType ONE_MINUS_GAMMA = ElemType(1.0) - RMS_GAMMA;
+    ElemType aveMultiplier = 0;
+#pragma omp parallel for reduction(+ : aveMultiplier)
+    for (long j = 0; j < (long) m_blockSize; j++)
+    {
+        size_t colOrRow = m_blockIds[j] - m_blockIdShift;
+        size_t base = blockCol ? colOrRow * GetNumRows() : colOrRow;
+        ElemType* curr_grad = m_pArray + j * len;
+        for (size_t i = 0; i < len; i++)
+        {
+            size_t k = base + i * stride;
+            // moving average of gradient-squared starts at the first gradient, as in the dense version
+            if (initialize)
+                avars[k] = curr_grad[i] * curr_grad[i];
+            avars[k] = RMS_GAMMA * avars[k] + ONE_MINUS_GAMMA * (curr_grad[i] * curr_grad[i]);
+            const int grad_sign = (ElemType(0) < curr_grad[i]) - (curr_grad[i] < ElemType(0));
+
+            if (signs[k] * grad_sign > 0)
+                steps[k] = std::min(steps[k] * RMS_WGT_INC, RMS_WGT_MAX);
+            else
+                steps[k] = std::max(steps[k] * RMS_WGT_DEC, RMS_WGT_MIN);
+
+            ElemType a = steps[k] / sqrt(avars[k] + floor);
+            curr_grad[i] *= a;
+            signs[k] = (ElemType) grad_sign;
+
+            if (needAveMultiplier)
+                aveMultiplier += a;
+        }
+    }
+
+    if (needAveMultiplier && m_nz > 0)
+        return aveMultiplier / m_nz;
+    else
+        return 1;
+}
+
 template <class ElemType>
 CPUSparseMatrix<ElemType>& CPUSparseMatrix<ElemType>::InplaceTruncateTop(const ElemType threshold)
 {
@@ -1221,6 +1566,8 @@ ElemType CPUSparseMatrix<ElemType>::SumOfElements() const
     return sum;
 }
 
+// Sparse matrices are stored in the same format as by GPUSparseMatrix: the non-zero values, then the major
+// and the compressed indices, both as size_t. Each of these is read/written as one block.
 template <typename ElemType>
 MATH_API File& operator>>(File& stream, CPUSparseMatrix<ElemType>& us)
 {
@@ -1246,27 +1593,23 @@ MATH_API File& operator>>(File& stream, CPUSparseMatrix<ElemType>& us)
         NOT_IMPLEMENTED;
 
     us.Resize(rownum, colnum, nz, true, false);
+    us.SetNzCount(nz);
 
     if (nz > 0)
     {
         size_t compressedSize = (us.GetFormat() == matrixFormatSparseCSC) ? colnum + 1 : rownum + 1;
-        ElemType* dataBuffer = us.NzValues();
         CPUSPARSE_INDEX_TYPE* unCompressedIndex = us.MajorIndexLocation();
         CPUSPARSE_INDEX_TYPE* compressedIndex = us.SecondaryIndexLocation();
 
         // read in the sparse matrix info
+        stream.ReadArray(us.NzValues(), nz);
+        vector<size_t> indices(max(nz, compressedSize));
+        stream.ReadArray(indices.data(), nz);
         for (size_t i = 0; i < nz; ++i)
-        {
-            stream >> dataBuffer[i];
-        }
-        for (size_t i = 0; i < nz; ++i)
-        {
-            stream >> unCompressedIndex[i];
-        }
+            unCompressedIndex[i] = (CPUSPARSE_INDEX_TYPE) indices[i];
+        stream.ReadArray(indices.data(), compressedSize);
         for (size_t i = 0; i < compressedSize; ++i)
-        {
-            stream >> compressedIndex[i];
-        }
+            compressedIndex[i] = (CPUSPARSE_INDEX_TYPE) indices[i];
     }
     stream.GetMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
 
@@ -1286,7 +1629,7 @@ MATH_API File& operator<<(File& stream, const CPUSparseMatrix<ElemType>& us)
     stream << sizeof(ElemType);
 	stream << std::wstring(L"nnmatrix"); // Note this is needed for compatability, and could potentially be an empty string
 
-    size_t nz, numRows, numCols;
+    size_t nz = us.NzCount(), numRows = us.GetNumRows(), numCols = us.GetNumCols();
     size_t compressedSize = us.SecondaryIndexCount();
     int format = us.GetFormat();
 
@@ -1294,28 +1637,23 @@ MATH_API File& operator<<(File& stream, const CPUSparseMatrix<ElemType>& us)
 
     if (nz > 0)
     {
-        ElemType* dataBuffer = us.NzValues();
-        CPUSPARSE_INDEX_TYPE* unCompressedIndex = us.MajorIndexLocation();
-        CPUSPARSE_INDEX_TYPE* compressedIndex = us.SecondaryIndexLocation();
-
-        for (size_t i = 0; i < nz; ++i)
-        {
-            stream << dataBuffer[i];
-        }
-        for (size_t i = 0; i < nz; ++i)
-        {
-            stream << unCompressedIndex[i];
-        }
-        for (size_t i = 0; i < compressedSize; ++i)
-        {
-            stream << compressedIndex[i];
-        }
+        const CPUSPARSE_INDEX_TYPE* unCompressedIndex = us.MajorIndexLocation();
+        const CPUSPARSE_INDEX_TYPE* compressedIndex = us.SecondaryIndexLocation();
+
+        stream.WriteArray(us.NzValues(), nz);
+        vector<size_t> indices(unCompressedIndex, unCompressedIndex + nz);
+        stream.WriteArray(indices.data(), nz);
+        indices.assign(compressedIndex, compressedIndex + compressedSize);
+        stream.WriteArray(indices.data(), compressedSize);
     }
     stream.PutMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
 
     return stream;
 }
 
+template MATH_API File& operator<<(File& stream, const CPUSparseMatrix<float>& us);
+template MATH_API File& operator<<(File& stream, const CPUSparseMatrix<double>& us);
+
 template class CPUSparseMatrix<float>;
 template class CPUSparseMatrix<double>;
 
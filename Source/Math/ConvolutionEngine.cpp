@@ -6,6 +6,7 @@
 #include "stdafx.h"
 #include "ConvolutionEngine.h"
 #include "CuDnnConvolutionEngine.h"
+#include <omp.h>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -420,74 +421,263 @@ protected:
             InvalidArgument("This engine batch normalization currently supports only CHW data layout for convolutional nodes.");
     }
 
+    // CPU batch normalization.
+    // Statistics are computed per normalization group g: a feature map (spatial) or a single activation (non-spatial).
+    // In CHW layout, group g of column j occupies the contiguous rows [g * spatialSize, (g + 1) * spatialSize).
+    // The minibatch is split into tiles of (group block x column chunk) which are reduced in parallel and then merged
+    // per group, so that even layers with few maps (e.g. the first layers of a ResNet) use all cores.
     void NormalizeBatchCore(const Tensor4D& inT, const Mat& in, const Tensor4D& scaleBiasT, const Mat& scale, const Mat& bias,
-                        bool spatial, double expAvgFactor, Mat& runMean, Mat& runInvStdDev, Mat& out, double epsilon, Mat& saveMean, Mat& saveInvStdDev) override
+                            bool spatial, double expAvgFactor, Mat& runMean, Mat& runInvStdDev, Mat& out, double epsilon, Mat& saveMean, Mat& saveInvStdDev) override
     {
-        UNUSED(inT);
-        UNUSED(in);
         UNUSED(scaleBiasT);
-        UNUSED(scale);
-        UNUSED(bias);
-        UNUSED(out);
-        UNUSED(spatial);
-        UNUSED(expAvgFactor);
-        UNUSED(runMean);
-        UNUSED(runInvStdDev);
-        UNUSED(epsilon);
-        UNUSED(saveMean);
-        UNUSED(saveInvStdDev);
-        RuntimeError("Not yet implemented.");
+        assert(std::isfinite(expAvgFactor) && expAvgFactor > 0);
+        epsilon = std::max(epsilon, 1e-9); // same lower bound as the GPU implementation
+        const size_t spatialSize = spatial ? inT.w() * inT.h() : 1;
+        const size_t vectorSize = in.GetNumRows();
+        const size_t batchSize = in.GetNumCols();
+        const size_t numGroups = vectorSize / spatialSize;
+        const ElemType* px = in.BufferPointer();
+        ElemType* pSaveMean = saveMean.BufferPointer();
+        ElemType* pSaveInvStdDev = saveInvStdDev.BufferPointer();
+        ElemType* pRunMean = runMean.BufferPointer();
+        ElemType* pRunInvStdDev = runInvStdDev.BufferPointer();
+
+        // Pass 1: mean and variance by parallel Welford reductions (Chan et al. for merging partial results).
+        BatchNormTiling tiling(numGroups, spatialSize, batchSize);
+        std::vector<double> partMean(tiling.numChunks * numGroups, 0);
+        std::vector<double> partM2(tiling.numChunks * numGroups, 0);
+#pragma omp parallel for schedule(dynamic)
+        for (long tile = 0; tile < (long) tiling.NumTiles(); tile++)
+        {
+            size_t g0, g1, j0, j1;
+            tiling.GetTile(tile, g0, g1, j0, j1);
+            double* mean = partMean.data() + tiling.Chunk(tile) * numGroups;
+            double* m2 = partM2.data() + tiling.Chunk(tile) * numGroups;
+            for (size_t j = j0; j < j1; j++)
+            {
+                const ElemType* pcol = px + j * vectorSize;
+                const double na = (double) ((j - j0) * spatialSize); // count accumulated so far for each group in this tile
+                const double nb = (double) spatialSize;
+                for (size_t g = g0; g < g1; g++)
+                {
+                    // statistics of this column's segment, then merge into the running (mean, m2)
+                    const ElemType* seg = pcol + g * spatialSize;
+                    double segMean = 0;
+                    for (size_t k = 0; k < spatialSize; k++)
+                        segMean += seg[k];
+                    segMean /= nb;
+                    double segM2 = 0;
+                    for (size_t k = 0; k < spatialSize; k++)
+                    {
+                        double d = seg[k] - segMean;
+                        segM2 += d * d;
+                    }
+                    double delta = segMean - mean[g];
+                    mean[g] += delta * nb / (na + nb);
+                    m2[g] += segM2 + delta * delta * na * nb / (na + nb);
+                }
+            }
+        }
+#pragma omp parallel for
+        for (long g = 0; g < (long) numGroups; g++)
+        {
+            double mean = partMean[g];
+            double m2 = partM2[g];
+            double n = (double) (tiling.ChunkColumns(0) * spatialSize);
+            for (size_t c = 1; c < tiling.numChunks; c++)
+            {
+                double nb = (double) (tiling.ChunkColumns(c) * spatialSize);
+                double delta = partMean[c * numGroups + g] - mean;
+                mean += delta * nb / (n + nb);
+                m2 += partM2[c * numGroups + g] + delta * delta * n * nb / (n + nb);
+                n += nb;
+            }
+            ElemType invStdDev = (ElemType) (1.0 / sqrt(m2 / n + epsilon));
+            pSaveMean[g] = (ElemType) mean;
+            pSaveInvStdDev[g] = invStdDev;
+            if (expAvgFactor == 1)
+            {
+                pRunMean[g] = (ElemType) mean;
+                pRunInvStdDev[g] = invStdDev;
+            }
+            else
+            {
+                pRunMean[g] = (ElemType) (expAvgFactor * mean + (1.0 - expAvgFactor) * pRunMean[g]);
+                pRunInvStdDev[g] = (ElemType) (expAvgFactor * invStdDev + (1.0 - expAvgFactor) * pRunInvStdDev[g]);
+            }
+        }
+
+        // Pass 2: out = scale * (x - mean) * invStdDev + bias, folded into a single multiply-add per element.
+        ApplyBatchNorm(in, scale, bias, saveMean, saveInvStdDev, spatialSize, out);
     }
 
     void NormalizeBatchInferenceCore(const Tensor4D& inT, const Mat& in, const Tensor4D& scaleBiasT, const Mat& scale, const Mat& bias,
-                                 bool spatial, const Mat& runMean, const Mat& runInvStdDev, Mat& out) override
+                                     bool spatial, const Mat& runMean, const Mat& runInvStdDev, Mat& out) override
+    {
+        UNUSED(scaleBiasT);
+        ApplyBatchNorm(in, scale, bias, runMean, runInvStdDev, spatial ? inT.w() * inT.h() : 1, out);
+    }
+
+    // Scale and bias gradients are overwritten, the input gradient is accumulated into (same as the GPU implementation).
+    void BackwardNormalizeBatchCore(const Tensor4D& inT, const Mat& in, const Mat& srcGrad, Mat& grad,
+                                    const Tensor4D& scaleBiasT, const Mat& scale, bool spatial, const Mat& saveMean, const Mat& saveInvStdDev,
+                                    Mat& scaleGrad, Mat& biasGrad) override
     {
         UNUSED(scaleBiasT);
-        if (spatial)
+        const size_t spatialSize = spatial ? inT.w() * inT.h() : 1;
+        const size_t vectorSize = in.GetNumRows();
+        const size_t batchSize = in.GetNumCols();
+        const size_t numGroups = vectorSize / spatialSize;
+        const ElemType* px = in.BufferPointer();
+        const ElemType* pdy = srcGrad.BufferPointer();
+        ElemType* pdx = grad.BufferPointer();
+        const ElemType* pScale = scale.BufferPointer();
+        const ElemType* pMean = saveMean.BufferPointer();
+        const ElemType* pInvStdDev = saveInvStdDev.BufferPointer();
+        ElemType* pdScale = scaleGrad.BufferPointer();
+        ElemType* pdBias = biasGrad.BufferPointer();
+
+        // Pass 1: dScale = sum(dy * xHat), dBias = sum(dy) per group.
+        BatchNormTiling tiling(numGroups, spatialSize, batchSize);
+        std::vector<double> partScale(tiling.numChunks * numGroups, 0);
+        std::vector<double> partBias(tiling.numChunks * numGroups, 0);
+#pragma omp parallel for schedule(dynamic)
+        for (long tile = 0; tile < (long) tiling.NumTiles(); tile++)
         {
-            size_t spatialSize = inT.w() * inT.h();
-#pragma omp parallel for
-            for (long icol = 0; icol < out.GetNumCols(); icol++)
+            size_t g0, g1, j0, j1;
+            tiling.GetTile(tile, g0, g1, j0, j1);
+            double* ds = partScale.data() + tiling.Chunk(tile) * numGroups;
+            double* db = partBias.data() + tiling.Chunk(tile) * numGroups;
+            for (size_t j = j0; j < j1; j++)
             {
-                for (long irow = 0; irow < out.GetNumRows(); irow++)
+                for (size_t g = g0; g < g1; g++)
                 {
-                    size_t imap = irow / spatialSize;
-                    out(irow, icol) = scale(imap, 0) * (in(irow, icol) - runMean(imap, 0)) * runInvStdDev(imap, 0) + bias(imap, 0);
+                    const size_t offset = j * vectorSize + g * spatialSize;
+                    const ElemType mean = pMean[g];
+                    double sumDyX = 0;
+                    double sumDy = 0;
+                    for (size_t k = 0; k < spatialSize; k++)
+                    {
+                        sumDyX += pdy[offset + k] * (px[offset + k] - mean);
+                        sumDy += pdy[offset + k];
+                    }
+                    ds[g] += sumDyX * pInvStdDev[g];
+                    db[g] += sumDy;
                 }
             }
         }
-        else
+#pragma omp parallel for
+        for (long g = 0; g < (long) numGroups; g++)
         {
+            double ds = 0, db = 0;
+            for (size_t c = 0; c < tiling.numChunks; c++)
+            {
+                ds += partScale[c * numGroups + g];
+                db += partBias[c * numGroups + g];
+            }
+            pdScale[g] = (ElemType) ds;
+            pdBias[g] = (ElemType) db;
+        }
+
+        // Pass 2: dx += scale * invStdDev * (dy - (xHat * dScale + dBias) / m), see the GPU kernel for the derivation.
+        const ElemType m = (ElemType) (batchSize * spatialSize);
 #pragma omp parallel for
-            for (long icol = 0; icol < out.GetNumCols(); icol++)
+        for (long j = 0; j < (long) batchSize; j++)
+        {
+            for (size_t g = 0; g < numGroups; g++)
             {
-                for (long irow = 0; irow < out.GetNumRows(); irow++)
+                const size_t offset = j * vectorSize + g * spatialSize;
+                const ElemType mean = pMean[g];
+                const ElemType invStdDev = pInvStdDev[g];
+                const ElemType a = pScale[g] * invStdDev;
+                const ElemType ds = pdScale[g] / m;
+                const ElemType db = pdBias[g] / m;
+                for (size_t k = 0; k < spatialSize; k++)
                 {
-                    out(irow, icol) = scale(irow, 0) * (in(irow, icol) - runMean(irow, 0)) * runInvStdDev(irow, 0) + bias(irow, 0);
+                    ElemType xNorm = (px[offset + k] - mean) * invStdDev;
+                    pdx[offset + k] += a * (pdy[offset + k] - (xNorm * ds + db));
                 }
             }
         }
     }
 
-    void BackwardNormalizeBatchCore(const Tensor4D& inT, const Mat& in, const Mat& srcGrad, Mat& grad,
-                                const Tensor4D& scaleBiasT, const Mat& scale, bool spatial, const Mat& saveMean, const Mat& saveInvStdDev,
-                                Mat& scaleGrad, Mat& biasGrad) override
+private:
+    // Splits a [numGroups x batchSize] batch normalization reduction into tiles of (group block, column chunk).
+    // Each column chunk has its own partial results, so tiles can be reduced without synchronization.
+    struct BatchNormTiling
     {
-        UNUSED(inT);
-        UNUSED(in);
-        UNUSED(srcGrad);
-        UNUSED(grad);
-        UNUSED(scaleBiasT);
-        UNUSED(scale);
-        UNUSED(scaleGrad);
-        UNUSED(biasGrad);
-        UNUSED(spatial);
-        UNUSED(saveMean);
-        UNUSED(saveInvStdDev);
-        RuntimeError("Not yet implemented.");
+        size_t numGroups, groupsPerBlock, numBlocks;
+        size_t batchSize, numChunks;
+
+        BatchNormTiling(size_t numGroups, size_t spatialSize, size_t batchSize)
+            : numGroups(numGroups), batchSize(batchSize)
+        {
+            // aim for ~4K elements per (group block, column) so that the inner loops run over contiguous memory
+            const size_t targetElements = 4096;
+            groupsPerBlock = std::max((size_t) 1, std::min(numGroups, targetElements / spatialSize));
+            numBlocks = (numGroups + groupsPerBlock - 1) / groupsPerBlock;
+            // enough column chunks to keep all threads busy, but no more (each chunk costs a partial result per group)
+            const size_t numThreads = (size_t) omp_get_max_threads();
+            numChunks = std::max((size_t) 1, std::min(batchSize, (2 * numThreads + numBlocks - 1) / numBlocks));
+        }
+        size_t NumTiles() const
+        {
+            return numBlocks * numChunks;
+        }
+        size_t Chunk(size_t tile) const
+        {
+            return tile / numBlocks;
+        }
+        size_t ChunkBegin(size_t chunk) const
+        {
+            return chunk * batchSize / numChunks;
+        }
+        size_t ChunkColumns(size_t chunk) const
+        {
+            return ChunkBegin(chunk + 1) - ChunkBegin(chunk);
+        }
+        void GetTile(size_t tile, size_t& g0, size_t& g1, size_t& j0, size_t& j1) const
+        {
+            size_t block = tile % numBlocks;
+            g0 = block * groupsPerBlock;
+            g1 = std::min(numGroups, g0 + groupsPerBlock);
+            j0 = ChunkBegin(Chunk(tile));
+            j1 = ChunkBegin(Chunk(tile) + 1);
+        }
+    };
+
+    // out = x * a + b with a = scale * invStdDev, b = bias - mean * a per group
+    static void ApplyBatchNorm(const Mat& in, const Mat& scale, const Mat& bias, const Mat& mean, const Mat& invStdDev, size_t spatialSize, Mat& out)
+    {
+        const size_t vectorSize = in.GetNumRows();
+        const size_t batchSize = in.GetNumCols();
+        const size_t numGroups = vectorSize / spatialSize;
+        const ElemType* pScale = scale.BufferPointer();
+        const ElemType* pBias = bias.BufferPointer();
+        const ElemType* pMean = mean.BufferPointer();
+        const ElemType* pInvStdDev = invStdDev.BufferPointer();
+        std::vector<ElemType> a(numGroups), b(numGroups);
+        for (size_t g = 0; g < numGroups; g++)
+        {
+            a[g] = pScale[g] * pInvStdDev[g];
+            b[g] = pBias[g] - pMean[g] * a[g];
+        }
+        const ElemType* px = in.BufferPointer();
+        ElemType* py = out.BufferPointer();
+#pragma omp parallel for
+        for (long j = 0; j < (long) batchSize; j++)
+        {
+            for (size_t g = 0; g < numGroups; g++)
+            {
+                const size_t offset = j * vectorSize + g * spatialSize;
+                const ElemType ag = a[g];
+                const ElemType bg = b[g];
+                for (size_t k = 0; k < spatialSize; k++)
+                    py[offset + k] = px[offset + k] * ag + bg;
+            }
+        }
     }
 
-private:
     size_t m_maxTempMemSizeInSamples;
     BatchNormImpl m_bnImpl;
     Mat m_ones;
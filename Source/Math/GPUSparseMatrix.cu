@@ -2679,22 +2679,15 @@ MATH_API File& operator>>(File& stream, GPUSparseMatrix<ElemType>& us)
         CPUSPARSE_INDEX_TYPE* compressedIndex = new CPUSPARSE_INDEX_TYPE[compressedSize];
 
         // read in the sparse matrix info
+        // Indices are stored as size_t; they are read in one block and then narrowed.
+        stream.ReadArray(dataBuffer, nz);
+        std::vector<size_t> indices(std::max(nz, compressedSize));
+        stream.ReadArray(indices.data(), nz);
         for (size_t i = 0; i < nz; ++i)
-        {
-            stream >> dataBuffer[i];
-        }
-        for (size_t i = 0; i < nz; ++i)
-        {
-            size_t val;
-            stream >> val;
-            unCompressedIndex[i] = val;
-        }
+            unCompressedIndex[i] = (CPUSPARSE_INDEX_TYPE) indices[i];
+        stream.ReadArray(indices.data(), compressedSize);
         for (size_t i = 0; i < compressedSize; ++i)
-        {
-            size_t val;
-            stream >> val;
-            compressedIndex[i] = val;
-        }
+            compressedIndex[i] = (CPUSPARSE_INDEX_TYPE) indices[i];
 
         if (us.m_format == matrixFormatSparseCSC)
             us.SetMatrixFromCSCFormat(compressedIndex, unCompressedIndex, dataBuffer, nz, rownum, colnum);
@@ -2744,20 +2737,12 @@ MATH_API File& operator<<(File& stream, const GPUSparseMatrix<ElemType>& us)
         else
             NOT_IMPLEMENTED;
 
-        for (size_t i = 0; i < nz; ++i)
-        {
-            stream << dataBuffer[i];
-        }
-        for (size_t i = 0; i < nz; ++i)
-        {
-            size_t val = unCompressedIndex[i];
-            stream << val;
-        }
-        for (size_t i = 0; i < compressedSize; ++i)
-        {
-            size_t val = compressedIndex[i];
-            stream << val;
-        }
+        // indices are stored as size_t
+        stream.WriteArray(dataBuffer, nz);
+        std::vector<size_t> indices(unCompressedIndex, unCompressedIndex + nz);
+        stream.WriteArray(indices.data(), nz);
+        indices.assign(compressedIndex, compressedIndex + compressedSize);
+        stream.WriteArray(indices.data(), compressedSize);
 
         delete[] dataBuffer;
         delete[] unCompressedIndex;
@@ -593,7 +593,10 @@ void Matrix<ElemType>::Read(File& stream)
     {
         if (M.GetDeviceId() < 0)
         {
-            NOT_IMPLEMENTED; // You might want to tranfer your matrix to GPU
+            if (M.m_CPUSparseMatrix == NULL)
+                M.m_CPUSparseMatrix = new CPUSparseMatrix<ElemType>(matrixFormatSparseCSC);
+            stream >> (*M.m_CPUSparseMatrix);
+            M.SetDataLocation(CPU, SPARSE);
         }
         else
         {
@@ -623,9 +626,9 @@ void Matrix<ElemType>::Write(File& stream) const
     {
         stream << 's';
         if (M.GetDeviceId() < 0)
-            NOT_IMPLEMENTED // stream<<(*M.m_CPUMatrix);
-                else stream
-                << (*M.m_GPUSparseMatrix);
+            stream << (*M.m_CPUSparseMatrix);
+        else
+            stream << (*M.m_GPUSparseMatrix);
     }
 }
 
@@ -1245,6 +1248,18 @@ void Matrix<ElemType>::SetMatrixFromCSCFormat(const CPUSPARSE_INDEX_TYPE* h_CSCC
                             m_GPUSparseMatrix->SetMatrixFromCSCFormat(h_CSCCol, h_Row, h_Val, nz, numRows, numCols));
 }
 
+template <class ElemType>
+void Matrix<ElemType>::SetMatrixFromCSRFormat(const CPUSPARSE_INDEX_TYPE* h_CSRRow, const CPUSPARSE_INDEX_TYPE* h_Col, const ElemType* h_Val,
+                                              const size_t nz, const size_t numRows, const size_t numCols)
+{
+    DISPATCH_MATRIX_ON_FLAG(this,
+                            this,
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED,
+                            m_CPUSparseMatrix->SetMatrixFromCSRFormat(h_CSRRow, h_Col, h_Val, nz, numRows, numCols),
+                            m_GPUSparseMatrix->SetMatrixFromCSRFormat(h_CSRRow, h_Col, h_Val, nz, numRows, numCols));
+}
+
 template <class ElemType>
 void Matrix<ElemType>::SetDiagonalValue(const ElemType v)
 {
@@ -1466,7 +1481,8 @@ void Matrix<ElemType>::FSAdagrad(size_t mbSize, Matrix<ElemType>& gradients, Mat
                             SetDataLocation(CPU),
                             m_GPUMatrix->FSAdagrad(*gradients.m_GPUMatrix, *functionValues.m_GPUMatrix, learnRatePerSample, momentum, adagradkeepweight, targetadagradavdenom_x_sqrtadagradsqrframes);
                             SetDataLocation(GPU),
-                            NOT_IMPLEMENTED,
+                            gradients.m_CPUSparseMatrix->FSAdagrad(*m_CPUMatrix, *functionValues.m_CPUMatrix, learnRatePerSample, momentum, adagradkeepweight, targetadagradavdenom_x_sqrtadagradsqrframes);
+                            SetDataLocation(CPU),
                             NOT_IMPLEMENTED);
 }
 
@@ -1481,13 +1497,14 @@ ElemType Matrix<ElemType>::RmsProp(Matrix<ElemType>& gradients,
 {
     DecideAndMoveToRightDevice(*this, gradients);
 
-    DISPATCH_MATRIX_ON_FLAG(this,
+    DISPATCH_MATRIX_ON_FLAG(&gradients,
                             &gradients,
                             return m_CPUMatrix->RmsProp(*gradients.m_CPUMatrix, RMS_GAMMA, RMS_WGT_INC, RMS_WGT_MAX, RMS_WGT_DEC, RMS_WGT_MIN, needAveMultiplier);
                             SetDataLocation(CPU),
                             return m_GPUMatrix->RmsProp(*gradients.m_GPUMatrix, RMS_GAMMA, RMS_WGT_INC, RMS_WGT_MAX, RMS_WGT_DEC, RMS_WGT_MIN, needAveMultiplier);
                             SetDataLocation(GPU),
-                            NOT_IMPLEMENTED,
+                            return gradients.m_CPUSparseMatrix->RmsProp(*m_CPUMatrix, RMS_GAMMA, RMS_WGT_INC, RMS_WGT_MAX, RMS_WGT_DEC, RMS_WGT_MIN, needAveMultiplier);
+                            SetDataLocation(CPU),
                             NOT_IMPLEMENTED);
 }
 
@@ -4033,9 +4050,15 @@ void Matrix<ElemType>::MultiplyAndWeightedAdd(ElemType alpha, const Matrix<ElemT
 
     if (c.GetDeviceId() < 0) // CPU
     {
-        if (a.GetMatrixType() == MatrixType::SPARSE)
-            NOT_IMPLEMENTED;
-        if (b.GetMatrixType() == MatrixType::SPARSE)
+        if (a.GetMatrixType() == MatrixType::SPARSE) // Sparse*Dense+Dense, e.g. pruned weights
+        {
+            if (b.GetMatrixType() == MatrixType::SPARSE)
+                NOT_IMPLEMENTED;
+            c.SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, false);
+            CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(alpha, *a.m_CPUSparseMatrix, transposeA, *b.m_CPUMatrix, transposeB, beta, *c.m_CPUMatrix);
+            c.SetDataLocation(CPU, DENSE);
+        }
+        else if (b.GetMatrixType() == MatrixType::SPARSE)
         {
             if (c.GetMatrixType() == MatrixType::DENSE)
             {
@@ -4974,6 +4997,41 @@ void Matrix<ElemType>::RCRFTransGrdCompute(const Matrix<ElemType>& lbls,
                             NOT_IMPLEMENTED);
 }
 
+// fused Gaussian mixture log-likelihood, for GMMLogLikelihoodNode; CPU only
+template <class ElemType>
+void Matrix<ElemType>::GMMLogLikelihood(const Matrix<ElemType>& unnormedPrior, const Matrix<ElemType>& mean, const Matrix<ElemType>& logStdDev,
+                                        const Matrix<ElemType>& feature, Matrix<ElemType>& logLikelihood, Matrix<ElemType>& posterior)
+{
+    DecideAndMoveToRightDevice(unnormedPrior, mean, logStdDev, feature);
+    logLikelihood._transferToDevice(feature.GetDeviceId());
+    posterior._transferToDevice(feature.GetDeviceId());
+
+    DISPATCH_MATRIX_ON_FLAG(&feature,
+                            nullptr,
+                            CPUMatrix<ElemType>::GMMLogLikelihood(*unnormedPrior.m_CPUMatrix, *mean.m_CPUMatrix, *logStdDev.m_CPUMatrix, *feature.m_CPUMatrix,
+                                                                  *logLikelihood.m_CPUMatrix, *posterior.m_CPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
+template <class ElemType>
+void Matrix<ElemType>::GMMLogLikelihoodGradient(size_t inputIndex, const Matrix<ElemType>& gradient, const Matrix<ElemType>& posterior,
+                                                const Matrix<ElemType>& unnormedPrior, const Matrix<ElemType>& mean, const Matrix<ElemType>& logStdDev,
+                                                const Matrix<ElemType>& feature, Matrix<ElemType>& inputGradient)
+{
+    DecideAndMoveToRightDevice(unnormedPrior, mean, logStdDev, feature);
+    DecideAndMoveToRightDevice(feature, gradient, posterior, inputGradient);
+
+    DISPATCH_MATRIX_ON_FLAG(&feature,
+                            nullptr,
+                            CPUMatrix<ElemType>::GMMLogLikelihoodGradient(inputIndex, *gradient.m_CPUMatrix, *posterior.m_CPUMatrix, *unnormedPrior.m_CPUMatrix,
+                                                                          *mean.m_CPUMatrix, *logStdDev.m_CPUMatrix, *feature.m_CPUMatrix, *inputGradient.m_CPUMatrix),
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED,
+                            NOT_IMPLEMENTED);
+}
+
 template <class ElemType>
 Matrix<ElemType>& Matrix<ElemType>::DropFrame(const Matrix<ElemType>& label, const Matrix<ElemType>& gamma, const ElemType& threshhold)
 {
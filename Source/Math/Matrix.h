@@ -233,6 +233,8 @@ public:
     }
     void SetMatrixFromCSCFormat(const CPUSPARSE_INDEX_TYPE* h_CSCCol, const CPUSPARSE_INDEX_TYPE* h_Row, const ElemType* h_Val,
                                 const size_t nz, const size_t numRows, const size_t numCols);
+    void SetMatrixFromCSRFormat(const CPUSPARSE_INDEX_TYPE* h_CSRRow, const CPUSPARSE_INDEX_TYPE* h_Col, const ElemType* h_Val,
+                                const size_t nz, const size_t numRows, const size_t numCols);
 
     void MaskColumnsValue(const Matrix<char>& columnsMask, ElemType val);
 
@@ -535,6 +537,13 @@ public:
                                     const int startLbl, // the time 0 start symbol in the output layer
                                     const int shift);
 
+    // for GMMLogLikelihoodNode (CPU only)
+    static void GMMLogLikelihood(const Matrix<ElemType>& unnormedPrior, const Matrix<ElemType>& mean, const Matrix<ElemType>& logStdDev,
+                                 const Matrix<ElemType>& feature, Matrix<ElemType>& logLikelihood, Matrix<ElemType>& posterior);
+    static void GMMLogLikelihoodGradient(size_t inputIndex, const Matrix<ElemType>& gradient, const Matrix<ElemType>& posterior,
+                                         const Matrix<ElemType>& unnormedPrior, const Matrix<ElemType>& mean, const Matrix<ElemType>& logStdDev,
+                                         const Matrix<ElemType>& feature, Matrix<ElemType>& inputGradient);
+
     template <typename T>
     friend class MatrixQuantizer;
 
@@ -893,20 +893,24 @@ struct latticefunctionskernels
     }
 
     template <typename ushortvector, typename uintvector, typename edgeinfowithscoresvector, typename nodeinfovector, typename doublevector, typename matrix>
+    // Only frames within [tbegin, tend) are updated; the multi-threaded CPU implementation uses this to partition by frames.
     static inline __device__ void sMBRerrorsignalj(size_t j, const ushortvector &alignstateids, const uintvector &alignoffsets,
                                                    const edgeinfowithscoresvector &edges,
                                                    const nodeinfovector &nodes, const doublevector &logpps, const float amf,
                                                    const doublevector &logEframescorrect, const double logEframescorrecttotal,
-                                                   matrix &errorsignal, matrix &errorsignalneg)
+                                                   matrix &errorsignal, matrix &errorsignalneg,
+                                                   const size_t tbegin = 0, const size_t tend = (size_t) -1)
     {
         size_t ts = nodes[edges[j].S].t;
         size_t te = nodes[edges[j].E].t;
-        if (ts != te)
+        const size_t tfirst = ts > tbegin ? ts : tbegin;
+        const size_t tlast = te < tend ? te : tend;
+        if (ts != te && tfirst < tlast)
         {
 #ifdef DIRECT_MODE
             float logEframescorrectj = logEframescorrect[j];
             size_t offset = alignoffsets[j];
-            for (size_t t = ts; t < te; t++)
+            for (size_t t = tfirst; t < tlast; t++)
             {
                 const size_t s = (size_t) alignstateids[t - ts + offset];
                 atomicLogAdd(&errorsignal(s, t), logEframescorrectj);
@@ -920,7 +924,7 @@ struct latticefunctionskernels
                 return;
             const float logedgecorrect = (float) (logpps[j] + log(absdiff));
             size_t offset = alignoffsets[j];
-            for (size_t t = ts; t < te; t++)
+            for (size_t t = tfirst; t < tlast; t++)
             {
                 const size_t s = (size_t) alignstateids[t - ts + offset];
                 if (diff > 0.0)
@@ -940,15 +944,18 @@ struct latticefunctionskernels
     static inline __device__ void stateposteriorsj(size_t j, const ushortvector &alignstateids, const uintvector &alignoffsets,
                                                    const edgeinfowithscoresvector &edges,
                                                    const nodeinfovector &nodes, const doublevector &logqs /*quantity to accumulate*/,
-                                                   matrix &logacc /*accumulator to accumulate into*/)
+                                                   matrix &logacc /*accumulator to accumulate into*/,
+                                                   const size_t tbegin = 0, const size_t tend = (size_t) -1 /*frame window to update, see sMBRerrorsignalj()*/)
     {
         size_t ts = nodes[edges[j].S].t;
         size_t te = nodes[edges[j].E].t;
-        if (ts != te)
+        const size_t tfirst = ts > tbegin ? ts : tbegin;
+        const size_t tlast = te < tend ? te : tend;
+        if (ts != te && tfirst < tlast)
         {
             const float logq = (float) logqs[j]; // per-edge quantity to accumulate, e.g. edge posteriors -> state posteriors
             size_t offset = alignoffsets[j];
-            for (size_t t = ts; t < te; t++)
+            for (size_t t = tfirst; t < tlast; t++)
             {
                 const size_t s = (size_t) alignstateids[t - ts + offset]; // get state for this (j,t)
                 atomicLogAdd(&logacc(s, t), logq);
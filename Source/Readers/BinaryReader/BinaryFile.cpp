@@ -10,6 +10,14 @@
 #include "BinaryReader.h"
 #include <limits.h>
 #include <stdint.h>
+#include <float.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -29,22 +37,20 @@ DWORD LODWORD(size_t size)
 // size - size of the file to map, will expand/contract existing files to given size. zero means keep current size
 BinaryFile::BinaryFile(std::wstring fileName, FileOptions options, size_t size)
 {
-
+    m_writeFile = options == fileOptionsReadWrite;
+    m_name = fileName;
+    m_maxViewSize = 0x10000000; // 256MB initial max size
+#ifdef _WIN32
     SYSTEM_INFO sysInfo;
     GetSystemInfo(&sysInfo);
     m_viewAlignment = sysInfo.dwAllocationGranularity;
     /* If file created, continue to map file. */
 
-    m_writeFile = options == fileOptionsReadWrite;
-    m_name = fileName;
-    m_maxViewSize = 0x10000000; // 256MB initial max size
     m_hndFile = CreateFile(fileName.c_str(), m_writeFile ? (GENERIC_WRITE | GENERIC_READ) : GENERIC_READ,
                            FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
     if (m_hndFile == INVALID_HANDLE_VALUE)
     {
-        char message[256];
-        sprintf_s(message, "Unable to Open/Create file %ls, error %x", fileName.c_str(), GetLastError());
-        RuntimeError(message);
+        RuntimeError("Unable to Open/Create file %ls, error %x", fileName.c_str(), GetLastError());
     }
 
     // code to detect type of file (network/local)
@@ -70,10 +76,38 @@ BinaryFile::BinaryFile(std::wstring fileName, FileOptions options, size_t size)
                           NULL);
     if (m_hndMapped == NULL)
     {
-        char message[256];
-        sprintf_s(message, "Unable to map file %ls, error 0x%x", fileName.c_str(), GetLastError());
-        RuntimeError(message);
+        RuntimeError("Unable to map file %ls, error 0x%x", fileName.c_str(), GetLastError());
+    }
+#else
+    // Section positions are rounded to the view alignment, so use the Windows allocation granularity
+    // (a multiple of the page size) to keep files interchangeable between platforms.
+    m_viewAlignment = 0x10000;
+    if (m_viewAlignment % sysconf(_SC_PAGESIZE) != 0)
+        m_viewAlignment = sysconf(_SC_PAGESIZE);
+
+    m_fd = open(wtocharpath(fileName).c_str(), m_writeFile ? (O_RDWR | O_CREAT) : O_RDONLY, 0644);
+    if (m_fd < 0)
+    {
+        RuntimeError("Unable to Open/Create file %ls, error %s", fileName.c_str(), strerror(errno));
     }
+
+    // get the actual size of the file
+    struct stat fileStat;
+    if (fstat(m_fd, &fileStat) != 0)
+    {
+        RuntimeError("Unable to get size of file %ls, error %s", fileName.c_str(), strerror(errno));
+    }
+    if (size == 0)
+    {
+        size = (size_t) fileStat.st_size;
+    }
+    // a mapping cannot extend the file, so grow it to the requested size up front (truncated to the written size on close)
+    else if (m_writeFile && size > (size_t) fileStat.st_size && ftruncate(m_fd, (off_t) size) != 0)
+    {
+        RuntimeError("Unable to extend file %ls to %zu bytes, error %s", fileName.c_str(), size, strerror(errno));
+    }
+    m_filePositionMax = size;
+#endif
     m_mappedSize = size;
 
     // if writing the file, the inital size of the file is zero
@@ -91,6 +125,7 @@ BinaryFile::~BinaryFile()
         // the view
         iter = ReleaseView(iter, true);
     }
+#ifdef _WIN32
     // TODO: Check for error code and throw if !std::uncaught_exception()
     CloseHandle(m_hndMapped);
 
@@ -101,6 +136,13 @@ BinaryFile::~BinaryFile()
         SetEndOfFile(m_hndFile);
     }
     CloseHandle(m_hndFile);
+#else
+    // if we are writing the file, truncate to actual size
+    // TODO: Check for error code and throw if !std::uncaught_exception()
+    if (m_writeFile)
+        ftruncate(m_fd, (off_t) m_filePositionMax);
+    close(m_fd);
+#endif
 }
 
 void BinaryFile::SetFilePositionMax(size_t filePositionMax)
@@ -108,9 +150,7 @@ void BinaryFile::SetFilePositionMax(size_t filePositionMax)
     m_filePositionMax = filePositionMax;
     if (m_filePositionMax > m_mappedSize)
     {
-        char message[128];
-        sprintf_s(message, "Setting max position larger than mapped file size: %ld > %ld", m_filePositionMax, m_mappedSize);
-        RuntimeError(message);
+        RuntimeError("Setting max position larger than mapped file size: %ld > %ld", m_filePositionMax, m_mappedSize);
     }
 }
 
@@ -145,7 +185,7 @@ vector<ViewPosition>::iterator BinaryFile::FindDataView(void* data)
     auto iter = m_views.begin();
     for (; iter != m_views.end(); ++iter)
     {
-        byte* viewBegin = (byte*) iter->view;
+        char* viewBegin = (char*) iter->view;
         if (viewBegin <= data && viewBegin + iter->size > data)
             break;
     }
@@ -192,10 +232,16 @@ vector<ViewPosition>::iterator BinaryFile::ReleaseView(vector<ViewPosition>::ite
     }
     else
     {
+#ifdef _WIN32
         if (m_writeFile)
             FlushViewOfFile(iter->view, iter->size);
         bool ret = UnmapViewOfFile(iter->view) != FALSE;
         ret;
+#else
+        if (m_writeFile)
+            msync(iter->view, iter->size, MS_ASYNC);
+        munmap(iter->view, iter->size);
+#endif
         iter = m_views.erase(iter);
     }
     return iter;
@@ -207,6 +253,7 @@ vector<ViewPosition>::iterator BinaryFile::ReleaseView(vector<ViewPosition>::ite
 // returns - pointer to the view
 void* BinaryFile::GetView(size_t filePosition, size_t size)
 {
+#ifdef _WIN32
     void* pBuf = MapViewOfFile(m_hndMapped,                                  // handle to map object
                                m_writeFile ? FILE_MAP_WRITE : FILE_MAP_READ, // get correct permissions
                                HIDWORD(filePosition),
@@ -214,10 +261,20 @@ void* BinaryFile::GetView(size_t filePosition, size_t size)
                                size);
     if (pBuf == NULL)
     {
-        char message[128];
-        sprintf_s(message, "Unable to map file %ls @ %lld, error %x", m_name.c_str(), filePosition, GetLastError());
-        RuntimeError(message);
+        RuntimeError("Unable to map file %ls @ %lld, error %x", m_name.c_str(), filePosition, GetLastError());
+    }
+#else
+    // views of a file we only read are read-only, so that a write through a view (e.g. a zero-copy minibatch matrix) faults
+    // instead of silently changing the data that is read again in the next epoch
+    void* pBuf = mmap(NULL, size, m_writeFile ? PROT_READ | PROT_WRITE : PROT_READ, m_writeFile ? MAP_SHARED : MAP_PRIVATE, m_fd, (off_t) filePosition);
+    if (pBuf == MAP_FAILED)
+    {
+        RuntimeError("Unable to map file %ls @ %zu, error %s", m_name.c_str(), filePosition, strerror(errno));
     }
+    // records are read front to back, let the kernel read ahead aggressively
+    if (!m_writeFile)
+        madvise(pBuf, size, MADV_SEQUENTIAL);
+#endif
     m_views.push_back(ViewPosition(pBuf, filePosition, size));
 
     // update file position max if neccesary
@@ -227,6 +284,24 @@ void* BinaryFile::GetView(size_t filePosition, size_t size)
     return pBuf;
 }
 
+// Prefetch - hint that a mapped range will be accessed soon, so it is paged in ahead of use
+// data - pointer into a current view
+// size - number of bytes that will be accessed
+void BinaryFile::Prefetch(void* data, size_t size)
+{
+    auto viewPos = FindDataView(data);
+    if (viewPos == m_views.end() || size == 0)
+        return;
+
+#ifndef _WIN32 // TODO: PrefetchVirtualMemory() once we require Windows 8
+    // clip to the view, madvise() wants a page aligned start
+    char* end = min((char*) data + size, (char*) viewPos->view + viewPos->size);
+    size_t pageSize = sysconf(_SC_PAGESIZE);
+    char* start = (char*) viewPos->view + (((char*) data - (char*) viewPos->view) / pageSize) * pageSize;
+    madvise(start, end - start, MADV_WILLNEED);
+#endif
+}
+
 // ReleaseView - Release a view of the file
 // view - view to release (must have been returned from GetView() previously
 void BinaryFile::ReleaseView(void* view)
@@ -304,7 +379,7 @@ void* BinaryFile::EnsureMapped(void* data, size_t size)
     auto viewPos = FindDataView(data);
     if (viewPos != m_views.end())
     {
-        int64_t offset = (byte*) data - (byte*) viewPos->view;
+        int64_t offset = (char*) data - (char*) viewPos->view;
         int64_t dataEnd = offset + size;
 
         // if our end of data is beyond the size of the view, need to reallocate
@@ -313,7 +388,7 @@ void* BinaryFile::EnsureMapped(void* data, size_t size)
             // TODO: this view change only accomidates this request
             size_t filePosition = viewPos->filePosition;
             ReleaseView(viewPos);
-            byte* view = (byte*) GetView(filePosition, dataEnd);
+            char* view = (char*) GetView(filePosition, dataEnd);
             data = view + offset;
         }
     }
@@ -341,7 +416,7 @@ size_t BinaryFile::RoundUp(size_t filePosition)
 SectionFile::SectionFile(std::wstring fileName, FileOptions options, size_t size)
     : BinaryFile(fileName, options, size)
 {
-    m_fileSection = new Section(this, 0, NULL, mappingFile, sectionHeaderMin);
+    m_fileSection = new Section(this, NULL, 0, mappingFile, sectionHeaderMin);
     if (m_writeFile)
     {
         m_fileSection->InitHeader(sectionTypeFile, string("Binary Data File"), sectionDataNone, 0);
@@ -350,9 +425,7 @@ SectionFile::SectionFile(std::wstring fileName, FileOptions options, size_t size
     // check for a file header
     if (!m_fileSection->ValidateHeader(m_writeFile))
     {
-        char message[128];
-        sprintf_s(message, "Invalid File format for binary file %ls", fileName.c_str());
-        RuntimeError(message);
+        RuntimeError("Invalid File format for binary file %ls", fileName.c_str());
     }
 }
 
@@ -390,7 +463,7 @@ void Section::InitHeader(SectionType type, std::string description, SectionData
     m_sectionHeader->flags = flagNone;                                                  // bit flags, dependent on sectionType
     m_sectionHeader->elementsCount = 0;                                                 // number of total elements stored
     memset(m_sectionHeader->nameDescription, 0, descriptionSize);                       // clear out the string buffer to all zeros first
-    strcpy_s(m_sectionHeader->nameDescription, description.c_str());                    // name and description of section contents in this format (name: description) (string, with extra bytes zeroed out, at least one null terminator required)
+    strcpy_s(m_sectionHeader->nameDescription, descriptionSize, description.c_str());   // name and description of section contents in this format (name: description) (string, with extra bytes zeroed out, at least one null terminator required)
     m_sectionHeader->size = sectionHeaderMin;                                           // size of this section (including header)
     m_sectionHeader->sizeAll = sectionHeaderMin;                                        // size of this section (including header and all sub-sections)
     m_sectionHeader->sectionFilePosition[0] = 0;                                        // sub-section file offsets (if needed), assumed to be in File Position order
@@ -498,9 +571,7 @@ Section* Section::ReadSection(size_t index, MappingType mapping, size_t sizeElem
     // make sure the header is valid
     if (!section->ValidateHeader())
     {
-        char message[256];
-        sprintf_s(message, "Invalid header in file %ls, in header %s\n", m_file->GetName().c_str(), section->GetName().c_str());
-        RuntimeError(message);
+        RuntimeError("Invalid header in file %ls, in header %ls\n", m_file->GetName().c_str(), section->GetName().c_str());
     }
 
     // setup the element mapping and pointers as needed
@@ -537,9 +608,7 @@ char* Section::EnsureElements(size_t element, size_t bytesRequested)
     size_t elementsRequested = bytesRequested / GetElementSize();
     if (element + elementsRequested > GetElementCount())
     {
-        char message[256];
-        sprintf_s(message, "Element out of range, error accesing element %lld, size=%lld\n", element, bytesRequested);
-        RuntimeError(message);
+        RuntimeError("Element out of range, error accesing element %lld, size=%lld\n", element, bytesRequested);
     }
 
     // make sure we have the buffer in the range to handle the request
@@ -551,6 +620,18 @@ char* Section::EnsureElements(size_t element, size_t bytesRequested)
     return (char*) m_elementBuffer + (element - m_elemMin) * GetElementSize();
 }
 
+// PrefetchElements - hint that a range of elements will be read soon
+// element - beginning element to access
+// bytesRequested - bytes requested
+// NOTE: only prefetches what is currently mapped, never changes the mapping
+void Section::PrefetchElements(size_t element, size_t bytesRequested)
+{
+    if (m_elementBuffer == NULL || element < m_elemMin || element >= m_elemMax)
+        return;
+    size_t bytesMapped = (m_elemMax - element) * GetElementSize();
+    m_file->Prefetch((char*) m_elementBuffer + (element - m_elemMin) * GetElementSize(), min(bytesRequested, bytesMapped));
+}
+
 // GetElementBuffer - get the element buffer for the passed element and size
 // element - element we want the elementBuffer to start from
 // windowSize - minimum size of the window in bytes for Element Window (will not resize smaller)
@@ -560,9 +641,7 @@ char* Section::GetElementBuffer(size_t element, size_t windowSize)
     // check element range
     if (!m_file->Writing() && element >= GetElementCount())
     {
-        char message[256];
-        sprintf_s(message, "Element out of range, error accesing element %lld, max element=%lld\n", element, GetElementCount());
-        RuntimeError(message);
+        RuntimeError("Element out of range, error accesing element %lld, max element=%lld\n", element, GetElementCount());
     }
 
     // section is mapped as a whole, so no separate mapping for element buffer
@@ -701,7 +780,7 @@ void* Section::EnsureMapped(void* dataStart, size_t size)
         // Element Window is mapped separately so won't no need to remap
         if (m_mappingType != mappingElementWindow)
         {
-            int64_t offset = (byte*) view - (byte*) dataStart;
+            int64_t offset = (char*) view - (char*) dataStart;
             m_sectionHeader = (SectionHeader*) ((char*) m_sectionHeader + offset);
             m_elementBuffer = (char*) m_sectionHeader + m_sectionHeader->sizeHeader;
             RemapHeader(m_sectionHeader, m_filePosition);
@@ -1070,9 +1149,7 @@ void SectionString::SetLabelMapping(const std::map<SectionString::LabelIdType, S
         auto iter = labelMapping.find(i);
         if (iter == labelMapping.end())
         {
-            char message[256];
-            sprintf_s(message, "Mapping table doesn't contain an entry for label Id#%d\n", i);
-            RuntimeError(message);
+            RuntimeError("Mapping table doesn't contain an entry for label Id#%d\n", i);
         }
 
         // add to reverse mapping table
@@ -1082,9 +1159,7 @@ void SectionString::SetLabelMapping(const std::map<SectionString::LabelIdType, S
         errno_t err = strcpy_s(curStr, size, str.c_str());
         if (err)
         {
-            char message[256];
-            sprintf_s(message, "Not enough room in mapping buffer, %lld bytes insufficient for string %d - %s\n", originalSize, i, str.c_str());
-            RuntimeError(message);
+            RuntimeError("Not enough room in mapping buffer, %lld bytes insufficient for string %d - %s\n", originalSize, i, str.c_str());
         }
         size_t len = str.length() + 1; // don't forget the null
         size -= len;
@@ -1104,9 +1179,7 @@ void* SectionString::GetElement(size_t index) const
     char* str = (char*) m_elementBuffer;
     if (index >= GetElementCount())
     {
-        char message[256];
-        sprintf_s(message, "GetElement: invalid index, %lld requested when there are only %lld elements\n", index, GetElementCount());
-        RuntimeError(message);
+        RuntimeError("GetElement: invalid index, %lld requested when there are only %lld elements\n", index, GetElementCount());
     }
 
     // now skip all the strings before the one that we want
@@ -1130,9 +1203,7 @@ char* SectionString::EnsureElements(size_t element, size_t bytesRequested)
     assert(GetMappingType() != mappingElementWindow); // not supported for string tables currently
     if (element >= GetElementCount())
     {
-        char message[256];
-        sprintf_s(message, "Element out of range, error accesing element %lld, size=%lld\n", element, bytesRequested);
-        RuntimeError(message);
+        RuntimeError("Element out of range, error accesing element %lld, size=%lld\n", element, bytesRequested);
     }
 
     // make sure we have the buffer in the range to handle the request
@@ -1221,7 +1292,7 @@ void SectionStats::InitCompute(const ConfigArray& compute)
     {
         std::string name = compute[i];
         auto stat = GetElement<NumericStatistics>(i);
-        strcpy_s(stat->statistic, name.c_str());
+        strcpy_s(stat->statistic, _countof(stat->statistic), name.c_str());
         stat->value = 0.0;
     }
 
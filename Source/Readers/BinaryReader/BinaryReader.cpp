@@ -52,6 +52,9 @@ void BinaryReader<ElemType>::LoadSections(Section* sectionRoot, MappingType mapp
 //  # reader to use
 //  readerType=BinaryReader
 //  miniBatchMode=Partial
+//  # zeroCopy - CPU minibatch matrices point directly into the memory mapped file (default false, requires windowSize=0)
+//  # the minibatch matrices are then read-only; only use it if nothing modifies the input matrices in place
+//  zeroCopy=false
 //  file={,
 //    c:\speech\mnist\mnist_features.bin
 //      c:\speech\mnist\mnist_labels.bin
@@ -82,6 +85,10 @@ void BinaryReader<ElemType>::InitFromConfig(const ConfigRecordType& readerConfig
     size_t windowSize = readerConfig(L"windowSize", (size_t) 0);
     MappingType mapping = windowSize ? mappingElementWindow : mappingSection;
 
+    // views are only stable when each section is mapped as a whole, element windows are remapped as we move through the data
+    bool zeroCopy = readerConfig(L"zeroCopy", false);
+    m_zeroCopy = zeroCopy && mapping == mappingSection;
+
     if (mOneLinePerFile)
     {
         for (int i = 0; i < files.size(); ++i)
@@ -170,6 +177,9 @@ void BinaryReader<ElemType>::DisplayProperties()
 template <class ElemType>
 BinaryReader<ElemType>::~BinaryReader()
 {
+    // the mappings go away with the section files, so matrices must not reference them anymore
+    DetachViews();
+
     // clear the section references, they will be deleted by the sectionFile destructors
     m_sections.clear();
 
@@ -205,14 +215,32 @@ void BinaryReader<ElemType>::StartMinibatchLoop(size_t mbSize, size_t epoch, siz
     m_epochSize = requestedEpochSamples;
     m_epoch = epoch;
 
+    DetachViews();
     SetupEpoch();
 }
 
+// DetachViews - give all minibatch matrices that still point into the mapped file a private copy of their data
+// This is done whenever the reader gives up control over the matrices (end of epoch, destruction), since the same
+// matrices may then be filled by another reader, or outlive the mapping.
+template <class ElemType>
+void BinaryReader<ElemType>::DetachViews()
+{
+    for (auto& matrixPtr : m_viewMatrices)
+    {
+        auto& matrix = dynamic_cast<Matrix<ElemType>&>(*matrixPtr);
+        if (matrix.GetDeviceId() != CPUDEVICE || matrix.GetMatrixType() != DENSE || matrix.OwnBuffer())
+            continue; // someone has replaced the content in the meantime
+        Matrix<ElemType> copy(matrix.GetNumRows(), matrix.GetNumCols(), matrix.BufferPointer(), CPUDEVICE);
+        matrix = std::move(copy);
+    }
+    m_viewMatrices.clear();
+}
+
 // CheckEndDataset - Check to see if we have arrived at the end of the dataset
-// actualmbsize - [in] the actual size of the dataset we are requesting,
+// actualmbsize - [in,out] the size of the minibatch we are requesting, reduced at the end of the epoch or dataset
 // returns - true if there we hit dataset end, false otherwise
 template <class ElemType>
-bool BinaryReader<ElemType>::CheckEndDataset(size_t actualmbsize)
+bool BinaryReader<ElemType>::CheckEndDataset(size_t& actualmbsize)
 {
     size_t epochEnd = m_epochSize;
     size_t epochSample = m_mbStartSample % m_epochSize;
@@ -254,6 +282,7 @@ bool BinaryReader<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
     // check to see if we have changed epochs, if so we are done with this one.
     if (m_mbStartSample / m_epochSize != m_epoch)
     {
+        DetachViews();
         return false;
     }
 
@@ -263,7 +292,10 @@ bool BinaryReader<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
 
     bool endOfDataset = CheckEndDataset(actualmbsize);
     if (endOfDataset)
+    {
+        DetachViews();
         return false;
+    }
 
     for (auto value : matrices)
     {
@@ -325,8 +357,24 @@ bool BinaryReader<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
         {
             RuntimeError("GetMinibatch: Section %ls Auxilary section specified, and/or element size %lld mismatch", section->GetName().c_str(), section->GetElementSize());
         }
-        gpuData.SetValue(rows, actualmbsize, gpuData.GetDeviceId(), data);
+
+        // on the CPU the minibatch can simply be a view onto the mapped section, otherwise copy it over
+        if (m_zeroCopy && gpuData.GetDeviceId() == CPUDEVICE && gpuData.GetMatrixType() == DENSE)
+        {
+            gpuData.SetValue(rows, actualmbsize, CPUDEVICE, data, matrixFlagDontOwnBuffer);
+            if (find(m_viewMatrices.begin(), m_viewMatrices.end(), value.second) == m_viewMatrices.end())
+                m_viewMatrices.push_back(value.second);
+        }
+        else
+        {
+            gpuData.SetValue(rows, actualmbsize, gpuData.GetDeviceId(), data);
+        }
+
+        // start paging in the next minibatch while this one is processed
+        if (index + 2 * rows * actualmbsize <= section->GetElementCount())
+            section->PrefetchElements(index + rows * actualmbsize, size);
     }
+    m_pMBLayout->InitAsFrameMode(actualmbsize);
 
     // advance to the next minibatch
     m_mbStartSample += actualmbsize;
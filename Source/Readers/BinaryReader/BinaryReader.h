@@ -127,11 +127,17 @@ struct ViewPosition
 // BinaryFile - class that will read/write a Binary file to a local or network path
 // for local paths, the disk file will be memory mapped for best performance
 // if a network path is used, it still works fine, but consistency between processes is not guaranteed
+// On Linux the file is mapped with mmap(); read-only views are private (copy-on-write) mappings, so data
+// handed out as zero-copy matrix views can never be written back to the file.
 class BinaryFile
 {
 protected:
+#ifdef _WIN32
     HANDLE m_hndFile;         // handle to the file
     HANDLE m_hndMapped;       // handle to the mapped file object
+#else
+    int m_fd;                 // file descriptor of the file (mappings are created per view)
+#endif
     size_t m_mappedSize;      // size of mapped file (zero for size of file being read)
     size_t m_maxViewSize;     // maximum size we want a single view to contain
     size_t m_viewAlignment;   // address alignment required by views
@@ -156,6 +162,7 @@ public:
     void* EnsureViewSize(void* view, size_t size);
     void* EnsureMapped(void* data, size_t size);
     vector<ViewPosition>::iterator Mapped(size_t filePosition, size_t& size);
+    void Prefetch(void* data, size_t size);
     size_t RoundUp(size_t filePosition);
     size_t GetViewAlignment()
     {
@@ -246,6 +253,7 @@ public:
         return (char*) m_elementBuffer + index * GetElementSize();
     }
     virtual char* EnsureElements(size_t element, size_t bytesRequested = 0);
+    void PrefetchElements(size_t element, size_t bytesRequested);
 
     SectionHeader* GetSectionHeader(size_t filePosition, MappingType& mappingType, size_t& size);
 
@@ -563,10 +571,15 @@ class BinaryReader : public IDataReader
     size_t m_dim;
     vector<FILE*> m_fStream;
 
+    // minibatch matrices that currently point into mapped file sections instead of owning their data
+    bool m_zeroCopy;                     // hand out CPU minibatch matrices as views onto the mapped sections
+    vector<MatrixBasePtr> m_viewMatrices; // matrices to detach before their view can become invalid
+
     void SetupEpoch();
+    void DetachViews();
     void LoadSections(Section* parentSection, MappingType mapping, size_t windowSize);
     void DisplayProperties();
-    bool CheckEndDataset(size_t actualmbsize);
+    bool CheckEndDataset(size_t& actualmbsize);
 
 public:
     template <class ConfigRecordType>
@@ -581,7 +594,7 @@ public:
     }
     virtual void Destroy();
     BinaryReader()
-        : m_pMBLayout(make_shared<MBLayout>())
+        : m_pMBLayout(make_shared<MBLayout>()), m_zeroCopy(false)
     {
     }
     virtual ~BinaryReader();
@@ -590,13 +603,12 @@ public:
 
     size_t GetNumParallelSequences()
     {
-        return 1;
+        return m_pMBLayout->GetNumParallelSequences();
     }
     void SetNumParallelSequences(const size_t){};
     void CopyMBLayoutTo(MBLayoutPtr pMBLayout)
     {
         pMBLayout->CopyFrom(m_pMBLayout);
-        NOT_IMPLEMENTED;
     }
     virtual const std::map<LabelIdType, LabelType>& GetLabelMapping(const std::wstring& sectionName);
     virtual void SetLabelMapping(const std::wstring& sectionName, const std::map<typename BinaryReader<ElemType>::LabelIdType, typename BinaryReader<ElemType>::LabelType>& labelMapping);
@@ -18,6 +18,8 @@ CNTKTextFormatReader::CNTKTextFormatReader(MemoryProviderPtr provider,
     m_provider(provider)
 {
     TextConfigHelper configHelper(config);
+    m_frameMode = configHelper.IsInFrameMode();
+    m_traceLevel = configHelper.GetTraceLevel();
     
     if (configHelper.GetElementType() == ElementType::tfloat) 
     {
@@ -56,7 +58,23 @@ void CNTKTextFormatReader::StartEpoch(const EpochConfiguration& config)
     }
 
     m_transformer->StartEpoch(config);
-    m_packer = std::make_shared<SampleModePacker>(
+    if (m_frameMode)
+    {
+        m_packer = std::make_shared<SampleModePacker>(
+            m_provider,
+            m_transformer,
+            config.m_minibatchSizeInSamples,
+            GetStreamDescriptions());
+        return;
+    }
+
+    if (m_sequencePacker != nullptr && m_traceLevel > 0)
+    {
+        fprintf(stderr, "CNTKTextFormatReader: %.1f%% of the packed frames of the previous epoch held data (the rest were gaps).\n",
+                100.0 * m_sequencePacker->GetPaddingEfficiency());
+    }
+
+    m_sequencePacker = std::make_shared<SequencePacker>(
         m_provider,
         m_transformer,
         config.m_minibatchSizeInSamples,
@@ -65,6 +83,12 @@ void CNTKTextFormatReader::StartEpoch(const EpochConfiguration& config)
 
 Minibatch CNTKTextFormatReader::ReadMinibatch()
 {
+    if (!m_frameMode)
+    {
+        assert(m_sequencePacker != nullptr);
+        return m_sequencePacker->ReadMinibatch();
+    }
+
     assert(m_packer != nullptr);
     return m_packer->ReadMinibatch();
 }
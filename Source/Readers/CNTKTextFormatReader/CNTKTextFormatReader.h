@@ -8,6 +8,7 @@
 #include "TextParser.h"
 #include "Reader.h"
 #include "SampleModePacker.h"
+#include "SequencePacker.h"
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -35,8 +36,11 @@ private:
     // A head transformer in a list of transformers.
     TransformerPtr m_transformer;
 
-    // Packer.
+    // Packer: m_packer in frame mode, m_sequencePacker otherwise.
     SampleModePackerPtr m_packer;
+    SequencePackerPtr m_sequencePacker;
+    bool m_frameMode;
+    unsigned int m_traceLevel;
 
     // Memory provider (TODO: this will possibly change in the near future.)
     MemoryProviderPtr m_provider;
@@ -124,6 +124,7 @@ TextConfigHelper::TextConfigHelper(const ConfigParameters& config)
         RuntimeError("'randomize' parameter must be set to 'auto' or 'none'");
     }
 
+    m_frameMode = config(L"frameMode", true);
     m_skipSequenceIds = config(L"skipSequenceIds", false);
     m_maxErrors = config(L"maxErrors", 0);
     m_traceLevel = config(L"traceLevel", 0);
@@ -27,6 +27,9 @@ public:
 
     bool ShouldRandomize() const { return m_randomize; }
 
+    // In frame mode each sequence is a single sample; otherwise sequences are packed into the parallel time axis.
+    bool IsInFrameMode() const { return m_frameMode; }
+
     bool ShouldSkipSequenceIds() const { return m_skipSequenceIds; }
 
     unsigned int GetMaxAllowedErrors() const { return m_maxErrors; }
@@ -45,6 +48,7 @@ private:
     std::wstring m_filepath;
     std::vector<StreamDescriptor> m_streams;
     bool m_randomize;
+    bool m_frameMode;
     ElementType m_elementType;
     bool m_skipSequenceIds;
     unsigned int m_maxErrors;
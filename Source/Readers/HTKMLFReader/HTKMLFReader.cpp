@@ -108,6 +108,7 @@ void HTKMLFReader<ElemType>::PrepareForTrainingOrTesting(const ConfigRecordType&
 {
     vector<wstring> scriptpaths;
     vector<wstring> RootPathInScripts;
+    vector<wstring> featureCachePaths; // optional consolidated memory-mapped feature cache per feature stream (blockRandomize only)
     wstring RootPathInLatticeTocs;
     vector<wstring> mlfpaths;
     vector<vector<wstring>> mlfpathsmulti;
@@ -188,6 +189,7 @@ void HTKMLFReader<ElemType>::PrepareForTrainingOrTesting(const ConfigRecordType&
         m_featureNameToIdMap[featureNames[i]] = iFeat;
         scriptpaths.push_back(thisFeature(L"scpFile"));
         RootPathInScripts.push_back(thisFeature(L"prefixPathInSCP", L""));
+        featureCachePaths.push_back(thisFeature(L"featureCacheFile", L""));
         m_featureNameToDimMap[featureNames[i]] = m_featDims[i];
 
         m_featuresBufferMultiIO.push_back(nullptr);
@@ -521,7 +523,7 @@ void HTKMLFReader<ElemType>::PrepareForTrainingOrTesting(const ConfigRecordType&
         m_frameSource.reset(new msra::dbn::minibatchutterancesourcemulti(infilesmulti, labelsmulti, m_featDims, m_labelDims, 
                                                                          numContextLeft, numContextRight, randomize, 
                                                                          *m_lattices, m_latticeMap, m_frameMode, 
-                                                                         minimizeReaderMemoryFootprint, m_expandToUtt));
+                                                                         minimizeReaderMemoryFootprint, m_expandToUtt, featureCachePaths));
         m_frameSource->setverbosity(m_verbosity);
     }
     else if (EqualCI(readMethod, L"rollingWindow"))
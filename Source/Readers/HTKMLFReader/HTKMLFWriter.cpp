@@ -33,6 +33,7 @@ void HTKMLFWriter<ElemType>::InitFromConfig(const ConfigRecordType& writerConfig
 {
     m_tempArray = nullptr;
     m_tempArraySize = 0;
+    m_outputQueueDepth = writerConfig(L"outputQueueDepth", (size_t) 4);
 
     vector<wstring> scriptpaths;
     vector<wstring> filelist;
@@ -100,6 +101,19 @@ void HTKMLFWriter<ElemType>::InitFromConfig(const ConfigRecordType& writerConfig
 template <class ElemType>
 void HTKMLFWriter<ElemType>::Destroy()
 {
+    // Writes are normally finished with the last file of the script (SaveData()). Destroy() is also called from the
+    // DataWriter destructor, which must not throw, so errors of writes still pending here are only logged.
+    while (!m_pendingWrites.empty())
+    {
+        try
+        {
+            WaitForPendingWrites(0);
+        }
+        catch (const std::exception& e)
+        {
+            fprintf(stderr, "HTKMLFWriter::Destroy: writing an output file failed: %s\n", e.what());
+        }
+    }
     delete[] m_tempArray;
     m_tempArray = nullptr;
     m_tempArraySize = 0;
@@ -134,14 +148,19 @@ bool HTKMLFWriter<ElemType>::SaveData(size_t /*recordStart*/, const std::map<std
 
     outputFileIndex++;
 
+    // that was the last file of the script: finish writing, so that errors reach the caller
+    if (outputFileIndex == outputFiles[0].size())
+        WaitForPendingWrites(0);
+
     return true;
 }
 
+// Save - copy the output to the CPU and write it as an HTK feature file in the background, so that the next minibatch can be computed meanwhile
 template <class ElemType>
 void HTKMLFWriter<ElemType>::Save(std::wstring& outputFile, Matrix<ElemType>& outputData)
 {
-    msra::dbn::matrix output;
-    output.resize(outputData.GetNumRows(), outputData.GetNumCols());
+    auto output = make_shared<msra::dbn::matrix>();
+    output->resize(outputData.GetNumRows(), outputData.GetNumCols());
     outputData.CopyToArray(m_tempArray, m_tempArraySize);
     ElemType* pValue = m_tempArray;
 
@@ -149,21 +168,39 @@ void HTKMLFWriter<ElemType>::Save(std::wstring& outputFile, Matrix<ElemType>& ou
     {
         for (int i = 0; i < outputData.GetNumRows(); i++)
         {
-            output(i, j) = (float) *pValue++;
+            (*output)(i, j) = (float) *pValue++;
         }
     }
 
-    const size_t nansinf = output.countnaninf();
-    if (nansinf > 0)
-        fprintf(stderr, "chunkeval: %d NaNs or INF detected in '%ls' (%d frames)\n", (int) nansinf, outputFile.c_str(), (int) output.cols());
-    // save it
-    msra::files::make_intermediate_dirs(outputFile);
-    msra::util::attempt(5, [&]()
-                        {
-                            msra::asr::htkfeatwriter::write(outputFile, "USER", this->sampPeriod, output);
-                        });
-
-    fprintf(stderr, "evaluate: writing %d frames of %ls\n", (int) output.cols(), outputFile.c_str());
+    msra::files::make_intermediate_dirs(outputFile); // (not in the background, since several writes may create the same directories)
+
+    unsigned int sampPeriod = this->sampPeriod;
+    m_pendingWrites.push_back(std::async(std::launch::async, [output, outputFile, sampPeriod]()
+    {
+        const size_t nansinf = output->countnaninf();
+        if (nansinf > 0)
+            fprintf(stderr, "chunkeval: %d NaNs or INF detected in '%ls' (%d frames)\n", (int) nansinf, outputFile.c_str(), (int) output->cols());
+        // save it
+        msra::util::attempt(5, [&]()
+                            {
+                                msra::asr::htkfeatwriter::write(outputFile, "USER", sampPeriod, *output);
+                            });
+
+        fprintf(stderr, "evaluate: writing %d frames of %ls\n", (int) output->cols(), outputFile.c_str());
+    }));
+    WaitForPendingWrites(m_outputQueueDepth);
+}
+
+// WaitForPendingWrites - wait until at most 'maxPending' files are being written, and pass on errors from writing them
+template <class ElemType>
+void HTKMLFWriter<ElemType>::WaitForPendingWrites(size_t maxPending)
+{
+    while (m_pendingWrites.size() > maxPending)
+    {
+        auto pendingWrite = move(m_pendingWrites.front());
+        m_pendingWrites.pop_front();
+        pendingWrite.get();
+    }
 }
 
 template <class ElemType>
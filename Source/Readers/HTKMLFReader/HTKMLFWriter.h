@@ -9,6 +9,8 @@
 #include "ScriptableObjects.h"
 #include <map>
 #include <vector>
+#include <deque>
+#include <future>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -26,8 +28,11 @@ private:
     unsigned int sampPeriod;
     size_t outputFileIndex;
     void Save(std::wstring& outputFile, Matrix<ElemType>& outputData);
+    void WaitForPendingWrites(size_t maxPending);
     ElemType* m_tempArray;
     size_t m_tempArraySize;
+    std::deque<std::future<void>> m_pendingWrites; // files being written in the background
+    size_t m_outputQueueDepth;                     // maximum number of files pending when SaveData() returns
 
     enum OutputTypes
     {
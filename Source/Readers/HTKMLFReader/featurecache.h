@@ -0,0 +1,303 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// featurecache.h -- consolidated, memory-mapped feature cache for minibatchutterancesourcemulti
+//
+
+#pragma once
+
+#include "Basics.h"
+#include "fileutil.h"
+#include "ssematrix.h"
+#include <stdint.h>
+#include <string.h>
+#include <random>
+#ifdef _WIN32
+#include "Windows.h"
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace msra { namespace dbn {
+
+// ---------------------------------------------------------------------------
+// featurecache -- all frames of one feature stream in a single file, one page-aligned block per chunk
+//
+// The file is built once by reading every chunk the regular way (htkfeatreader), and from then on it is
+// memory-mapped read-only, so that paging in a chunk is one copy out of the mapping instead of one
+// fopen(), header parse and byte swap per HTK file. Blocks are stored in the column layout of
+// msra::dbn::matrix (including the column padding), so they are copied as-is.
+//
+// Validity is keyed on a hash of the utterance list (see hashstring()/hashvalue()) and the chunk count;
+// a stale or damaged cache is simply rebuilt.
+//
+// Several processes (e.g. the ranks of an MPI job) may find the cache missing and build it at the same time.
+// Each one writes its own temporary file and atomically renames it into place, so a reader always sees either
+// no cache or a complete one; the last rename wins, and all candidates have identical contents.
+//
+// File layout:
+//  - fileheader
+//  - chunk table: [numchunks] x chunkentry
+//  - frame blocks, each starting at a page-aligned offset: colstride x numframes floats
+// ---------------------------------------------------------------------------
+
+class featurecache
+{
+    struct fileheader
+    {
+        char magic[8];      // "FEATCCH1"
+        uint64_t key;       // hash of the utterance list this cache was built from
+        uint64_t numchunks;
+        uint64_t featdim;
+        uint64_t colstride; // column stride of the stored blocks, in floats
+        uint64_t sampperiod;
+        char featkind[48];  // zero-terminated
+    };
+    struct chunkentry
+    {
+        uint64_t offset;    // byte offset of the block, page-aligned
+        uint64_t numframes;
+    };
+    static const char *magictag()
+    {
+        return "FEATCCH1";
+    }
+    static const uint64_t pagesize = 4096;
+
+    std::wstring path;
+    fileheader header;
+    std::vector<chunkentry> chunks;
+
+    // mapping
+    const char *mapped;
+    uint64_t mappedsize;
+#ifdef _WIN32
+    HANDLE hfile, hmapping;
+#else
+    int fd;
+#endif
+
+    // while building
+    FILE *fbuild;
+    std::wstring buildpath; // temporary file, unique to this builder
+
+    static uint64_t pagealign(uint64_t offset)
+    {
+        return (offset + pagesize - 1) / pagesize * pagesize;
+    }
+
+    bool map()
+    {
+#ifdef _WIN32
+        hfile = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+        if (hfile == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(hfile, &size) || size.QuadPart == 0)
+            return unmap(), false;
+        mappedsize = (uint64_t) size.QuadPart;
+        hmapping = CreateFileMappingW(hfile, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (hmapping == NULL)
+            return unmap(), false;
+        mapped = (const char *) MapViewOfFile(hmapping, FILE_MAP_READ, 0, 0, 0);
+        if (mapped == NULL)
+            return unmap(), false;
+#else
+        fd = ::open(wtocharpath(path).c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0)
+            return unmap(), false;
+        mappedsize = (uint64_t) st.st_size;
+        void *p = mmap(NULL, mappedsize, PROT_READ, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED)
+            return unmap(), false;
+        mapped = (const char *) p;
+        madvise(p, mappedsize, MADV_RANDOM); // chunks are paged in in randomized order
+#endif
+        return true;
+    }
+
+    void unmap()
+    {
+#ifdef _WIN32
+        if (mapped)
+            UnmapViewOfFile(mapped);
+        if (hmapping != NULL)
+            CloseHandle(hmapping);
+        if (hfile != INVALID_HANDLE_VALUE)
+            CloseHandle(hfile);
+        hmapping = NULL;
+        hfile = INVALID_HANDLE_VALUE;
+#else
+        if (mapped)
+            munmap((void *) mapped, mappedsize);
+        if (fd >= 0)
+            ::close(fd);
+        fd = -1;
+#endif
+        mapped = NULL;
+        mappedsize = 0;
+        chunks.clear();
+    }
+
+    featurecache(const featurecache &);
+    void operator=(const featurecache &);
+
+public:
+    featurecache(const std::wstring &path)
+        : path(path), mapped(NULL), mappedsize(0), fbuild(NULL)
+    {
+#ifdef _WIN32
+        hfile = INVALID_HANDLE_VALUE;
+        hmapping = NULL;
+#else
+        fd = -1;
+#endif
+        memset(&header, 0, sizeof(header));
+    }
+    ~featurecache()
+    {
+        unmap();
+        if (fbuild) // interrupted build
+        {
+            fclose(fbuild);
+            _wunlink(buildpath.c_str());
+        }
+    }
+
+    // FNV-1a hash for computing the key over the utterance list
+    static uint64_t hashinit()
+    {
+        return 14695981039346656037ull;
+    }
+    static uint64_t hashbytes(uint64_t h, const void *p, size_t n)
+    {
+        const unsigned char *b = (const unsigned char *) p;
+        for (size_t i = 0; i < n; i++)
+            h = (h ^ b[i]) * 1099511628211ull;
+        return h;
+    }
+    static uint64_t hashstring(uint64_t h, const std::wstring &s)
+    {
+        return hashbytes(h, s.c_str(), (s.size() + 1) * sizeof(wchar_t)); // include terminator to separate consecutive strings
+    }
+    static uint64_t hashvalue(uint64_t h, uint64_t v)
+    {
+        return hashbytes(h, &v, sizeof(v));
+    }
+
+    const std::wstring &getpath() const
+    {
+        return path;
+    }
+
+    // try to map an existing cache file; returns false if it does not exist or does not match 'key'
+    bool open(uint64_t key, size_t numchunks)
+    {
+        unmap();
+        if (!fexists(path.c_str()) || !map())
+            return false;
+        if (mappedsize < sizeof(fileheader))
+            return unmap(), false;
+        memcpy(&header, mapped, sizeof(header));
+        if (memcmp(header.magic, magictag(), sizeof(header.magic)) != 0 || header.key != key || header.numchunks != numchunks)
+            return unmap(), false;
+        if (mappedsize < sizeof(fileheader) + numchunks * sizeof(chunkentry))
+            return unmap(), false;
+        chunks.resize(numchunks);
+        memcpy(chunks.data(), mapped + sizeof(fileheader), numchunks * sizeof(chunkentry));
+        for (const auto &chunk : chunks) // a truncated file (e.g. disk full during build) is treated as stale
+            if (chunk.offset + chunk.numframes * header.colstride * sizeof(float) > mappedsize)
+                return unmap(), false;
+        return true;
+    }
+
+    bool isopen() const
+    {
+        return mapped != NULL;
+    }
+
+    // feature format as stored in the cache
+    std::string featkind() const
+    {
+        return header.featkind;
+    }
+    size_t featdim() const
+    {
+        return (size_t) header.featdim;
+    }
+    unsigned int sampperiod() const
+    {
+        return (unsigned int) header.sampperiod;
+    }
+
+    // copy the frames of chunk k into 'frames', which must have been sized to [featdim x numframes]
+    void readchunk(size_t k, msra::dbn::matrix &frames) const
+    {
+        if (!isopen())
+            LogicError("featurecache::readchunk: cache is not open");
+        const chunkentry &chunk = chunks[k];
+        if (frames.rows() != header.featdim || frames.cols() != chunk.numframes || frames.getcolstride() != header.colstride)
+            LogicError("featurecache::readchunk: chunk %d has unexpected dimensions", (int) k);
+        if (chunk.numframes > 0)
+            memcpy(&frames(0, 0), mapped + chunk.offset, (size_t)(chunk.numframes * header.colstride * sizeof(float)));
+    }
+
+    // build a new cache: beginbuild(), writechunk() for all chunks in order, endbuild()
+    // The file is written under a temporary name and renamed when complete, so an interrupted build leaves no stale cache.
+    void beginbuild(size_t numchunks)
+    {
+        unmap();
+        // process id and a random number, since concurrent builders may run in different processes, on different hosts
+        buildpath = msra::strfun::wstrprintf(L"%ls.%d-%08x.tmp", path.c_str(), (int) GetCurrentProcessId(), (unsigned int) std::random_device()());
+        fbuild = fopenOrDie(buildpath, L"wb");
+        chunks.assign(numchunks, chunkentry{ 0, 0 });
+        fsetpos(fbuild, pagealign(sizeof(fileheader) + numchunks * sizeof(chunkentry)));
+    }
+    void writechunk(size_t k, const msra::dbn::matrix &frames)
+    {
+        uint64_t offset = pagealign(fgetpos(fbuild));
+        fsetpos(fbuild, offset);
+        chunks[k].offset = offset;
+        chunks[k].numframes = frames.cols();
+        header.featdim = frames.rows();
+        header.colstride = frames.getcolstride();
+        if (frames.cols() > 0)
+            fwriteOrDie(&frames(0, 0), sizeof(float), frames.getcolstride() * frames.cols(), fbuild);
+    }
+    void endbuild(uint64_t key, const std::string &featkind, unsigned int sampperiod)
+    {
+        memcpy(header.magic, magictag(), sizeof(header.magic));
+        header.key = key;
+        header.numchunks = chunks.size();
+        header.sampperiod = sampperiod;
+        memset(header.featkind, 0, sizeof(header.featkind));
+        strncpy(header.featkind, featkind.c_str(), sizeof(header.featkind) - 1);
+        fsetpos(fbuild, (uint64_t) 0);
+        fwriteOrDie(&header, sizeof(header), 1, fbuild);
+        fwriteOrDie(chunks.data(), sizeof(chunkentry), chunks.size(), fbuild);
+        fflushOrDie(fbuild);
+        fclose(fbuild);
+        fbuild = NULL;
+        // replace atomically; unlinking first would let a concurrent open() find no cache and build another one
+#ifdef _WIN32
+        if (!MoveFileExW(buildpath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING))
+        {
+            // the existing file is mapped by another process, which means another builder has completed it
+            if (!fexists(path.c_str()))
+                RuntimeError("featurecache: error renaming '%ls' to '%ls': %d", buildpath.c_str(), path.c_str(), (int) GetLastError());
+            unlinkOrDie(buildpath);
+        }
+#else
+        if (::rename(wtocharpath(buildpath).c_str(), wtocharpath(path).c_str()) != 0)
+            RuntimeError("featurecache: error renaming '%ls' to '%ls': %s", buildpath.c_str(), path.c_str(), strerror(errno));
+#endif
+    }
+};
+} }
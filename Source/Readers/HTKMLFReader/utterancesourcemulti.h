@@ -12,6 +12,7 @@
 #include "latticearchive.h" // for reading HTK phoneme lattices (MMI training)
 #include "minibatchsourcehelpers.h"
 #include "minibatchiterator.h"
+#include "featurecache.h"
 #include "unordered_set"
 
 namespace msra { namespace dbn {
@@ -97,10 +98,12 @@ class minibatchutterancesourcemulti : public minibatchsource
         mutable msra::dbn::matrix frames;                                           // stores all frames consecutively (mutable since this is a cache)
         size_t totalframes;                                                         // total #frames for all utterances in this chunk
         mutable std::vector<shared_ptr<const latticesource::latticepair>> lattices; // (may be empty if none)
+        const featurecache *cache;                                                  // if not NULL then frames are paged in from this consolidated cache
+        size_t cacheindex;                                                          // index of this chunk inside 'cache'
 
         // construction
         utterancechunkdata()
-            : totalframes(0)
+            : totalframes(0), cache(NULL), cacheindex(0)
         {
         }
         void push_back(utterancedesc && /*destructive*/ utt)
@@ -142,6 +145,26 @@ class minibatchutterancesourcemulti : public minibatchsource
         {
             return !frames.empty();
         }
+        // read the frames of all utterances of this chunk from their original HTK files (does not touch lattices)
+        // We pass in the feature info variables by ref which will be filled lazily upon first read
+        void readframes(string &featkind, size_t &featdim, unsigned int &sampperiod) const
+        {
+            msra::asr::htkfeatreader reader; // feature reader (we reinstantiate it for each block, i.e. we reopen the file actually)
+            // if this is the first feature read ever, we explicitly open the first file to get the information such as feature dimension
+            if (featdim == 0)
+            {
+                reader.getinfo(utteranceset[0].parsedpath, featkind, featdim, sampperiod);
+                fprintf(stderr, "requiredata: determined feature kind as %d-dimensional '%s' with frame shift %.1f ms\n", (int) featdim, featkind.c_str(), sampperiod / 1e4);
+            }
+            // read all utterances; if they are in the same archive, htkfeatreader will be efficient in not closing the file
+            frames.resize(featdim, totalframes);
+            foreach_index (i, utteranceset)
+            {
+                // read features for this file
+                auto uttframes = getutteranceframes(i);                                                                                   // matrix stripe for this utterance (currently unfilled)
+                reader.read(utteranceset[i].parsedpath, (const string &) featkind, sampperiod, uttframes, utteranceset[i].needsExpansion); // note: file info here used for checkuing only
+            }
+        }
         // page in data for this chunk
         // We pass in the feature info variables by ref which will be filled lazily upon first read
         void requiredata(string &featkind, size_t &featdim, unsigned int &sampperiod, const latticesource &latticesource, int verbosity = 0) const
@@ -152,30 +175,22 @@ class minibatchutterancesourcemulti : public minibatchsource
                 LogicError("requiredata: called when data is already in memory");
             try // this function supports retrying since we read from the unrealible network, i.e. do not return in a broken state
             {
-                msra::asr::htkfeatreader reader; // feature reader (we reinstantiate it for each block, i.e. we reopen the file actually)
-                // if this is the first feature read ever, we explicitly open the first file to get the information such as feature dimension
-                if (featdim == 0)
+                if (cache) // consolidated cache: one copy out of the memory-mapped file for the whole chunk
                 {
-                    reader.getinfo(utteranceset[0].parsedpath, featkind, featdim, sampperiod);
-                    fprintf(stderr, "requiredata: determined feature kind as %d-dimensional '%s' with frame shift %.1f ms\n", (int) featdim, featkind.c_str(), sampperiod / 1e4);
+                    frames.resize(featdim, totalframes);
+                    cache->readchunk(cacheindex, frames);
                 }
-                // read all utterances; if they are in the same archive, htkfeatreader will be efficient in not closing the file
-                frames.resize(featdim, totalframes);
+                else
+                    readframes(featkind, featdim, sampperiod);
+                // page in lattice data
                 if (!latticesource.empty())
-                    lattices.resize(utteranceset.size());
-                foreach_index (i, utteranceset)
                 {
-                    // fprintf (stderr, ".");
-                    // read features for this file
-                    auto uttframes = getutteranceframes(i);                                                    // matrix stripe for this utterance (currently unfilled)
-                    reader.read(utteranceset[i].parsedpath, (const string &)featkind, sampperiod, uttframes, utteranceset[i].needsExpansion);  // note: file info here used for checkuing only
-                    // page in lattice data
-                    if (!latticesource.empty())
-                        latticesource.getlattices(utteranceset[i].key(), lattices[i], uttframes.cols());
+                    lattices.resize(utteranceset.size());
+                    foreach_index (i, utteranceset)
+                        latticesource.getlattices(utteranceset[i].key(), lattices[i], numframes(i));
                 }
-                // fprintf (stderr, "\n");
                 if (verbosity)
-                    fprintf(stderr, "requiredata: %d utterances read\n", (int) utteranceset.size());
+                    fprintf(stderr, "requiredata: %d utterances read%s\n", (int) utteranceset.size(), cache ? " from feature cache" : "");
             }
             catch (...)
             {
@@ -841,7 +856,8 @@ public:
     // This mode requires utterances with time stamps.
     minibatchutterancesourcemulti(const std::vector<std::vector<wstring>> &infiles, const std::vector<map<wstring, std::vector<msra::asr::htkmlfentry>>> &labels,
                                   std::vector<size_t> vdim, std::vector<size_t> udim, std::vector<size_t> leftcontext, std::vector<size_t> rightcontext, size_t randomizationrange,
-                                  const latticesource &lattices, const map<wstring, msra::lattices::lattice::htkmlfwordsequence> &allwordtranscripts, const bool framemode, bool minimizeMemoryFootprint, std::vector<bool> expandToUtt)
+                                  const latticesource &lattices, const map<wstring, msra::lattices::lattice::htkmlfwordsequence> &allwordtranscripts, const bool framemode, bool minimizeMemoryFootprint, std::vector<bool> expandToUtt,
+                                  const std::vector<wstring> &featurecachepaths = std::vector<wstring>())
                                   : vdim(vdim), leftcontext(leftcontext), rightcontext(rightcontext), sampperiod(0), featdim(0), randomizationrange(randomizationrange), currentsweep(SIZE_MAX), lattices(lattices), allwordtranscripts(allwordtranscripts), framemode(framemode), chunksinram(0), timegetbatch(0), verbosity(2), m_generatePhoneBoundaries(!lattices.empty()), m_frameRandomizer(randomizedchunks, minimizeMemoryFootprint), expandToUtt(expandToUtt)
     // [v-hansu] change framemode (lattices.empty()) into framemode (false) to run utterance mode without lattice
     // you also need to change another line, search : [v-hansu] comment out to run utterance mode without lattice
@@ -1163,6 +1179,74 @@ public:
                     (int) numutterances, (int) thisallchunks.size(), numutterances / (double) thisallchunks.size(), _totalframes / (double) thisallchunks.size());
             // Now utterances are stored exclusively in allchunks[]. They are never referred to by a sequential utterance id at this point, only by chunk/within-chunk index.
         }
+        // attach consolidated feature caches where requested
+        featurecaches.resize(infiles.size());
+        foreach_index (m, featurecachepaths)
+        {
+            if (m < (int) infiles.size() && !featurecachepaths[m].empty())
+                attachfeaturecache(m, featurecachepaths[m]);
+        }
+    }
+
+private:
+    std::vector<unique_ptr<featurecache>> featurecaches; // [m] consolidated feature cache for stream m (NULL if none)
+
+    // key identifying the feature content of stream m: the chunked utterance list incl. frame ranges and expansion
+    uint64_t featurecachekey(size_t m) const
+    {
+        uint64_t key = featurecache::hashinit();
+        for (const auto &chunkdata : allchunks[m])
+        {
+            key = featurecache::hashvalue(key, chunkdata.numutterances());
+            for (const auto &utt : chunkdata.utteranceset)
+            {
+                key = featurecache::hashstring(key, utt.logicalpath());
+                key = featurecache::hashstring(key, utt.parsedpath.physicallocation());
+                key = featurecache::hashvalue(key, utt.numframes());
+                key = featurecache::hashvalue(key, utt.needsExpansion ? 1 : 0);
+            }
+        }
+        return key;
+    }
+
+    // open the feature cache for stream m, or build it first if it is missing or stale
+    // Building reads every chunk once the regular way; from then on, chunks are paged in from the memory-mapped cache.
+    void attachfeaturecache(size_t m, const wstring &path)
+    {
+        std::vector<utterancechunkdata> &thisallchunks = allchunks[m];
+        const uint64_t key = featurecachekey(m);
+        unique_ptr<featurecache> cache(new featurecache(path));
+        if (!cache->open(key, thisallchunks.size()))
+        {
+            fprintf(stderr, "minibatchutterancesource: building feature cache '%ls' for feature set %d (%d chunks)\n", path.c_str(), (int) m, (int) thisallchunks.size());
+            cache->beginbuild(thisallchunks.size());
+            foreach_index (k, thisallchunks)
+            {
+                const utterancechunkdata &chunkdata = thisallchunks[k];
+                msra::util::attempt(5, [&]() // (reading from network)
+                                    {
+                                        if (chunkdata.isinram())
+                                            chunkdata.frames.resize(0, 0);
+                                        chunkdata.readframes(featkind[m], featdim[m], sampperiod[m]);
+                                    });
+                cache->writechunk(k, chunkdata.frames);
+                chunkdata.frames.resize(0, 0);
+            }
+            cache->endbuild(key, featkind[m], sampperiod[m]);
+            if (!cache->open(key, thisallchunks.size()))
+                RuntimeError("minibatchutterancesource: failed to open newly built feature cache '%ls'", path.c_str());
+        }
+        else
+            fprintf(stderr, "minibatchutterancesource: using feature cache '%ls' for feature set %d\n", path.c_str(), (int) m);
+        featkind[m] = cache->featkind();
+        featdim[m] = cache->featdim();
+        sampperiod[m] = cache->sampperiod();
+        foreach_index (k, thisallchunks)
+        {
+            thisallchunks[k].cache = cache.get();
+            thisallchunks[k].cacheindex = k;
+        }
+        featurecaches[m] = std::move(cache);
     }
 
 private:
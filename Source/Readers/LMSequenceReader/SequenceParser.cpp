@@ -8,6 +8,8 @@
 #include "stdafx.h"
 #include <stdexcept>
 #include <stdint.h>
+#include <random>
+#include <sys/stat.h>
 #include "Basics.h"
 #include "SequenceParser.h"
 #include "fileutil.h"
@@ -587,3 +589,166 @@ long LMBatchSequenceParser<NumType, LabelType>::Parse(size_t recordsRequested, s
 
 template class LMBatchSequenceParser<float, std::string>;
 template class LMBatchSequenceParser<double, std::string>;
+
+// ---------------------------------------------------------------------------
+// LMWordIdCorpus
+// ---------------------------------------------------------------------------
+
+LMWordIdCorpus::Source::Source(const std::wstring& textFileName, uint64_t vocabHash)
+    : vocabHash(vocabHash)
+{
+#ifdef _WIN32
+    struct _stat64 buf;
+    if (_wstat64(textFileName.c_str(), &buf) != 0)
+#else
+    struct stat buf;
+    if (stat(wtocharpath(textFileName).c_str(), &buf) != 0)
+#endif
+        RuntimeError("LMWordIdCorpus: Cannot access text file %ls.", textFileName.c_str());
+    textFileSize = (uint64_t) buf.st_size;
+    textFileTime = (uint64_t) buf.st_mtime;
+}
+
+uint64_t LMWordIdCorpus::HashWord(uint64_t hash, const std::string& word)
+{
+    for (char c : word)
+        hash = (hash ^ (unsigned char) c) * 1099511628211ull;
+    return (hash ^ 0xff) * 1099511628211ull; // terminator, so that word boundaries matter
+}
+
+bool LMWordIdCorpus::Open(const std::wstring& fileName, size_t vocabSize, const Source& source)
+{
+    if (m_file)
+        fclose(m_file);
+    m_file = nullptr;
+    m_sentenceBegin.clear();
+    if (!fexists(fileName))
+        return false;
+    m_fileName = fileName;
+    m_file = fopenOrDie(fileName, L"rb");
+
+    fcheckTag(m_file, "LMWI");
+    int version;
+    fget(m_file, version);
+    uint64_t fileVocabSize = 0, numSentences = 0, numTokens = 0, indexOffset = 0;
+    Source fileSource;
+    if (version == s_version)
+    {
+        fget(m_file, fileVocabSize);
+        fget(m_file, numSentences);
+        fget(m_file, numTokens);
+        fget(m_file, indexOffset);
+        fget(m_file, fileSource.textFileSize);
+        fget(m_file, fileSource.textFileTime);
+        fget(m_file, fileSource.vocabHash);
+    }
+    if (version != s_version || fileVocabSize != vocabSize || fileSource != source)
+    {
+        fprintf(stderr, "LMWordIdCorpus: %ls is stale (format version, vocabulary, or text file changed).\n", fileName.c_str());
+        fclose(m_file);
+        m_file = nullptr;
+        return false;
+    }
+    m_vocabSize = vocabSize;
+
+    m_sentenceBegin.resize((size_t) numSentences + 1);
+    fsetpos(m_file, indexOffset);
+    freadOrDie(m_sentenceBegin, m_sentenceBegin.size(), m_file);
+    if (m_sentenceBegin.back() != numTokens)
+        RuntimeError("LMWordIdCorpus: %ls has an inconsistent sentence index.", fileName.c_str());
+    Reset();
+    return true;
+}
+
+size_t LMWordIdCorpus::Read(size_t tokensRequested, std::vector<unsigned int>& wordIds, std::vector<SentenceInfo>& sentences)
+{
+    if (!m_file)
+        LogicError("LMWordIdCorpus::Read: No corpus opened.");
+
+    // determine the range of sentences to read
+    const size_t firstSentence = m_nextSentence;
+    const size_t numSentences = GetNumSentences();
+    while (m_nextSentence < numSentences && m_sentenceBegin[m_nextSentence] - m_sentenceBegin[firstSentence] < tokensRequested)
+        m_nextSentence++;
+    if (m_nextSentence == firstSentence)
+        return 0;
+
+    // these are contiguous in the file, so read them in one go
+    const uint64_t firstToken = m_sentenceBegin[firstSentence];
+    const size_t numTokens = (size_t) (m_sentenceBegin[m_nextSentence] - firstToken);
+    const size_t orgNumWordIds = wordIds.size();
+    wordIds.resize(orgNumWordIds + numTokens);
+    fsetpos(m_file, s_headerSize + firstToken * sizeof(unsigned int));
+    freadOrDie(&wordIds[orgNumWordIds], sizeof(unsigned int), numTokens, m_file);
+
+    for (size_t i = firstSentence; i < m_nextSentence; i++)
+    {
+        SentenceInfo stinfo;
+        stinfo.sBegin = orgNumWordIds + (size_t) (m_sentenceBegin[i] - firstToken);
+        stinfo.sLen = (size_t) (m_sentenceBegin[i + 1] - m_sentenceBegin[i]);
+        sentences.push_back(stinfo);
+    }
+    return m_nextSentence - firstSentence;
+}
+
+void LMWordIdCorpus::BeginWrite(const std::wstring& fileName, size_t vocabSize, const Source& source)
+{
+    if (m_file)
+        fclose(m_file);
+    m_fileName = fileName;
+    m_tempFileName = msra::strfun::wstrprintf(L"%ls.%d-%08x.tmp", fileName.c_str(), (int) GetCurrentProcessId(), (unsigned int) std::random_device()());
+    m_vocabSize = vocabSize;
+    m_source = source;
+    m_file = fopenOrDie(m_tempFileName, L"wb");
+
+    // the header gets rewritten with the actual counts in EndWrite()
+    std::vector<char> header(s_headerSize, 0);
+    fwriteOrDie(header, m_file);
+
+    m_sentenceBegin.assign(1, 0);
+    m_numTokensWritten = 0;
+}
+
+void LMWordIdCorpus::WriteSentence(const unsigned int* wordIds, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+        if (wordIds[i] >= m_vocabSize)
+            LogicError("LMWordIdCorpus::WriteSentence: Word id %d out of range of vocabulary size %d.", (int) wordIds[i], (int) m_vocabSize);
+    fwriteOrDie(wordIds, sizeof(*wordIds), len, m_file);
+    m_numTokensWritten += len;
+    m_sentenceBegin.push_back(m_numTokensWritten);
+}
+
+void LMWordIdCorpus::EndWrite()
+{
+    const uint64_t indexOffset = s_headerSize + m_numTokensWritten * sizeof(unsigned int);
+    fwriteOrDie(m_sentenceBegin, m_file);
+
+    rewind(m_file);
+    fputTag(m_file, "LMWI");
+    fput(m_file, s_version);
+    fput(m_file, (uint64_t) m_vocabSize);
+    fput(m_file, (uint64_t) GetNumSentences());
+    fput(m_file, m_numTokensWritten);
+    fput(m_file, indexOffset);
+    fput(m_file, m_source.textFileSize);
+    fput(m_file, m_source.textFileTime);
+    fput(m_file, m_source.vocabHash);
+    fcloseOrDie(m_file);
+    m_file = nullptr;
+
+    // replace atomically; unlinking first would let a concurrent Open() find no corpus and compile another one
+#ifdef _WIN32
+    if (!MoveFileExW(m_tempFileName.c_str(), m_fileName.c_str(), MOVEFILE_REPLACE_EXISTING))
+    {
+        // the existing file is open in another process, which means another writer has completed it
+        if (!fexists(m_fileName))
+            RuntimeError("LMWordIdCorpus: error renaming '%ls' to '%ls': %d", m_tempFileName.c_str(), m_fileName.c_str(), (int) GetLastError());
+        unlinkOrDie(m_tempFileName);
+    }
+#else
+    if (::rename(wtocharpath(m_tempFileName).c_str(), wtocharpath(m_fileName).c_str()) != 0)
+        RuntimeError("LMWordIdCorpus: error renaming '%ls' to '%ls': %s", m_tempFileName.c_str(), m_fileName.c_str(), strerror(errno));
+#endif
+    m_tempFileName.clear();
+}
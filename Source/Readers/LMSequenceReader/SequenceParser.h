@@ -642,3 +642,81 @@ public:
     //   TODO: can return value be negative? If not, use size_t
     long Parse(size_t recordsRequested, std::vector<LabelType> *labels, std::vector<NumType> *numbers, std::vector<SequencePosition> *seqPos);
 };
+
+// precompiled word-ID corpus for LMBatchSequenceParser-style input
+// The text corpus is tokenized and mapped to word ids once, and stored as
+//  - header: tag "LMWI", version, vocabulary size, #sentences, #tokens, byte offset of index, and the Source it was compiled from
+//  - all word ids of all sentences, as uint32, in corpus order
+//  - index: #sentences+1 uint64 token offsets of the sentence begins
+// Reading then is a single fread() per cache block, instead of tokenizing and looking up every word.
+// Several processes (e.g. MPI ranks) may compile the same corpus concurrently. Each one writes its own temporary
+// file and atomically renames it into place, so a reader always sees either no corpus or a complete one.
+class LMWordIdCorpus
+{
+public:
+    // what a corpus was compiled from; a corpus compiled from a different text file or vocabulary is stale
+    struct Source
+    {
+        uint64_t textFileSize;
+        uint64_t textFileTime; // modification time
+        uint64_t vocabHash;    // see HashWord()
+
+        Source()
+            : textFileSize(0), textFileTime(0), vocabHash(0)
+        {
+        }
+        Source(const std::wstring& textFileName, uint64_t vocabHash);
+        bool operator==(const Source& other) const { return textFileSize == other.textFileSize && textFileTime == other.textFileTime && vocabHash == other.vocabHash; }
+        bool operator!=(const Source& other) const { return !(*this == other); }
+    };
+
+    // FNV-1a hash of a sequence of words; start with HashInit(), then call HashWord() for each word in id order
+    static uint64_t HashInit() { return 14695981039346656037ull; }
+    static uint64_t HashWord(uint64_t hash, const std::string& word);
+
+private:
+    FILE* m_file;
+    std::wstring m_fileName;
+    std::vector<uint64_t> m_sentenceBegin; // [#sentences+1] token offset of each sentence, and total #tokens at the end
+    size_t m_vocabSize;
+    size_t m_nextSentence;                 // read cursor
+
+    // used while writing
+    std::wstring m_tempFileName;           // unique to this writer; empty unless writing
+    uint64_t m_numTokensWritten;
+    Source m_source;
+
+    static const int s_version = 2;
+    static const size_t s_headerSize = 4 + sizeof(int) + 7 * sizeof(uint64_t);
+
+public:
+    LMWordIdCorpus()
+        : m_file(nullptr), m_vocabSize(0), m_nextSentence(0), m_numTokensWritten(0)
+    {
+    }
+    ~LMWordIdCorpus()
+    {
+        if (m_file)
+            fclose(m_file);
+        if (!m_tempFileName.empty()) // interrupted while writing
+            _wunlink(m_tempFileName.c_str());
+    }
+
+    // open an existing corpus for reading
+    // Returns false if there is none, or it is stale (another format version, vocabulary size, or source); then compile it anew.
+    bool Open(const std::wstring& fileName, size_t vocabSize, const Source& source);
+    size_t GetNumSentences() const { return m_sentenceBegin.empty() ? 0 : m_sentenceBegin.size() - 1; }
+    size_t GetNumTokens() const { return m_sentenceBegin.empty() ? 0 : (size_t) m_sentenceBegin.back(); }
+    void Reset() { m_nextSentence = 0; }
+
+    // read the next sentences until at least 'tokensRequested' tokens were read (like LMSequenceParser::Parse())
+    // Word ids are appended to 'wordIds', sentences to 'sentences' with sBegin relative to the first word id appended.
+    // Returns the number of sentences read; 0 at the end of the corpus.
+    size_t Read(size_t tokensRequested, std::vector<unsigned int>& wordIds, std::vector<SentenceInfo>& sentences);
+
+    // compile a corpus: BeginWrite(), one WriteSentence() per sentence, EndWrite()
+    // The file is written under a temp name and renamed at the end, so that an interrupted run leaves no partial corpus behind.
+    void BeginWrite(const std::wstring& fileName, size_t vocabSize, const Source& source);
+    void WriteSentence(const unsigned int* wordIds, size_t len);
+    void EndWrite();
+};
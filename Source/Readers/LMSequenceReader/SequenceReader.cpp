@@ -1417,6 +1417,8 @@ void BatchSequenceReader<ElemType>::InitFromConfig(const ConfigRecordType& reade
     {
         readerMode = ReaderMode::NCE;
         m_noiseSampleSize = featureConfig(L"noise_number", 0);
+        // sharing the noise samples across the minibatch lets the CPU NCE criterion score them with one GEMM
+        m_sharedNoiseSamples = featureConfig(L"noise_shared", false);
     }
     else if (EqualCI(mode, L"softmax"))
         readerMode = ReaderMode::Softmax;
@@ -1573,6 +1575,77 @@ void BatchSequenceReader<ElemType>::InitFromConfig(const ConfigRecordType& reade
 
     mRequestedNumParallelSequences = readerConfig(L"nbruttsineachrecurrentiter", (size_t) 1); // 0 indicates auto-fill mbSize
     // TODO: ^^ This should depend on the sequences themselves.
+
+    // precompiled word-id corpus: compiled from the text file on first use, and then read instead of it
+    wstring wordIdCorpusPath = readerConfig(L"wordIdCorpus", L"");
+    m_useWordIdCorpus = !wordIdCorpusPath.empty();
+    if (m_useWordIdCorpus)
+    {
+        if (labelIn.type != labelCategory || (labelOut.type != labelNextWord && labelOut.type != labelNone))
+            InvalidArgument("BatchSequenceReader: wordIdCorpus requires input labels of type 'category' and output labels of type 'nextWord' or 'none'.");
+        // a corpus compiled from another text file or vocabulary is stale, and gets compiled anew
+        uint64_t vocabHash = LMWordIdCorpus::HashWord(LMWordIdCorpus::HashWord(LMWordIdCorpus::HashInit(), labelIn.beginSequence), labelIn.endSequence);
+        for (const auto& entry : labelIn.mapIdToLabel)
+            vocabHash = LMWordIdCorpus::HashWord(vocabHash, entry.second);
+        const LMWordIdCorpus::Source source(pathName, vocabHash);
+        if (!m_wordIdCorpus.Open(wordIdCorpusPath, labelIn.dim, source))
+        {
+            CompileWordIdCorpus(wordIdCorpusPath, source);
+            if (!m_wordIdCorpus.Open(wordIdCorpusPath, labelIn.dim, source))
+                RuntimeError("BatchSequenceReader: Word-id corpus '%ls' was replaced by another one while compiling it.", wordIdCorpusPath.c_str());
+        }
+        if (m_traceLevel > 0)
+            fprintf(stderr, "LMSequenceReader: Reading word-id corpus '%ls' (%d sentences, %d tokens).\n", wordIdCorpusPath.c_str(), (int) m_wordIdCorpus.GetNumSentences(), (int) m_wordIdCorpus.GetNumTokens());
+    }
+
+    // length bucketing: batch sentences of similar length, padding the shorter ones with gaps
+    m_bucketByLength = readerConfig(L"bucketByLength", false);
+}
+
+// tokenize the text corpus once and write it out as a word-id corpus (see LMWordIdCorpus)
+// Note: The output label of a token is taken as the word id of the next token. Unlike the text path, tokens that match
+// the end-sequence symbol only case-insensitively are not mapped to it.
+template <class ElemType>
+void BatchSequenceReader<ElemType>::CompileWordIdCorpus(const std::wstring& corpusPath, const LMWordIdCorpus::Source& source)
+{
+    fprintf(stderr, "LMSequenceReader: Compiling word-id corpus '%ls'...", corpusPath.c_str()), fflush(stderr);
+
+    LabelInfo& labelIn = m_labelInfo[labelInfoIn];
+    LMWordIdCorpus corpus;
+    corpus.BeginWrite(corpusPath, labelIn.dim, source);
+    std::vector<LabelIdType> wordIds;
+    m_parser.ParseReset();
+    for (;;)
+    {
+        Reset();
+        std::vector<SequencePosition> seqPos;
+        if (m_parser.Parse(m_cacheBlockSize, &m_labelTemp, &m_featureTemp, &seqPos) == 0)
+            break;
+        for (const auto& sentence : m_parser.mSentenceIndex2SentenceInfo)
+        {
+            wordIds.resize(sentence.sLen);
+            for (size_t i = 0; i < sentence.sLen; i++)
+                wordIds[i] = GetIdFromLabel(m_labelTemp[sentence.sBegin + i], labelIn);
+            corpus.WriteSentence(wordIds.data(), wordIds.size());
+        }
+    }
+    fprintf(stderr, " %d sentences, %d tokens.\n", (int) corpus.GetNumSentences(), (int) corpus.GetNumTokens());
+    corpus.EndWrite();
+
+    Reset();
+    m_parser.ParseReset();
+}
+
+// read the next cache block of sentences into m_parser.mSentenceIndex2SentenceInfo[] and m_labelTemp[] or m_wordIdTemp[]
+// Returns the number of sentences read.
+template <class ElemType>
+size_t BatchSequenceReader<ElemType>::ReadCacheBlock()
+{
+    if (m_useWordIdCorpus)
+        return m_wordIdCorpus.Read(m_cacheBlockSize, m_wordIdTemp, m_parser.mSentenceIndex2SentenceInfo);
+
+    std::vector<SequencePosition> seqPos;
+    return (size_t) m_parser.Parse(m_cacheBlockSize, &m_labelTemp, &m_featureTemp, &seqPos);
 }
 
 template <class ElemType>
@@ -1589,6 +1662,8 @@ void BatchSequenceReader<ElemType>::Reset()
         m_labelTemp.clear();
     if (m_featureTemp.size() > 0)
         m_featureTemp.clear();
+    m_wordIdTemp.clear();
+    mBucketEnd.clear();
     m_parser.mSentenceIndex2SentenceInfo.clear();
 }
 
@@ -1673,10 +1748,49 @@ void BatchSequenceReader<ElemType>::StartMinibatchLoop(size_t mbSize, size_t epo
     m_idx2clsRead = false;
 
     m_parser.ParseReset();
+    if (m_useWordIdCorpus)
+        m_wordIdCorpus.Reset();
 
     Reset();
 }
 
+// sort the sentences of the current cache block by length, cut them into minibatches of similar length, and shuffle those
+// DetermineSequencesToProcess() then returns these minibatches one by one, as recorded in mBucketEnd[].
+template <class ElemType>
+void BatchSequenceReader<ElemType>::BucketSequencesByLength()
+{
+    auto& sentences = m_parser.mSentenceIndex2SentenceInfo;
+    std::stable_sort(sentences.begin(), sentences.end(), [](const SentenceInfo& a, const SentenceInfo& b) { return a.sLen < b.sLen; });
+
+    // cut into buckets of up to mRequestedNumParallelSequences sentences, or if that is 0, up to m_mbSize tokens including padding
+    const size_t maxToProcess = mRequestedNumParallelSequences > 0 ? mRequestedNumParallelSequences : SIZE_MAX;
+    const size_t maxTokens    = mRequestedNumParallelSequences > 0 ?                       SIZE_MAX : m_mbSize;
+    std::vector<std::pair<size_t, size_t>> buckets; // [begin, end) ranges into sentences[]
+    for (size_t begin = 0, end; begin < sentences.size(); begin = end)
+    {
+        for (end = begin + 1; end < sentences.size() && end - begin < maxToProcess; end++)
+        {
+            if ((end - begin + 1) * sentences[end].sLen >= maxTokens) // sorted, so the last one determines the padded length
+                break;
+        }
+        buckets.push_back(make_pair(begin, end));
+    }
+
+    std::mt19937 g(m_randomSeed);
+    std::shuffle(buckets.begin(), buckets.end(), g);
+
+    std::vector<SentenceInfo> bucketedSentences;
+    bucketedSentences.reserve(sentences.size());
+    mBucketEnd.assign(sentences.size(), 0);
+    for (const auto& bucket : buckets)
+    {
+        size_t begin = bucketedSentences.size();
+        bucketedSentences.insert(bucketedSentences.end(), sentences.begin() + bucket.first, sentences.begin() + bucket.second);
+        mBucketEnd[begin] = bucketedSentences.size();
+    }
+    sentences.swap(bucketedSentences);
+}
+
 // fill mToProcess[] with the next set of sequences of the same length
 // This function updates mToProcess[] (only, except it also lazily initializes mProcessed[]).
 // If mToProcess[] is not empty, then it will check whether those sequences are done, and if not, just return with mToProcess[] unchanged.
@@ -1714,10 +1828,41 @@ size_t BatchSequenceReader<ElemType>::DetermineSequencesToProcess()
     }
 
     // if we still have unfinished sequences then just return their length
+    // They are all the same length, except with length bucketing, where the shorter ones get padded to the longest.
     if (mToProcess.size() > 0)
     {
-        // They are all the same length, so we can just get the value from the first entry.
-        return m_parser.mSentenceIndex2SentenceInfo[mToProcess[0]].sLen;
+        size_t sln = 0;
+        for (auto seq : mToProcess)
+            sln = max(sln, m_parser.mSentenceIndex2SentenceInfo[seq].sLen);
+        return sln;
+    }
+
+    // with length bucketing, the next set is the bucket starting at the first unprocessed sequence
+    // Sentences without a single sample (one token and an output label) are skipped, since a bucket pads its shorter
+    // sentences by repeating their last sample. A bucket of only such sentences is skipped altogether.
+    if (m_bucketByLength)
+    {
+        const size_t minLen = (m_labelInfo[labelInfoOut].type != labelNone) ? 2 : 1;
+        size_t sln = 0;
+        size_t seq = mLastProcessedSentenceId;
+        while (mToProcess.empty())
+        {
+            while (seq < mNumRead && mProcessed[seq])
+                seq++;
+            if (seq >= mNumRead)
+                break;
+            for (size_t end = mBucketEnd[seq]; seq < end; seq++)
+            {
+                if (m_parser.mSentenceIndex2SentenceInfo[seq].sLen < minLen)
+                {
+                    mProcessed[seq] = true;
+                    continue;
+                }
+                mToProcess.push_back(seq);
+                sln = max(sln, m_parser.mSentenceIndex2SentenceInfo[seq].sLen);
+            }
+        }
+        return sln;
     }
 
     // mToProcess[] is empty: fill it up with at most mRequestedNumParallelSequences entries of the same length
@@ -1783,9 +1928,8 @@ bool BatchSequenceReader<ElemType>::GetMinibatchData(size_t& /*out*/ firstPosInS
     {
         Reset();
 
-        std::vector<SequencePosition> seqPos;
         fprintf(stderr, "LMSequenceReader: Reading epoch data..."), fflush(stderr);
-        mNumRead = m_parser.Parse(m_cacheBlockSize, &m_labelTemp, &m_featureTemp, &seqPos);
+        mNumRead = ReadCacheBlock();
         fprintf(stderr, " %d sequences read.\n", (int) mNumRead);
         firstPosInSentence = mLastPosInSentence;
         if (mNumRead == 0)
@@ -1804,6 +1948,8 @@ bool BatchSequenceReader<ElemType>::GetMinibatchData(size_t& /*out*/ firstPosInS
             std::mt19937 g(++m_randomSeed); // random seed is initialized to epoch, but gets incremented for intermediate reshuffles
             std::shuffle(m_parser.mSentenceIndex2SentenceInfo.begin(), m_parser.mSentenceIndex2SentenceInfo.end(), g);
         }
+        if (m_bucketByLength)
+            BucketSequencesByLength();
 
         m_readNextSampleLine += mNumRead;
         sLn = DetermineSequencesToProcess();
@@ -1828,16 +1974,19 @@ bool BatchSequenceReader<ElemType>::GetMinibatchData(size_t& /*out*/ firstPosInS
         for (int k = 0; k < mToProcess.size(); k++)
         {
             size_t seq = mToProcess[k];
-            size_t pos = m_parser.mSentenceIndex2SentenceInfo[seq].sBegin + i;
+            const auto& sentence = m_parser.mSentenceIndex2SentenceInfo[seq];
 
-            // labelIn should be a category label
-            const auto& labelValue = m_labelTemp[pos];
-            pos++; // consume it
+            // with length bucketing, shorter sentences are padded by repeating their last token; the MBLayout marks these as gaps
+            // (seqEnd > 0, sentences without a sample are not bucketed, see DetermineSequencesToProcess())
+            const size_t seqEnd = sentence.sLen - (labelOut.type != labelNone);
+            const bool isGap = (i >= seqEnd);
+            size_t pos = sentence.sBegin + (isGap ? seqEnd - 1 : i);
 
             // generate the feature token
+            // labelIn should be a category label
             if (labelIn.type == labelCategory)
             {
-                LabelIdType labelId = GetIdFromLabel(labelValue, labelIn);
+                LabelIdType labelId = m_useWordIdCorpus ? m_wordIdTemp[pos] : GetIdFromLabel(m_labelTemp[pos], labelIn);
 
                 // use the found value, and set the appropriate location to a 1.0
                 assert(labelIn.dim > labelId); // if this goes off labelOut dimension is too small
@@ -1845,20 +1994,24 @@ bool BatchSequenceReader<ElemType>::GetMinibatchData(size_t& /*out*/ firstPosInS
             }
             else
                 RuntimeError("Input labels are expected to be category labels.");
+            pos++; // consume it
 
             // generate the output label token
             if (labelOut.type != labelNone)
             {
-                const auto& labelValue = m_labelTemp[pos];
                 LabelIdType labelId;
-                if (labelOut.type == labelCategory)
+                if (m_useWordIdCorpus) // (only nextWord, see InitFromConfig())
+                    labelId = m_wordIdTemp[pos];
+                else if (labelOut.type == labelCategory)
                 {
+                    const auto& labelValue = m_labelTemp[pos];
                     pos++; // consume it   --TODO: value is not used after this
                     labelId = GetIdFromLabel(labelValue, labelOut);
                 }
                 else if (nextWord)
                 {
-                    // this is the next word (pos was already incremented above when reading out labelValue)
+                    // this is the next word (pos was already incremented above when reading out the input label)
+                    const auto& labelValue = m_labelTemp[pos];
                     if (EqualCI(labelValue, labelIn.endSequence)) // end symbol may differ between input and output
                         labelId = GetIdFromLabel(labelIn.endSequence, labelIn);
                     else
@@ -1870,8 +2023,11 @@ bool BatchSequenceReader<ElemType>::GetMinibatchData(size_t& /*out*/ firstPosInS
                 m_labelIdData.push_back(labelId);
             }
 
-            m_totalSamples++;
-            m_epochSamplesReturned++;
+            if (!isGap)
+            {
+                m_totalSamples++;
+                m_epochSamplesReturned++;
+            }
         }
     }
     //mLastPosInSentence = i; // (we could also iterate over mLastPosInSentence directly)
@@ -1888,6 +2044,7 @@ bool BatchSequenceReader<ElemType>::GetMinibatchData(size_t& /*out*/ firstPosInS
 //  - each epoch's sequences are randomly sorted
 //  - up to N sequences of the same length are returned in each MB
 //     - minibatches consist of sequences of the same length only (no gaps)
+//     - except with bucketByLength, where they are of similar length, and the shorter ones are padded with gaps
 template <class ElemType>
 bool BatchSequenceReader<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
 {
@@ -1937,6 +2094,11 @@ bool BatchSequenceReader<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices
         ptrdiff_t end = (ptrdiff_t) len - (ptrdiff_t) firstPosInSentence;
         if (begin >= (ptrdiff_t) nT)
             LogicError("BatchSequenceReader: Sentence begin outside minibatch?");
+        if (end <= 0 && m_bucketByLength) // a shorter sentence of the bucket already ended in a previous (truncated) minibatch
+        {
+            m_pMBLayout->AddGap(s, 0, nT);
+            continue;
+        }
         if (end < 0)
             LogicError("BatchSequenceReader: Sentence end outside minibatch?");
         m_pMBLayout->AddSequence(NEW_SEQUENCE_ID, s, begin, (size_t) end);
@@ -2108,6 +2270,13 @@ void BatchSequenceReader<ElemType>::GetLabelOutput(StreamMinibatchInputs& matric
 
     ElemType epsilon = (ElemType) 1e-6; // avoid all zero, although this is almost impossible.
 
+    vector<int> sharedNoiseSamples;
+    if (readerMode == ReaderMode::NCE && m_sharedNoiseSamples)
+    {
+        for (size_t noiseid = 0; noiseid < m_noiseSampleSize; noiseid++)
+            sharedNoiseSamples.push_back(m_noiseSampler.sample());
+    }
+
     for (size_t jSample = mbStartSample; j < actualmbsize; ++j, ++jSample)
     {
         // get the token
@@ -2122,7 +2291,7 @@ void BatchSequenceReader<ElemType>::GetLabelOutput(StreamMinibatchInputs& matric
             labels.SetValue(1, j, (ElemType) m_noiseSampler.logprob(wrd));
             for (size_t noiseid = 0; noiseid < m_noiseSampleSize; noiseid++)
             {
-                int wid = m_noiseSampler.sample();
+                int wid = m_sharedNoiseSamples ? sharedNoiseSamples[noiseid] : m_noiseSampler.sample();
                 labels.SetValue(2 * (noiseid + 1), j, (ElemType) wid);
                 labels.SetValue(2 * (noiseid + 1) + 1, j, -(ElemType) m_noiseSampler.logprob(wid));
             }
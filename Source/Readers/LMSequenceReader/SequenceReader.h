@@ -131,6 +131,7 @@ public:
     map<int, vector<int>> class_words;
 
     int m_noiseSampleSize;
+    bool m_sharedNoiseSamples; // draw one set of noise samples per minibatch instead of per word (NCE mode)
     noiseSampler<long> m_noiseSampler;
 
     ReaderMode readerMode;
@@ -264,6 +265,7 @@ public:
         m_cachingReader = NULL;
         m_cachingWriter = NULL;
         m_labelsIdBuffer = NULL;
+        m_sharedNoiseSamples = false;
         readerMode = ReaderMode::Class;
         /*
         delete m_featuresBufferRow;
@@ -346,6 +348,7 @@ public:
     using Base::idx4class;
     using Base::m_indexer;
     using Base::m_noiseSampleSize;
+    using Base::m_sharedNoiseSamples;
     using Base::m_noiseSampler;
     using Base::readerMode;
     using Base::GetIdFromLabel;
@@ -371,6 +374,15 @@ private:
     std::vector<ElemType> m_featureTemp;
     std::vector<LabelType> m_labelTemp;
 
+    // precompiled word-ID corpus (config "wordIdCorpus"); if used, m_wordIdTemp[] replaces m_labelTemp[]
+    bool m_useWordIdCorpus;
+    LMWordIdCorpus m_wordIdCorpus;
+    std::vector<LabelIdType> m_wordIdTemp;
+
+    // length bucketing (config "bucketByLength"): minibatches of sentences of similar rather than identical length
+    bool m_bucketByLength;
+    std::vector<size_t> mBucketEnd; // [mNumRead] for the first sentence of each bucket, the end of the bucket
+
     bool mSentenceEnd;
     //bool mSentenceBegin;
 
@@ -386,6 +398,8 @@ public:
         mLastPosInSentence = 0;
         mNumRead = 0;
         mSentenceEnd = false;
+        m_useWordIdCorpus = false;
+        m_bucketByLength = false;
     }
 
     template <class ConfigRecordType>
@@ -400,6 +414,9 @@ public:
     }
 private:
     void Reset();
+    void CompileWordIdCorpus(const std::wstring& corpusPath, const LMWordIdCorpus::Source& source);
+    size_t ReadCacheBlock();
+    void BucketSequencesByLength();
     size_t DetermineSequencesToProcess();
     bool GetMinibatchData(size_t& firstPosInSentence);
     void GetLabelOutput(StreamMinibatchInputs& matrices, size_t m_mbStartSample, size_t actualmbsize);
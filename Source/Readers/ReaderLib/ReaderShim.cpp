@@ -15,6 +15,7 @@
 #define DATAREADER_EXPORTS // creating the exports here
 #include "DataReader.h"
 #include "ReaderShim.h"
+#include "CPUMatrix.h" // for BindToMasterNumaNode()
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -78,6 +79,8 @@ void ReaderShim<ElemType>::StartDistributedMinibatchLoop(
 
     m_prefetchTask = std::async(m_launchType, [this]()
     {
+        // place the chunk and minibatch buffers on the node of the consuming (master) thread
+        CPUMatrix<ElemType>::BindToMasterNumaNode();
         return m_reader->ReadMinibatch();
     });
 }
@@ -135,6 +138,8 @@ bool ReaderShim<ElemType>::GetMinibatch(StreamMinibatchInputs& matrices)
 
     m_prefetchTask = std::async(m_launchType, [this]()
     {
+        // place the chunk and minibatch buffers on the node of the consuming (master) thread
+        CPUMatrix<ElemType>::BindToMasterNumaNode();
         return m_reader->ReadMinibatch();
     });
 
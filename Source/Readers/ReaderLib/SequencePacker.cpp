@@ -0,0 +1,228 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+#define _SCL_SECURE_NO_WARNINGS
+
+#include "SequencePacker.h"
+#include "ElementTypeUtils.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+SequencePacker::SequencePacker(
+    MemoryProviderPtr memoryProvider,
+    TransformerPtr transformer,
+    size_t minibatchSize,
+    const std::vector<StreamDescriptionPtr>& streams) : m_transformer(transformer),
+                                                        m_minibatchSize(minibatchSize),
+                                                        m_outputStreams(streams),
+                                                        m_minibatchLayout(std::make_shared<MBLayout>()),
+                                                        m_memoryProvider(memoryProvider),
+                                                        m_numSamplesPacked(0),
+                                                        m_numFramesPacked(0)
+{
+    m_inputStreams = m_transformer->GetStreamDescriptions();
+    assert(m_inputStreams.size() == m_outputStreams.size());
+    assert(
+        std::find_if(
+            m_outputStreams.begin(),
+            m_outputStreams.end(),
+            [](const StreamDescriptionPtr& s)
+            {
+                return s->m_storageType == StorageType::sparse_csc;
+            }) == m_outputStreams.end());
+
+    assert(m_minibatchSize > 0);
+    for (int i = 0; i < m_outputStreams.size(); ++i)
+    {
+        const auto& stream = m_outputStreams[i];
+        // Input and output should match in everything except for sparse/dense.
+        assert(stream->m_elementType == ElementType::tfloat || stream->m_elementType == ElementType::tdouble);
+        assert(stream->m_name == m_inputStreams[i]->m_name);
+        assert(stream->m_id == m_inputStreams[i]->m_id);
+        assert(GetSampleSize(m_inputStreams[i]) == GetSampleSize(stream));
+
+        // Initially sized for a minibatch without gaps, grown on demand.
+        m_streamBuffers.push_back(
+            AllocateBuffer(m_minibatchSize * stream->m_sampleLayout->GetNumElements(), GetSizeByType(stream->m_elementType)));
+        m_streamBufferSizes.push_back(m_minibatchSize);
+    }
+}
+
+Minibatch SequencePacker::ReadMinibatch()
+{
+    auto sequences = m_transformer->GetNextSequences(m_minibatchSize);
+
+    Minibatch minibatch(sequences.m_endOfEpoch);
+    if (sequences.m_data.empty() || sequences.m_data.front().empty())
+    {
+        return minibatch;
+    }
+
+    assert(m_streamBuffers.size() == sequences.m_data.size());
+
+    // Determine the sequence lengths, which have to agree across all streams.
+    const auto& primarySequences = sequences.m_data.front();
+    const size_t numSequences = primarySequences.size();
+    std::vector<size_t> lengths(numSequences);
+    size_t numSamples = 0;
+    for (size_t sequenceIndex = 0; sequenceIndex < numSequences; ++sequenceIndex)
+    {
+        size_t length = GetNumberOfSamples(primarySequences[sequenceIndex], 0);
+        if (length == 0)
+        {
+            RuntimeError("SequencePacker: Empty sequences are not supported.");
+        }
+
+        for (size_t streamIndex = 1; streamIndex < sequences.m_data.size(); ++streamIndex)
+        {
+            size_t streamLength = GetNumberOfSamples(sequences.m_data[streamIndex][sequenceIndex], streamIndex);
+            if (streamLength != length)
+            {
+                RuntimeError("SequencePacker: Sequence has %d samples in stream '%ls' but %d samples in stream '%ls'.",
+                             (int)length, m_inputStreams[0]->m_name.c_str(), (int)streamLength, m_inputStreams[streamIndex]->m_name.c_str());
+            }
+        }
+
+        lengths[sequenceIndex] = length;
+        numSamples += length;
+    }
+
+    // Bin-pack first-fit by decreasing length: MBLayout::InitAsPackedSequences() places the sequences first-fit
+    // in the order given, into rows as long as the longest sequence.
+    std::vector<size_t> order(numSequences);
+    for (size_t i = 0; i < numSequences; ++i)
+    {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&lengths](size_t a, size_t b) { return lengths[a] > lengths[b]; });
+
+    m_sequenceInfos.resize(numSequences);
+    for (size_t i = 0; i < numSequences; ++i)
+    {
+        m_sequenceInfos[i] = MBLayout::SequenceInfo{ NEW_SEQUENCE_ID, SIZE_MAX, 0, lengths[order[i]] };
+    }
+    m_minibatchLayout->InitAsPackedSequences(m_sequenceInfos, m_placement, m_rowAllocations);
+
+    const size_t numFrames = m_minibatchLayout->GetNumCols();
+    m_numSamplesPacked += numSamples;
+    m_numFramesPacked += numFrames;
+
+    // For each stream copy the sequences to their place in the buffer, with gap frames zeroed.
+    for (size_t streamIndex = 0; streamIndex < sequences.m_data.size(); ++streamIndex)
+    {
+        const auto& stream = m_outputStreams[streamIndex];
+        if (m_streamBufferSizes[streamIndex] < numFrames)
+        {
+            m_streamBuffers[streamIndex] = AllocateBuffer(numFrames * stream->m_sampleLayout->GetNumElements(), GetSizeByType(stream->m_elementType));
+            m_streamBufferSizes[streamIndex] = numFrames;
+        }
+
+        if (numFrames > numSamples)
+        {
+            auto buffer = m_streamBuffers[streamIndex].get();
+            std::fill(buffer, buffer + numFrames * GetSampleSize(stream), 0);
+        }
+
+        const auto& streamSequences = sequences.m_data[streamIndex];
+        for (size_t i = 0; i < numSequences; ++i)
+        {
+            size_t parallelSequence, timeBegin;
+            std::tie(parallelSequence, timeBegin) = m_placement[i];
+            CopySequenceToBuffer(streamSequences[order[i]], streamIndex, parallelSequence, timeBegin);
+        }
+    }
+
+    // Creating output minibatch with shared layout between all streams.
+    for (int i = 0; i < m_outputStreams.size(); ++i)
+    {
+        auto stream = std::make_shared<StreamMinibatch>();
+        stream->m_data = m_streamBuffers[i].get();
+        stream->m_dataSize = numFrames * GetSampleSize(m_outputStreams[i]);
+        stream->m_layout = m_minibatchLayout;
+
+        minibatch.m_data.push_back(stream);
+    }
+
+    return minibatch;
+}
+
+size_t SequencePacker::GetSampleSize(StreamDescriptionPtr stream)
+{
+    assert(stream != nullptr);
+    size_t elementSize = GetSizeByType(stream->m_elementType);
+    return stream->m_sampleLayout->GetNumElements() * elementSize;
+}
+
+size_t SequencePacker::GetNumberOfSamples(const SequenceDataPtr& sequence, size_t streamIndex)
+{
+    if (m_inputStreams[streamIndex]->m_storageType == StorageType::dense)
+    {
+        return reinterpret_cast<DenseSequenceData&>(*sequence).m_numberOfSamples;
+    }
+    else if (m_inputStreams[streamIndex]->m_storageType == StorageType::sparse_csc)
+    {
+        return reinterpret_cast<SparseSequenceData&>(*sequence).m_indices.size();
+    }
+
+    RuntimeError("Storage type %d is not supported.", (int)m_inputStreams[streamIndex]->m_storageType);
+}
+
+// Copies the samples of a sequence to the frames (timeBegin + t) * numParallelSequences + parallelSequence of the stream buffer.
+void SequencePacker::CopySequenceToBuffer(SequenceDataPtr sequence, size_t streamIndex, size_t parallelSequence, size_t timeBegin)
+{
+    size_t sampleSize = GetSampleSize(m_inputStreams[streamIndex]);
+    auto sequenceData = reinterpret_cast<const char*>(sequence->m_data);
+
+    const auto& stream = m_inputStreams[streamIndex];
+    auto elementSize = GetSizeByType(stream->m_elementType);
+    auto buffer = m_streamBuffers[streamIndex].get();
+    const size_t numParallelSequences = m_minibatchLayout->GetNumParallelSequences();
+
+    if (stream->m_storageType == StorageType::dense)
+    {
+        const auto& data = reinterpret_cast<DenseSequenceData&>(*sequence);
+        for (size_t t = 0; t < data.m_numberOfSamples; ++t)
+        {
+            char* destination = buffer + ((timeBegin + t) * numParallelSequences + parallelSequence) * sampleSize;
+            std::copy(sequenceData + t * sampleSize, sequenceData + (t + 1) * sampleSize, destination);
+        }
+    }
+    else if (stream->m_storageType == StorageType::sparse_csc)
+    {
+        const auto& data = reinterpret_cast<SparseSequenceData&>(*sequence);
+
+        // Currently sparse data has to be unpacked to the dense one. Possibly can be done later
+        // in the network or as a transformation.
+        // The non-zero values of all samples are stored contiguously, in sample order.
+        size_t nonZeroOffset = 0;
+        for (size_t t = 0; t < data.m_indices.size(); ++t)
+        {
+            char* destination = buffer + ((timeBegin + t) * numParallelSequences + parallelSequence) * sampleSize;
+            std::fill(destination, destination + sampleSize, 0);
+
+            const auto& indices = data.m_indices[t];
+            for (size_t nonZeroIndex = 0; nonZeroIndex < indices.size(); ++nonZeroIndex, ++nonZeroOffset)
+            {
+                std::copy(sequenceData + nonZeroOffset * elementSize, sequenceData + (nonZeroOffset + 1) * elementSize, destination + indices[nonZeroIndex] * elementSize);
+            }
+        }
+    }
+    else
+    {
+        RuntimeError("Storage type %d is not supported.", (int)m_inputStreams[streamIndex]->m_storageType);
+    }
+}
+
+std::shared_ptr<char> SequencePacker::AllocateBuffer(size_t numElements, size_t elementSize)
+{
+    return std::shared_ptr<char>(
+        reinterpret_cast<char*>(m_memoryProvider->Alloc(elementSize, numElements)),
+        [this](char* p)
+        {
+            m_memoryProvider->Free(p);
+        });
+}
+} } }
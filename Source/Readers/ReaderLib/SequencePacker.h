@@ -0,0 +1,62 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+
+#pragma once
+
+#include "Reader.h"
+#include "MemoryProvider.h"
+#include "Transformer.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// A packer for sequence mode: packs variable-length sequences end-to-end into the parallel sequences of the minibatch.
+// The number of time steps is the length of the longest sequence; shorter sequences are bin-packed into the
+// parallel sequences first-fit by decreasing length, and the remaining frames are gaps in the MBLayout.
+// All streams of a sequence must have the same number of samples.
+class SequencePacker
+{
+public:
+    SequencePacker(
+        MemoryProviderPtr memoryProvider,
+        TransformerPtr transformer,
+        size_t minibatchSize,
+        const std::vector<StreamDescriptionPtr>& streams);
+
+    Minibatch ReadMinibatch();
+
+    // Fraction of the frames of all minibatches packed so far that hold data rather than gaps.
+    double GetPaddingEfficiency() const
+    {
+        return m_numFramesPacked > 0 ? (double) m_numSamplesPacked / m_numFramesPacked : 1.0;
+    }
+
+private:
+    std::shared_ptr<char> AllocateBuffer(size_t numElements, size_t elementSize);
+    size_t GetSampleSize(StreamDescriptionPtr stream);
+    size_t GetNumberOfSamples(const SequenceDataPtr& sequence, size_t streamIndex);
+    void CopySequenceToBuffer(SequenceDataPtr sequence, size_t streamIndex, size_t parallelSequence, size_t timeBegin);
+
+    MemoryProviderPtr m_memoryProvider;
+    TransformerPtr m_transformer;
+    std::vector<StreamDescriptionPtr> m_outputStreams;
+    std::vector<StreamDescriptionPtr> m_inputStreams;
+    std::vector<std::shared_ptr<char>> m_streamBuffers;
+    std::vector<size_t> m_streamBufferSizes; // [stream] buffer capacity in samples; grows when a minibatch needs more frames than that
+
+    MBLayoutPtr m_minibatchLayout;
+    size_t m_minibatchSize;
+
+    // temp buffers for MBLayout::InitAsPackedSequences()
+    std::vector<MBLayout::SequenceInfo> m_sequenceInfos;
+    std::vector<std::pair<size_t, size_t>> m_placement;
+    std::vector<size_t> m_rowAllocations;
+
+    // statistics for GetPaddingEfficiency()
+    size_t m_numSamplesPacked;
+    size_t m_numFramesPacked;
+};
+
+typedef std::shared_ptr<SequencePacker> SequencePackerPtr;
+} } }
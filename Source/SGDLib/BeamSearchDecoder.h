@@ -0,0 +1,462 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// BeamSearchDecoder.h -- batched beam-search decoding over a recurrent network
+//
+#pragma once
+
+#include "Basics.h"
+#include "DataReader.h"
+#include "ComputationNetwork.h"
+#include "DataReaderHelpers.h"
+#include "RecurrentNodes.h"
+#include "NonlinearityNodes.h"
+#include "File.h"
+#include "fileutil.h"
+#include "ProgressTracing.h"
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// BeamSearchDecoder -- continue a batch of prompts by beam search
+//
+// The network predicts the next token at its output node from the current token, which is fed one-hot
+// into its token input node; the history is carried by PastValue nodes. This covers RNN language models
+// as well as sequence-to-sequence models trained as a single recurrence over the source sequence, a
+// separator, and the target sequence.
+//
+// Each prompt is first run through the network as one sequence of a regular minibatch; the output at its
+// last frame predicts the first decoded token. From then on, the surviving hypotheses of all prompts advance
+// together, one token per step, as the parallel sequences of a single-frame minibatch, so that every step is
+// one batched forward pass. Pruning takes the top 'beamWidth' tokens of each hypothesis with VectorMax(), and
+// the PastValue state is then gathered to follow the hypotheses that survived. Any other inputs of the network
+// are held at their value at the last frame of the respective prompt.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class BeamSearchDecoder
+{
+    typedef shared_ptr<ComputationNode<ElemType>> ComputationNodePtr;
+
+public:
+    struct Hypothesis
+    {
+        std::vector<size_t> tokens; // decoded tokens, excluding the prompt and the end symbol
+        double logProbability;      // log probability of 'tokens' (followed by the end symbol, unless cut at maxLength) given the prompt
+    };
+
+    BeamSearchDecoder(ComputationNetworkPtr net, const std::wstring& tokenInputNodeName, const std::wstring& outputNodeName,
+                      size_t beamWidth, size_t maxLength, size_t endSymbol, size_t numBest = 1, int verbosity = 0)
+        : m_net(net),
+          m_beamWidth(beamWidth),
+          m_maxLength(maxLength),
+          m_endSymbol(endSymbol),
+          m_numBest(numBest),
+          m_verbosity(verbosity),
+          m_columnMap(net->GetDeviceId()),
+          m_scores(net->GetDeviceId()),
+          m_topKIndexes(net->GetDeviceId()),
+          m_topKValues(net->GetDeviceId())
+    {
+        if (m_beamWidth == 0 || m_maxLength == 0)
+            InvalidArgument("BeamSearchDecoder: beamWidth and maxLength must be at least 1.");
+        if (m_numBest == 0 || m_numBest > m_beamWidth)
+            InvalidArgument("BeamSearchDecoder: numBest must be between 1 and beamWidth.");
+
+        m_tokenInputNode = dynamic_pointer_cast<ComputationNode<ElemType>>(net->GetNodeFromName(tokenInputNodeName));
+        m_outputNode = net->GetNodeFromName(outputNodeName);
+
+        const auto& inputNodes = net->InputNodes(m_outputNode);
+        m_inputNodes.assign(inputNodes.begin(), inputNodes.end());
+        if (find(m_inputNodes.begin(), m_inputNodes.end(), m_tokenInputNode) == m_inputNodes.end())
+            InvalidArgument("BeamSearchDecoder: The output node %ls does not depend on the token input node %ls.", outputNodeName.c_str(), tokenInputNodeName.c_str());
+        for (const auto& node : m_inputNodes)
+        {
+            if (node == m_tokenInputNode)
+                continue;
+            m_contextNodes.push_back(dynamic_pointer_cast<ComputationNode<ElemType>>(node));
+            m_contextValues.push_back(make_shared<Matrix<ElemType>>(net->GetDeviceId()));
+        }
+
+        // stepping the network one frame at a time requires all recurrence to look into the past
+        for (const auto& node : net->GetEvalOrder(m_outputNode))
+        {
+            auto pastValueNode = dynamic_pointer_cast<PastValueNode<ElemType>>(node);
+            if (pastValueNode)
+                m_pastValueNodes.push_back(pastValueNode);
+            else if (dynamic_pointer_cast<IStatefulNode>(node))
+                InvalidArgument("BeamSearchDecoder: %ls %ls operation is not supported, since decoding can only carry state from the past.",
+                                node->NodeName().c_str(), node->OperationName().c_str());
+        }
+
+        // how to turn the output into log probabilities
+        if (m_outputNode->OperationName() == OperationNameOf(SoftmaxNode))
+            m_outputKind = OutputKind::probability;
+        else if (m_outputNode->OperationName() == OperationNameOf(LogSoftmaxNode))
+            m_outputKind = OutputKind::logProbability;
+        else
+            m_outputKind = OutputKind::unnormalized;
+
+        m_net->AllocateAllMatrices({}, {m_outputNode}, nullptr);
+        m_net->StartEvaluateMinibatchLoop(m_outputNode);
+    }
+
+    // SetPrompts - load prompts given as token ids into the network as one minibatch, one parallel sequence per prompt
+    // This requires the token input to be the only input the output node depends on.
+    void SetPrompts(const std::vector<std::vector<size_t>>& prompts)
+    {
+        if (!m_contextNodes.empty())
+            InvalidArgument("BeamSearchDecoder: Prompts given as token ids require %ls to be the only input of %ls.", m_tokenInputNode->NodeName().c_str(), m_outputNode->NodeName().c_str());
+
+        size_t numPrompts = prompts.size();
+        size_t numTimeSteps = 0;
+        for (const auto& prompt : prompts)
+        {
+            if (prompt.empty())
+                InvalidArgument("BeamSearchDecoder: Prompts must not be empty.");
+            numTimeSteps = max(numTimeSteps, prompt.size());
+        }
+
+        auto pMBLayout = m_net->GetMBLayoutPtr();
+        pMBLayout->Init(numPrompts, numTimeSteps);
+        std::vector<size_t> tokens(numPrompts * numTimeSteps, SIZE_MAX); // SIZE_MAX denotes a gap
+        for (size_t p = 0; p < numPrompts; p++)
+        {
+            pMBLayout->AddSequence(NEW_SEQUENCE_ID, p, 0, prompts[p].size());
+            pMBLayout->AddGap(p, prompts[p].size(), numTimeSteps);
+            for (size_t t = 0; t < prompts[p].size(); t++)
+                tokens[t * numPrompts + p] = prompts[p][t];
+        }
+        SetTokenInput(tokens);
+        m_tokenInputNode->NotifyFunctionValuesMBSizeModified();
+    }
+
+    // Decode - beam search for all prompts of the minibatch that has been loaded into the network (input values and MBLayout)
+    // Each sequence of the MBLayout is one prompt and must lie entirely within the minibatch.
+    // results[i] receives the up to 'numBest' best hypotheses of the i-th sequence of the MBLayout, best first.
+    void Decode(std::vector<std::vector<Hypothesis>>& results)
+    {
+        ScopedNetworkOperationMode modeGuard(m_net, NetworkOperationMode::inferring);
+
+        auto pMBLayout = m_net->GetMBLayoutPtr();
+        size_t numParallelSequences = pMBLayout->GetNumParallelSequences();
+        size_t numTimeSteps = pMBLayout->GetNumTimeSteps();
+
+        // run the prompts; the output at the last frame of each prompt predicts its first token
+        ComputationNetwork::BumpEvalTimeStamp(m_inputNodes);
+        m_net->ForwardProp(m_outputNode);
+
+        std::vector<ActiveHypothesis> active; // active hypotheses, grouped by prompt
+        std::vector<size_t> columns;          // for each active hypothesis: column of the last minibatch that holds its prediction and state
+        std::vector<size_t> promptLengths;
+        for (const auto& seq : pMBLayout->GetAllSequences())
+        {
+            if (seq.seqId == GAP_SEQUENCE_ID)
+                continue;
+            if (seq.tBegin < 0 || seq.tEnd > numTimeSteps)
+                RuntimeError("BeamSearchDecoder: Prompts must lie entirely within one minibatch (e.g. disable truncation in the reader).");
+            active.push_back(ActiveHypothesis{promptLengths.size(), std::vector<size_t>(), 0.0});
+            columns.push_back((seq.tEnd - 1) * numParallelSequences + seq.s);
+            promptLengths.push_back(seq.GetNumTimeSteps());
+        }
+        results.assign(promptLengths.size(), std::vector<Hypothesis>());
+
+        // keep the other inputs at the last frame of each prompt, one column per prompt
+        SetColumnMap(columns);
+        for (size_t i = 0; i < m_contextNodes.size(); i++)
+        {
+            if (m_contextNodes[i]->Value().GetMatrixType() != MatrixType::DENSE)
+                InvalidArgument("BeamSearchDecoder: Input %ls must be dense.", m_contextNodes[i]->NodeName().c_str());
+            m_contextValues[i]->DoGatherColumnsOf(0, m_columnMap, m_contextNodes[i]->Value(), 1);
+        }
+
+        std::vector<size_t> topKTokens;
+        std::vector<double> topKLogProbabilities;
+        std::vector<Candidate> candidates;
+        for (size_t step = 0; !active.empty(); step++)
+        {
+            size_t topK = ScoreTopK(columns, topKTokens, topKLogProbabilities);
+
+            // for each prompt, expand its hypotheses by their top tokens and keep the best 'beamWidth' expansions;
+            // those that end (or reach maxLength) are moved to the results
+            std::vector<ActiveHypothesis> next;
+            std::vector<size_t> parentColumns;
+            for (size_t begin = 0, end; begin < active.size(); begin = end)
+            {
+                size_t prompt = active[begin].prompt;
+                for (end = begin; end < active.size() && active[end].prompt == prompt; end++)
+                    ;
+
+                candidates.clear();
+                for (size_t h = begin; h < end; h++)
+                    for (size_t k = 0; k < topK; k++)
+                        candidates.push_back(Candidate{active[h].logProbability + topKLogProbabilities[h * topK + k], h, topKTokens[h * topK + k]});
+                size_t numSurvivors = min(m_beamWidth, candidates.size());
+                partial_sort(candidates.begin(), candidates.begin() + numSurvivors, candidates.end(),
+                             [](const Candidate& a, const Candidate& b) { return a.logProbability > b.logProbability; });
+
+                auto& finished = results[prompt];
+                for (size_t c = 0; c < numSurvivors; c++)
+                {
+                    const auto& candidate = candidates[c];
+                    const auto& parent = active[candidate.parent];
+                    if (candidate.token == m_endSymbol)
+                        finished.push_back(Hypothesis{parent.tokens, candidate.logProbability});
+                    else
+                    {
+                        ActiveHypothesis hypothesis{prompt, parent.tokens, candidate.logProbability};
+                        hypothesis.tokens.push_back(candidate.token);
+                        if (hypothesis.tokens.size() >= m_maxLength)
+                            finished.push_back(Hypothesis{move(hypothesis.tokens), hypothesis.logProbability});
+                        else
+                        {
+                            next.push_back(move(hypothesis));
+                            parentColumns.push_back(columns[candidate.parent]);
+                        }
+                    }
+                }
+
+                // log probabilities only decrease as hypotheses grow, so once 'numBest' hypotheses have finished,
+                // active ones that do not score better than the worst of them can be dropped
+                if (finished.size() >= m_numBest)
+                {
+                    nth_element(finished.begin(), finished.begin() + (m_numBest - 1), finished.end(), BetterHypothesis);
+                    double threshold = finished[m_numBest - 1].logProbability;
+                    while (!next.empty() && next.back().prompt == prompt && next.back().logProbability <= threshold)
+                    {
+                        next.pop_back();
+                        parentColumns.pop_back();
+                    }
+                }
+            }
+            active.swap(next);
+            if (active.empty())
+                break;
+
+            // advance all surviving hypotheses by one frame: gather the state of their parents, and feed their last tokens
+            size_t numHypotheses = active.size();
+            SetColumnMap(parentColumns);
+            for (auto& pastValueNode : m_pastValueNodes)
+                pastValueNode->GatherDelayedValue(m_columnMap);
+
+            std::vector<size_t> prompts(numHypotheses), tokens(numHypotheses);
+            for (size_t h = 0; h < numHypotheses; h++)
+            {
+                prompts[h] = active[h].prompt;
+                tokens[h] = active[h].tokens.back();
+            }
+            pMBLayout->Init(numHypotheses, 1);
+            for (size_t h = 0; h < numHypotheses; h++)
+                pMBLayout->AddSequence(NEW_SEQUENCE_ID, h, -(ptrdiff_t) (promptLengths[prompts[h]] + step), 2); // continues the prompt and its decoded tokens
+
+            SetTokenInput(tokens);
+            SetColumnMap(prompts);
+            for (size_t i = 0; i < m_contextNodes.size(); i++)
+                m_contextNodes[i]->Value().DoGatherColumnsOf(0, m_columnMap, *m_contextValues[i], 1);
+            for (auto& node : m_inputNodes)
+                node->NotifyFunctionValuesMBSizeModified();
+
+            ComputationNetwork::BumpEvalTimeStamp(m_inputNodes);
+            m_net->ForwardProp(m_outputNode);
+
+            columns.resize(numHypotheses);
+            for (size_t h = 0; h < numHypotheses; h++)
+                columns[h] = h;
+
+            if (m_verbosity > 1)
+                fprintf(stderr, "BeamSearchDecoder: step %d: %d active hypotheses.\n", (int) step, (int) numHypotheses);
+        }
+
+        for (auto& finished : results)
+        {
+            sort(finished.begin(), finished.end(), BetterHypothesis);
+            if (finished.size() > m_numBest)
+                finished.resize(m_numBest);
+        }
+    }
+
+    // Decode - decode all prompts delivered by a reader and write the results as text, one line per hypothesis:
+    //   <prompt index> <rank> <log probability> <tokens...>
+    // The reader must deliver complete sequences (no truncation). Tokens are printed as words if a label mapping file is given.
+    void Decode(IDataReader& dataReader, size_t mbSize, const std::wstring& outputPath, const std::wstring& labelMappingFile, size_t numOutputSamples = requestDataSize)
+    {
+        StreamMinibatchInputs inputMatrices;
+        for (auto& node : m_inputNodes)
+            inputMatrices.AddInputMatrix(node->NodeName(), node->ValuePtr());
+
+        std::vector<std::string> labelMapping;
+        if (!labelMappingFile.empty())
+            File::LoadLabelFile(labelMappingFile, labelMapping);
+
+        File::MakeIntermediateDirs(outputPath);
+        File file(outputPath, fileOptionsWrite | fileOptionsText);
+        FILE* f = file;
+
+        dataReader.StartMinibatchLoop(mbSize, 0, numOutputSamples);
+
+        const size_t numIterationsBeforePrintingProgress = 100;
+        size_t numItersSinceLastPrintOfProgress = 0;
+        size_t numPrompts = 0;
+        size_t actualMBSize;
+        std::vector<std::vector<Hypothesis>> results;
+        while (DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(dataReader, m_net, nullptr, false, false, inputMatrices, actualMBSize, nullptr))
+        {
+            Decode(results);
+
+            for (const auto& nbest : results)
+            {
+                for (size_t rank = 0; rank < nbest.size(); rank++)
+                {
+                    fprintfOrDie(f, "%d\t%d\t%.6f\t", (int) numPrompts, (int) rank, nbest[rank].logProbability);
+                    for (size_t i = 0; i < nbest[rank].tokens.size(); i++)
+                    {
+                        size_t token = nbest[rank].tokens[i];
+                        if (token < labelMapping.size())
+                            fprintfOrDie(f, i == 0 ? "%s" : " %s", labelMapping[token].c_str());
+                        else
+                            fprintfOrDie(f, i == 0 ? "%d" : " %d", (int) token);
+                    }
+                    fprintfOrDie(f, "\n");
+                }
+                numPrompts++;
+            }
+
+            numItersSinceLastPrintOfProgress = ProgressTracing::TraceFakeProgress(numIterationsBeforePrintingProgress, numItersSinceLastPrintOfProgress);
+
+            // call DataEnd function in dataReader to do
+            // reader specific process if sentence ending is reached
+            dataReader.DataEnd();
+        }
+
+        file.Flush();
+        fprintf(stderr, "Written to %ls\nTotal Prompts Decoded = %d\n", outputPath.c_str(), (int) numPrompts);
+    }
+
+private:
+    struct ActiveHypothesis
+    {
+        size_t prompt;              // index of the prompt this hypothesis continues
+        std::vector<size_t> tokens; // decoded tokens so far
+        double logProbability;
+    };
+
+    struct Candidate
+    {
+        double logProbability;
+        size_t parent; // index into the active hypotheses
+        size_t token;
+    };
+
+    enum class OutputKind
+    {
+        probability,    // Softmax
+        logProbability, // LogSoftmax
+        unnormalized    // anything else is taken as unnormalized log probabilities (e.g. the input to a softmax)
+    };
+
+    static bool BetterHypothesis(const Hypothesis& a, const Hypothesis& b)
+    {
+        return a.logProbability > b.logProbability;
+    }
+
+    // load 'indices' as a row vector into m_columnMap, for use with DoGatherColumnsOf()
+    void SetColumnMap(const std::vector<size_t>& indices)
+    {
+        m_columnMapBuffer.assign(indices.begin(), indices.end());
+        m_columnMap.SetValue(1, indices.size(), m_columnMap.GetDeviceId(), m_columnMapBuffer.data(), matrixFlagNormal);
+    }
+
+    // set the token input to one one-hot column per entry of 'tokens' (SIZE_MAX leaves a column empty)
+    void SetTokenInput(const std::vector<size_t>& tokens)
+    {
+        auto& value = m_tokenInputNode->Value();
+        size_t vocabSize = m_tokenInputNode->GetSampleMatrixNumRows();
+        size_t numCols = tokens.size();
+        for (auto token : tokens)
+            if (token != SIZE_MAX && token >= vocabSize)
+                InvalidArgument("BeamSearchDecoder: Token %d is out of range for input %ls of dimension %d.", (int) token, m_tokenInputNode->NodeName().c_str(), (int) vocabSize);
+
+        if (value.GetMatrixType() == MatrixType::SPARSE)
+        {
+            std::vector<CPUSPARSE_INDEX_TYPE> colStarts(numCols + 1), rowIndices;
+            std::vector<ElemType> values;
+            for (size_t j = 0; j < numCols; j++)
+            {
+                colStarts[j] = (CPUSPARSE_INDEX_TYPE) rowIndices.size();
+                if (tokens[j] != SIZE_MAX)
+                {
+                    rowIndices.push_back((CPUSPARSE_INDEX_TYPE) tokens[j]);
+                    values.push_back(1);
+                }
+            }
+            colStarts[numCols] = (CPUSPARSE_INDEX_TYPE) rowIndices.size();
+            value.SetMatrixFromCSCFormat(colStarts.data(), rowIndices.data(), values.data(), values.size(), vocabSize, numCols);
+        }
+        else
+        {
+            m_tokenInputBuffer.assign(vocabSize * numCols, 0);
+            for (size_t j = 0; j < numCols; j++)
+                if (tokens[j] != SIZE_MAX)
+                    m_tokenInputBuffer[j * vocabSize + tokens[j]] = 1;
+            value.SetValue(vocabSize, numCols, value.GetDeviceId(), m_tokenInputBuffer.data(), matrixFlagNormal);
+        }
+    }
+
+    // get the top tokens and their log probabilities for the output columns 'columns'; returns the number of tokens per column
+    size_t ScoreTopK(const std::vector<size_t>& columns, std::vector<size_t>& topKTokens, std::vector<double>& topKLogProbabilities)
+    {
+        SetColumnMap(columns);
+        m_scores.DoGatherColumnsOf(0, m_columnMap, m_outputNode->As<ComputationNode<ElemType>>()->Value(), 1);
+        if (m_outputKind == OutputKind::unnormalized)
+            m_scores.InplaceLogSoftmax(true);
+
+        size_t topK = min(m_beamWidth, m_scores.GetNumRows());
+        m_scores.VectorMax(m_topKIndexes, m_topKValues, true, (int) topK);
+
+        size_t numValues = topK * columns.size();
+        m_topKBuffer.resize(numValues);
+        topKTokens.resize(numValues);
+        topKLogProbabilities.resize(numValues);
+        m_topKIndexes.CopySection(topK, columns.size(), m_topKBuffer.data(), topK);
+        for (size_t i = 0; i < numValues; i++)
+            topKTokens[i] = (size_t) m_topKBuffer[i];
+        m_topKValues.CopySection(topK, columns.size(), m_topKBuffer.data(), topK);
+        for (size_t i = 0; i < numValues; i++)
+            topKLogProbabilities[i] = m_outputKind == OutputKind::probability ? log((double) m_topKBuffer[i]) : (double) m_topKBuffer[i];
+        return topK;
+    }
+
+    ComputationNetworkPtr m_net;
+    size_t m_beamWidth;  // number of hypotheses kept per prompt
+    size_t m_maxLength;  // maximum number of decoded tokens
+    size_t m_endSymbol;  // token that ends a hypothesis
+    size_t m_numBest;    // number of hypotheses returned per prompt
+    int m_verbosity;
+    OutputKind m_outputKind;
+
+    ComputationNodePtr m_tokenInputNode;
+    ComputationNodeBasePtr m_outputNode;
+    std::vector<ComputationNodeBasePtr> m_inputNodes;              // all inputs the output node depends on, including the token input
+    std::vector<ComputationNodePtr> m_contextNodes;                // all other inputs
+    std::vector<shared_ptr<Matrix<ElemType>>> m_contextValues;     // value of each context input at the last frame of each prompt
+    std::vector<shared_ptr<PastValueNode<ElemType>>> m_pastValueNodes;
+
+    Matrix<ElemType> m_columnMap;
+    Matrix<ElemType> m_scores;
+    Matrix<ElemType> m_topKIndexes;
+    Matrix<ElemType> m_topKValues;
+    std::vector<ElemType> m_columnMapBuffer;
+    std::vector<ElemType> m_tokenInputBuffer;
+    std::vector<ElemType> m_topKBuffer;
+
+    void operator=(const BeamSearchDecoder&); // (not assignable)
+};
+
+}}}
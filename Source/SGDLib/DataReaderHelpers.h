@@ -10,6 +10,7 @@
 #include <string>
 #include <map>
 #include <set>
+#include <future>
 
 namespace Microsoft { namespace MSR { namespace CNTK {
 
@@ -94,6 +95,8 @@ namespace Microsoft { namespace MSR { namespace CNTK {
     // -------------------------------------------------------------------
     // non-inplace decimation , to be used in subminibatch implementation
     // returns a subset of parallel sequences
+    // Matrices already present in decimatedMB and a non-null pDecimateMBLayout are reused, so that a caller
+    // that decimates repeatedly can keep its buffers instead of allocating new ones each time.
     template <class ElemType>
     static pair<size_t, size_t> DecimateMinibatch(const StreamMinibatchInputs& MB,    // input matrices
                                                   StreamMinibatchInputs& decimatedMB, // output decimated matrices.
@@ -130,15 +133,24 @@ namespace Microsoft { namespace MSR { namespace CNTK {
             if (nT != numCols / numParallelSequences)
                 LogicError("ERROR: MBLayout borked, GetNumTimeSteps() mismatches minibatch number of columns\n");
 
-            auto matrixp = make_shared<Matrix<ElemType>>(deviceId);
+            shared_ptr<Matrix<ElemType>> matrixp;
+            if (decimatedMB.HasInput(name))
+                matrixp = dynamic_pointer_cast<Matrix<ElemType>>(decimatedMB.find(name)->second);
+            else
+            {
+                matrixp = make_shared<Matrix<ElemType>>(deviceId);
+                decimatedMB.AddInputMatrix(name, matrixp);
+            }
             matrixp->AssignRowSliceValuesOf(mat.Reshaped(numRows * numParallelSequences, nT), st * numRows, (en - st) * numRows);
             matrixp->Reshape(numRows, numNewParallelSequence * nT);
-            decimatedMB.AddInputMatrix(name, matrixp);
             // If we had a RowSlice function, we would like to write in this way
             // decimatedMB[name]->SetValue(mat.Reshaped(nRows*nSequence, nT).RowSlice( st*nRows , (en-st)*nRows).Reshaped(nRows, nNewParallelSequence*nT));
         }
         // decimate MBLayout as well
-        pDecimateMBLayout = make_shared<MBLayout>(numNewParallelSequence, nT);
+        if (pDecimateMBLayout)
+            pDecimateMBLayout->Init(numNewParallelSequence, nT);
+        else
+            pDecimateMBLayout = make_shared<MBLayout>(numNewParallelSequence, nT);
 #if 1
         // now copy over all sequence info records that are inside the range, with adjusted 's'
         const auto& sequences = pMBLayout->GetAllSequences();
@@ -180,7 +192,11 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         for (auto k : mb)
         {
             const auto& name = k.first;
-            mb.GetInputMatrix<ElemType>(name).SetValue(decimatedMB.GetInputMatrix<ElemType>(name)); // deep-copy our local one to the output location
+            auto& mat = mb.GetInputMatrix<ElemType>(name);
+            if (mat.OwnBuffer())
+                mat.SetValue(decimatedMB.GetInputMatrix<ElemType>(name)); // deep-copy our local one to the output location
+            else // a view onto the reader's data (e.g. BinaryReader with zeroCopy), which must not be written to
+                mat = std::move(decimatedMB.GetInputMatrix<ElemType>(name));
         }
         pMBLayout->MoveFrom(pDecimatedMB);
         return selected;
@@ -226,10 +242,13 @@ namespace Microsoft { namespace MSR { namespace CNTK {
     //            {
     //                sbhelper.GetSubMinibatchToNet(i);
     //                net.Evaluate(criterionNodes[0]);
+    //                net.Backprop(criterionNodes[0], /*accumulateParameterGradients=*/i > 0);
     //                sbhelper.DoneWithCurrentSubMinibatch();
     //            }
     //            UpdateWeights(...);
     //        }
+    // Each sub-minibatch is decimated into its own buffers, which are kept across minibatches. On the CPU, sub-minibatch i+1
+    // is decimated on a helper thread while sub-minibatch i is being computed. Parameter gradients accumulate in place.
 
     template <class ElemType>
     class SubminibatchDispatcher
@@ -258,10 +277,13 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         std::map<wstring, vector<shared_ptr<INodeState>>> m_netStates; // m_netStatefulNodes[node][i] caches the state of i-th subminibatch of node
         bool m_hasLattices;
 
-        Matrices m_cachedGradient;
+        // per-subminibatch buffers, allocated once and reused for every minibatch
+        std::vector<Matrices> m_subminibatchInputs;                // decimated input matrices of each subminibatch
+        std::vector<MBLayoutPtr> m_subminibatchLayouts;            // and their MBLayouts
+        std::vector<pair<size_t, size_t>> m_subminibatchSeqRanges; // range of parallel sequences of each subminibatch (for lattices)
+
         // we also need to remember where to put into the net
         MBLayoutPtr m_netMBLayoutPtr;
-        std::map<wstring, shared_ptr<ComputationNode<ElemType>>> m_LearnableNodePtr;
         // followings are lattice-related
         Matrices m_netInputMatrixPtr;
         LatticePtr m_netLatticePtr;
@@ -269,6 +291,10 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         ExtrauttMapPtr m_netExtrauttMapPtr;
         BoundariesPtr m_netBoundariesPtr;
         // we remember the pointer to the learnable Nodes so that we can accumulate the gradient once a sub-minibatch is done
+        std::map<wstring, shared_ptr<ComputationNode<ElemType>>> m_LearnableNodePtr;
+        // Block-sparse gradients (sparse input to Times or LookupTable) are not accumulated in place: the GPU dense x sparse
+        // product resets its output. They are summed up here, densely, as all gradients were before in-place accumulation.
+        Matrices m_cachedSparseGradient;
 
         size_t m_numParallelSequences; // number of paralle sequence in the cached matrix and MBLayout
         size_t m_numSubminibatches;    // how many subminibatches we are going to use ?
@@ -277,7 +303,36 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         std::vector<shared_ptr<ComputationNode<ElemType>>> m_netEvaluationNodes;
         std::map<wstring, shared_ptr<IStatefulNode>> m_netStatefulNodes; // we need to Export/Import states of stateful nodes when we swtich subminibatches
 
+        // the next subminibatch is prepared while the current one is computed (declared last, so it is destroyed, i.e. waited for, first)
+        std::launch m_launchType;           // async for CPU, deferred (run when needed, on the main thread) for GPU
+        size_t m_pendingSubminibatchIndex;  // which subminibatch m_pendingSubminibatch is preparing
+        std::future<void> m_pendingSubminibatch;
+
     private:
+        // decimate one subminibatch from the cached minibatch into its own buffers
+        void PrepareSubminibatch(size_t iSubminibatch)
+        {
+            m_subminibatchSeqRanges[iSubminibatch] = DataReaderHelpers::DecimateMinibatch<ElemType>(m_inputMatricesCache, m_subminibatchInputs[iSubminibatch],
+                                                                                                    m_MBLayoutCache, m_subminibatchLayouts[iSubminibatch],
+                                                                                                    m_numSubminibatches, iSubminibatch);
+        }
+
+        void StartPreparingSubminibatch(size_t iSubminibatch)
+        {
+            m_pendingSubminibatchIndex = iSubminibatch;
+            m_pendingSubminibatch = std::async(m_launchType, [this, iSubminibatch]()
+                                               {
+                                                   PrepareSubminibatch(iSubminibatch);
+                                               });
+        }
+
+        // wait for a pending preparation, and rethrow its exception if any
+        void WaitForPendingSubminibatch()
+        {
+            if (m_pendingSubminibatch.valid())
+                m_pendingSubminibatch.get();
+        }
+
         void EnumerateStatefulNodeWithRoot(ComputationNetwork& net, ComputationNodeBasePtr root, std::map<wstring, shared_ptr<IStatefulNode>>& statefulnode)
         {
             const std::list<ComputationNodeBasePtr> evalorder = net.GetEvalOrder(root);
@@ -312,8 +367,16 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
     public:
         SubminibatchDispatcher()
-            : m_MBLayoutCache(nullptr), m_netLatticePtr(nullptr), m_netExtrauttMapPtr(nullptr), m_netUidPtr(nullptr), m_netBoundariesPtr(nullptr)
+            : m_MBLayoutCache(nullptr), m_netLatticePtr(nullptr), m_netExtrauttMapPtr(nullptr), m_netUidPtr(nullptr), m_netBoundariesPtr(nullptr),
+              m_launchType(std::launch::deferred), m_pendingSubminibatchIndex(SIZE_MAX)
+        {
+        }
+
+        ~SubminibatchDispatcher()
         {
+            // don't let a helper thread write into buffers that are about to go away
+            if (m_pendingSubminibatch.valid())
+                m_pendingSubminibatch.wait();
         }
 
         void Init(ComputationNetworkPtr& net,
@@ -324,13 +387,11 @@ namespace Microsoft { namespace MSR { namespace CNTK {
             m_MBLayoutCache = make_shared<MBLayout>();
             m_netCriterionAccumulator = make_shared<Matrix<ElemType>>(1, 1, net->GetDeviceId());
             m_netEvaluationAccumulator = make_shared<Matrix<ElemType>>(1, evaluationNodes.size(), net->GetDeviceId());
-            // remember ptrs to learnable nodes
+            // remember ptrs to learnable nodes; only those with block-sparse gradients need an accumulator
             for (auto x : learnableNodes)
-            {
-                shared_ptr<ComputationNode<ElemType>> pLearnableNode = dynamic_pointer_cast<ComputationNode<ElemType>>(x);
-                wstring nodename = x->NodeName();
-                m_LearnableNodePtr[nodename] = pLearnableNode;
-            }
+                m_LearnableNodePtr[x->NodeName()] = dynamic_pointer_cast<ComputationNode<ElemType>>(x);
+            // helper threads would compete with the GPU for the CUDA stream, so on the GPU prepare subminibatches on the main thread
+            m_launchType = net->GetDeviceId() == CPUDEVICE ? std::launch::async : std::launch::deferred;
             for (auto& x : criterionNodes)
             {
                 m_netCriterionNodes.push_back(dynamic_pointer_cast<ComputationNode<ElemType>>(x));
@@ -376,6 +437,9 @@ namespace Microsoft { namespace MSR { namespace CNTK {
                                      StreamMinibatchInputs& inputMatrices,
                                      size_t requestedSubminibatches)
         {
+            // the cache is about to be overwritten, make sure nobody is still reading from it
+            WaitForPendingSubminibatch();
+
             // first, remember interface to the net
             m_netMBLayoutPtr = net.GetMBLayoutPtr();
             m_netInputMatrixPtr = inputMatrices;
@@ -414,25 +478,13 @@ namespace Microsoft { namespace MSR { namespace CNTK {
             // we cannot split further; instead, each subsequence become a subminibatch
             size_t actualnumSubminibatches = requestedSubminibatches > nParallelSequences ? nParallelSequences : requestedSubminibatches;
 
-            // 4. third, allocate space for accumulated gradient
-            for (auto& n : m_LearnableNodePtr)
+            // 4. per-subminibatch buffers; they keep their allocation from the previous minibatch
+            if (m_subminibatchInputs.size() < actualnumSubminibatches)
             {
-                auto node = n.second;
-                if (node->IsParameterUpdateRequired())
-                {
-                    wstring nodeName = node->GetName();
-                    shared_ptr<ComputationNode<ElemType>> pLearnableNode = node;
-                    const auto& funvalue = pLearnableNode->Value(); // gradient may not be allocated when this function is first called
-                    size_t nrow = funvalue.GetNumRows();
-                    size_t ncol = funvalue.GetNumCols();
-                    if (m_cachedGradient.find(nodeName) == m_cachedGradient.end())
-                    {
-                        // not allocated yet
-                        auto matrixp = make_shared<Matrix<ElemType>>(nrow, ncol, funvalue.GetDeviceId());
-                        matrixp->SetValue(0);
-                        m_cachedGradient.AddInputMatrix(nodeName, matrixp);
-                    }
-                }
+                m_subminibatchInputs.resize(actualnumSubminibatches);
+                m_subminibatchSeqRanges.resize(actualnumSubminibatches);
+                while (m_subminibatchLayouts.size() < actualnumSubminibatches)
+                    m_subminibatchLayouts.push_back(make_shared<MBLayout>());
             }
             // 5. for stateful node
             for (auto x : m_netStatefulNodes)
@@ -445,7 +497,12 @@ namespace Microsoft { namespace MSR { namespace CNTK {
                 }
             }
 
-            return (m_numSubminibatches = actualnumSubminibatches);
+            m_numSubminibatches = actualnumSubminibatches;
+
+            // 6. start preparing the first subminibatch
+            StartPreparingSubminibatch(0);
+
+            return m_numSubminibatches;
         }
 
         void DecimateLattices(
@@ -487,10 +544,15 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
         void GetSubMinibatchToNet(size_t iSubminibatch)
         {
-            Matrices decimatedMatrices;
-            MBLayoutPtr decimatedLayout;
-            pair<size_t, size_t> seqRange = DataReaderHelpers::DecimateMinibatch<ElemType>(m_inputMatricesCache, decimatedMatrices, m_MBLayoutCache, decimatedLayout, m_numSubminibatches, iSubminibatch);
-            //  NOTE: deimatedMatrices must be released by caller
+            // normally this subminibatch has been prepared while the previous one was computed
+            WaitForPendingSubminibatch();
+            if (m_pendingSubminibatchIndex != iSubminibatch) // (out-of-order request)
+                PrepareSubminibatch(iSubminibatch);
+            m_pendingSubminibatchIndex = SIZE_MAX;
+
+            const Matrices& decimatedMatrices = m_subminibatchInputs[iSubminibatch];
+            const MBLayoutPtr& decimatedLayout = m_subminibatchLayouts[iSubminibatch];
+            pair<size_t, size_t> seqRange = m_subminibatchSeqRanges[iSubminibatch];
 
             // base on the seqRange, we do the decimation for lattices and related variables
             if (m_hasLattices)
@@ -513,6 +575,10 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
             m_netMBLayoutPtr->CopyFrom(decimatedLayout);
 
+            // overlap preparing the next subminibatch with the forward and backward pass of this one
+            if (iSubminibatch + 1 < m_numSubminibatches)
+                StartPreparingSubminibatch(iSubminibatch + 1);
+
             for (auto& x : m_netStatefulNodes)
             {
                 const wstring& name = x.first;
@@ -525,17 +591,23 @@ namespace Microsoft { namespace MSR { namespace CNTK {
         // TODO: encapsulate it into a destructor? Note: Cannot throw exceptions in destructor.
         void DoneWithCurrentSubMinibatch(size_t iSubminibatch)
         {
-            // accumulate gradient here
-            for (auto x : m_cachedGradient)
+            // dense gradients have been accumulated in place by Backprop(); add up block-sparse ones here, and let
+            // the next subminibatch compute them afresh
+            for (auto& x : m_LearnableNodePtr)
             {
-                wstring nodename = x.first;
-                if (m_LearnableNodePtr.find(nodename) == m_LearnableNodePtr.end())
+                const wstring& nodename = x.first;
+                auto& pNode = x.second;
+                if (!pNode->IsParameterUpdateRequired() || !pNode->IsGradientInitialized() || pNode->Gradient().GetMatrixType() != SPARSE)
+                    continue;
+                if (!m_cachedSparseGradient.HasInput(nodename))
                 {
-                    RuntimeError("ERROR: in DoneWithCurrentSubMinibatch: node %ls not found in LeanrableNode", nodename.c_str());
+                    const auto& funvalue = pNode->Value();
+                    auto matrixp = make_shared<Matrix<ElemType>>(funvalue.GetNumRows(), funvalue.GetNumCols(), funvalue.GetDeviceId());
+                    matrixp->SetValue(0);
+                    m_cachedSparseGradient.AddInputMatrix(nodename, matrixp);
                 }
-                shared_ptr<ComputationNode<ElemType>> pNode = m_LearnableNodePtr[nodename];
-                m_cachedGradient.GetInputMatrix<ElemType>(nodename) += pNode->Gradient();
-                pNode->Gradient().SetValue((ElemType) 0);
+                Matrix<ElemType>::ScaleAndAdd(1, pNode->Gradient(), m_cachedSparseGradient.GetInputMatrix<ElemType>(nodename));
+                pNode->SetGradientInitialized(false);
             }
             // accumulate criterion value
             Matrix<ElemType>::AddElementToElement(m_netCriterionNodes[0]->Value(), 0, 0,
@@ -559,14 +631,14 @@ namespace Microsoft { namespace MSR { namespace CNTK {
 
         void DoneWithCurrentMinibatch()
         {
-            for (auto& x : m_cachedGradient)
+            // the dense parameter gradients already hold the sum over all subminibatches, the block-sparse ones become dense
+            for (auto& x : m_cachedSparseGradient)
             {
-                const wstring& name  = x.first;
-                auto& accumulategrad = m_cachedGradient.GetInputMatrix<ElemType>(name);
-
-                if (m_LearnableNodePtr.find(name) == m_LearnableNodePtr.end())
-                    LogicError("DoneWithCurrentSubMinibatch: Node '%ls' not found in LearnableNode set.", name.c_str());
-                m_LearnableNodePtr[name]->Gradient().SetValue(accumulategrad);
+                const wstring& name = x.first;
+                auto& accumulategrad = m_cachedSparseGradient.GetInputMatrix<ElemType>(name);
+                auto& pNode = m_LearnableNodePtr[name];
+                pNode->Gradient().SetValue(accumulategrad);
+                pNode->SetGradientInitialized(true);
                 accumulategrad.SetValue(0);
             }
             // also revert net.m_MBLayoutPtr
@@ -7,6 +7,7 @@
 #include "NonlinearityNodes.h"          // for DropoutNode
 #include "SpecialPurposeNodes.h"        // for SequenceWithSoftmaxNode
 #include "DataReaderHelpers.h"
+#include "PreComputeNodes.h"            // for PreComputedNodeBase
 #include "MatrixQuantizerImpl.h"
 #ifdef QUANTIZED_GRADIENT_AGGREGATION
 #include "AllReduceDistGradAggregator.h"
@@ -186,6 +187,18 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
     // allocate memory for forward and backward computation
     net->AllocateAllMatrices(evaluationNodes, additionalNodesToEvaluate, criterionNodes[0]);
 
+    // compute on the valid frames only of minibatches with gaps (packed variable-length sequences)
+    net->Environment().m_skipGaps = m_skipGaps;
+
+    // per-node timing and memory statistics, reported after every epoch
+    if (m_profileNodes || !m_profileTraceFile.empty())
+    {
+        wstring traceFile = m_profileTraceFile;
+        if (!traceFile.empty() && m_mpi && m_mpi->NumNodesInUse() > 1)
+            traceFile = msra::strfun::wstrprintf(L"%ls.rank%d", traceFile.c_str(), (int) m_mpi->CurrentNodeRank());
+        net->Environment().m_nodeProfiler = make_shared<NodeProfiler>(m_profileNodes, traceFile, m_profileTraceMaxEvents);
+    }
+
     // get feature and label nodes into an array of matrices that will be passed to GetMinibatch()
     // TODO: instead, remember the nodes directly, to be able to handle both float and double nodes; current version will crash for mixed networks
     StreamMinibatchInputs* inputMatrices = new StreamMinibatchInputs();
@@ -457,11 +470,15 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
                       evaluationNodes,
                       inputMatrices,
                       learnableNodes, smoothedGradients,
-                      epochCriterion, epochEvalErrors, totalSamplesSeen);
+                      epochCriterion, epochEvalErrors, totalSamplesSeen,
+                      "", /*allowMidEpochCheckPoints=*/ true);
 
         timer.Stop();
         double epochTime = timer.ElapsedSeconds();
 
+        if (net->Environment().m_nodeProfiler)
+            net->Environment().m_nodeProfiler->WriteReport(stderr, msra::strfun::strprintf("for epoch %d", (int) i + 1));
+
         net->SetBatchNormalizationNodesBelowEvalMode(true, criterionNodes[0]);
 
         if (m_useEvalCriterionControlLR && epochEvalErrors.size() > 0)
@@ -526,6 +543,8 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
 
                 // BUGBUG: We should not use the training MB size. The training MB size is constrained by both convergence and memory. Eval is only constrained by memory.
             vector<double> vScore = evalforvalidation.Evaluate(validationSetDataReader, cvSetTrainAndEvalNodes, m_mbSize[i]);
+            if (net->Environment().m_nodeProfiler)
+                net->Environment().m_nodeProfiler->WriteReport(stderr, msra::strfun::strprintf("for validation of epoch %d", (int) i + 1));
             fprintf(stderr, "Finished Epoch[%2d of %d]: [Validation Set] TrainLossPerSample = %.8g", i + 1, (int) m_maxEpochs, vScore[0]);
             if (vScore.size() > 1)
             {
@@ -661,6 +680,9 @@ void SGD<ElemType>::TrainOrAdaptModel(int startEpoch, ComputationNetworkPtr net,
             auto modelName = GetModelNameForEpoch(i);
             fprintf(stderr, "SGD: Saving checkpoint model '%ls'\n", modelName.c_str());
             net->Save(modelName);
+            // the epoch checkpoint supersedes the mid-epoch one
+            if (m_numMBsToCheckpoint > 0)
+                _wunlink(GetMidEpochCheckPointFileName(i).c_str());
             if (!m_keepCheckPointFiles)
             {
                 // delete previous checkpoint file to save space
@@ -739,7 +761,8 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                                     /*out*/ double& epochCriterion,
                                     /*out*/ std::vector<double>& epochEvalErrors,
                                     /*in/out*/ size_t& totalSamplesSeen,
-                                    std::string prefixMsg)
+                                    std::string prefixMsg,
+                                    bool allowMidEpochCheckPoints)
 {
     ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
 
@@ -801,6 +824,52 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         trainSetDataReader->StartMinibatchLoop(tunedMBSize, epochNumber, epochSize);
     }
 
+    // resume from a mid-epoch checkpoint of this epoch, if a previous run left one
+    // The readers cannot seek, so we get back to the recorded position by reading and discarding the minibatches
+    // that were already trained on. This relies on the reader's randomization being a function of the epoch.
+    // Like the epoch-end checkpoints, mid-epoch ones do not include the quantization residuals of 1-bit SGD.
+    bool checkpointMidEpoch = allowMidEpochCheckPoints && m_numMBsToCheckpoint > 0;
+    if (checkpointMidEpoch && useGradientAggregation && m_bufferedAsyncGradientAggregation)
+    {
+        // the gradient of the last minibatch is still being aggregated when we would take the snapshot, and would be lost
+        fprintf(stderr, "WARNING: Mid-epoch checkpoints are not supported with buffered asynchronous gradient aggregation, disabling them.\n");
+        checkpointMidEpoch = false;
+    }
+    if (checkpointMidEpoch)
+    {
+        size_t numMBsToSkip;
+        double checkPointCriterion;
+        std::vector<double> checkPointEvalErrors(epochEvalErrors.size());
+        if (LoadMidEpochCheckPoint(epochNumber, numMBsToSkip, totalEpochSamples, totalSamplesSeen, checkPointCriterion, checkPointEvalErrors, learnableNodes, smoothedGradients))
+        {
+            fprintf(stderr, "Resuming epoch %d from mid-epoch checkpoint after %d minibatches (%d samples); skipping them in the reader.\n",
+                    epochNumber + 1, (int) numMBsToSkip, (int) totalEpochSamples);
+            for (; numMBsRun < (int) numMBsToSkip; numMBsRun++)
+            {
+                if (!trainSetDataReader->GetMinibatch(*inputMatrices))
+                    break;
+                trainSetDataReader->DataEnd();
+            }
+
+            // continue accumulating the criteria from where the checkpoint left off
+            if (useGradientAggregation)
+            {
+                epochCriterion = checkPointCriterion;
+                epochEvalErrors = checkPointEvalErrors;
+            }
+            else
+            {
+                localEpochCriterion.SetValue((ElemType) checkPointCriterion);
+                std::vector<ElemType> evalErrors(checkPointEvalErrors.begin(), checkPointEvalErrors.end());
+                if (!evalErrors.empty())
+                    localEpochEvalErrors.SetValue(1, evalErrors.size(), localEpochEvalErrors.GetDeviceId(), evalErrors.data());
+            }
+            epochCriterionLastMBs = checkPointCriterion;
+            epochEvalErrorsLastMBs = checkPointEvalErrors;
+        }
+    }
+    bool midEpochCheckPointDue = false;
+
     net->StartEvaluateMinibatchLoop(evaluationNodes);
     net->StartEvaluateMinibatchLoop(criterionNodes);
     if (m_needAdaptRegularization && m_adaptationRegType == AdaptationRegType::KL && refNode)
@@ -934,8 +1003,9 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
                 // backprop
                 // ===========================================================
 
+                // with sub-minibatches, the gradients of all sub-minibatches are summed up in place
                 if (learnRatePerSample > 0.01 * m_minLearnRate) // only compute gradient when learning rate is large enough
-                    net->Backprop(criterionNodes[0]);
+                    net->Backprop(criterionNodes[0], /*accumulateParameterGradients=*/ismb > 0);
 
                 // house-keeping for sub-minibatching
                 if (actualNumSubminibatches > 1)
@@ -1174,11 +1244,35 @@ size_t SGD<ElemType>::TrainOneEpoch(ComputationNetworkPtr net,
         // TODO: move the two-forward-pass support out of the reader.
         AttemptUtteranceDerivativeFeatures(net, trainSetDataReader, featureNodes, inputMatrices);
 
+        // With model averaging, the workers' models only agree right after a sync, so the checkpoint waits for the next one.
+        // The criteria are those of the main node; for the others, they are an estimate of their own.
+        midEpochCheckPointDue |= checkpointMidEpoch && numMBsRun % m_numMBsToCheckpoint == 0;
+        if (midEpochCheckPointDue && (!useModelAveraging || nSamplesSinceLastModelSync == 0))
+        {
+            if ((m_mpi == nullptr) || m_mpi->IsMainNode())
+            {
+                double criterionSoFar = epochCriterion;
+                std::vector<double> evalErrorsSoFar = epochEvalErrors;
+                if (!useGradientAggregation)
+                {
+                    criterionSoFar = localEpochCriterion.Get00Element();
+                    for (size_t i = 0; i < evalErrorsSoFar.size(); i++)
+                        evalErrorsSoFar[i] = localEpochEvalErrors(0, i);
+                }
+                SaveMidEpochCheckPoint(epochNumber, numMBsRun, totalEpochSamples, totalSamplesSeen, criterionSoFar, evalErrorsSoFar, learnableNodes, smoothedGradients);
+            }
+            midEpochCheckPointDue = false;
+        }
+
         profiler.NextSample();
     }
 
     // --- END MAIN MINIBATCH LOOP
 
+    // the epoch-end checkpoint must not race with a mid-epoch one still being written
+    if (checkpointMidEpoch)
+        WaitForMidEpochCheckPoint();
+
     if (useModelAveraging )
     {
         m_pMASGDHelper->OnEpochEnd(learnableNodes, smoothedGradients, nSamplesSinceLastModelSync);
@@ -1298,25 +1392,64 @@ bool SGD<ElemType>::PreCompute(ComputationNetworkPtr net,
     // compute
     ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::preComputing);
 
+    // statistics cached by an earlier run
+    // Only the main node writes the cache, so it alone decides whether to use it; otherwise a worker that found no cache (e.g. on
+    // a local disk) would wait forever in the aggregation below for those that skipped it.
+    if (!m_preComputeCacheFile.empty())
+    {
+        bool loadedFromCache = (m_mpi == nullptr || m_mpi->IsMainNode()) && LoadPreComputeCache(nodes);
+        if (m_mpi != nullptr && m_mpi->NumNodesInUse() > 1)
+        {
+            int useCache = loadedFromCache ? 1 : 0;
+            m_mpi->Bcast(&useCache, 1, m_mpi->MainNodeRank());
+            loadedFromCache = useCache != 0;
+            if (loadedFromCache)
+            {
+                BcastPreComputedValues(nodes);
+                for (auto & node : nodes)
+                    dynamic_pointer_cast<PreComputedNodeBase<ElemType>>(node)->m_hasComputed = true;
+            }
+        }
+        if (loadedFromCache)
+        {
+            fprintf(stderr, "\nPrecomputing --> Loaded from cache file %ls.\n\n", m_preComputeCacheFile.c_str());
+            return true;
+        }
+    }
+
+    // In distributed precomputation, each worker accumulates over its share of the data, and the accumulators are merged at the end.
+    bool useParallelPreCompute = m_distributedPreCompute && m_mpi != nullptr && m_mpi->NumNodesInUse() > 1;
+    bool useDistributedMBReading = useParallelPreCompute &&
+                                   m_enableDistributedMBReading &&
+                                   trainSetDataReader->SupportsDistributedMBRead();
+
     // trainSetDataReader->StartMinibatchLoop(m_mbSize[0],  0 , requestDataSize);
     // trainSetDataReader->StartMinibatchLoop(m_mbSize[0],  0 , m_epochSize); // only based on one epoch
     // [1/12/2015 erw] to support large dataset, we usually partition whole dataset into several epoch's,
     // so we need to use all the data to do precomputing
-    if (m_useAllDataForPreComputedNode) // using all the data
-        trainSetDataReader->StartMinibatchLoop(m_mbSize[0], 0);
-    else // using only one epoch. Note: One epoch is often enough for feature mean/stddev, but not for estimating priors.
-        trainSetDataReader->StartMinibatchLoop(m_mbSize[0], 0, m_epochSize);
+    size_t epochSize = m_useAllDataForPreComputedNode ? requestDataSize : m_epochSize; // Note: One epoch is often enough for feature mean/stddev, but not for estimating priors.
+    if (useDistributedMBReading)
+        trainSetDataReader->StartDistributedMinibatchLoop(m_mbSize[0], 0, m_mpi->CurrentNodeRank(), m_mpi->NumNodesInUse(), epochSize);
+    else
+        trainSetDataReader->StartMinibatchLoop(m_mbSize[0], 0, epochSize);
     net->StartEvaluateMinibatchLoop(nodes);
 
+    if (useParallelPreCompute)
+        fprintf(stderr, "Precomputing on %d workers (MyRank = %d)%s.\n", (int) m_mpi->NumNodesInUse(), (int) m_mpi->CurrentNodeRank(),
+                useDistributedMBReading ? ", distributed reading is ENABLED" : "");
+
     // initialize
     for (auto & node : nodes)
         dynamic_pointer_cast<IPreComputeNode>(node)->MarkComputed(false /*begin accumulating*/);
 
     const size_t numIterationsBeforePrintingProgress = 100;
     size_t numItersSinceLastPrintOfProgress = 0;
-    size_t actualMBSizeDummy;
-    while (DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(*trainSetDataReader, net, nullptr, false, false, *inputMatrices, actualMBSizeDummy, m_mpi))
+    size_t actualMBSize;
+    while (DataReaderHelpers::GetMinibatchIntoNetwork<ElemType>(*trainSetDataReader, net, nullptr, useDistributedMBReading, useParallelPreCompute, *inputMatrices, actualMBSize, m_mpi))
     {
+        if (actualMBSize == 0) // decimation may leave this worker with nothing to do
+            continue;
+
         // TODO: move these into GetMinibatchIntoNetwork()  --but those are passed around; necessary? Can't we get them from 'net'?
         ComputationNetwork::BumpEvalTimeStamp(featureNodes);
         ComputationNetwork::BumpEvalTimeStamp(labelNodes);
@@ -1326,15 +1459,109 @@ bool SGD<ElemType>::PreCompute(ComputationNetworkPtr net,
         numItersSinceLastPrintOfProgress = ProgressTracing::TraceFakeProgress(numIterationsBeforePrintingProgress, numItersSinceLastPrintOfProgress);
     }
 
+    // merge the workers' accumulators
+    if (useParallelPreCompute)
+    {
+        auto allReduce = [this](double* data, size_t n)
+        {
+            m_mpi->AllReduce(data, n);
+        };
+        for (auto & node : nodes)
+            dynamic_pointer_cast<IPreComputeNode>(node)->AggregateAccumulators(allReduce);
+    }
+
     // finalize
     for (auto & node : nodes)
         dynamic_pointer_cast<IPreComputeNode>(node)->MarkComputed(true /*done accumulating*/);
 
+    // All workers now hold the same statistics up to rounding in the reductions; make them bit-identical to the main node's.
+    if (useParallelPreCompute)
+        BcastPreComputedValues(nodes);
+
+    if (!m_preComputeCacheFile.empty() && (m_mpi == nullptr || m_mpi->IsMainNode()))
+        SavePreComputeCache(nodes);
+
     fprintf(stderr, "\nPrecomputing --> Completed.\n\n");
 
     return true;
 }
 
+// overwrite the values of all PreCompute nodes with those of the main node
+template <class ElemType>
+void SGD<ElemType>::BcastPreComputedValues(const std::list<ComputationNodeBasePtr>& nodes)
+{
+    for (const auto& node : nodes)
+    {
+        auto pcnode = dynamic_pointer_cast<ComputationNode<ElemType>>(node);
+        pcnode->UpdateFunctionValuesSize(); // (not yet done on workers that skipped the precomputation)
+        auto& value = pcnode->Value();
+        std::unique_ptr<ElemType[]> buffer(value.CopyToArray());
+        m_mpi->Bcast(buffer.get(), value.GetNumElements(), m_mpi->MainNodeRank());
+        value.SetValue(value.GetNumRows(), value.GetNumCols(), value.GetDeviceId(), buffer.get());
+    }
+}
+
+// The precompute cache holds the values of all PreCompute nodes, so that a restarted run can skip the precomputation pass.
+// It is keyed by node name and dimensions only; it must be deleted when the training data changes.
+template <class ElemType>
+void SGD<ElemType>::SavePreComputeCache(const std::list<ComputationNodeBasePtr>& nodes)
+{
+    // save into a temporary file and rename it, so that a killed process does not leave a corrupted cache behind
+    wstring tempFileName = m_preComputeCacheFile + L".tmp";
+    {
+        File fstream(tempFileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite);
+        fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BPreComputeCache");
+        fstream << nodes.size();
+        for (const auto& node : nodes)
+            fstream << node->NodeName() << dynamic_pointer_cast<ComputationNode<ElemType>>(node)->Value();
+        fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EPreComputeCache");
+        fstream.Flush();
+    }
+    renameOrDie(tempFileName, m_preComputeCacheFile);
+}
+
+// returns false, leaving all nodes untouched, if the cache does not exist or does not match the nodes
+template <class ElemType>
+bool SGD<ElemType>::LoadPreComputeCache(const std::list<ComputationNodeBasePtr>& nodes)
+{
+    if (!fexists(m_preComputeCacheFile.c_str()))
+        return false;
+
+    File fstream(m_preComputeCacheFile, FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead);
+    fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BPreComputeCache");
+    size_t numEntries;
+    fstream >> numEntries;
+    map<wstring, Matrix<ElemType>> values;
+    for (size_t i = 0; i < numEntries; i++)
+    {
+        wstring nodeName;
+        Matrix<ElemType> value(CPUDEVICE);
+        fstream >> nodeName >> value;
+        values.insert(make_pair(nodeName, std::move(value)));
+    }
+    fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EPreComputeCache");
+
+    for (const auto& node : nodes)
+    {
+        auto iter = values.find(node->NodeName());
+        if (iter == values.end() || iter->second.GetNumElements() != node->GetSampleLayout().GetNumElements())
+        {
+            fprintf(stderr, "Precomputing --> Cache file %ls does not match node %ls, ignoring it.\n", m_preComputeCacheFile.c_str(), node->NodeName().c_str());
+            return false;
+        }
+    }
+
+    for (const auto& node : nodes)
+    {
+        auto pcnode = dynamic_pointer_cast<PreComputedNodeBase<ElemType>>(node);
+        auto& value = pcnode->Value();
+        std::unique_ptr<ElemType[]> buffer(values.find(node->NodeName())->second.CopyToArray());
+        value.SetValue(value.GetNumRows(), value.GetNumCols(), value.GetDeviceId(), buffer.get());
+        pcnode->m_hasComputed = true;
+    }
+    return true;
+}
+
 // return a reasonable initial learning rate based on the initial mbsize
 template <class ElemType>
 double SGD<ElemType>::SearchForBestLearnRate(ComputationNetworkPtr net,
@@ -1925,10 +2152,11 @@ template <class ElemType>
                                     (ElemType) learnRatePerSample, (ElemType) momentum, useNesterovMomentum);
     }
     else if (adpType == GradientsUpdateType::AdaGrad ||
-             (adpType == GradientsUpdateType::RmsProp && gradientValues.GetMatrixType() == MatrixType::SPARSE) ||
-             (adpType == GradientsUpdateType::FSAdaGrad && gradientValues.GetMatrixType() == MatrixType::SPARSE))
+             (adpType == GradientsUpdateType::RmsProp && gradientValues.GetMatrixType() == MatrixType::SPARSE && gradientValues.GetDeviceId() != CPUDEVICE) ||
+             (adpType == GradientsUpdateType::FSAdaGrad && gradientValues.GetMatrixType() == MatrixType::SPARSE && gradientValues.GetDeviceId() != CPUDEVICE))
     {
-        // rmsprop for sparse is not implemented yet, delegate it with adagrad
+        // rmsprop and fsadagrad for GPU sparse are not implemented yet, delegate them to adagrad
+        // (on the CPU, block-sparse gradients have lazy variants that only touch the active rows)
 
         double aveMultiplier = smoothedGradient.Adagrad(gradientValues, needAveMultiplier);
         Matrix<ElemType>::ScaleAndAdd((ElemType)(-learnRatePerSample / aveMultiplier), gradientValues, functionValues);
@@ -2118,12 +2346,220 @@ bool SGD<ElemType>::LoadCheckPointInfo(const size_t epochNumber,
     return true;
 }
 
+// Snapshot the parameters and smoothed gradients into host memory and write them on a background thread.
+// Only the copy to the staging area stalls training; at most one checkpoint is in flight at any time.
+template <class ElemType>
+void SGD<ElemType>::SaveMidEpochCheckPoint(const int epoch, const size_t numMBsRun, const size_t totalEpochSamples, const size_t totalSamplesSeen,
+                                           const double epochCriterion, const std::vector<double>& epochEvalErrors,
+                                           const std::list<ComputationNodeBasePtr>& learnableNodes,
+                                           const std::list<Matrix<ElemType>>& smoothedGradients)
+{
+    // the staging area is still being written from the previous checkpoint
+    WaitForMidEpochCheckPoint();
+
+    auto stageMatrix = [](const Matrix<ElemType>& m, StagedMatrix& staged)
+    {
+        staged.numRows = m.GetNumRows();
+        staged.numCols = m.GetNumCols();
+        staged.data.resize(staged.numRows * staged.numCols);
+        ElemType* data = staged.data.data();
+        size_t size = staged.data.size();
+        m.CopyToArray(data, size); // (the array is large enough, so this does not reallocate)
+    };
+
+    auto& stage = m_midEpochCheckPointStage;
+    stage.epoch = epoch;
+    stage.numMBsRun = numMBsRun;
+    stage.totalEpochSamples = totalEpochSamples;
+    stage.totalSamplesSeen = totalSamplesSeen;
+    stage.epochCriterion = epochCriterion;
+    stage.epochEvalErrors = epochEvalErrors;
+    stage.nodeNames.resize(learnableNodes.size());
+    stage.values.resize(learnableNodes.size());
+    stage.smoothedGradients.resize(smoothedGradients.size());
+    size_t i = 0;
+    for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, i++)
+    {
+        ComputationNodePtr node = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter);
+        stage.nodeNames[i] = node->NodeName();
+        stageMatrix(node->Value(), stage.values[i]);
+    }
+    i = 0;
+    for (auto smoothedGradientIter = smoothedGradients.begin(); smoothedGradientIter != smoothedGradients.end(); smoothedGradientIter++, i++)
+        stageMatrix(*smoothedGradientIter, stage.smoothedGradients[i]);
+
+    const wstring checkPointFileName = GetMidEpochCheckPointFileName(epoch);
+    m_pendingMidEpochCheckPoint = std::async(std::launch::async, [this, checkPointFileName]()
+    {
+        const auto& stage = m_midEpochCheckPointStage;
+        auto writeMatrices = [](File& fstream, const std::vector<StagedMatrix>& matrices)
+        {
+            for (const auto& m : matrices)
+            {
+                fstream << m.numRows << m.numCols;
+                fstream.WriteArray(m.data.data(), m.data.size());
+            }
+        };
+
+        // same as SaveCheckPointInfo(): write to a temporary file, then rename it, so that a crash leaves the previous checkpoint intact
+        wstring tempFileName = checkPointFileName + L".tmp";
+        {
+            File fstream(tempFileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsWrite);
+            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BVersion");
+            fstream << (size_t) CURRENT_CNTK_CHECKPOINT_VERSION;
+            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EVersion");
+
+            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BMidEpochCKP");
+            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BPosition");
+            fstream << stage.epoch << stage.numMBsRun << stage.totalEpochSamples << stage.totalSamplesSeen;
+            fstream << stage.epochCriterion << stage.epochEvalErrors.size();
+            for (double evalError : stage.epochEvalErrors)
+                fstream << evalError;
+            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EPosition");
+
+            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BParameters");
+            fstream << stage.nodeNames.size();
+            for (const auto& nodeName : stage.nodeNames)
+                fstream << nodeName;
+            writeMatrices(fstream, stage.values);
+            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EParameters");
+
+            fstream.PutMarker(FileMarker::fileMarkerBeginSection, L"BGradient");
+            fstream << stage.smoothedGradients.size();
+            writeMatrices(fstream, stage.smoothedGradients);
+            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EGradient");
+            fstream.PutMarker(FileMarker::fileMarkerEndSection, L"EMidEpochCKP");
+
+            fstream.Flush();
+        }
+        renameOrDie(tempFileName, checkPointFileName);
+    });
+}
+
+// wait for the background write of a mid-epoch checkpoint, if any; rethrows its errors
+template <class ElemType>
+void SGD<ElemType>::WaitForMidEpochCheckPoint()
+{
+    if (m_pendingMidEpochCheckPoint.valid())
+        m_pendingMidEpochCheckPoint.get();
+}
+
+// Restore parameters and smoothed gradients from the mid-epoch checkpoint of 'epoch', and return the position in the epoch
+// and the criteria accumulated up to it. Returns false if there is none, or if it does not match the network.
+template <class ElemType>
+bool SGD<ElemType>::LoadMidEpochCheckPoint(const int epoch,
+                                           /*out*/ size_t& numMBsRun, /*out*/ size_t& totalEpochSamples, /*out*/ size_t& totalSamplesSeen,
+                                           /*out*/ double& epochCriterion, /*in/out*/ std::vector<double>& epochEvalErrors,
+                                           const std::list<ComputationNodeBasePtr>& learnableNodes,
+                                           std::list<Matrix<ElemType>>& smoothedGradients)
+{
+    const wstring checkPointFileName = GetMidEpochCheckPointFileName(epoch);
+    if (!fexists(checkPointFileName.c_str()))
+        return false;
+
+    File fstream(checkPointFileName, FileOptions::fileOptionsBinary | FileOptions::fileOptionsRead);
+
+    size_t ckpVersion;
+    fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BVersion");
+    fstream >> ckpVersion;
+    fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EVersion");
+
+    fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BMidEpochCKP");
+    size_t checkPointEpoch, checkPointNumMBsRun, checkPointEpochSamples, checkPointSamplesSeen;
+    fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BPosition");
+    fstream >> checkPointEpoch >> checkPointNumMBsRun >> checkPointEpochSamples >> checkPointSamplesSeen;
+    double checkPointCriterion;
+    size_t numEvalErrors;
+    fstream >> checkPointCriterion >> numEvalErrors;
+    std::vector<double> checkPointEvalErrors(numEvalErrors);
+    for (auto& evalError : checkPointEvalErrors)
+        fstream >> evalError;
+    fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EPosition");
+
+    // read everything before touching the network, so that a mismatching file leaves it unchanged
+    size_t numNodes;
+    fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BParameters");
+    fstream >> numNodes;
+    if (checkPointEpoch != epoch || numNodes != learnableNodes.size() || numEvalErrors != epochEvalErrors.size())
+    {
+        fprintf(stderr, "Warning: mid-epoch checkpoint %ls does not match this epoch or network, ignoring it.\n", checkPointFileName.c_str());
+        return false;
+    }
+    std::vector<wstring> nodeNames(numNodes);
+    for (auto& nodeName : nodeNames)
+        fstream >> nodeName;
+
+    auto readMatrices = [&fstream](std::vector<StagedMatrix>& matrices)
+    {
+        for (auto& m : matrices)
+        {
+            fstream >> m.numRows >> m.numCols;
+            m.data.resize(m.numRows * m.numCols);
+            fstream.ReadArray(m.data.data(), m.data.size());
+        }
+    };
+    std::vector<StagedMatrix> values(numNodes);
+    readMatrices(values);
+    fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EParameters");
+
+    size_t numSmoothedGradients;
+    fstream.GetMarker(FileMarker::fileMarkerBeginSection, L"BGradient");
+    fstream >> numSmoothedGradients;
+    if (numSmoothedGradients != smoothedGradients.size())
+    {
+        fprintf(stderr, "Warning: mid-epoch checkpoint %ls does not match this epoch or network, ignoring it.\n", checkPointFileName.c_str());
+        return false;
+    }
+    std::vector<StagedMatrix> gradients(numSmoothedGradients);
+    readMatrices(gradients);
+    fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EGradient");
+    fstream.GetMarker(FileMarker::fileMarkerEndSection, L"EMidEpochCKP");
+
+    size_t i = 0;
+    for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, i++)
+    {
+        ComputationNodePtr node = dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter);
+        if (node->NodeName() != nodeNames[i] || node->Value().GetNumRows() != values[i].numRows || node->Value().GetNumCols() != values[i].numCols)
+        {
+            fprintf(stderr, "Warning: mid-epoch checkpoint %ls does not match node %ls, ignoring it.\n", checkPointFileName.c_str(), node->NodeName().c_str());
+            return false;
+        }
+    }
+
+    auto restoreMatrix = [](Matrix<ElemType>& m, StagedMatrix& staged)
+    {
+        if (staged.data.empty())
+            m.Resize(staged.numRows, staged.numCols);
+        else
+            m.SetValue(staged.numRows, staged.numCols, m.GetDeviceId(), staged.data.data());
+    };
+    i = 0;
+    for (auto nodeIter = learnableNodes.begin(); nodeIter != learnableNodes.end(); nodeIter++, i++)
+        restoreMatrix(dynamic_pointer_cast<ComputationNode<ElemType>>(*nodeIter)->Value(), values[i]);
+    i = 0;
+    for (auto smoothedGradientIter = smoothedGradients.begin(); smoothedGradientIter != smoothedGradients.end(); smoothedGradientIter++, i++)
+        restoreMatrix(*smoothedGradientIter, gradients[i]);
+
+    numMBsRun = checkPointNumMBsRun;
+    totalEpochSamples = checkPointEpochSamples;
+    totalSamplesSeen = checkPointSamplesSeen;
+    epochCriterion = checkPointCriterion;
+    epochEvalErrors = checkPointEvalErrors;
+    return true;
+}
+
 template <class ElemType>
 wstring SGD<ElemType>::GetCheckPointFileNameForEpoch(const int epoch)
 {
     return GetModelNameForEpoch(epoch) + L".ckp";
 }
 
+template <class ElemType>
+wstring SGD<ElemType>::GetMidEpochCheckPointFileName(const int epoch)
+{
+    return GetModelNameForEpoch(epoch) + L".mid.ckp";
+}
+
 template <class ElemType>
 wstring SGD<ElemType>::GetModelNameForEpoch(const int epoch, bool bLastModel)
 {
@@ -2360,6 +2796,7 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_truncated = configSGD(L"truncated", false);
     m_maxSamplesInRAM = configSGD(L"maxSamplesInRAM", (size_t) SIZE_MAX);
     m_numSubminiBatches = configSGD(L"numSubminibatches", (size_t) 1);
+    m_skipGaps = configSGD(L"skipGaps", false);
 
     // the number of samples in each epoch (0 means, use all the samples in each epoch).
     m_epochSize = configSGD(L"epochSize", (size_t) 0);
@@ -2386,6 +2823,10 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     m_traceLevel = configSGD(L"traceLevel", (int) 0);
     m_numMBsToShowResult = configSGD(L"numMBsToShowResult", (size_t) 10);
     m_numMBsToCUDAProfile = configSGD(L"numMBsToCUDAProfile", (size_t) 0);
+    m_numMBsToCheckpoint = configSGD(L"numMBsToCheckpoint", (size_t) 0);
+    m_profileNodes = configSGD(L"profileNodes", false);
+    m_profileTraceFile = (wstring) configSGD(L"profileTraceFile", L"");
+    m_profileTraceMaxEvents = configSGD(L"profileTraceMaxEvents", (size_t) 1000000);
 
     m_gradientClippingWithTruncation = configSGD(L"gradientClippingWithTruncation", true);
     m_clippingThresholdPerSample = configSGD(L"clippingThresholdPerSample", numeric_limits<double>::infinity());
@@ -2442,6 +2883,8 @@ SGDParams::SGDParams(const ConfigRecordType& configSGD, size_t sizeofElemType)
     }
 
     m_useAllDataForPreComputedNode = configSGD(L"UseAllDataForPreComputedNode", true);
+    m_distributedPreCompute = configSGD(L"distributedPreCompute", false);
+    m_preComputeCacheFile = (wstring) configSGD(L"preComputeCacheFile", L"");
 
     // consistency checks
     for (size_t i = 0; i < m_mbSize.size(); i++)
@@ -16,7 +16,9 @@
 #include "Config.h"
 #include <chrono>
 #include <random>
+#include <future>
 #include "Profiler.h"
+#include "NodeProfiler.h"
 #include "MASGD.h"
 
 using namespace std; // ugh! TODO: get rid of this from .h files!!!
@@ -174,6 +176,9 @@ protected:
     // if m_maxTempMemSizeInSamples = SIZE_MAX (which means users do not specify the option) and m_numSubminiBatches > 1
     // we divide one minibatch to m_numSubminiBatches subMinibatches
 
+    // if true, nodes that support it compute on the valid frames of minibatches with gaps only (see ComputationEnvironment::m_skipGaps)
+    bool m_skipGaps;
+
     // the number of samples in each epoch (0 means, use all the samples in each epoch).
     size_t m_epochSize;
     size_t m_maxComputedEpochSize;
@@ -227,6 +232,10 @@ protected:
 
     int m_numMBsToShowResult;
     int m_numMBsToCUDAProfile;
+    size_t m_numMBsToCheckpoint; // if > 0, write a mid-epoch checkpoint every this many minibatches, in the background (see SaveMidEpochCheckPoint())
+    bool m_profileNodes;            // print per-node timing and memory after every epoch (see NodeProfiler)
+    wstring m_profileTraceFile;     // if given, also write a Chrome-trace JSON file of all node calls
+    size_t m_profileTraceMaxEvents; // the trace is closed after this many events
 
     bool m_doGradientCheck;
     double m_gradientCheckSigDigit;
@@ -234,6 +243,8 @@ protected:
     bool m_doUnitTest;
 
     bool m_useAllDataForPreComputedNode;
+    bool m_distributedPreCompute;  // with MPI, each worker precomputes over its share of the data (see PreCompute())
+    wstring m_preComputeCacheFile; // if given, PreCompute node values are loaded from/saved to this file
 
     // Parallel training
     MPIWrapperPtr m_mpi;
@@ -352,6 +363,9 @@ protected:
                     std::vector<ComputationNodeBasePtr>& featureNodes,
                     std::vector<ComputationNodeBasePtr>& labelNodes,
                     StreamMinibatchInputs* inputMatrices);
+    void SavePreComputeCache(const std::list<ComputationNodeBasePtr>& nodes);
+    bool LoadPreComputeCache(const std::list<ComputationNodeBasePtr>& nodes);
+    void BcastPreComputedValues(const std::list<ComputationNodeBasePtr>& nodes);
 
     // return a reasonable initial learning rate based on the initial mbsize
     double SearchForBestLearnRate(ComputationNetworkPtr net,
@@ -450,7 +464,8 @@ protected:
                          /*out*/ double& epochCriterion,
                          /*out*/ std::vector<double>& epochEvalErrors,
                          /*out*/ size_t& totalSamplesSeen,
-                         std::string prefixMsg = "");
+                         std::string prefixMsg = "",
+                         bool allowMidEpochCheckPoints = false);
 
     void InitDistGradAgg(int numEvalNodes, int traceLevel);
     void InitModelAggregationHandler(int traceLevel);
@@ -493,7 +508,20 @@ protected:
                             /*out*/ double& prevCriterion,
                             /*out*/ size_t& minibatchSize);
 
+    // mid-epoch checkpoints: parameters, smoothed gradients, the position within the epoch, and the criteria accumulated so far
+    void SaveMidEpochCheckPoint(const int epoch, const size_t numMBsRun, const size_t totalEpochSamples, const size_t totalSamplesSeen,
+                                const double epochCriterion, const std::vector<double>& epochEvalErrors,
+                                const std::list<ComputationNodeBasePtr>& learnableNodes,
+                                const std::list<Matrix<ElemType>>& smoothedGradients);
+    bool LoadMidEpochCheckPoint(const int epoch,
+                                /*out*/ size_t& numMBsRun, /*out*/ size_t& totalEpochSamples, /*out*/ size_t& totalSamplesSeen,
+                                /*out*/ double& epochCriterion, /*in/out*/ std::vector<double>& epochEvalErrors,
+                                const std::list<ComputationNodeBasePtr>& learnableNodes,
+                                std::list<Matrix<ElemType>>& smoothedGradients);
+    void WaitForMidEpochCheckPoint();
+
     wstring GetCheckPointFileNameForEpoch(const int epoch);
+    wstring GetMidEpochCheckPointFileName(const int epoch);
     wstring GetModelNameForEpoch(const int epoch, bool bLastModel = false);
 
     // return -1 if nothing exists
@@ -536,6 +564,28 @@ protected:
 
     shared_ptr<IMASGD<ElemType>> m_pMASGDHelper;
 
+    // staging copy of a mid-epoch checkpoint, taken on the training thread and written by m_pendingMidEpochCheckPoint
+    struct StagedMatrix
+    {
+        size_t numRows;
+        size_t numCols;
+        std::vector<ElemType> data; // column-major; reused across checkpoints
+    };
+    struct MidEpochCheckPointStage
+    {
+        size_t epoch;
+        size_t numMBsRun;
+        size_t totalEpochSamples;
+        size_t totalSamplesSeen;
+        double epochCriterion;               // sums over the minibatches so far, not yet divided by totalEpochSamples
+        std::vector<double> epochEvalErrors;
+        std::vector<wstring> nodeNames;
+        std::vector<StagedMatrix> values;
+        std::vector<StagedMatrix> smoothedGradients;
+    };
+    MidEpochCheckPointStage m_midEpochCheckPointStage;
+    std::future<void> m_pendingMidEpochCheckPoint;
+
 private:
     int SGDTrace(FILE* __restrict __stream, const char* __restrict __format, ...);
 };
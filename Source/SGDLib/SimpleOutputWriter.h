@@ -16,6 +16,8 @@
 #include <stdexcept>
 #include <fstream>
 #include <cstdio>
+#include <deque>
+#include <future>
 #include "ProgressTracing.h"
 #include "ComputationNetworkBuilder.h"
 
@@ -81,8 +83,9 @@ private:
     }
 
 public:
-    SimpleOutputWriter(ComputationNetworkPtr net, int verbosity = 0)
-        : m_net(net), m_verbosity(verbosity)
+    // outputQueueDepth - number of minibatches that may be formatted and written in the background while the next ones are computed
+    SimpleOutputWriter(ComputationNetworkPtr net, int verbosity = 0, size_t outputQueueDepth = 4)
+        : m_net(net), m_verbosity(verbosity), m_outputQueueDepth(outputQueueDepth)
     {
     }
 
@@ -187,9 +190,11 @@ public:
         std::string sampleSeparator;   // and this between rows
         // Optional printf precision parameter:
         std::string precisionFormat;        // printf precision, e.g. ".2" to get a "%.2f"
+        // Binary output instead of text (real values only; all strings above are ignored), see FormatBinary()
+        bool binary;
 
         WriteFormattingOptions() :
-            isCategoryLabel(false), transpose(true), sequenceEpilogue("\n"), elementSeparator(" "), sampleSeparator("\n")
+            isCategoryLabel(false), transpose(true), sequenceEpilogue("\n"), elementSeparator(" "), sampleSeparator("\n"), binary(false)
         { }
 
         // Process -- replace newlines and all %s by the given string
@@ -208,9 +213,42 @@ public:
         }
     };
 
-    void WriteMinibatch(FILE* f, ComputationNodePtr node, 
-        const WriteFormattingOptions & formattingOptions, char formatChar, std::string valueFormatString, std::vector<std::string>& labelMapping,
-        size_t numMBsRun, bool gradient)
+    // binary output format: for each sequence, its number of rows and of frames (int32 each), followed by its frames as float32 values, one frame after another
+    static void FormatBinary(std::string& out, const ElemType* matData, size_t matRows, MBLayoutPtr pMBLayout)
+    {
+        if (!pMBLayout) // no MBLayout: a single sample
+        {
+            pMBLayout = make_shared<MBLayout>();
+            pMBLayout->InitAsFrameMode(1);
+        }
+        std::vector<float> frame(matRows);
+        size_t width = pMBLayout->GetNumTimeSteps();
+        size_t stride = pMBLayout->GetNumParallelSequences() * matRows;
+        for (const auto& seqInfo : pMBLayout->GetAllSequences())
+        {
+            if (seqInfo.seqId == GAP_SEQUENCE_ID)
+                continue;
+            size_t tBegin = seqInfo.tBegin >= 0 ? seqInfo.tBegin : 0;
+            size_t tEnd = seqInfo.tEnd <= width ? seqInfo.tEnd : width;
+            int32_t header[2] = {(int32_t) matRows, (int32_t) (tEnd - tBegin)};
+            out.append((const char*) header, sizeof(header));
+            const ElemType* seqData = matData + (tBegin * pMBLayout->GetNumParallelSequences() + seqInfo.s) * matRows; // (sequences may begin before the minibatch)
+            for (size_t t = tBegin; t < tEnd; t++, seqData += stride)
+            {
+                for (size_t i = 0; i < matRows; i++)
+                    frame[i] = (float) seqData[i];
+                out.append((const char*) frame.data(), matRows * sizeof(float));
+            }
+        }
+    }
+
+    // WriteMinibatchAsync - format and write the current minibatch of a node in the background
+    // The values are copied to the CPU right away, so that the network can go on with the next minibatch. Each minibatch is
+    // formatted by its own task, in parallel with the others, and written once the task of the previous minibatch has written
+    // its output, which keeps the order of the output. At most 'm_outputQueueDepth' minibatches are pending when this returns.
+    void WriteMinibatchAsync(std::deque<std::shared_future<void>>& pendingWrites, FILE* f, ComputationNodePtr node,
+                             const WriteFormattingOptions& formattingOptions, const std::string& valueFormatString, const std::vector<std::string>& labelMapping,
+                             size_t numMBsRun, bool gradient)
     {
         const auto sequenceSeparator = formattingOptions.Processed(node->NodeName(), formattingOptions.sequenceSeparator, numMBsRun);
         const auto sequencePrologue =  formattingOptions.Processed(node->NodeName(), formattingOptions.sequencePrologue,  numMBsRun);
@@ -218,9 +256,40 @@ public:
         const auto elementSeparator =  formattingOptions.Processed(node->NodeName(), formattingOptions.elementSeparator,  numMBsRun);
         const auto sampleSeparator =   formattingOptions.Processed(node->NodeName(), formattingOptions.sampleSeparator,   numMBsRun);
 
-        node->WriteMinibatchWithFormatting(f, SIZE_MAX, SIZE_MAX, formattingOptions.transpose, formattingOptions.isCategoryLabel, labelMapping,
-            sequenceSeparator, sequencePrologue, sequenceEpilogue, elementSeparator, sampleSeparator,
-            valueFormatString, gradient);
+        // take a snapshot of the minibatch
+        const Matrix<ElemType>& values = gradient ? node->Gradient() : node->Value();
+        size_t numRows = values.GetNumRows();
+        auto data = make_shared<std::vector<ElemType>>(values.GetNumElements());
+        values.CopySection(numRows, values.GetNumCols(), data->data(), numRows);
+        MBLayoutPtr pMBLayout;
+        if (node->GetMBLayout())
+        {
+            pMBLayout = make_shared<MBLayout>();
+            pMBLayout->CopyFrom(node->GetMBLayout());
+        }
+
+        bool binary = formattingOptions.binary;
+        bool transpose = formattingOptions.transpose;
+        bool isCategoryLabel = formattingOptions.isCategoryLabel;
+        std::shared_future<void> previous = pendingWrites.empty() ? std::shared_future<void>() : pendingWrites.back();
+        pendingWrites.push_back(std::async(std::launch::async, [=, &labelMapping]()
+        {
+            std::string out;
+            if (binary)
+                FormatBinary(out, data->data(), numRows, pMBLayout);
+            else
+                ComputationNode<ElemType>::FormatMinibatch(out, data->data(), numRows, pMBLayout, SIZE_MAX, SIZE_MAX, transpose, isCategoryLabel, labelMapping,
+                                                           sequenceSeparator, sequencePrologue, sequenceEpilogue, elementSeparator, sampleSeparator, valueFormatString);
+            if (previous.valid())
+                previous.get(); // wait for the previous minibatch to be written (and pass on its errors)
+            fwriteOrDie(out.data(), 1, out.size(), f);
+        }).share());
+
+        while (pendingWrites.size() > m_outputQueueDepth)
+        {
+            pendingWrites.front().get();
+            pendingWrites.pop_front();
+        }
     }
 
     void InsertNode(std::vector<ComputationNodeBasePtr>& allNodes, ComputationNodeBasePtr parent, ComputationNodeBasePtr newNode)
@@ -289,6 +358,8 @@ public:
         std::vector<std::string> labelMapping;
         if (formattingOptions.isCategoryLabel && !formattingOptions.labelMappingFile.empty())
             File::LoadLabelFile(formattingOptions.labelMappingFile, labelMapping);
+        if (formattingOptions.binary && formattingOptions.isCategoryLabel)
+            InvalidArgument("write: Binary output is only supported for real values.");
 
         // open output files
         File::MakeIntermediateDirs(outputPath);
@@ -298,7 +369,7 @@ public:
             std::wstring nodeOutputPath = outputPath;
             if (nodeOutputPath != L"-")
                 nodeOutputPath += L"." + onode->NodeName();
-            auto f = make_shared<File>(nodeOutputPath, fileOptionsWrite | fileOptionsText);
+            auto f = make_shared<File>(nodeOutputPath, fileOptionsWrite | (formattingOptions.binary ? fileOptionsBinary : fileOptionsText));
             outputStreams[onode] = f;
         }
 
@@ -310,11 +381,15 @@ public:
         size_t totalEpochSamples = 0;
         size_t numMBsRun = 0;
 
-        for (auto & onode : outputNodes)
+        if (!formattingOptions.binary)
         {
-            FILE* f = *outputStreams[onode];
-            fprintfOrDie(f, "%s", formattingOptions.prologue.c_str());
+            for (auto & onode : outputNodes)
+            {
+                FILE* f = *outputStreams[onode];
+                fprintfOrDie(f, "%s", formattingOptions.prologue.c_str());
+            }
         }
+        std::deque<std::shared_future<void>> pendingWrites; // minibatches being formatted and written in the background
 
         size_t actualMBSize;
         const size_t numIterationsBeforePrintingProgress = 100;
@@ -333,7 +408,7 @@ public:
                 m_net->ForwardProp(onode);
 
                 FILE* file = *outputStreams[onode];
-                WriteMinibatch(file, dynamic_pointer_cast<ComputationNode<ElemType>>(onode), formattingOptions, formatChar, valueFormatString, labelMapping, numMBsRun, /* gradient */ false);
+                WriteMinibatchAsync(pendingWrites, file, dynamic_pointer_cast<ComputationNode<ElemType>>(onode), formattingOptions, valueFormatString, labelMapping, numMBsRun, /* gradient */ false);
                 if (nodeUnitTest)
                 {
                     m_net->Backprop(onode);
@@ -353,7 +428,7 @@ public:
                     }
                     else
                     {
-                        WriteMinibatch(file, node, formattingOptions, formatChar, valueFormatString, labelMapping, numMBsRun, /* gradient */ true);
+                        WriteMinibatchAsync(pendingWrites, file, node, formattingOptions, valueFormatString, labelMapping, numMBsRun, /* gradient */ true);
                     }
                 }
             }
@@ -368,10 +443,18 @@ public:
             dataReader.DataEnd();
         } // end loop over minibatches
 
-        for (auto & stream : outputStreams)
+        // wait for the pending output (and pass on errors that happened while writing it)
+        for (auto& pendingWrite : pendingWrites)
+            pendingWrite.get();
+        pendingWrites.clear();
+
+        if (!formattingOptions.binary)
         {
-            FILE* f = *stream.second;
-            fprintfOrDie(f, "%s", formattingOptions.epilogue.c_str());
+            for (auto & stream : outputStreams)
+            {
+                FILE* f = *stream.second;
+                fprintfOrDie(f, "%s", formattingOptions.epilogue.c_str());
+            }
         }
 
         fprintf(stderr, "Written to %ls*\nTotal Samples Evaluated = %lu\n", outputPath.c_str(), totalEpochSamples);
@@ -384,6 +467,7 @@ public:
 private:
     ComputationNetworkPtr m_net;
     int m_verbosity;
+    size_t m_outputQueueDepth; // maximum number of minibatches pending in the background when writing to files
     void operator=(const SimpleOutputWriter&); // (not assignable)
 };
 
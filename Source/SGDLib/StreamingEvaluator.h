@@ -0,0 +1,392 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+// StreamingEvaluator.h -- chunk-by-chunk evaluation of recurrent networks over many concurrent streams
+//
+#pragma once
+
+#include "Basics.h"
+#include "ComputationNetwork.h"
+#include "RecurrentNodes.h"
+#include <vector>
+#include <string>
+#include <map>
+#include <set>
+#include <algorithm>
+
+using namespace std;
+
+namespace Microsoft { namespace MSR { namespace CNTK {
+
+// -----------------------------------------------------------------------
+// StreamingEvaluator -- evaluate a recurrent network on streams whose frames arrive in chunks, e.g. for online speech recognition
+//
+// Each call to EvaluateChunk() takes the next chunk of frames of any number of streams and evaluates them together
+// as the parallel sequences of one minibatch. A stream seen for the first time starts a new sequence; any other
+// stream continues where its last chunk ended, so the network never re-runs a stream's history.
+//
+// The state of a stream is the last frame of each PastValue node's input. Between calls it is kept on the device
+// in one state pool per PastValue node, one column per stream. Before a chunk, the columns of the streams in the
+// chunk are gathered and imported into the PastValue nodes as a DelayedValueNodeState; afterwards, each node's
+// state is reduced to the last frame of every stream with GatherDelayedValue() and exported back into the pool.
+// The state of a single stream can be exported and imported as well, e.g. to move a stream to another evaluator.
+// -----------------------------------------------------------------------
+
+template <class ElemType>
+class StreamingEvaluator
+{
+    typedef shared_ptr<DelayedValueNodeState<ElemType>> DelayedNodeStatePtr;
+
+public:
+    // node name -> frames of one stream, one sample after another
+    typedef std::map<std::wstring, std::vector<ElemType>*> StreamBuffers;
+
+    // outputNodeNames - nodes that can be requested from EvaluateChunk(); if empty, the network's output nodes
+    StreamingEvaluator(ComputationNetworkPtr net, const std::vector<std::wstring>& outputNodeNames = std::vector<std::wstring>(), int verbosity = 0)
+        : m_net(net),
+          m_verbosity(verbosity),
+          m_columnMap(net->GetDeviceId()),
+          m_gathered(net->GetDeviceId()),
+          m_capacity(0)
+    {
+        if (outputNodeNames.empty())
+            m_outputNodes = net->OutputNodes();
+        else
+            for (const auto& name : outputNodeNames)
+                m_outputNodes.push_back(net->GetNodeFromName(name));
+        if (m_outputNodes.empty())
+            InvalidArgument("StreamingEvaluator: No output nodes given.");
+
+        std::set<ComputationNodeBasePtr> visited;
+        for (const auto& outputNode : m_outputNodes)
+            for (const auto& node : net->InputNodes(outputNode))
+                if (visited.insert(node).second)
+                    m_inputNodes.push_back(node);
+
+        // a chunk must not depend on frames that have not arrived yet, so all recurrence must look into the past
+        visited.clear();
+        for (const auto& outputNode : m_outputNodes)
+        {
+            for (const auto& node : net->GetEvalOrder(outputNode))
+            {
+                if (!visited.insert(node).second)
+                    continue;
+                auto pastValueNode = dynamic_pointer_cast<PastValueNode<ElemType>>(node);
+                if (pastValueNode)
+                {
+                    if (pastValueNode->TimeStep() != 1)
+                        InvalidArgument("StreamingEvaluator: %ls %ls operation must have timeStep=1.", node->NodeName().c_str(), node->OperationName().c_str());
+                    m_pastValueNodes.push_back(pastValueNode);
+                    m_statePools.push_back(make_shared<Matrix<ElemType>>(net->GetDeviceId()));
+                }
+                else if (dynamic_pointer_cast<IStatefulNode>(node))
+                    InvalidArgument("StreamingEvaluator: %ls %ls operation is not supported, since streaming can only carry state from the past.",
+                                    node->NodeName().c_str(), node->OperationName().c_str());
+            }
+        }
+
+        m_net->AllocateAllMatrices({}, m_outputNodes, nullptr);
+        for (const auto& outputNode : m_outputNodes)
+            m_net->StartEvaluateMinibatchLoop(outputNode);
+    }
+
+    // EvaluateChunk - evaluate the next chunk of each stream in 'inputs', all streams as one minibatch
+    // inputs - stream id -> input node name -> the chunk's frames; all inputs of a stream must have the same number of frames
+    // outputs - stream id -> output node name -> receives the output frames of the chunk; streams and nodes are optional
+    void EvaluateChunk(const std::map<size_t, StreamBuffers>& inputs, std::map<size_t, StreamBuffers>& outputs)
+    {
+        size_t numStreams = inputs.size();
+        if (numStreams == 0)
+            return;
+        for (const auto& iter : outputs)
+            if (inputs.find(iter.first) == inputs.end())
+                InvalidArgument("StreamingEvaluator: Output requested for stream %d, which has no input in this chunk.", (int) iter.first);
+
+        ScopedNetworkOperationMode modeGuard(m_net, NetworkOperationMode::inferring);
+
+        // the chunk length of each stream; streams seen for the first time get a state slot
+        std::vector<Stream*> streams;
+        std::vector<size_t> lengths;
+        size_t numTimeSteps = 0;
+        for (const auto& iter : inputs)
+        {
+            size_t length = GetNumFrames(iter.first, iter.second);
+            auto found = m_streams.find(iter.first);
+            if (found == m_streams.end())
+                found = m_streams.insert(make_pair(iter.first, Stream{AllocateSlot(), 0})).first;
+            streams.push_back(&found->second);
+            lengths.push_back(length);
+            numTimeSteps = max(numTimeSteps, length);
+        }
+
+        // one parallel sequence per stream; a stream that has seen frames before continues its sequence
+        auto pMBLayout = m_net->GetMBLayoutPtr();
+        pMBLayout->Init(numStreams, numTimeSteps);
+        bool anyContinued = false;
+        for (size_t i = 0; i < numStreams; i++)
+        {
+            pMBLayout->AddSequence(NEW_SEQUENCE_ID, i, -(ptrdiff_t) streams[i]->numFrames, lengths[i]);
+            if (lengths[i] < numTimeSteps)
+                pMBLayout->AddGap(i, lengths[i], numTimeSteps);
+            anyContinued |= streams[i]->numFrames > 0;
+        }
+
+        // load the frames, column t * numStreams + i holding frame t of the i-th stream
+        for (const auto& node : m_inputNodes)
+        {
+            auto& value = node->As<ComputationNode<ElemType>>()->Value();
+            if (value.GetMatrixType() != MatrixType::DENSE)
+                InvalidArgument("StreamingEvaluator: Input %ls must be dense.", node->NodeName().c_str());
+            size_t dim = node->GetSampleMatrixNumRows();
+            m_buffer.assign(dim * numStreams * numTimeSteps, 0);
+            size_t i = 0;
+            for (const auto& iter : inputs)
+            {
+                const auto& frames = *iter.second.find(node->NodeName())->second;
+                for (size_t t = 0; t < lengths[i]; t++)
+                    std::copy(frames.begin() + t * dim, frames.begin() + (t + 1) * dim, m_buffer.begin() + (t * numStreams + i) * dim);
+                i++;
+            }
+            value.SetValue(dim, numStreams * numTimeSteps, value.GetDeviceId(), m_buffer.data(), matrixFlagNormal);
+            node->NotifyFunctionValuesMBSizeModified();
+        }
+
+        // restore the state of the continued streams, one single-frame parallel sequence per stream
+        // (new streams start at a sequence boundary, so their columns are never read)
+        if (anyContinued)
+        {
+            std::vector<ptrdiff_t> slots(numStreams);
+            for (size_t i = 0; i < numStreams; i++)
+                slots[i] = streams[i]->numFrames > 0 ? (ptrdiff_t) streams[i]->slot : -1;
+            SetColumnMap(slots);
+            auto stateLayout = CreateStateLayout(numStreams);
+            for (size_t k = 0; k < m_pastValueNodes.size(); k++)
+            {
+                m_gathered.DoGatherColumnsOf(0, m_columnMap, *m_statePools[k], 1);
+                auto state = make_shared<DelayedValueNodeState<ElemType>>(m_net->GetDeviceId());
+                state->CacheState(m_gathered);
+                state->CacheDelayedMBLayout(stateLayout);
+                m_pastValueNodes[k]->ImportState(state);
+            }
+        }
+
+        ComputationNetwork::BumpEvalTimeStamp(m_inputNodes);
+        for (const auto& outputNode : m_outputNodes)
+            m_net->ForwardProp(outputNode);
+
+        // hand out the requested outputs
+        for (const auto& outputNode : m_outputNodes)
+        {
+            bool requested = false;
+            for (const auto& iter : outputs)
+                requested |= iter.second.find(outputNode->NodeName()) != iter.second.end();
+            if (!requested)
+                continue;
+
+            const auto& value = outputNode->As<ComputationNode<ElemType>>()->Value();
+            size_t dim = value.GetNumRows();
+            m_buffer.resize(value.GetNumElements());
+            value.CopySection(dim, value.GetNumCols(), m_buffer.data(), dim);
+            size_t i = 0;
+            for (const auto& iter : inputs)
+            {
+                auto streamOutputs = outputs.find(iter.first);
+                if (streamOutputs != outputs.end())
+                {
+                    auto found = streamOutputs->second.find(outputNode->NodeName());
+                    if (found != streamOutputs->second.end())
+                    {
+                        auto& frames = *found->second;
+                        frames.resize(lengths[i] * dim);
+                        for (size_t t = 0; t < lengths[i]; t++)
+                            std::copy(m_buffer.begin() + (t * numStreams + i) * dim, m_buffer.begin() + (t * numStreams + i + 1) * dim, frames.begin() + t * dim);
+                    }
+                }
+                i++;
+            }
+        }
+
+        // keep the state at the last frame of each stream
+        std::vector<ptrdiff_t> lastFrames(numStreams);
+        for (size_t i = 0; i < numStreams; i++)
+            lastFrames[i] = (lengths[i] - 1) * numStreams + i;
+        SetColumnMap(lastFrames);
+        for (size_t k = 0; k < m_pastValueNodes.size(); k++)
+        {
+            m_pastValueNodes[k]->GatherDelayedValue(m_columnMap);
+            auto state = dynamic_pointer_cast<DelayedValueNodeState<ElemType>>(m_pastValueNodes[k]->ExportState());
+            const auto& lastValues = state->ExportCachedActivity();
+            auto& pool = *m_statePools[k];
+            if (pool.GetNumRows() != lastValues.GetNumRows())
+                pool.Resize(lastValues.GetNumRows(), m_capacity); // first chunk
+            for (size_t i = 0; i < numStreams; i++)
+                pool.SetColumnSlice(lastValues.ColumnSlice(i, 1), streams[i]->slot, 1);
+        }
+        for (size_t i = 0; i < numStreams; i++)
+            streams[i]->numFrames += lengths[i];
+
+        if (m_verbosity > 1)
+            fprintf(stderr, "StreamingEvaluator: chunk of %d streams, up to %d frames; %d open streams.\n", (int) numStreams, (int) numTimeSteps, (int) m_streams.size());
+    }
+
+    // EndStream - forget a stream; a later chunk with the same id starts a new stream
+    void EndStream(size_t streamId)
+    {
+        auto found = m_streams.find(streamId);
+        if (found == m_streams.end())
+            return;
+        m_freeSlots.push_back(found->second.slot);
+        m_streams.erase(found);
+    }
+
+    bool HasStream(size_t streamId) const { return m_streams.find(streamId) != m_streams.end(); }
+    size_t GetNumStreams() const { return m_streams.size(); }
+
+    // ExportStreamState - get the state of a stream after its last chunk, one DelayedValueNodeState per PastValue node name
+    // The stream must have seen at least one frame.
+    void ExportStreamState(size_t streamId, std::map<std::wstring, NodeStatePtr>& states) const
+    {
+        const auto& stream = GetStream(streamId);
+        if (stream.numFrames == 0)
+            InvalidArgument("StreamingEvaluator: Stream %d has no state yet.", (int) streamId);
+
+        auto stateLayout = CreateStateLayout(1);
+        states.clear();
+        for (size_t k = 0; k < m_pastValueNodes.size(); k++)
+        {
+            auto state = make_shared<DelayedValueNodeState<ElemType>>(m_net->GetDeviceId());
+            state->CacheState(m_statePools[k]->ColumnSlice(stream.slot, 1));
+            state->CacheDelayedMBLayout(stateLayout);
+            states[m_pastValueNodes[k]->NodeName()] = state;
+        }
+    }
+
+    // ImportStreamState - continue a stream from an exported state; an existing stream of that id is replaced
+    void ImportStreamState(size_t streamId, const std::map<std::wstring, NodeStatePtr>& states)
+    {
+        // validate everything before touching the stream
+        std::vector<DelayedNodeStatePtr> nodeStates;
+        for (size_t k = 0; k < m_pastValueNodes.size(); k++)
+        {
+            const auto& name = m_pastValueNodes[k]->NodeName();
+            auto found = states.find(name);
+            auto state = found != states.end() ? dynamic_pointer_cast<DelayedValueNodeState<ElemType>>(found->second) : nullptr;
+            if (!state || state->IsEmpty())
+                InvalidArgument("StreamingEvaluator: No state given for %ls.", name.c_str());
+            const auto& value = state->ExportCachedActivity();
+            size_t dim = ComputationNodeBasePtr(m_pastValueNodes[k])->GetSampleMatrixNumRows();
+            if (value.GetNumRows() != dim || value.GetNumCols() != 1)
+                InvalidArgument("StreamingEvaluator: The state for %ls must be a single column of dimension %d.", name.c_str(), (int) dim);
+            nodeStates.push_back(state);
+        }
+
+        EndStream(streamId);
+        Stream stream{AllocateSlot(), 1}; // (the actual number of frames does not matter, only that the stream continues)
+        for (size_t k = 0; k < m_pastValueNodes.size(); k++)
+        {
+            auto& pool = *m_statePools[k];
+            if (pool.GetNumRows() != nodeStates[k]->ExportCachedActivity().GetNumRows())
+                pool.Resize(nodeStates[k]->ExportCachedActivity().GetNumRows(), m_capacity);
+            pool.SetColumnSlice(nodeStates[k]->ExportCachedActivity(), stream.slot, 1);
+        }
+        m_streams[streamId] = stream;
+    }
+
+private:
+    struct Stream
+    {
+        size_t slot;      // column of this stream in the state pools
+        size_t numFrames; // frames evaluated so far
+    };
+
+    const Stream& GetStream(size_t streamId) const
+    {
+        auto found = m_streams.find(streamId);
+        if (found == m_streams.end())
+            InvalidArgument("StreamingEvaluator: Unknown stream %d.", (int) streamId);
+        return found->second;
+    }
+
+    // number of frames of a stream's chunk, validated against all inputs
+    size_t GetNumFrames(size_t streamId, const StreamBuffers& buffers) const
+    {
+        size_t numFrames = 0;
+        for (size_t i = 0; i < m_inputNodes.size(); i++)
+        {
+            const auto& name = m_inputNodes[i]->NodeName();
+            auto found = buffers.find(name);
+            if (found == buffers.end() || !found->second)
+                InvalidArgument("StreamingEvaluator: No input %ls given for stream %d.", name.c_str(), (int) streamId);
+            size_t dim = m_inputNodes[i]->GetSampleMatrixNumRows();
+            size_t size = found->second->size();
+            if (size % dim != 0 || (i > 0 && size / dim != numFrames))
+                InvalidArgument("StreamingEvaluator: Input %ls of stream %d does not hold the same number of whole frames as the other inputs.", name.c_str(), (int) streamId);
+            numFrames = size / dim;
+        }
+        if (numFrames == 0)
+            InvalidArgument("StreamingEvaluator: The chunk of stream %d is empty.", (int) streamId);
+        return numFrames;
+    }
+
+    // get a free column in the state pools, growing them as needed
+    size_t AllocateSlot()
+    {
+        if (m_freeSlots.empty())
+        {
+            size_t capacity = max((size_t) 16, 2 * m_capacity);
+            for (auto& pool : m_statePools)
+            {
+                if (pool->GetNumRows() == 0) // not sized yet (before the first chunk)
+                    continue;
+                Matrix<ElemType> grown(pool->GetNumRows(), capacity, pool->GetDeviceId());
+                if (m_capacity > 0)
+                    grown.SetColumnSlice(*pool, 0, m_capacity);
+                pool->SetValue(grown);
+            }
+            for (size_t slot = capacity; slot-- > m_capacity;)
+                m_freeSlots.push_back(slot);
+            m_capacity = capacity;
+        }
+        size_t slot = m_freeSlots.back();
+        m_freeSlots.pop_back();
+        return slot;
+    }
+
+    // layout of the carried-over state: one single-frame sequence per stream that started before and continues after
+    static MBLayoutPtr CreateStateLayout(size_t numStreams)
+    {
+        auto pMBLayout = make_shared<MBLayout>(numStreams, 1);
+        for (size_t s = 0; s < numStreams; s++)
+            pMBLayout->AddSequence(NEW_SEQUENCE_ID, s, -1, 2);
+        return pMBLayout;
+    }
+
+    // load 'indices' as a row vector into m_columnMap, for use with DoGatherColumnsOf() (negative indices denote gaps)
+    void SetColumnMap(const std::vector<ptrdiff_t>& indices)
+    {
+        m_columnMapBuffer.assign(indices.begin(), indices.end());
+        m_columnMap.SetValue(1, indices.size(), m_columnMap.GetDeviceId(), m_columnMapBuffer.data(), matrixFlagNormal);
+    }
+
+    ComputationNetworkPtr m_net;
+    int m_verbosity;
+
+    std::vector<ComputationNodeBasePtr> m_outputNodes;
+    std::vector<ComputationNodeBasePtr> m_inputNodes;
+    std::vector<shared_ptr<PastValueNode<ElemType>>> m_pastValueNodes;
+
+    std::map<size_t, Stream> m_streams;                         // open streams by id
+    std::vector<shared_ptr<Matrix<ElemType>>> m_statePools;     // per PastValue node: the state of each stream, one column per slot
+    std::vector<size_t> m_freeSlots;
+    size_t m_capacity;                                          // number of slots in the state pools
+
+    Matrix<ElemType> m_columnMap;
+    Matrix<ElemType> m_gathered;
+    std::vector<ElemType> m_columnMapBuffer;
+    std::vector<ElemType> m_buffer;
+
+    void operator=(const StreamingEvaluator&); // (not assignable)
+};
+
+}}}
@@ -13,6 +13,8 @@
 #include "latticefunctionskernels.h" // for emulation
 #include "cudalatticeops.h"
 #include <numeric> // for debug
+#include <algorithm>
+#include <omp.h> // for the multi-threaded CPU implementation
 #include "cudalib.h"
 
 #define TWO_CHANNEL // [v-hansu]
@@ -359,6 +361,224 @@ static void emulatemmierrorsignal(const std::vector<unsigned short>& alignstatei
                 });
 }
 
+// -----------------------------------------------------------------------
+// multi-threaded CPU implementation
+// The same kernels as above, distributed over OpenMP threads. Wherever several edges accumulate into the
+// same location through atomicLogAdd(), those edges are run by a single thread in exactly the order in
+// which emulatecuda() would visit them. Since log-add is not associative, this is what makes the results
+// bit-identical to the single-threaded emulation:
+//  - forward/backward: within a launch (one topological batch), edges are grouped by target node
+//  - error signals: each thread owns a range of frames and runs all edges restricted to those frames
+//  - element-wise steps and edge alignment write disjoint locations and are simply split up
+// -----------------------------------------------------------------------
+
+static const size_t minparallelbatch = 64; // batches smaller than this are not worth waking up the threads
+
+// the sequence of indices j < n in the order in which emulatecuda() would run them for a given shufflemode
+// The unshuffled kernels (j = thread index within block + block index * block size) correspond to shufflemode 0.
+static void emulationorder(const dim3& b, const dim3& t, const size_t shufflemode, const size_t n, std::vector<size_t>& order)
+{
+    order.clear();
+    for (size_t bx = 0; bx < b.x; bx++)
+        for (size_t ty = 0; ty < t.y; ty++)
+            for (size_t tx = 0; tx < t.x; tx++)
+            {
+                const size_t j = msra::lattices::latticefunctionskernels::shuffle(tx, t.x, ty, t.y, bx, b.x, shufflemode);
+                if (j < n)
+                    order.push_back(j);
+            }
+}
+
+// group a sequence of indices by key, preserving the original sequence order within each group
+// On return, group g consists of order[groupstarts[g]..groupstarts[g+1]).
+template <typename KEYFUNC>
+static void groupbykey(std::vector<size_t>& order, std::vector<size_t>& groupstarts, const KEYFUNC& key)
+{
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+                     {
+                         return key(a) < key(b);
+                     });
+    groupstarts.clear();
+    for (size_t k = 0; k < order.size(); k++)
+        if (k == 0 || key(order[k]) != key(order[k - 1]))
+            groupstarts.push_back(k);
+    groupstarts.push_back(order.size());
+}
+
+static void cpusetvalue(std::vector<double>& thisvector, double value)
+{
+#pragma omp parallel for schedule(static) if (thisvector.size() >= minparallelbatch)
+    for (long j = 0; j < (long) thisvector.size(); j++)
+        msra::lattices::latticefunctionskernels::setvaluej((size_t) j, thisvector, value);
+}
+
+// split the frames of an error-signal matrix into chunks for the threads to own
+static size_t numframechunks(size_t numframes)
+{
+    const size_t minframesperchunk = 16;
+    const size_t maxchunks = 4 * (size_t) omp_get_max_threads(); // allow for some load balancing
+    return std::max((size_t) 1, std::min(maxchunks, numframes / minframesperchunk));
+}
+
+static void cpuedgealignment(const std::vector<lrhmmdef>& hmms, const std::vector<lr3transP>& transPs, const size_t spalignunitid, const size_t silalignunitid,
+                             const std::vector<msra::lattices::nodeinfo>& nodes, const std::vector<msra::lattices::edgeinfowithscores>& edges,
+                             const std::vector<msra::lattices::aligninfo>& aligns,
+                             const msra::math::ssematrixbase& logLLs, const std::vector<unsigned int>& alignoffsets,
+                             std::vector<unsigned short>& backptrstorage, const std::vector<size_t>& backptroffsets,
+                             std::vector<unsigned short>& alignresult, std::vector<float>& edgeacscores)
+{
+    // each edge writes its own alignment, backpointer and score range; edges differ a lot in length, hence dynamic
+#pragma omp parallel for schedule(dynamic, 16)
+    for (long j = 0; j < (long) edges.size(); j++)
+        msra::lattices::latticefunctionskernels::edgealignmentj((size_t) j, hmms, transPs, spalignunitid, silalignunitid, logLLs, nodes, edges, aligns,
+                                                                alignoffsets, backptrstorage, backptroffsets, alignresult, edgeacscores);
+}
+
+static double cpuforwardbackwardlattice(const size_t* batchsizeforward, const size_t* batchsizebackward,
+                                        const size_t numlaunchforward, const size_t numlaunchbackward,
+                                        const size_t spalignunitid, const size_t silalignunitid,
+                                        const std::vector<float>& edgeacscores,
+                                        const std::vector<msra::lattices::edgeinfowithscores>& edges, const std::vector<msra::lattices::nodeinfo>& nodes,
+                                        const std::vector<msra::lattices::aligninfo>& aligns,
+                                        const std::vector<unsigned short>& alignments, const std::vector<unsigned int>& alignoffsets,
+                                        std::vector<double>& logpps, std::vector<double>& logalphas, std::vector<double>& logbetas,
+                                        const float lmf, const float wp, const float amf, const float boostingfactor, const bool returnEframescorrect,
+                                        const std::vector<unsigned short>& uids, const std::vector<unsigned short>& senone2classmap,
+                                        std::vector<double>& logaccalphas, std::vector<double>& logaccbetas, std::vector<double>& logframescorrectedge,
+                                        std::vector<double>& logEframescorrect, double& logEframescorrecttotal)
+{
+    const dim3 t(32, 8); // launch geometry of the emulation, which determines the accumulation order we must reproduce
+    const size_t tpb = t.x * t.y;
+    cpusetvalue(logalphas, LOGZERO);
+    cpusetvalue(logbetas, LOGZERO);
+    cpusetvalue(logaccalphas, LOGZERO);
+    cpusetvalue(logaccbetas, LOGZERO);
+
+    logalphas.front() = 0;
+    logbetas[nodes.size() - 1] = 0;
+
+    std::vector<size_t> order;       // edges of current launch, relative to its start index
+    std::vector<size_t> groupstarts; // groups of edges that accumulate into the same node
+
+    // forward pass
+    // An edge updates alpha of its end node E, and, for the added silence paths, E + nodes.size(); grouping by E covers both.
+    size_t startindex = 0;
+    for (size_t i = 0; i < numlaunchforward; i++)
+    {
+        const size_t batchsize = batchsizeforward[i];
+        emulationorder(dim3((batchsize + tpb - 1) / tpb), t, 1, batchsize, order);
+        groupbykey(order, groupstarts, [&](size_t j)
+                   {
+                       return edges[j + startindex].E;
+                   });
+#pragma omp parallel for schedule(dynamic) if (batchsize >= minparallelbatch)
+        for (long g = 0; g < (long) groupstarts.size() - 1; g++)
+        {
+            for (size_t k = groupstarts[g]; k < groupstarts[g + 1]; k++)
+                msra::lattices::latticefunctionskernels::forwardlatticej(order[k] + startindex, edgeacscores, spalignunitid, silalignunitid, edges, nodes, aligns, alignments, alignoffsets,
+                                                                         logalphas, lmf, wp, amf, boostingfactor, uids, senone2classmap, returnEframescorrect, logframescorrectedge, logaccalphas);
+        }
+        startindex += batchsize;
+    }
+    double totalfwscore = logalphas[nodes.size() - 1];
+
+    // backward pass, likewise grouped by start node S
+    startindex = edges.size();
+    for (size_t i = 0; i < numlaunchbackward; i++)
+    {
+        const size_t batchsize = batchsizebackward[i];
+        startindex -= batchsize;
+        emulationorder(dim3((batchsize + tpb - 1) / tpb), t, 0, batchsize, order);
+        groupbykey(order, groupstarts, [&](size_t j)
+                   {
+                       return edges[j + startindex].S;
+                   });
+#pragma omp parallel for schedule(dynamic) if (batchsize >= minparallelbatch)
+        for (long g = 0; g < (long) groupstarts.size() - 1; g++)
+        {
+            for (size_t k = groupstarts[g]; k < groupstarts[g + 1]; k++)
+                msra::lattices::latticefunctionskernels::backwardlatticej(order[k] + startindex, edgeacscores, spalignunitid, silalignunitid,
+                                                                          edges, nodes, aligns, totalfwscore, logpps, logalphas,
+                                                                          logbetas, lmf, wp, amf, boostingfactor, returnEframescorrect, logframescorrectedge,
+                                                                          logaccalphas, logEframescorrect, logaccbetas);
+        }
+    }
+    double totalbwscore = logbetas.front();
+    if (returnEframescorrect)
+        logEframescorrecttotal = logaccbetas.front() - totalbwscore;
+
+    double difffwbw = totalfwscore - totalbwscore;
+    double absdifffwbw = difffwbw > 0 ? difffwbw : 0 - difffwbw;
+    if (absdifffwbw / nodes.size() > 1e-4)
+        fprintf(stderr, "forwardbackward: WARNING: lattice fw and bw scores %.10f vs. %.10f (%d nodes/%d edges)\n", (float) totalfwscore, (float) totalbwscore, (int) nodes.size(), (int) edges.size());
+    return totalfwscore;
+}
+
+static void cpusMBRerrorsignal(const std::vector<unsigned short>& alignstateids, const std::vector<unsigned int>& alignoffsets,
+                               const std::vector<msra::lattices::edgeinfowithscores>& edges, const std::vector<msra::lattices::nodeinfo>& nodes,
+                               const std::vector<double>& logpps, const float amf,
+                               const std::vector<double>& logEframescorrect, const double logEframescorrecttotal,
+                               msra::math::ssematrixbase& errorsignal, msra::math::ssematrixbase& errorsignalneg)
+{
+    const dim3 t(32, 8);
+    const size_t tpb = t.x * t.y;
+    std::vector<size_t> order;
+    emulationorder(dim3((edges.size() + tpb - 1) / tpb), t, 3, edges.size(), order);
+
+    const size_t numframes = errorsignal.cols();
+    const size_t numchunks = numframechunks(numframes);
+#pragma omp parallel for schedule(dynamic)
+    for (long c = 0; c < (long) numchunks; c++)
+    {
+        const size_t tbegin = numframes * c / numchunks;
+        const size_t tend = numframes * (c + 1) / numchunks;
+        for (size_t tt = tbegin; tt < tend; tt++)
+            for (size_t s = 0; s < errorsignal.rows(); s++)
+                errorsignal(s, tt) = errorsignalneg(s, tt) = LOGZERO;
+        for (size_t k = 0; k < order.size(); k++)
+            msra::lattices::latticefunctionskernels::sMBRerrorsignalj(order[k], alignstateids, alignoffsets, edges, nodes, logpps, amf, logEframescorrect, logEframescorrecttotal,
+                                                                      errorsignal, errorsignalneg, tbegin, tend);
+        for (size_t tt = tbegin; tt < tend; tt++)
+            for (size_t s = 0; s < errorsignal.rows(); s++)
+                errorsignal(s, tt) = (expf(errorsignal(s, tt)) - expf(errorsignalneg(s, tt))) / amf; // same as errorcomputationi()
+    }
+}
+
+// shared by MMI error signal and state posteriors: accumulate per-edge logqs into logacc, optionally exponentiating the result
+static void cpustateposteriors(const std::vector<unsigned short>& alignstateids, const std::vector<unsigned int>& alignoffsets,
+                               const std::vector<msra::lattices::edgeinfowithscores>& edges, const std::vector<msra::lattices::nodeinfo>& nodes,
+                               const std::vector<double>& logqs, msra::math::ssematrixbase& logacc, const bool exponentiate)
+{
+    const dim3 t(32, 8);
+    const size_t tpb = t.x * t.y;
+    std::vector<size_t> order;
+    emulationorder(dim3((edges.size() + tpb - 1) / tpb), t, 3, edges.size(), order);
+
+    const size_t numframes = logacc.cols();
+    const size_t numchunks = numframechunks(numframes);
+#pragma omp parallel for schedule(dynamic)
+    for (long c = 0; c < (long) numchunks; c++)
+    {
+        const size_t tbegin = numframes * c / numchunks;
+        const size_t tend = numframes * (c + 1) / numchunks;
+        for (size_t tt = tbegin; tt < tend; tt++)
+            for (size_t s = 0; s < logacc.rows(); s++)
+                logacc(s, tt) = LOGZERO;
+        for (size_t k = 0; k < order.size(); k++)
+            msra::lattices::latticefunctionskernels::stateposteriorsj(order[k], alignstateids, alignoffsets, edges, nodes, logqs, logacc, tbegin, tend);
+        if (exponentiate)
+            for (size_t tt = tbegin; tt < tend; tt++)
+                for (size_t s = 0; s < logacc.rows(); s++)
+                    logacc(s, tt) = expf(logacc(s, tt));
+    }
+}
+
+// use the multi-threaded CPU implementation unless we only have one thread anyway
+static bool usecputhreads()
+{
+    return omp_get_max_threads() > 1;
+}
+
 // -----------------------------------------------------------------------
 // parallelstate (-impl) --holds variables for CUDA access
 // -----------------------------------------------------------------------
@@ -763,11 +983,18 @@ void lattice::parallelforwardbackwardalign(parallelstate& parallelstate,
         if (parallelstate->hmmscpuforgpu.size() == 0)
             throw ::logic_error("we no longer support emulation for edgealign, please copy hmmscpuforgpu and lr3transPcpuforgpu if you want");
         edgeacscores.resize(edges.size());
-        emulateedgealignment(parallelstate->hmmscpuforgpu, parallelstate->lr3transPcpuforgpu, parallelstate->spalignunitid,
+        if (usecputhreads())
+            cpuedgealignment(parallelstate->hmmscpuforgpu, parallelstate->lr3transPcpuforgpu, parallelstate->spalignunitid,
                              parallelstate->silalignunitid,
                              nodes, edges, align, logLLs, edgealignments.getalignoffsets(),
                              backpointers.getbackptrbuffer(), backpointers.getbackptroffsets(),
                              edgealignments.getalignmentsbuffer(), edgeacscores);
+        else
+            emulateedgealignment(parallelstate->hmmscpuforgpu, parallelstate->lr3transPcpuforgpu, parallelstate->spalignunitid,
+                                 parallelstate->silalignunitid,
+                                 nodes, edges, align, logLLs, edgealignments.getalignoffsets(),
+                                 backpointers.getbackptrbuffer(), backpointers.getbackptroffsets(),
+                                 edgealignments.getalignmentsbuffer(), edgeacscores);
         // emulate the GPU version, save result back to GPU
         parallelstate->alignresult->assign(edgealignments.getalignmentsbuffer(), false);
         parallelstate->edgeacscoresgpu->assign(edgeacscores, true);
@@ -871,13 +1098,22 @@ double lattice::parallelforwardbackwardlattice(parallelstate& parallelstate, con
             Eframescorrectbuf.resize(edges.size());
         }
 
-        totalfwscore = emulateforwardbackwardlattice(&batchsizeforward[0], &batchsizebackward[0],
+        if (usecputhreads())
+            totalfwscore = cpuforwardbackwardlattice(&batchsizeforward[0], &batchsizebackward[0],
                                                      batchsizeforward.size(), batchsizebackward.size(),
                                                      parallelstate->spalignunitid, parallelstate->silalignunitid,
                                                      edgeacscores, edges, nodes, align,
                                                      thisedgealignments.getalignmentsbuffer(), thisedgealignments.getalignoffsets(),
                                                      logpps, logalphas, logbetas, lmf, wp, amf, boostingfactor, returnEframescorrect, uidsuint, parallelstate->senone2classmapcpuforgpu,
-                                                     logaccalphas, logaccbetas, logframescorrectedge, logEframescorrect, Eframescorrectbuf, logEframescorrecttotal);
+                                                     logaccalphas, logaccbetas, logframescorrectedge, logEframescorrect, logEframescorrecttotal);
+        else
+            totalfwscore = emulateforwardbackwardlattice(&batchsizeforward[0], &batchsizebackward[0],
+                                                         batchsizeforward.size(), batchsizebackward.size(),
+                                                         parallelstate->spalignunitid, parallelstate->silalignunitid,
+                                                         edgeacscores, edges, nodes, align,
+                                                         thisedgealignments.getalignmentsbuffer(), thisedgealignments.getalignoffsets(),
+                                                         logpps, logalphas, logbetas, lmf, wp, amf, boostingfactor, returnEframescorrect, uidsuint, parallelstate->senone2classmapcpuforgpu,
+                                                         logaccalphas, logaccbetas, logframescorrectedge, logEframescorrect, Eframescorrectbuf, logEframescorrecttotal);
     }
     return totalfwscore;
 }
@@ -917,7 +1153,10 @@ void lattice::parallelsMBRerrorsignal(parallelstate& parallelstate, const edgeal
     }
     else
     {
-        emulatesMBRerrorsignal(thisedgealignments.getalignmentsbuffer(), thisedgealignments.getalignoffsets(), edges, nodes, logpps, amf, logEframescorrect, logEframescorrecttotal, errorsignal, errorsignalneg);
+        if (usecputhreads())
+            cpusMBRerrorsignal(thisedgealignments.getalignmentsbuffer(), thisedgealignments.getalignoffsets(), edges, nodes, logpps, amf, logEframescorrect, logEframescorrecttotal, errorsignal, errorsignalneg);
+        else
+            emulatesMBRerrorsignal(thisedgealignments.getalignmentsbuffer(), thisedgealignments.getalignoffsets(), edges, nodes, logpps, amf, logEframescorrect, logEframescorrecttotal, errorsignal, errorsignalneg);
     }
 }
 
@@ -940,7 +1179,10 @@ void lattice::parallelmmierrorsignal(parallelstate& parallelstate, const edgeali
     }
     else
     {
-        emulatemmierrorsignal(thisedgealignments.getalignmentsbuffer(), thisedgealignments.getalignoffsets(), edges, nodes, logpps, errorsignal);
+        if (usecputhreads())
+            cpustateposteriors(thisedgealignments.getalignmentsbuffer(), thisedgealignments.getalignoffsets(), edges, nodes, logpps, errorsignal, true /*exponentiate*/);
+        else
+            emulatemmierrorsignal(thisedgealignments.getalignmentsbuffer(), thisedgealignments.getalignoffsets(), edges, nodes, logpps, errorsignal);
     }
 }
 };
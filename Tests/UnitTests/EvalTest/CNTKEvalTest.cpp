@@ -5,14 +5,82 @@
 #include "Eval.h"
 #include "DataReader.h"
 #include "Config.h"
+#include <random>
 using namespace Microsoft::MSR::CNTK;
 
+// streamingLatency action: time the streaming evaluation of a recurrent model, one chunk of each stream per
+// EvaluateChunk() call with the state carried over, against re-evaluating each stream's history for every chunk
+//   modelPath, numStreams=16, numChunks=40, chunkLength=4, inputNodeName and outputNodeName (default: the model's first)
+template <typename ElemType>
+void DoStreamingLatency(ConfigParameters& config)
+{
+    size_t numStreams = config("numStreams", "16");
+    size_t numChunks = config("numChunks", "40");
+    size_t chunkLength = config("chunkLength", "4");
+    std::wstring modelPath = config("modelPath");
+
+    Eval<ElemType> eval(config);
+    eval.CreateNetwork("modelPath=" + std::string(modelPath.begin(), modelPath.end()));
+    std::map<std::wstring, size_t> inputDims, outputDims;
+    eval.GetNodeDimensions(inputDims, nodeInput);
+    eval.GetNodeDimensions(outputDims, nodeOutput);
+    if (inputDims.empty() || outputDims.empty())
+        RuntimeError("streamingLatency: The model has no input or no output node.");
+    std::wstring inputName = config("inputNodeName", inputDims.begin()->first.c_str());
+    std::wstring outputName = config("outputNodeName", outputDims.begin()->first.c_str());
+    size_t inputDim = inputDims[inputName];
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<ElemType> distribution(-1, 1);
+    std::vector<std::vector<ElemType>> frames(numStreams, std::vector<ElemType>(numChunks * chunkLength * inputDim));
+    for (auto& streamFrames : frames)
+        for (auto& value : streamFrames)
+            value = distribution(rng);
+
+    auto evaluate = [&](size_t firstFrame, size_t numFrames, size_t streamIdBase)
+    {
+        std::map<size_t, std::map<std::wstring, std::vector<ElemType>*>> inputs, outputs;
+        std::vector<std::vector<ElemType>> inputFrames(numStreams), outputFrames(numStreams);
+        for (size_t s = 0; s < numStreams; s++)
+        {
+            inputFrames[s].assign(frames[s].begin() + firstFrame * inputDim, frames[s].begin() + (firstFrame + numFrames) * inputDim);
+            inputs[streamIdBase + s][inputName] = &inputFrames[s];
+            outputs[streamIdBase + s][outputName] = &outputFrames[s];
+        }
+        eval.EvaluateChunk(inputs, outputs);
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t chunk = 0; chunk < numChunks; chunk++)
+        evaluate(chunk * chunkLength, chunkLength, 0);
+    double streamingSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (size_t chunk = 0; chunk < numChunks; chunk++)
+    {
+        size_t streamIdBase = (chunk + 1) * numStreams;
+        evaluate(0, (chunk + 1) * chunkLength, streamIdBase);
+        for (size_t s = 0; s < numStreams; s++)
+            eval.EndStream(streamIdBase + s);
+    }
+    double rerunSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    fprintf(stderr, "streamingLatency: %d streams, %d frames per chunk: %.3f ms per chunk streaming, %.3f ms per chunk re-evaluating the history\n",
+            (int) numStreams, (int) chunkLength, 1000 * streamingSeconds / numChunks, 1000 * rerunSeconds / numChunks);
+}
+
 // process the command
 template <typename ElemType>
 void DoCommand(const ConfigParameters& configRoot)
 {
     ConfigArray command = configRoot("command", "train");
     ConfigParameters config = configRoot(command[0]);
+    std::string action = config("action", "evaluate");
+    if (action == "streamingLatency")
+    {
+        DoStreamingLatency<ElemType>(config);
+        return;
+    }
     ConfigParameters readerConfig(config("reader"));
     readerConfig.Insert("traceLevel", config("traceLevel", "0"));
 
@@ -8,11 +8,15 @@
 #define NOMINMAX
 #include "Windows.h"
 #include <chrono>
+#include <functional>
 #include <iostream>
+#include <random>
 #include <vector>
 #include "Matrix.h"
 #include "CPUMatrix.h"
+#include "CPUSparseMatrix.h"
 #include "Sequences.h"
+#include "File.h"
 using namespace Microsoft::MSR::CNTK;
 using namespace std;
 
@@ -435,6 +439,342 @@ void MandSTest(int count, int devId)
     delete[] data3;
 }
 
+// compare bandwidth-bound element-wise ops and a GEMM with and without NUMA affinity
+// Buffers are allocated after switching the mode, so that first-touch placement applies to them.
+template <class ElemType>
+void NumaAffinityScalingTest(int n, int m, int count)
+{
+    cout << "Testing NUMA affinity, " << n << "x" << m << " matrices, " << count << " runs" << endl;
+    for (int numa = 0; numa < 2; numa++)
+    {
+        bool enabled = CPUMatrix<ElemType>::SetNumaAffinity(numa != 0);
+        CPUMatrix<ElemType> A(n, m), B(n, m), C(n, m), W(n, n);
+        A.SetUniformRandomValue(-1, 1, 1);
+        B.SetUniformRandomValue(-1, 1, 2);
+        W.SetUniformRandomValue(-1, 1, 3);
+
+        auto t_start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < count; ++i)
+        {
+            C.AssignElementProductOf(A, B);
+            C.InplaceSigmoid();
+        }
+        auto t_mid = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < count; ++i)
+            CPUMatrix<ElemType>::MultiplyAndWeightedAdd(1, W, false, A, false, 0, C);
+        auto t_end = std::chrono::high_resolution_clock::now();
+
+        cout << "NUMA affinity " << (enabled ? "on " : "off") << ": element-wise "
+             << std::chrono::duration<double>(t_mid - t_start).count() / count << " seconds, GEMM "
+             << std::chrono::duration<double>(t_end - t_mid).count() / count << " seconds" << endl;
+    }
+    CPUMatrix<ElemType>::SetNumaAffinity(false);
+}
+
+// time the blocked CPUMatrix data-movement kernels against the straightforward column loops they replace
+// The reference loops are kept here for comparison; each result is also checked against its reference.
+template <class ElemType>
+void DataMovementKernelsTest(size_t n, size_t m, int count)
+{
+    cout << "Testing data movement, " << n << "x" << m << ", " << count << " runs" << endl;
+    CPUMatrix<ElemType> A(n, m), B(n, m), C(n, m), ref(n, m);
+    A.SetUniformRandomValue(-1, 1, 1);
+
+    auto time = [count](const std::function<void()>& f)
+    {
+        f(); // warm-up, also allocates the result
+        auto t_start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < count; ++i)
+            f();
+        auto t_end = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double>(t_end - t_start).count() / count;
+    };
+    auto report = [](const char* what, double tRef, double tNew, bool same)
+    {
+        cout << what << ": reference " << tRef * 1e3 << " ms, CPUMatrix " << tNew * 1e3 << " ms, speed-up " << tRef / tNew
+             << (same ? "" : "  MISMATCH") << endl;
+    };
+
+    // transpose
+    double tRef = time([&]()
+                       {
+                           ref.Resize(m, n);
+#pragma omp parallel for
+                           for (long j = 0; j < (long) m; j++)
+                               for (size_t i = 0; i < n; i++)
+                                   ref(j, i) = A(i, j);
+                       });
+    double tNew = time([&]()
+                       {
+                           B.AssignTransposeOf(A);
+                       });
+    report("AssignTransposeOf     ", tRef, tNew, B.IsEqualTo(ref));
+
+    // row slice of the middle half
+    size_t startRow = n / 4, numRows = n / 2;
+    tRef = time([&]()
+                {
+                    ref.Resize(numRows, m);
+#pragma omp parallel for
+                    for (long j = 0; j < (long) m; j++)
+                        for (size_t i = 0; i < numRows; i++)
+                            ref(i, j) = A(startRow + i, j);
+                });
+    tNew = time([&]()
+                {
+                    B.AssignRowSliceValuesOf(A, startRow, numRows);
+                });
+    report("AssignRowSliceValuesOf", tRef, tNew, B.IsEqualTo(ref));
+
+    // gather and scatter with a map that reverses the column order
+    CPUMatrix<ElemType> map(1, m);
+    for (size_t j = 0; j < m; j++)
+        map(0, j) = (ElemType) (m - 1 - j);
+    tRef = time([&]()
+                {
+                    ref.Resize(n, m);
+#pragma omp parallel for
+                    for (long j = 0; j < (long) m; j++)
+                        for (size_t i = 0; i < n; i++)
+                            ref(i, j) = A(i, (size_t) map(0, j));
+                });
+    tNew = time([&]()
+                {
+                    C.DoGatherColumnsOf(0, map, A, 1);
+                });
+    report("DoGatherColumnsOf     ", tRef, tNew, C.IsEqualTo(ref));
+    tNew = time([&]()
+                {
+                    C.Resize(n, m);
+                    C.DoScatterColumnsOf(0, map, A, 1);
+                });
+    report("DoScatterColumnsOf    ", tRef, tNew, C.IsEqualTo(ref));
+}
+
+// time saving and loading a model-sized matrix in binary format, against writing it element by element
+// For a 500M-parameter model, use e.g. (25000, 20000); this needs 2 GB of RAM per matrix and of disk space.
+template <class ElemType>
+void MatrixSaveLoadTest(size_t n, size_t m)
+{
+    cout << "Testing matrix save/load, " << n << "x" << m << " = " << n * m / 1e6 << "M parameters" << endl;
+    CPUMatrix<ElemType> A(n, m);
+    A.SetUniformRandomValue(-1, 1, 1);
+    const std::wstring fileName(L"MatrixSaveLoadTest.bin");
+
+    auto t_start = std::chrono::high_resolution_clock::now();
+    {
+        File file(fileName, fileOptionsBinary | fileOptionsWrite);
+        foreach_coord (i, j, A) // what operator<< used to do
+            file << A(i, j);
+    }
+    auto t_elementwise = std::chrono::high_resolution_clock::now();
+    {
+        File file(fileName, fileOptionsBinary | fileOptionsWrite);
+        file << A;
+    }
+    auto t_saved = std::chrono::high_resolution_clock::now();
+    CPUMatrix<ElemType> B;
+    {
+        File file(fileName, fileOptionsBinary | fileOptionsRead);
+        file >> B;
+    }
+    auto t_loaded = std::chrono::high_resolution_clock::now();
+
+    cout << "element-wise save " << std::chrono::duration<double>(t_elementwise - t_start).count() << " seconds, save "
+         << std::chrono::duration<double>(t_saved - t_elementwise).count() << " seconds, load "
+         << std::chrono::duration<double>(t_loaded - t_saved).count() << " seconds"
+         << (B.IsEqualTo(A, 0) ? "" : "  MISMATCH") << endl;
+    _wunlink(fileName.c_str());
+}
+
+// time the dense x sparse products of a layer with sparse input against the single-threaded loops they replace
+// The input has nonzerosPerColumn nonzeros per column on average, with document lengths uniform in
+// [1, 2 * nonzerosPerColumn) and feature ids drawn log-uniformly, which makes a few features very frequent like words.
+template <class ElemType>
+void SparseProductKernelsTest(size_t hiddenDim, size_t inputDim, size_t minibatchSize, size_t nonzerosPerColumn, int count)
+{
+    cout << "Testing sparse products, hidden " << hiddenDim << ", input " << inputDim << ", minibatch " << minibatchSize << ", "
+         << nonzerosPerColumn << " nonzeros per column, " << count << " runs" << endl;
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    vector<CPUSPARSE_INDEX_TYPE> colStarts, rowIndices;
+    vector<ElemType> values;
+    for (size_t j = 0; j < minibatchSize; j++)
+    {
+        colStarts.push_back((CPUSPARSE_INDEX_TYPE) values.size());
+        vector<CPUSPARSE_INDEX_TYPE> rows;
+        for (size_t length = 1 + rng() % (2 * nonzerosPerColumn - 1); rows.size() < length;)
+        {
+            CPUSPARSE_INDEX_TYPE row = (CPUSPARSE_INDEX_TYPE) (pow((double) inputDim, uniform(rng)) - 1);
+            if (find(rows.begin(), rows.end(), row) == rows.end())
+                rows.push_back(row);
+        }
+        sort(rows.begin(), rows.end());
+        for (auto row : rows)
+        {
+            rowIndices.push_back(row);
+            values.push_back((ElemType) uniform(rng));
+        }
+    }
+    colStarts.push_back((CPUSPARSE_INDEX_TYPE) values.size());
+    CPUSparseMatrix<ElemType> X(matrixFormatSparseCSC);
+    X.SetMatrixFromCSCFormat(colStarts.data(), rowIndices.data(), values.data(), values.size(), inputDim, minibatchSize);
+
+    CPUMatrix<ElemType> W(hiddenDim, inputDim), dY(hiddenDim, minibatchSize), Y, ref, dW(hiddenDim, inputDim);
+    W.SetUniformRandomValue(-1, 1, 1);
+    dY.SetUniformRandomValue(-1, 1, 2);
+
+    auto time = [count](const std::function<void()>& f)
+    {
+        f(); // warm-up, also allocates the result
+        auto t_start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < count; ++i)
+            f();
+        auto t_end = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double>(t_end - t_start).count() / count;
+    };
+    auto report = [](const char* what, double tRef, double tNew, bool same)
+    {
+        cout << what << ": reference " << tRef * 1e3 << " ms, CPUSparseMatrix " << tNew * 1e3 << " ms, speed-up " << tRef / tNew
+             << (same ? "" : "  MISMATCH") << endl;
+    };
+
+    // forward: W * X
+    double tRef = time([&]()
+                       {
+                           ref.Resize(hiddenDim, minibatchSize);
+                           ref.SetValue(0);
+                           for (size_t j = 0; j < minibatchSize; j++)
+                               for (CPUSPARSE_INDEX_TYPE p = colStarts[j]; p < colStarts[j + 1]; p++)
+                                   for (size_t h = 0; h < hiddenDim; h++)
+                                       ref(h, j) += W(h, rowIndices[p]) * values[p];
+                       });
+    double tNew = time([&]()
+                       {
+                           CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(1, W, false, X, false, 0, Y);
+                       });
+    report("W * X                 ", tRef, tNew, Y.IsEqualTo(ref));
+
+    // weight gradient: dY * X^T, dense and block-sparse
+    tRef = time([&]()
+                {
+                    ref.Resize(hiddenDim, inputDim);
+                    ref.SetValue(0);
+                    for (size_t j = 0; j < minibatchSize; j++)
+                        for (CPUSPARSE_INDEX_TYPE p = colStarts[j]; p < colStarts[j + 1]; p++)
+                            for (size_t h = 0; h < hiddenDim; h++)
+                                ref(h, rowIndices[p]) += dY(h, j) * values[p];
+                });
+    tNew = time([&]()
+                {
+                    CPUSparseMatrix<ElemType>::MultiplyAndWeightedAdd(1, dY, false, X, true, 0, dW);
+                });
+    report("dY * X^T              ", tRef, tNew, dW.IsEqualTo(ref));
+    CPUSparseMatrix<ElemType> sparseGradient(matrixFormatSparseBlockCol);
+    tNew = time([&]()
+                {
+                    sparseGradient.Reset();
+                    CPUSparseMatrix<ElemType>::MultiplyAndAdd(1, dY, false, X, true, sparseGradient);
+                });
+    dW.SetValue(0);
+    CPUSparseMatrix<ElemType>::ScaleAndAdd(1, sparseGradient, dW);
+    report("dY * X^T, block-sparse", tRef, tNew, dW.IsEqualTo(ref));
+}
+
+// time the fused GMM log-likelihood kernels against the chain of matrix operations GMMLogLikelihoodNode evaluates on
+// other devices, for isotropic components with parameters shared by all frames
+template <class ElemType>
+void GMMLogLikelihoodTest(size_t featureDim, size_t numComponents, size_t numFrames, int count)
+{
+    cout << "Testing GMM log-likelihood, feature dim " << featureDim << ", " << numComponents << " components, " << numFrames << " frames, "
+         << count << " runs" << endl;
+    const size_t D = featureDim, K = numComponents, T = numFrames;
+    Matrix<ElemType> unnormedPrior(K, 1, CPUDEVICE), mean(K * D, 1, CPUDEVICE), logStdDev(K, 1, CPUDEVICE), feature(D, T, CPUDEVICE);
+    unnormedPrior.SetUniformRandomValue(-1, 1, 1);
+    mean.SetUniformRandomValue(-1, 1, 2);
+    logStdDev.SetUniformRandomValue(-0.5, 0.5, 3);
+    feature.SetUniformRandomValue(-1, 1, 4);
+    Matrix<ElemType> gradient(1, T, CPUDEVICE), ones(1, K, CPUDEVICE), onesT(T, 1, CPUDEVICE);
+    gradient.SetUniformRandomValue(-1, 1, 5);
+    ones.SetValue(1);
+    onesT.SetValue(1);
+
+    Matrix<ElemType> logLikelihood(CPUDEVICE), posterior(CPUDEVICE), meanGradient(K * D, 1, CPUDEVICE);
+    Matrix<ElemType> refLogLikelihood(CPUDEVICE), refPosterior(CPUDEVICE), refMeanGradient(K * D, 1, CPUDEVICE);
+    Matrix<ElemType> prior(CPUDEVICE), stddev(CPUDEVICE), normedDeviationVectors(CPUDEVICE), normedDeviation(CPUDEVICE), temp(CPUDEVICE);
+
+    auto time = [count](const std::function<void()>& f)
+    {
+        f(); // warm-up, also allocates the result
+        auto t_start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < count; ++i)
+            f();
+        auto t_end = std::chrono::high_resolution_clock::now();
+        return std::chrono::duration<double>(t_end - t_start).count() / count;
+    };
+    auto report = [](const char* what, double tRef, double tNew, bool same)
+    {
+        cout << what << ": matrix operations " << tRef * 1e3 << " ms, fused " << tNew * 1e3 << " ms, speed-up " << tRef / tNew
+             << (same ? "" : "  MISMATCH") << endl;
+    };
+
+    // forward
+    double tRef = time([&]()
+                       {
+                           prior.AssignLogSoftmaxOf(unnormedPrior, true);
+                           prior.InplaceExp();
+                           stddev.AssignExpOf(logStdDev);
+                           normedDeviationVectors.AssignRepeatOf(feature, K, 1);
+                           normedDeviationVectors -= mean;
+                           normedDeviationVectors.Reshape(D, T * K);
+                           normedDeviation.AssignVectorNorm2Of(normedDeviationVectors, true);
+                           normedDeviation ^= 2;
+                           temp.AssignRepeatOf(stddev, 1, T);
+                           temp.Reshape(1, T * K);
+                           temp ^= 2;
+                           normedDeviation.ElementDivideBy(temp);
+                           normedDeviationVectors.RowElementDivideBy(temp);
+                           normedDeviationVectors.Reshape(D * K, T);
+                           refPosterior.AssignProductOf(-0.5f, normedDeviation);
+                           temp.InplaceLog();
+                           temp *= (ElemType) D / 2;
+                           refPosterior -= temp;
+                           refPosterior -= (ElemType)(D / 2.0 * log(TWO_PI));
+                           refPosterior.InplaceExp();
+                           normedDeviation.Reshape(K, T);
+                           refPosterior.Reshape(K, T);
+                           refPosterior.ColumnElementMultiplyWith(prior);
+                           Matrix<ElemType>::Multiply(ones, false, refPosterior, false, refLogLikelihood);
+                           refPosterior.RowElementDivideBy(refLogLikelihood);
+                           refLogLikelihood.InplaceLog();
+                       });
+    double tNew = time([&]()
+                       {
+                           Matrix<ElemType>::GMMLogLikelihood(unnormedPrior, mean, logStdDev, feature, logLikelihood, posterior);
+                       });
+    report("log-likelihood", tRef, tNew, logLikelihood.IsEqualTo(refLogLikelihood, 1e-3f) && posterior.IsEqualTo(refPosterior, 1e-4f));
+
+    // gradient w.r.t. the means, summed over the frames
+    tRef = time([&]()
+                {
+                    temp.SetValue(normedDeviationVectors);
+                    temp.Reshape(D, T * K);
+                    refPosterior.Reshape(1, T * K);
+                    temp.RowElementMultiplyWith(refPosterior);
+                    refPosterior.Reshape(K, T);
+                    temp.Reshape(D * K, T);
+                    temp.RowElementMultiplyWith(gradient);
+                    refMeanGradient.SetValue(0);
+                    Matrix<ElemType>::MultiplyAndAdd(temp, false, onesT, false, refMeanGradient);
+                });
+    tNew = time([&]()
+                {
+                    meanGradient.SetValue(0);
+                    Matrix<ElemType>::GMMLogLikelihoodGradient(1, gradient, posterior, unnormedPrior, mean, logStdDev, feature, meanGradient);
+                });
+    report("mean gradient ", tRef, tNew, meanGradient.IsEqualTo(refMeanGradient, 1e-2f));
+}
+
 int wmain()
 {
     ColumnSliceMultAndAddTest<float>(2048, 2048, 256, 0);
@@ -443,6 +783,21 @@ int wmain()
 
     TestOldRnnForwardPropSRP<float>();
 
+    NumaAffinityScalingTest<float>(4096, 4096, 10);
+
+    DataMovementKernelsTest<float>(4096, 4096, 10); // square
+    DataMovementKernelsTest<float>(512, 65536, 10); // hidden layer x minibatch
+    DataMovementKernelsTest<float>(65536, 8, 10);   // few tall columns
+
+    MatrixSaveLoadTest<float>(5000, 5000); // 25M parameters
+    // MatrixSaveLoadTest<float>(25000, 20000); // 500M parameters; needs 2 GB of disk and 4 GB of memory
+
+    SparseProductKernelsTest<float>(512, 50000, 1024, 1, 10);   // word embedding, one-hot input
+    SparseProductKernelsTest<float>(300, 50000, 1024, 30, 10);  // DSSM, letter-trigram bag of words
+    SparseProductKernelsTest<float>(256, 100000, 512, 100, 10); // LibSVM-style feature vectors
+
+    GMMLogLikelihoodTest<float>(39, 256, 1024, 10); // MFCC features, 256-component GMM
+
     // MandSTest<float>(100, 2);
 
     /*cout<<endl<<"********************Matrix SquareMultiplyAndWeightedAdd10TimesAvg TEST********************"<<endl;
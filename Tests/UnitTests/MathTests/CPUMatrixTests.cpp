@@ -568,6 +568,22 @@ BOOST_FIXTURE_TEST_CASE(CPUMatrixTranspose, RandomSeedFixture)
     BOOST_CHECK(m2.IsEqualTo(m0, c_epsilonFloatE4));
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUMatrixTransposeTiled, RandomSeedFixture)
+{
+    // large enough for several tiles and parallel execution, with partial tiles at both edges
+    DMatrix m0(300, 77);
+    m0.SetUniformRandomValue(-1, 1, IncrementCounter());
+
+    DMatrix m1;
+    m1.AssignTransposeOf(m0);
+    BOOST_CHECK_EQUAL(m1.GetNumRows(), 77);
+    BOOST_CHECK_EQUAL(m1.GetNumCols(), 300);
+    foreach_coord (i, j, m0)
+    {
+        BOOST_CHECK_EQUAL(m1(j, i), m0(i, j));
+    }
+}
+
 BOOST_FIXTURE_TEST_CASE(CPUMatrixColumnSlice, RandomSeedFixture)
 {
     DMatrix m0(2, 3);
@@ -848,6 +864,42 @@ BOOST_FIXTURE_TEST_CASE(CPUAssignRepeatOf, RandomSeedFixture)
     BOOST_CHECK(m1.IsEqualTo(m2, c_epsilonFloatE4));
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUMatrixGatherScatterColumns, RandomSeedFixture)
+{
+    const size_t numRows = 1000, numCols = 40;
+    DMatrix m0(numRows, numCols);
+    m0.SetUniformRandomValue(-1, 1, IncrementCounter());
+
+    // map with gaps (-1) and with several source columns for the same target
+    DMatrix map(1, numCols);
+    for (size_t j = 0; j < numCols; j++)
+        map(0, j) = (j % 5 == 4) ? -1 : (double) (j / 3);
+
+    DMatrix gathered;
+    gathered.DoGatherColumnsOf(0, map, m0, 1);
+    for (size_t j = 0; j < numCols; j++)
+    {
+        if (map(0, j) < 0)
+            continue;
+        for (size_t i = 0; i < numRows; i++)
+            BOOST_CHECK_EQUAL(gathered(i, j), m0(i, (size_t) map(0, j)));
+    }
+
+    DMatrix scattered(numRows, numCols);
+    scattered.SetValue(1);
+    scattered.DoScatterColumnsOf(2, map, m0, 1);
+    DMatrix expected(numRows, numCols);
+    expected.SetValue(2);
+    for (size_t j = 0; j < numCols; j++)
+    {
+        if (map(0, j) < 0)
+            continue;
+        for (size_t i = 0; i < numRows; i++)
+            expected(i, (size_t) map(0, j)) += m0(i, j);
+    }
+    BOOST_CHECK(scattered.IsEqualTo(expected, c_epsilonFloatE4));
+}
+
 BOOST_FIXTURE_TEST_CASE(CPURowElementOperations, RandomSeedFixture)
 {
     DMatrix m0 = DMatrix::RandomUniform(20, 28, -1, 1, IncrementCounter());
@@ -874,6 +926,129 @@ BOOST_FIXTURE_TEST_CASE(CPUColumnElementOperations, RandomSeedFixture)
     BOOST_CHECK(m0.IsEqualTo(m2, c_epsilonFloatE4));
 }
 
+// The fused GMM log-likelihood must match the direct formula, for shared and per-frame parameters and for isotropic and
+// diagonal covariances, and its gradients must match finite differences.
+BOOST_FIXTURE_TEST_CASE(CPUMatrixGMMLogLikelihood, RandomSeedFixture)
+{
+    const size_t K = 4; // components
+    const size_t D = 5; // feature dimension
+    const size_t T = 13; // frames
+    for (bool shared : {true, false})
+    {
+        for (bool diagonal : {false, true})
+        {
+            const size_t P = shared ? 1 : T;
+            DMatrix unnormedPrior = DMatrix::RandomUniform(K, P, -1, 1, IncrementCounter());
+            DMatrix mean = DMatrix::RandomUniform(K * D, P, -1, 1, IncrementCounter());
+            DMatrix logStdDev = DMatrix::RandomUniform(diagonal ? K * D : K, P, -0.5, 0.5, IncrementCounter());
+            DMatrix feature = DMatrix::RandomUniform(D, T, -1, 1, IncrementCounter());
+            DMatrix logLikelihood, posterior;
+            DMatrix::GMMLogLikelihood(unnormedPrior, mean, logStdDev, feature, logLikelihood, posterior);
+
+            for (size_t t = 0; t < T; t++)
+            {
+                const size_t p = shared ? 0 : t;
+                double priorSum = 0;
+                for (size_t c = 0; c < K; c++)
+                    priorSum += exp(unnormedPrior(c, p));
+                vector<double> componentLikelihoods(K);
+                double likelihood = 0;
+                for (size_t c = 0; c < K; c++)
+                {
+                    double density = exp(unnormedPrior(c, p)) / priorSum;
+                    for (size_t d = 0; d < D; d++)
+                    {
+                        double stdDev = exp(logStdDev(diagonal ? c * D + d : c, p));
+                        double deviation = (feature(d, t) - mean(c * D + d, p)) / stdDev;
+                        density *= exp(-deviation * deviation / 2) / (sqrt(2 * pi) * stdDev);
+                    }
+                    componentLikelihoods[c] = density;
+                    likelihood += density;
+                }
+                BOOST_CHECK_CLOSE(logLikelihood(0, t), log(likelihood), 1e-8);
+                for (size_t c = 0; c < K; c++)
+                    BOOST_CHECK_SMALL(posterior(c, t) - componentLikelihoods[c] / likelihood, 1e-10);
+            }
+
+            // gradients of sum_t weight_t * logLikelihood_t
+            DMatrix weight = DMatrix::RandomUniform(1, T, -1, 1, IncrementCounter());
+            DMatrix* inputs[] = {&unnormedPrior, &mean, &logStdDev, &feature};
+            for (size_t inputIndex = 0; inputIndex < 4; inputIndex++)
+            {
+                DMatrix& input = *inputs[inputIndex];
+                DMatrix gradient(input.GetNumRows(), input.GetNumCols());
+                gradient.SetValue(0);
+                DMatrix::GMMLogLikelihoodGradient(inputIndex, weight, posterior, unnormedPrior, mean, logStdDev, feature, gradient);
+
+                const double h = 1e-6;
+                foreach_coord (i, j, input)
+                {
+                    double objective[2];
+                    for (int sign = 0; sign < 2; sign++)
+                    {
+                        const double value = input(i, j);
+                        input(i, j) = value + (sign ? h : -h);
+                        DMatrix perturbedLogLikelihood, perturbedPosterior;
+                        DMatrix::GMMLogLikelihood(unnormedPrior, mean, logStdDev, feature, perturbedLogLikelihood, perturbedPosterior);
+                        input(i, j) = value;
+                        objective[sign] = 0;
+                        for (size_t t = 0; t < T; t++)
+                            objective[sign] += weight(0, t) * perturbedLogLikelihood(0, t);
+                    }
+                    BOOST_CHECK_SMALL(gradient(i, j) - (objective[1] - objective[0]) / (2 * h), 1e-6);
+                }
+            }
+        }
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUMatrixNCESharedNoiseSamples, RandomSeedFixture)
+{
+    // when the noise samples are shared by all instances of the minibatch, the NCE criterion and its derivatives are
+    // computed with GEMMs; they must match the per-instance computation, i.e. calls on single-column slices
+    const size_t hdSize = 8, vocabSize = 30, numNoiseSamples = 5, batchSize = 16;
+    const size_t noise[numNoiseSamples] = {3, 17, 3, 29, 0}; // with a repeated word
+    DMatrix samples(2 * (numNoiseSamples + 1), batchSize);
+    for (size_t j = 0; j < batchSize; j++)
+    {
+        samples(0, j) = (double) ((j * 7) % vocabSize); // target word and its log probability
+        samples(1, j) = -std::log((double) vocabSize);
+        for (size_t k = 0; k < numNoiseSamples; k++)
+        {
+            samples(2 * (k + 1), j) = (double) noise[k];
+            samples(2 * (k + 1) + 1, j) = std::log((double) vocabSize);
+        }
+    }
+    DMatrix hidden = DMatrix::RandomUniform(hdSize, batchSize, -1, 1, 1);
+    DMatrix embedding = DMatrix::RandomUniform(hdSize, vocabSize, -1, 1, 2);
+    DMatrix bias = DMatrix::RandomUniform(1, vocabSize, -1, 1, 3);
+
+    DMatrix tmp(numNoiseSamples + 1, batchSize), value(1, 1);
+    samples.AssignNoiseContrastiveEstimation(hidden, embedding, bias, tmp, value);
+    DMatrix hiddenGrad = DMatrix::Zeros(hdSize, batchSize), embeddingGrad = DMatrix::Zeros(hdSize, vocabSize), biasGrad = DMatrix::Zeros(1, vocabSize);
+    samples.AssignNCEDerivative(tmp, hidden, embedding, 1, hiddenGrad);
+    samples.AssignNCEDerivative(tmp, hidden, embedding, 2, embeddingGrad);
+    samples.AssignNCEDerivative(tmp, hidden, embedding, 3, biasGrad);
+
+    double expectedValue = 0;
+    DMatrix expectedEmbeddingGrad = DMatrix::Zeros(hdSize, vocabSize), expectedBiasGrad = DMatrix::Zeros(1, vocabSize);
+    for (size_t j = 0; j < batchSize; j++)
+    {
+        DMatrix samplesColumn = samples.ColumnSlice(j, 1), hiddenColumn = hidden.ColumnSlice(j, 1);
+        DMatrix tmpColumn(numNoiseSamples + 1, 1), valueColumn(1, 1), hiddenGradColumn = DMatrix::Zeros(hdSize, 1);
+        samplesColumn.AssignNoiseContrastiveEstimation(hiddenColumn, embedding, bias, tmpColumn, valueColumn);
+        samplesColumn.AssignNCEDerivative(tmpColumn, hiddenColumn, embedding, 1, hiddenGradColumn);
+        samplesColumn.AssignNCEDerivative(tmpColumn, hiddenColumn, embedding, 2, expectedEmbeddingGrad);
+        samplesColumn.AssignNCEDerivative(tmpColumn, hiddenColumn, embedding, 3, expectedBiasGrad);
+        expectedValue += valueColumn(0, 0);
+        BOOST_CHECK(tmpColumn.IsEqualTo(tmp.ColumnSlice(j, 1), 1e-12));
+        BOOST_CHECK(hiddenGradColumn.IsEqualTo(hiddenGrad.ColumnSlice(j, 1), 1e-12));
+    }
+    BOOST_CHECK_CLOSE(value(0, 0), expectedValue, 1e-10);
+    BOOST_CHECK(embeddingGrad.IsEqualTo(expectedEmbeddingGrad, 1e-12));
+    BOOST_CHECK(biasGrad.IsEqualTo(expectedBiasGrad, 1e-12));
+}
+
 BOOST_FIXTURE_TEST_CASE(CPUMatrixSeedingFloat, RandomSeedFixture)
 {
     const float low = 0;
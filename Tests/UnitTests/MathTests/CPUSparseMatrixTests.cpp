@@ -59,6 +59,194 @@ BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixCopyColumnSliceToDense, RandomSeedFixture
     BOOST_CHECK(dm1.IsEqualTo(dm2, c_epsilonFloatE4));
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixLazyBlockGradientUpdates, RandomSeedFixture)
+{
+    const size_t dim = 8;
+    const size_t vocab = 50;
+    const size_t samples = 6;
+    DenseMatrix outGrad(dim, samples);
+    outGrad.SetUniformRandomValue(-1, 1, IncrementCounter());
+
+    // one-hot input with repeated word ids, like an embedding lookup
+    SparseMatrix input(MatrixFormat::matrixFormatSparseCSC, vocab, samples, 0);
+    for (size_t j = 0; j < samples; j++)
+        input.SetValue((j * 3) % 9, j, 1);
+
+    // block-sparse gradient, accumulated over two halves of the minibatch
+    SparseMatrix sparseGrad(MatrixFormat::matrixFormatSparseBlockCol);
+    SparseMatrix::MultiplyAndAdd(1, outGrad.ColumnSlice(0, samples / 2), false, input.ColumnSlice(0, samples / 2), true, sparseGrad);
+    SparseMatrix::MultiplyAndAdd(1, outGrad.ColumnSlice(samples / 2, samples / 2), false, input.ColumnSlice(samples / 2, samples / 2), true, sparseGrad);
+    DenseMatrix denseGrad(dim, vocab);
+    SparseMatrix::MultiplyAndWeightedAdd(1, outGrad, false, input, true, 0, denseGrad);
+
+    DenseMatrix denseWeights(dim, vocab);
+    denseWeights.SetUniformRandomValue(-1, 1, IncrementCounter());
+    DenseMatrix sparseWeights(denseWeights);
+
+    // FSAdagrad: untouched columns have zero state, so lazy and dense updates agree everywhere
+    DenseMatrix denseState, sparseState;
+    for (size_t step = 0; step < 2; step++)
+    {
+        denseState.FSAdagrad(denseGrad, denseWeights, 0.1, 0.9, 0.95, 0.0025);
+        sparseGrad.FSAdagrad(sparseState, sparseWeights, 0.1, 0.9, 0.95, 0.0025);
+    }
+    BOOST_CHECK(denseWeights.IsEqualTo(sparseWeights, c_epsilonFloatE5));
+
+    // RmsProp scales the gradient in place
+    DenseMatrix denseRmsState, sparseRmsState;
+    denseRmsState.RmsProp(denseGrad, 0.99, 1.2, 10, 0.75, 0.1, false);
+    sparseGrad.RmsProp(sparseRmsState, 0.99, 1.2, 10, 0.75, 0.1, false);
+    DenseMatrix::ScaleAndAdd(-0.1, denseGrad, denseWeights);
+    SparseMatrix::ScaleAndAdd(-0.1, sparseGrad, sparseWeights);
+    BOOST_CHECK(denseWeights.IsEqualTo(sparseWeights, c_epsilonFloatE5));
+}
+
+// sparse x dense must agree with dense x dense for CSC and CSR and all transpositions, e.g. for pruned weights
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixSparseTimesDense, RandomSeedFixture)
+{
+    const size_t m = 70;
+    const size_t k = 90;
+    const size_t n = 33;
+    DenseMatrix denseA(m, k);
+    denseA.SetUniformRandomValue(-1, 1, IncrementCounter());
+    foreach_coord (row, col, denseA)
+    {
+        if (fabs(denseA(row, col)) < 0.8)
+            denseA(row, col) = 0;
+    }
+
+    // compress along columns (CSC) or rows (CSR)
+    auto compress = [&](bool byRows, vector<CPUSPARSE_INDEX_TYPE>& starts, vector<CPUSPARSE_INDEX_TYPE>& indices, vector<double>& values)
+    {
+        size_t outer = byRows ? m : k, inner = byRows ? k : m;
+        for (size_t a = 0; a < outer; a++)
+        {
+            starts.push_back((CPUSPARSE_INDEX_TYPE) values.size());
+            for (size_t b = 0; b < inner; b++)
+            {
+                double value = byRows ? denseA(a, b) : denseA(b, a);
+                if (value != 0)
+                {
+                    indices.push_back((CPUSPARSE_INDEX_TYPE) b);
+                    values.push_back(value);
+                }
+            }
+        }
+        starts.push_back((CPUSPARSE_INDEX_TYPE) values.size());
+    };
+    vector<CPUSPARSE_INDEX_TYPE> cscStarts, cscRows, csrStarts, csrCols;
+    vector<double> cscValues, csrValues;
+    compress(false, cscStarts, cscRows, cscValues);
+    compress(true, csrStarts, csrCols, csrValues);
+    SparseMatrix cscA(MatrixFormat::matrixFormatSparseCSC);
+    cscA.SetMatrixFromCSCFormat(cscStarts.data(), cscRows.data(), cscValues.data(), cscValues.size(), m, k);
+    SparseMatrix csrA(MatrixFormat::matrixFormatSparseCSR);
+    csrA.SetMatrixFromCSRFormat(csrStarts.data(), csrCols.data(), csrValues.data(), csrValues.size(), m, k);
+
+    for (bool transposeA : {false, true})
+    {
+        for (bool transposeB : {false, true})
+        {
+            const size_t innerDim = transposeA ? m : k;
+            DenseMatrix b(transposeB ? n : innerDim, transposeB ? innerDim : n);
+            b.SetUniformRandomValue(-1, 1, IncrementCounter());
+            DenseMatrix c0(transposeA ? k : m, n);
+            c0.SetUniformRandomValue(-1, 1, IncrementCounter());
+            for (double beta : {0.0, 0.5})
+            {
+                DenseMatrix expected(c0);
+                DenseMatrix::MultiplyAndWeightedAdd(0.7, denseA, transposeA, b, transposeB, beta, expected);
+                for (const SparseMatrix* a : {&cscA, &csrA})
+                {
+                    DenseMatrix actual(c0);
+                    SparseMatrix::MultiplyAndWeightedAdd(0.7, *a, transposeA, b, transposeB, beta, actual);
+                    BOOST_CHECK(expected.IsEqualTo(actual, c_epsilonFloatE4));
+                }
+            }
+        }
+    }
+}
+
+// dense x sparse must agree with dense x dense for CSC and CSR and all transpositions, also with skewed columns that
+// make the work per thread uneven, and the block-sparse gradient must agree with the dense one
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixDenseTimesSparse, RandomSeedFixture)
+{
+    const size_t m = 45;
+    const size_t k = 300;
+    const size_t n = 64;
+    DenseMatrix denseB(k, n);
+    denseB.SetUniformRandomValue(-1, 1, IncrementCounter());
+    foreach_coord (row, col, denseB)
+    {
+        // a few long columns and a few frequent rows, otherwise about 2% nonzeros
+        if (col % 16 != 3 && row % 50 != 7 && fabs(denseB(row, col)) < 0.98)
+            denseB(row, col) = 0;
+    }
+
+    // compress along columns (CSC) or rows (CSR)
+    auto compress = [&](SparseMatrix& sparse)
+    {
+        const bool byRows = sparse.GetFormat() == MatrixFormat::matrixFormatSparseCSR;
+        vector<CPUSPARSE_INDEX_TYPE> starts, indices;
+        vector<double> values;
+        for (size_t a = 0; a < (byRows ? k : n); a++)
+        {
+            starts.push_back((CPUSPARSE_INDEX_TYPE) values.size());
+            for (size_t b = 0; b < (byRows ? n : k); b++)
+            {
+                double value = byRows ? denseB(a, b) : denseB(b, a);
+                if (value != 0)
+                {
+                    indices.push_back((CPUSPARSE_INDEX_TYPE) b);
+                    values.push_back(value);
+                }
+            }
+        }
+        starts.push_back((CPUSPARSE_INDEX_TYPE) values.size());
+        if (byRows)
+            sparse.SetMatrixFromCSRFormat(starts.data(), indices.data(), values.data(), values.size(), k, n);
+        else
+            sparse.SetMatrixFromCSCFormat(starts.data(), indices.data(), values.data(), values.size(), k, n);
+    };
+    SparseMatrix cscB(MatrixFormat::matrixFormatSparseCSC), csrB(MatrixFormat::matrixFormatSparseCSR);
+    compress(cscB);
+    compress(csrB);
+
+    for (bool transposeA : {false, true})
+    {
+        for (bool transposeB : {false, true})
+        {
+            const size_t innerDim = transposeB ? n : k;
+            DenseMatrix a(transposeA ? innerDim : m, transposeA ? m : innerDim);
+            a.SetUniformRandomValue(-1, 1, IncrementCounter());
+            DenseMatrix c0(m, transposeB ? k : n);
+            c0.SetUniformRandomValue(-1, 1, IncrementCounter());
+            for (double beta : {0.0, 0.5})
+            {
+                DenseMatrix expected(c0);
+                DenseMatrix::MultiplyAndWeightedAdd(0.7, a, transposeA, denseB, transposeB, beta, expected);
+                for (const SparseMatrix* b : {&cscB, &csrB})
+                {
+                    DenseMatrix actual(c0);
+                    SparseMatrix::MultiplyAndWeightedAdd(0.7, a, transposeA, *b, transposeB, beta, actual);
+                    BOOST_CHECK(expected.IsEqualTo(actual, c_epsilonFloatE4));
+                }
+            }
+        }
+    }
+
+    DenseMatrix outGrad(m, n);
+    outGrad.SetUniformRandomValue(-1, 1, IncrementCounter());
+    DenseMatrix expected(m, k);
+    DenseMatrix::MultiplyAndWeightedAdd(0.7, outGrad, false, denseB, true, 0, expected);
+    SparseMatrix sparseGrad(MatrixFormat::matrixFormatSparseBlockCol);
+    SparseMatrix::MultiplyAndAdd(0.7, outGrad, false, cscB, true, sparseGrad);
+    DenseMatrix actual(m, k);
+    actual.SetValue(0);
+    SparseMatrix::ScaleAndAdd(1, sparseGrad, actual);
+    BOOST_CHECK(expected.IsEqualTo(actual, c_epsilonFloatE4));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 }
 } } }
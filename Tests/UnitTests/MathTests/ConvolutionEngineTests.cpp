@@ -749,6 +749,113 @@ BOOST_AUTO_TEST_CASE(BatchNormalizationForwardTrain)
     }
 }
 
+BOOST_AUTO_TEST_CASE(BatchNormalizationForwardTrainCpu)
+{
+    if (!IsCuDnnSupported())
+        return;
+
+    std::mt19937 rng(0);
+    std::normal_distribution<float> nd;
+
+    auto initMat = [&](SingleMatrix& buf, size_t r, size_t c, vec& data) -> SingleMatrix
+    {
+        data.resize(r * 3 * c);
+        std::fill(begin(data), end(data), std::numeric_limits<float>::quiet_NaN());
+        std::generate(begin(data) + r * c, begin(data) + 2 * r * c, [&] { return nd(rng); });
+        buf.SetValue(r, 3 * c, buf.GetDeviceId(), data.data());
+        // Get center slice.
+        return buf.ColumnSlice(c, c);
+    };
+
+    int deviceId = -1;
+    int cudnnDeviceId = deviceId < 0 ? 0 : deviceId;
+    auto fact = ConvFact::Create(cudnnDeviceId, ConvFact::EngineType::CuDnn, ImageLayoutKind::CHW);
+    auto engCudnn = fact->CreateConvEngine(cudnnDeviceId, ImageLayoutKind::CHW, 0, BatchNormImpl::CuDnn);
+    auto testFact = ConvFact::Create(deviceId, ConvFact::EngineType::Auto, ImageLayoutKind::CHW);
+    auto engCntk = testFact->CreateConvEngine(deviceId, ImageLayoutKind::CHW, 0, BatchNormImpl::Cntk);
+    for (auto& cfg : GenerateBNTestConfigs(*fact))
+    {
+        auto& t = *std::move(std::get<0>(cfg));
+        bool spatial = std::get<1>(cfg);
+        double expAvg = std::get<2>(cfg);
+        double eps = 1e-5; // CUDNN_BN_MIN_EPSILON
+
+        size_t crow = t.w() * t.h() * t.c();
+        size_t ccol = t.n();
+
+        vec buf(crow * t.n());
+        std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+        SingleMatrix in(crow, ccol, buf.data(), deviceId, matrixFlagNormal);
+        SingleMatrix inExp(crow, ccol, buf.data(), cudnnDeviceId, matrixFlagNormal);
+
+        Tensor4DPtr scaleBiasT = spatial ? fact->CreateTensor(1, 1, t.c(), 1) : fact->CreateTensor(t.w(), t.h(), t.c(), 1);
+        size_t crowScaleBias = scaleBiasT->w() * scaleBiasT->h() * scaleBiasT->c();
+        buf.resize(crowScaleBias);
+
+        std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+        SingleMatrix scale(crowScaleBias, 1, buf.data(), deviceId, matrixFlagNormal);
+        SingleMatrix scaleExp(crowScaleBias, 1, buf.data(), cudnnDeviceId, matrixFlagNormal);
+        std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+        SingleMatrix bias(crowScaleBias, 1, buf.data(), deviceId, matrixFlagNormal);
+        SingleMatrix biasExp(crowScaleBias, 1, buf.data(), cudnnDeviceId, matrixFlagNormal);
+
+        SingleMatrix runMeanBuf(deviceId);
+        SingleMatrix runMean = initMat(runMeanBuf, crowScaleBias, 1, buf);
+        SingleMatrix runMeanExp(crowScaleBias, 1, runMean.CopyToArray(), cudnnDeviceId, matrixFlagNormal);
+        SingleMatrix runInvStdDevBuf(deviceId);
+        SingleMatrix runInvStdDev = initMat(runInvStdDevBuf, crowScaleBias, 1, buf);
+        SingleMatrix runInvStdDevExp(crowScaleBias, 1, runInvStdDev.CopyToArray(), cudnnDeviceId, matrixFlagNormal);
+
+        SingleMatrix saveMeanBuf(deviceId);
+        SingleMatrix saveMean = initMat(saveMeanBuf, crowScaleBias, 1, buf);
+        SingleMatrix saveMeanExp(crowScaleBias, 1, saveMean.CopyToArray(), cudnnDeviceId, matrixFlagNormal);
+        SingleMatrix saveInvStdDevBuf(deviceId);
+        SingleMatrix saveInvStdDev = initMat(saveInvStdDevBuf, crowScaleBias, 1, buf);
+        SingleMatrix saveInvStdDevExp(crowScaleBias, 1, saveInvStdDev.CopyToArray(), cudnnDeviceId, matrixFlagNormal);
+
+        SingleMatrix outBuf(deviceId);
+        SingleMatrix out = initMat(outBuf, crow, ccol, buf);
+        SingleMatrix outExp(crow, ccol, out.CopyToArray(), cudnnDeviceId, matrixFlagNormal);
+
+        engCntk->NormalizeBatch(t, in, *scaleBiasT, scale, bias, spatial, expAvg, runMean, runInvStdDev,
+                                out, eps, saveMean, saveInvStdDev);
+        engCudnn->NormalizeBatch(t, inExp, *scaleBiasT, scaleExp, biasExp, spatial, expAvg, runMeanExp, runInvStdDevExp,
+                                 outExp, eps, saveMeanExp, saveInvStdDevExp);
+
+        std::stringstream tmsg;
+        tmsg << "tensor: (w = " << t.w() << ", h = " << t.h() << ", c = " << t.c() << ", n = " << t.n()
+             << ", spatial = " << (spatial ? "true" : "false")
+             << ", expAvg = " << expAvg << ")";
+        std::string msg = " are not equal, " + tmsg.str();
+        std::string msgNan = " has NaNs, " + tmsg.str();
+        std::string msgNotNan = " has buffer overflow/underflow, " + tmsg.str();
+
+        float relErr = Err<float>::Rel;
+        float absErr = Err<float>::Abs;
+        std::string emsg;
+
+        BOOST_REQUIRE_MESSAGE(!out.HasNan("out"), "out" << msgNan);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(out, outExp, emsg, relErr, absErr * 20), "out" << msg << ". " << emsg);
+        BOOST_REQUIRE_MESSAGE(CountNans(outBuf) == crow * 2 * ccol, "out" << msgNotNan);
+
+        BOOST_REQUIRE_MESSAGE(!runMean.HasNan("runMean"), "runMean" << msgNan);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(runMean, runMeanExp, emsg, relErr, absErr), "runMean" << msg << ". " << emsg);
+        BOOST_REQUIRE_MESSAGE(CountNans(runMeanBuf) == crowScaleBias * 2, "runMean" << msgNotNan);
+
+        BOOST_REQUIRE_MESSAGE(!runInvStdDev.HasNan("runInvStdDev"), "runInvStdDev" << msgNan);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(runInvStdDev, runInvStdDevExp, emsg, relErr, absErr), "runInvStdDev" << msg << ". " << emsg);
+        BOOST_REQUIRE_MESSAGE(CountNans(runInvStdDevBuf) == crowScaleBias * 2, "runInvStdDev" << msgNotNan);
+
+        BOOST_REQUIRE_MESSAGE(!saveMean.HasNan("saveMean"), "saveMean" << msgNan);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(saveMean, saveMeanExp, emsg, relErr, absErr), "saveMean" << msg << ". " << emsg);
+        BOOST_REQUIRE_MESSAGE(CountNans(saveMeanBuf) == crowScaleBias * 2, "saveMean" << msgNotNan);
+
+        BOOST_REQUIRE_MESSAGE(!saveInvStdDev.HasNan("saveInvStdDev"), "saveInvStdDev" << msgNan);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(saveInvStdDev, saveInvStdDevExp, emsg, relErr, absErr), "saveInvStdDev" << msg << ". " << emsg);
+        BOOST_REQUIRE_MESSAGE(CountNans(saveInvStdDevBuf) == crowScaleBias * 2, "saveInvStdDev" << msgNotNan);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(BatchNormalizationForwardInference)
 {
     if (!IsCuDnnSupported())
@@ -1041,6 +1148,101 @@ BOOST_AUTO_TEST_CASE(BatchNormalizationBackward)
     }
 }
 
+BOOST_AUTO_TEST_CASE(BatchNormalizationBackwardCpu)
+{
+    if (!IsCuDnnSupported())
+        return;
+
+    std::mt19937 rng(0);
+    std::normal_distribution<float> nd;
+
+    auto initMat = [&](SingleMatrix& buf, size_t r, size_t c, vec& data) -> SingleMatrix
+    {
+        data.resize(r * 3 * c);
+        std::fill(begin(data), end(data), std::numeric_limits<float>::quiet_NaN());
+        std::generate(begin(data) + r * c, begin(data) + 2 * r * c, [&] { return nd(rng); });
+        buf.SetValue(r, 3 * c, buf.GetDeviceId(), data.data());
+        // Get center slice.
+        return buf.ColumnSlice(c, c);
+    };
+
+    int deviceId = -1;
+    int cudnnDeviceId = deviceId < 0 ? 0 : deviceId;
+    auto fact = ConvFact::Create(cudnnDeviceId, ConvFact::EngineType::CuDnn, ImageLayoutKind::CHW);
+    auto engCudnn = fact->CreateConvEngine(cudnnDeviceId, ImageLayoutKind::CHW, 0, BatchNormImpl::CuDnn);
+    auto testFact = ConvFact::Create(deviceId, ConvFact::EngineType::Auto, ImageLayoutKind::CHW);
+    auto engCntk = testFact->CreateConvEngine(deviceId, ImageLayoutKind::CHW, 0, BatchNormImpl::Cntk);
+    for (auto& cfg : GenerateBNTestConfigs(*fact))
+    {
+        auto& t = *std::move(std::get<0>(cfg));
+        bool spatial = std::get<1>(cfg);
+
+        size_t crow = t.w() * t.h() * t.c();
+        size_t ccol = t.n();
+
+        vec buf(crow * t.n());
+        std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+        SingleMatrix x(crow, ccol, buf.data(), deviceId, matrixFlagNormal);
+        SingleMatrix xExp(crow, ccol, buf.data(), cudnnDeviceId, matrixFlagNormal);
+
+        std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+        SingleMatrix dy(crow, ccol, buf.data(), deviceId, matrixFlagNormal);
+        SingleMatrix dyExp(crow, ccol, buf.data(), cudnnDeviceId, matrixFlagNormal);
+
+        Tensor4DPtr scaleBiasT = spatial ? fact->CreateTensor(1, 1, t.c(), 1) : fact->CreateTensor(t.w(), t.h(), t.c(), 1);
+        size_t crowScaleBias = scaleBiasT->w() * scaleBiasT->h() * scaleBiasT->c();
+        buf.resize(crowScaleBias);
+
+        std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+        SingleMatrix scale(crowScaleBias, 1, buf.data(), deviceId, matrixFlagNormal);
+        SingleMatrix scaleExp(crowScaleBias, 1, buf.data(), cudnnDeviceId, matrixFlagNormal);
+
+        std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+        SingleMatrix saveMean(crowScaleBias, 1, buf.data(), deviceId, matrixFlagNormal);
+        SingleMatrix saveMeanExp(crowScaleBias, 1, buf.data(), cudnnDeviceId, matrixFlagNormal);
+
+        std::generate(begin(buf), end(buf), [&] { return nd(rng); });
+        SingleMatrix saveInvStdDev(crowScaleBias, 1, buf.data(), deviceId, matrixFlagNormal);
+        SingleMatrix saveInvStdDevExp(crowScaleBias, 1, buf.data(), cudnnDeviceId, matrixFlagNormal);
+
+        SingleMatrix dScaleBuf(deviceId);
+        SingleMatrix dScale = initMat(dScaleBuf, crowScaleBias, 1, buf);
+        SingleMatrix dScaleExp(crowScaleBias, 1, dScale.CopyToArray(), cudnnDeviceId, matrixFlagNormal);
+        SingleMatrix dBiasBuf(deviceId);
+        SingleMatrix dBias = initMat(dBiasBuf, crowScaleBias, 1, buf);
+        SingleMatrix dBiasExp(crowScaleBias, 1, dBias.CopyToArray(), cudnnDeviceId, matrixFlagNormal);
+
+        SingleMatrix dxBuf(deviceId);
+        SingleMatrix dx = initMat(dxBuf, crow, ccol, buf);
+        SingleMatrix dxExp(crow, ccol, dx.CopyToArray(), cudnnDeviceId, matrixFlagNormal);
+
+        engCntk->BackwardNormalizeBatch(t, x, dy, dx, *scaleBiasT, scale, spatial, saveMean, saveInvStdDev, dScale, dBias);
+        engCudnn->BackwardNormalizeBatch(t, xExp, dyExp, dxExp, *scaleBiasT, scaleExp, spatial, saveMeanExp, saveInvStdDevExp, dScaleExp, dBiasExp);
+
+        std::stringstream tmsg;
+        tmsg << "tensor: (w = " << t.w() << ", h = " << t.h() << ", c = " << t.c() << ", n = " << t.n() << ", spatial = " << (spatial ? "true" : "false") << ")";
+        std::string msg = " are not equal, " + tmsg.str();
+        std::string msgNan = " has NaNs, " + tmsg.str();
+        std::string msgNotNan = " has buffer overflow/underflow, " + tmsg.str();
+
+        float relErr = Err<float>::Rel;
+        float absErr = Err<float>::Abs;
+        std::string emsg;
+
+        BOOST_REQUIRE_MESSAGE(!dx.HasNan("dx"), "dx" << msgNan);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(dx, dxExp, emsg, relErr * 16, absErr * 8), "dx" << msg << ". " << emsg);
+        BOOST_REQUIRE_MESSAGE(CountNans(dxBuf) == crow * 2 * ccol, "out" << msgNotNan);
+
+        BOOST_REQUIRE_MESSAGE(!dScale.HasNan("dScale"), "dScale" << msgNan);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(dScale, dScaleExp, emsg, relErr * 32, absErr * 8), "dScale" << msg << ". " << emsg);
+        BOOST_REQUIRE_MESSAGE(CountNans(dScaleBuf) == crowScaleBias * 2, "dScale" << msgNotNan);
+
+        BOOST_REQUIRE_MESSAGE(!dBias.HasNan("dBias"), "dBias" << msgNan);
+        BOOST_REQUIRE_MESSAGE(CheckEqual(dBias, dBiasExp, emsg, relErr * 32, absErr * 8), "dBias" << msg << ". " << emsg);
+        BOOST_REQUIRE_MESSAGE(CountNans(dBiasBuf) == crowScaleBias * 2, "dBias" << msgNotNan);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 }
@@ -0,0 +1,153 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+// ToDo: CPP file directly included, to get at its file-local CPU implementations
+#include "../../../Source/SequenceTrainingLib/parallelforwardbackward.cpp"
+#include <cstring>
+#include <random>
+
+using namespace msra::lattices;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// a random lattice with numNodes nodes over numFrames frames, with edges sorted by end node as in a lattice archive
+struct RandomLattice
+{
+    std::vector<nodeinfo> nodes;
+    std::vector<edgeinfowithscores> edges;
+    std::vector<aligninfo> aligns;
+    std::vector<unsigned int> alignoffsets;
+    std::vector<unsigned short> alignments;
+    std::vector<float> edgeacscores;
+    std::vector<unsigned short> uids;
+    std::vector<size_t> batchsizeforward, batchsizebackward;
+
+    RandomLattice(size_t numNodes, size_t numFrames, size_t numStates, unsigned int seed)
+    {
+        std::mt19937 rng(seed);
+        for (size_t i = 0; i < numNodes; i++)
+            nodes.push_back(nodeinfo(i == 0 ? 0 : (i == numNodes - 1 ? numFrames : 1 + i * (numFrames - 2) / numNodes)));
+        for (size_t E = 1; E < numNodes; E++)
+        {
+            std::vector<size_t> Ss(1, E - 1); // connect consecutive nodes, so that every node is on a complete path
+            for (size_t k = rng() % 4; k > 0; k--)
+            {
+                size_t S = rng() % E;
+                if (nodes[S].t < nodes[E].t && find(Ss.begin(), Ss.end(), S) == Ss.end())
+                    Ss.push_back(S);
+            }
+            std::sort(Ss.begin(), Ss.end());
+            for (size_t S : Ss)
+            {
+                edgeinfowithscores e(S, E, -(float) (rng() % 100), -(float) (rng() % 50) / 10.0f, aligns.size());
+                e.unused = (S != E - 1 && rng() % 7 == 0); // some added sil/sp edges, which may be forbidden, but not on the chain
+                edges.push_back(e);
+                aligns.push_back(aligninfo(rng() % 50, 1));
+                alignoffsets.push_back((unsigned int) alignments.size());
+                for (size_t t = nodes[S].t; t < nodes[E].t; t++)
+                    alignments.push_back((unsigned short) (rng() % numStates));
+            }
+        }
+        alignoffsets.push_back((unsigned int) alignments.size());
+        for (size_t j = 0; j < edges.size(); j++)
+            edgeacscores.push_back(-(float) (rng() % 1000) / 7.0f);
+        for (size_t t = 0; t < numFrames; t++)
+            uids.push_back((unsigned short) (rng() % numStates));
+
+        // launch batches, determined the same way as in parallelforwardbackwardlattice()
+        size_t endnodeforward = edges[0].E, countforward = 0, endnodebackward = edges.back().S, countbackward = 0;
+        for (size_t j = 0; j < edges.size(); j++)
+        {
+            if (edges[j].S < endnodeforward)
+                countforward++;
+            else
+            {
+                batchsizeforward.push_back(countforward);
+                countforward = 1;
+                endnodeforward = edges[j].E;
+            }
+            const size_t backj = edges.size() - 1 - j;
+            if (edges[backj].E > endnodebackward)
+            {
+                countbackward++;
+                if (endnodebackward < edges[backj].S)
+                    endnodebackward = edges[backj].S;
+            }
+            else
+            {
+                batchsizebackward.push_back(countbackward);
+                countbackward = 1;
+                endnodebackward = edges[backj].S;
+            }
+        }
+        batchsizeforward.push_back(countforward);
+        batchsizebackward.push_back(countbackward);
+    }
+};
+
+static bool BitIdentical(const msra::math::ssematrixbase& a, const msra::math::ssematrixbase& b)
+{
+    foreach_coord (i, j, a)
+        if (memcmp(&a(i, j), &b(i, j), sizeof(float)) != 0)
+            return false;
+    return true;
+}
+
+BOOST_AUTO_TEST_SUITE(LatticeForwardBackwardSuite)
+
+// The multi-threaded CPU forward/backward and error signals must give bit-identical results to the single-threaded
+// emulation of the CUDA kernels, in both MMI and sMBR mode.
+BOOST_AUTO_TEST_CASE(LatticeForwardBackwardMatchesEmulation)
+{
+    const size_t numNodes = 2000, numFrames = 300, numStates = 100;
+    RandomLattice lattice(numNodes, numFrames, numStates, 1);
+    const std::vector<unsigned short> senone2classmap;
+    const int savedNumThreads = omp_get_max_threads();
+    omp_set_num_threads(4);
+
+    for (bool smbr : {false, true})
+    {
+        const size_t numEdges = lattice.edges.size();
+        std::vector<double> logpps(numEdges), logalphas(2 * numNodes), logbetas(2 * numNodes), logaccalphas(2 * numNodes), logaccbetas(2 * numNodes);
+        std::vector<double> logframescorrectedge(numEdges), logEframescorrect(numEdges), Eframescorrectbuf(numEdges);
+        auto cpulogpps = logpps, cpulogalphas = logalphas, cpulogbetas = logbetas, cpulogaccalphas = logaccalphas, cpulogaccbetas = logaccbetas;
+        auto cpulogframescorrectedge = logframescorrectedge, cpulogEframescorrect = logEframescorrect;
+        double logEframescorrecttotal = 0, cpulogEframescorrecttotal = 0;
+
+        double totalfwscore = emulateforwardbackwardlattice(&lattice.batchsizeforward[0], &lattice.batchsizebackward[0], lattice.batchsizeforward.size(), lattice.batchsizebackward.size(),
+                                                            0, 1, lattice.edgeacscores, lattice.edges, lattice.nodes, lattice.aligns, lattice.alignments, lattice.alignoffsets,
+                                                            logpps, logalphas, logbetas, 1.0f, 0.0f, 1.0f, 0.0f, smbr, lattice.uids, senone2classmap,
+                                                            logaccalphas, logaccbetas, logframescorrectedge, logEframescorrect, Eframescorrectbuf, logEframescorrecttotal);
+        double cputotalfwscore = cpuforwardbackwardlattice(&lattice.batchsizeforward[0], &lattice.batchsizebackward[0], lattice.batchsizeforward.size(), lattice.batchsizebackward.size(),
+                                                           0, 1, lattice.edgeacscores, lattice.edges, lattice.nodes, lattice.aligns, lattice.alignments, lattice.alignoffsets,
+                                                           cpulogpps, cpulogalphas, cpulogbetas, 1.0f, 0.0f, 1.0f, 0.0f, smbr, lattice.uids, senone2classmap,
+                                                           cpulogaccalphas, cpulogaccbetas, cpulogframescorrectedge, cpulogEframescorrect, cpulogEframescorrecttotal);
+        BOOST_CHECK(totalfwscore == cputotalfwscore);
+        BOOST_CHECK(logpps == cpulogpps);
+        BOOST_CHECK(logalphas == cpulogalphas);
+        BOOST_CHECK(logbetas == cpulogbetas);
+        BOOST_CHECK(logEframescorrect == cpulogEframescorrect);
+        BOOST_CHECK(logEframescorrecttotal == cpulogEframescorrecttotal);
+
+        msra::dbn::matrix errorsignal(numStates, numFrames), errorsignalneg(numStates, numFrames);
+        msra::dbn::matrix cpuerrorsignal(numStates, numFrames), cpuerrorsignalneg(numStates, numFrames);
+        if (smbr)
+        {
+            emulatesMBRerrorsignal(lattice.alignments, lattice.alignoffsets, lattice.edges, lattice.nodes, logpps, 1.0f, logEframescorrect, logEframescorrecttotal, errorsignal, errorsignalneg);
+            cpusMBRerrorsignal(lattice.alignments, lattice.alignoffsets, lattice.edges, lattice.nodes, logpps, 1.0f, logEframescorrect, logEframescorrecttotal, cpuerrorsignal, cpuerrorsignalneg);
+        }
+        else
+        {
+            emulatemmierrorsignal(lattice.alignments, lattice.alignoffsets, lattice.edges, lattice.nodes, logpps, errorsignal);
+            cpustateposteriors(lattice.alignments, lattice.alignoffsets, lattice.edges, lattice.nodes, logpps, cpuerrorsignal, true /*exponentiate*/);
+        }
+        BOOST_CHECK(BitIdentical(errorsignal, cpuerrorsignal));
+    }
+    omp_set_num_threads(savedNumThreads);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
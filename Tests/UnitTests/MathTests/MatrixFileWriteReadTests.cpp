@@ -37,6 +37,64 @@ BOOST_FIXTURE_TEST_CASE(CPUMatrixFileWriteRead, RandomSeedFixture)
     BOOST_CHECK(matrixCpuCopy.IsEqualTo(matrixCpuRead, c_epsilonFloatE5));
 }
 
+BOOST_FIXTURE_TEST_CASE(CPUMatrixFileWriteReadBinary, RandomSeedFixture)
+{
+    CPUMatrix<float> matrixCpu = CPUMatrix<float>::RandomUniform(43, 10, -26.3f, 30.2f, IncrementCounter());
+
+    std::wstring fileNameCpu(L"MCPU.bin");
+    {
+        File fileCpu(fileNameCpu, fileOptionsBinary | fileOptionsWrite);
+        fileCpu << matrixCpu;
+    }
+
+    // the block write must produce the same bytes as writing element by element did
+    std::wstring fileNameReference(L"MCPUReference.bin");
+    {
+        File fileReference(fileNameReference, fileOptionsBinary | fileOptionsWrite);
+        fileReference.PutMarker(fileMarkerBeginSection, std::wstring(L"BMAT"));
+        fileReference << sizeof(float) << std::wstring(L"unnamed") << (int) matrixFormatDense << matrixCpu.GetNumRows() << matrixCpu.GetNumCols();
+        foreach_coord (i, j, matrixCpu) // (column-major order)
+            fileReference << matrixCpu(i, j);
+        fileReference.PutMarker(fileMarkerEndSection, std::wstring(L"EMAT"));
+    }
+    std::string bytes, bytesReference;
+    {
+        File fileCpu(fileNameCpu, fileOptionsBinary | fileOptionsRead);
+        File fileReference(fileNameReference, fileOptionsBinary | fileOptionsRead);
+        fileCpu.ReadChars(bytes, fileCpu.Size());
+        fileReference.ReadChars(bytesReference, fileReference.Size());
+    }
+    BOOST_CHECK(bytes == bytesReference);
+
+    CPUMatrix<float> matrixCpuRead;
+    File fileCpu(fileNameCpu, fileOptionsBinary | fileOptionsRead);
+    fileCpu >> matrixCpuRead;
+    BOOST_CHECK(matrixCpu.IsEqualTo(matrixCpuRead, 0));
+}
+
+BOOST_FIXTURE_TEST_CASE(CPUSparseMatrixFileWriteRead, RandomSeedFixture)
+{
+    for (auto options : {fileOptionsText, fileOptionsBinary})
+    {
+        Matrix<float> matrixSparse = Matrix<float>::RandomUniform(43, 10, CPUDEVICE, -26.3f, 30.2f, IncrementCounter());
+        Matrix<float> matrixSparseCopy = matrixSparse.DeepClone();
+        matrixSparse.SwitchToMatrixType(MatrixType::SPARSE, matrixFormatSparseCSC, true);
+
+        std::wstring filenameSparse(L"MCPUS.bin");
+        File fileSparse(filenameSparse, options | fileOptionsReadWrite);
+
+        fileSparse << matrixSparse;
+        fileSparse.SetPosition(0);
+
+        Matrix<float> matrixSparseRead(CPUDEVICE);
+        fileSparse >> matrixSparseRead;
+
+        BOOST_CHECK(MatrixType::SPARSE == matrixSparseRead.GetMatrixType());
+        matrixSparseRead.SwitchToMatrixType(MatrixType::DENSE, matrixFormatDense, true);
+        BOOST_CHECK(matrixSparseRead.IsEqualTo(matrixSparseCopy, c_epsilonFloatE5));
+    }
+}
+
 BOOST_FIXTURE_TEST_CASE(MatrixFileWriteRead, RandomSeedFixture)
 {
     // Test Matrix in Dense mode
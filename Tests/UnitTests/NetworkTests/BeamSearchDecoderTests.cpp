@@ -0,0 +1,111 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "ComputationNetwork.h"
+#include "ComputationNetworkBuilder.h"
+#include "BeamSearchDecoder.h"
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+static const size_t vocabSize = 8;
+static const size_t endSymbol = 0;
+
+// Builds a small RNN language model with random weights:
+//   h = Tanh(W * E * token + R * PastValue(h) + b), output = LogSoftmax(O * h)
+static ComputationNetworkPtr CreateRecurrentLanguageModel()
+{
+    const size_t hiddenDim = 6;
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<float> builder(*net);
+
+    auto tokens = builder.CreateInputNode(L"tokens", vocabSize);
+    auto E = builder.CreateLearnableParameter(L"E", hiddenDim, vocabSize);
+    auto W = builder.CreateLearnableParameter(L"W", hiddenDim, hiddenDim);
+    auto R = builder.CreateLearnableParameter(L"R", hiddenDim, hiddenDim);
+    auto b = builder.CreateLearnableParameter(L"b", hiddenDim, 1);
+    auto O = builder.CreateLearnableParameter(L"O", vocabSize, hiddenDim);
+    unsigned long seed = 1;
+    for (auto& parameter : {E, W, R, b, O})
+        parameter->Value().SetUniformRandomValue(-1.5f, 1.5f, seed++);
+
+    auto pastValue = builder.PastValue(tokens /*replaced below*/, 0.1f, hiddenDim, 1, L"pastH");
+    auto input = builder.Times(W, builder.Times(E, tokens, 1, L"embedding"), 1, L"Wx");
+    auto h = builder.Tanh(builder.Plus(builder.Plus(input, builder.Times(R, pastValue, 1, L"Rh"), L"sum"), b, L"z"), L"h");
+    static_pointer_cast<ComputationNodeBase>(pastValue)->SetInput(0, h); // close the loop
+    auto output = builder.LogSoftmax(builder.Times(O, h, 1, L"logits"), L"output");
+
+    net->FeatureNodes().push_back(tokens);
+    net->OutputNodes().push_back(output);
+    net->CompileNetwork();
+    return net;
+}
+
+// score prompt + tokens (+ end symbol) as one full sequence, without beam search
+static double ScoreSequence(ComputationNetworkPtr net, BeamSearchDecoder<float>& decoder, const vector<size_t>& prompt,
+                            const vector<size_t>& tokens, bool ended)
+{
+    vector<size_t> sequence = prompt;
+    sequence.insert(sequence.end(), tokens.begin(), tokens.end());
+    if (ended)
+        sequence.push_back(endSymbol);
+
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::inferring);
+    auto output = net->GetNodeFromName(L"output");
+    decoder.SetPrompts({sequence});
+    ComputationNetwork::BumpEvalTimeStamp(net->FeatureNodes());
+    net->ForwardProp(output);
+
+    const auto& value = dynamic_pointer_cast<ComputationNode<float>>(output)->Value();
+    double logProbability = 0;
+    for (size_t t = prompt.size(); t < sequence.size(); t++)
+        logProbability += value(sequence[t], t - 1);
+    return logProbability;
+}
+
+BOOST_AUTO_TEST_SUITE(BeamSearchDecoderSuite)
+
+// Decoding several prompts as one batch must give the same n-best lists as decoding them one by one,
+// and the scores must match scoring the decoded sequences in one regular forward pass.
+BOOST_AUTO_TEST_CASE(BeamSearchBatchedMatchesSingle)
+{
+    const size_t beamWidth = 4, maxLength = 6, numBest = 3;
+    auto net = CreateRecurrentLanguageModel();
+    BeamSearchDecoder<float> decoder(net, L"tokens", L"output", beamWidth, maxLength, endSymbol, numBest);
+
+    vector<vector<size_t>> prompts = {{1, 2, 3}, {4}, {5, 6}, {7, 7, 1, 2}};
+    vector<vector<BeamSearchDecoder<float>::Hypothesis>> batched;
+    decoder.SetPrompts(prompts);
+    decoder.Decode(batched);
+    BOOST_REQUIRE_EQUAL(batched.size(), prompts.size());
+
+    for (size_t p = 0; p < prompts.size(); p++)
+    {
+        vector<vector<BeamSearchDecoder<float>::Hypothesis>> single;
+        decoder.SetPrompts({prompts[p]});
+        decoder.Decode(single);
+        BOOST_REQUIRE_EQUAL(single.size(), 1);
+        BOOST_REQUIRE_EQUAL(single[0].size(), batched[p].size());
+        BOOST_CHECK_EQUAL(batched[p].size(), numBest);
+
+        for (size_t i = 0; i < batched[p].size(); i++)
+        {
+            const auto& hypothesis = batched[p][i];
+            BOOST_CHECK(hypothesis.tokens == single[0][i].tokens);
+            BOOST_CHECK_CLOSE(hypothesis.logProbability, single[0][i].logProbability, 1e-3);
+            if (i > 0)
+                BOOST_CHECK_LE(hypothesis.logProbability, batched[p][i - 1].logProbability);
+
+            bool ended = hypothesis.tokens.size() < maxLength;
+            double expected = ScoreSequence(net, decoder, prompts[p], hypothesis.tokens, ended);
+            BOOST_CHECK_CLOSE(hypothesis.logProbability, expected, 1e-3);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
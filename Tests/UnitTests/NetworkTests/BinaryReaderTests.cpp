@@ -0,0 +1,78 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "DataReader.h"
+#include "DataWriter.h"
+#include "DataReaderHelpers.h"
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+static const size_t featureDim = 3;
+static const size_t numRecords = 10;
+
+// writes a BinaryReader file with one 'features' section, whose element i has the value i
+static void WriteDataFile(const wstring& path)
+{
+    ConfigParameters config;
+    config.Parse(msra::strfun::strprintf("writerType=BinaryReader\nwrecords=%d\nfeatures=[\nwfile=%ls\nwsize=1\ndim=%d\nsectionType=data\n]\n",
+                                         (int) numRecords, path.c_str(), (int) featureDim));
+    DataWriter writer(config);
+    vector<float> data(featureDim * numRecords);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = (float) i;
+    std::map<std::wstring, void*, nocase_compare> matrices;
+    matrices[L"features"] = data.data();
+    writer.SaveData(0, matrices, numRecords, numRecords);
+}
+
+BOOST_AUTO_TEST_SUITE(BinaryReaderSuite)
+
+// Data-parallel training decimates each minibatch in place. With and without zeroCopy (where the minibatch matrices
+// are views onto the mapped file), this must not change what the reader returns when it reads the same data again.
+BOOST_AUTO_TEST_CASE(BinaryReaderDataUnchangedByInPlaceDecimation)
+{
+    const wstring path = L"BinaryReaderTests.bin";
+    _wunlink(path.c_str());
+    WriteDataFile(path);
+
+    for (bool zeroCopy : {false, true})
+    {
+        ConfigParameters config;
+        config.Parse(msra::strfun::strprintf("readerType=BinaryReader\nfile=%ls\nzeroCopy=%s\n", path.c_str(), zeroCopy ? "true" : "false"));
+        DataReader reader(config);
+        auto features = make_shared<Matrix<float>>(CPUDEVICE);
+        StreamMinibatchInputs inputs;
+        inputs.AddInputMatrix(L"features", features);
+        auto pMBLayout = make_shared<MBLayout>();
+
+        for (size_t epoch = 0; epoch < 2; epoch++)
+        {
+            reader.StartMinibatchLoop(4, epoch, numRecords);
+            size_t record = 0;
+            while (reader.GetMinibatch(inputs))
+            {
+                const size_t numCols = features->GetNumCols();
+                for (size_t j = 0; j < numCols; j++)
+                    for (size_t i = 0; i < featureDim; i++)
+                        BOOST_CHECK_EQUAL((*features)(i, j), (float) ((record + j) * featureDim + i));
+
+                // keep the second half, as rank 1 of 2 does
+                reader.CopyMBLayoutTo(pMBLayout);
+                DataReaderHelpers::DecimateMinibatchInPlace<float>(inputs, 2, 1, pMBLayout);
+                BOOST_CHECK_EQUAL(features->GetNumCols(), numCols - numCols / 2);
+                BOOST_CHECK_EQUAL((*features)(0, 0), (float) ((record + numCols / 2) * featureDim));
+                record += numCols;
+            }
+            BOOST_CHECK_EQUAL(record, numRecords);
+        }
+    }
+    _wunlink(path.c_str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
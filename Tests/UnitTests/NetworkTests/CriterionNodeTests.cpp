@@ -0,0 +1,197 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "ComputationNetwork.h"
+#include "ComputationNetworkBuilder.h"
+#include "TrainingNodes.h"
+#include <random>
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+static const size_t featureDim = 6;
+static const size_t hiddenDim = 5;
+
+// largest absolute difference between the elements of two matrices of the same dimensions
+static float MaxDeviation(const Matrix<float>& a, const Matrix<float>& b)
+{
+    BOOST_REQUIRE_EQUAL(a.GetNumRows(), b.GetNumRows());
+    BOOST_REQUIRE_EQUAL(a.GetNumCols(), b.GetNumCols());
+    vector<float> x(a.GetNumElements()), y(b.GetNumElements());
+    a.CopySection(a.GetNumRows(), a.GetNumCols(), x.data(), a.GetNumRows());
+    b.CopySection(b.GetNumRows(), b.GetNumCols(), y.data(), b.GetNumRows());
+    float deviation = 0;
+    for (size_t i = 0; i < x.size(); i++)
+        deviation = max(deviation, fabs(x[i] - y[i]));
+    return deviation;
+}
+
+static shared_ptr<ComputationNode<float>> GetNode(const ComputationNetworkPtr& net, const wstring& name)
+{
+    return dynamic_pointer_cast<ComputationNode<float>>(net->GetNodeFromName(name));
+}
+
+// sets the value of an input node to 'data', and notifies it of the new minibatch size and the new value
+static void SetInput(const ComputationNetworkPtr& net, const wstring& name, size_t rows, vector<float>& data)
+{
+    auto input = GetNode(net, name);
+    input->Value().SetValue(rows, data.size() / rows, CPUDEVICE, data.data(), matrixFlagNormal);
+    input->NotifyFunctionValuesMBSizeModified();
+    input->BumpEvalTimeStamp();
+}
+
+// Builds criterion = ClassCrossEntropyWithSoftmax(labels, Wh * features, W, Wc * features) with random weights,
+// over a vocabulary of 'classEnds.back()' words split into classes [classEnds[c-1], classEnds[c]).
+static ComputationNetworkPtr CreateClassBasedNetwork(const vector<size_t>& classEnds)
+{
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<float> builder(*net);
+
+    auto features = builder.CreateInputNode(L"features", featureDim);
+    auto labels = builder.CreateInputNode(L"labels", 4);
+    auto Wh = builder.CreateLearnableParameter(L"Wh", hiddenDim, featureDim);
+    auto W = builder.CreateLearnableParameter(L"W", hiddenDim, classEnds.back());
+    auto Wc = builder.CreateLearnableParameter(L"Wc", classEnds.size(), featureDim);
+    unsigned long seed = 1;
+    for (auto& parameter : {Wh, W, Wc})
+        parameter->Value().SetUniformRandomValue(-1.0f, 1.0f, seed++);
+    auto criterion = builder.ClassCrossEntropyWithSoftmax(labels, builder.Times(Wh, features, 1, L"hidden"), W, builder.Times(Wc, features, 1, L"classLogits"), L"criterion");
+
+    net->FeatureNodes().push_back(features);
+    net->LabelNodes().push_back(labels);
+    net->FinalCriterionNodes().push_back(criterion);
+    net->CompileNetwork();
+    net->AllocateAllMatrices({}, {}, criterion);
+    return net;
+}
+
+// Builds criterion = CrossEntropyWithSoftmax(labels, W * features) with random weights.
+static ComputationNetworkPtr CreateSoftmaxNetwork(size_t numClasses)
+{
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<float> builder(*net);
+
+    auto features = builder.CreateInputNode(L"features", featureDim);
+    auto labels = builder.CreateInputNode(L"labels", numClasses);
+    auto W = builder.CreateLearnableParameter(L"W", numClasses, featureDim);
+    W->Value().SetUniformRandomValue(-1.0f, 1.0f, 1);
+    auto criterion = builder.CrossEntropyWithSoftmax(labels, builder.Times(W, features, 1, L"logits"), L"criterion");
+
+    net->FeatureNodes().push_back(features);
+    net->LabelNodes().push_back(labels);
+    net->FinalCriterionNodes().push_back(criterion);
+    net->CompileNetwork();
+    net->AllocateAllMatrices({}, {}, criterion);
+    return net;
+}
+
+BOOST_AUTO_TEST_SUITE(CriterionNodeSuite)
+
+// The batched CPU path of ClassBasedCrossEntropyWithSoftmax, which groups the frames by class, must give the same
+// criterion and gradients as the per-frame computation, on a minibatch with a gap and classes of different sizes.
+BOOST_AUTO_TEST_CASE(ClassBasedBatchedMatchesPerFrame)
+{
+    const vector<size_t> classEnds = {4, 7, 8, 13};
+    const size_t numSequences = 2, numTimeSteps = 7, numCols = numSequences * numTimeSteps;
+
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+    vector<float> features(featureDim * numCols), labels;
+    for (auto& value : features)
+        value = distribution(rng);
+    for (size_t j = 0; j < numCols; j++)
+    {
+        size_t word = rng() % classEnds.back();
+        size_t cls = upper_bound(classEnds.begin(), classEnds.end(), word) - classEnds.begin();
+        labels.insert(labels.end(), {(float) word, (float) cls, (float) (cls == 0 ? 0 : classEnds[cls - 1]), (float) classEnds[cls]});
+    }
+
+    ComputationNetworkPtr nets[2];
+    for (size_t batched = 0; batched < 2; batched++)
+    {
+        auto net = nets[batched] = CreateClassBasedNetwork(classEnds);
+        ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+        auto pMBLayout = net->GetMBLayoutPtr();
+        pMBLayout->Init(numSequences, numTimeSteps);
+        pMBLayout->AddSequence(0, 0, 0, numTimeSteps);
+        pMBLayout->AddSequence(1, 1, 0, numTimeSteps - 3);
+        pMBLayout->AddGap(1, numTimeSteps - 3, numTimeSteps);
+        SetInput(net, L"features", featureDim, features);
+        SetInput(net, L"labels", 4, labels);
+
+        auto criterion = net->GetNodeFromName(L"criterion");
+        dynamic_pointer_cast<ClassBasedCrossEntropyWithSoftmaxNode<float>>(criterion)->EnableBatchedCPUPath(batched != 0);
+        net->ForwardProp(criterion);
+        net->Backprop(criterion);
+    }
+
+    BOOST_CHECK_LT(MaxDeviation(GetNode(nets[0], L"criterion")->Value(), GetNode(nets[1], L"criterion")->Value()), 1e-4f);
+    for (auto name : {L"Wh", L"W", L"Wc"})
+        BOOST_CHECK_LT(MaxDeviation(GetNode(nets[0], name)->Gradient(), GetNode(nets[1], name)->Gradient()), 1e-5f);
+}
+
+// With gap skipping, CrossEntropyWithSoftmax computes the softmax of the valid columns only. This must give the same
+// criterion and gradient as the full computation, also when the minibatch grows, and whatever the gap columns contain.
+BOOST_AUTO_TEST_CASE(CrossEntropyWithSoftmaxSkipGapsMatchesFull)
+{
+    const size_t numClasses = 7, numSequences = 3;
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+
+    ComputationNetworkPtr nets[2];
+    for (size_t skipGaps = 0; skipGaps < 2; skipGaps++)
+    {
+        nets[skipGaps] = CreateSoftmaxNetwork(numClasses);
+        nets[skipGaps]->Environment().m_skipGaps = skipGaps != 0;
+    }
+
+    for (size_t numTimeSteps : {4, 8})
+    {
+        // sequences of length T, T/2 and 1; the rest are gaps, filled with garbage
+        const size_t numCols = numSequences * numTimeSteps;
+        const size_t lengths[numSequences] = {numTimeSteps, numTimeSteps / 2, 1};
+        vector<float> features(featureDim * numCols, 1e4f), labels(numClasses * numCols, 1.0f);
+        for (size_t s = 0; s < numSequences; s++)
+        {
+            for (size_t t = 0; t < lengths[s]; t++)
+            {
+                const size_t j = t * numSequences + s;
+                for (size_t i = 0; i < featureDim; i++)
+                    features[j * featureDim + i] = distribution(rng);
+                for (size_t i = 0; i < numClasses; i++)
+                    labels[j * numClasses + i] = 0;
+                labels[j * numClasses + rng() % numClasses] = 1;
+            }
+        }
+
+        for (auto& net : nets)
+        {
+            ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+            auto pMBLayout = net->GetMBLayoutPtr();
+            pMBLayout->Init(numSequences, numTimeSteps);
+            for (size_t s = 0; s < numSequences; s++)
+            {
+                pMBLayout->AddSequence(s, s, 0, lengths[s]);
+                if (lengths[s] < numTimeSteps)
+                    pMBLayout->AddGap(s, lengths[s], numTimeSteps);
+            }
+            SetInput(net, L"features", featureDim, features);
+            SetInput(net, L"labels", numClasses, labels);
+
+            auto criterion = net->GetNodeFromName(L"criterion");
+            net->ZeroGradients(criterion);
+            net->ForwardProp(criterion);
+            net->Backprop(criterion);
+        }
+
+        BOOST_CHECK_LT(MaxDeviation(GetNode(nets[0], L"criterion")->Value(), GetNode(nets[1], L"criterion")->Value()), 1e-4f);
+        BOOST_CHECK_LT(MaxDeviation(GetNode(nets[0], L"W")->Gradient(), GetNode(nets[1], L"W")->Gradient()), 1e-5f);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
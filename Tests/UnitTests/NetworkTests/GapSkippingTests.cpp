@@ -0,0 +1,138 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "ComputationNetwork.h"
+#include "ComputationNetworkBuilder.h"
+#include <random>
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+static const size_t featureDim = 4;
+static const size_t hiddenDim = 5;
+static const size_t labelDim = 3;
+
+static shared_ptr<ComputationNode<float>> GetNode(const ComputationNetworkPtr& net, const wstring& name)
+{
+    return dynamic_pointer_cast<ComputationNode<float>>(net->GetNodeFromName(name));
+}
+
+// sets the value of an input node to 'data', and notifies it of the new minibatch size and the new value
+static void SetInput(const ComputationNetworkPtr& net, const wstring& name, size_t rows, vector<float>& data)
+{
+    auto input = GetNode(net, name);
+    input->Value().SetValue(rows, data.size() / rows, CPUDEVICE, data.data(), matrixFlagNormal);
+    input->NotifyFunctionValuesMBSizeModified();
+    input->BumpEvalTimeStamp();
+}
+
+static vector<float> ToVector(const Matrix<float>& m)
+{
+    vector<float> result(m.GetNumElements());
+    float* p = result.data();
+    size_t n = result.size();
+    m.CopyToArray(p, n);
+    return result;
+}
+
+// Builds a recurrent layer h = Sigmoid(W * features + R * PastValue(h) + b) with criterion = CrossEntropyWithSoftmax(labels, V * h).
+// W * features and V * h are computed on the whole minibatch, R * PastValue(h) frame by frame inside the loop.
+static ComputationNetworkPtr CreateNetwork(bool skipGaps)
+{
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<float> builder(*net);
+
+    auto features = builder.CreateInputNode(L"features", featureDim);
+    auto labels = builder.CreateInputNode(L"labels", labelDim);
+    auto W = builder.CreateLearnableParameter(L"W", hiddenDim, featureDim);
+    auto R = builder.CreateLearnableParameter(L"R", hiddenDim, hiddenDim);
+    auto b = builder.CreateLearnableParameter(L"b", hiddenDim, 1);
+    auto V = builder.CreateLearnableParameter(L"V", labelDim, hiddenDim);
+    unsigned long seed = 1;
+    for (auto& parameter : {W, R, b, V})
+        parameter->Value().SetUniformRandomValue(-1.0f, 1.0f, seed++);
+    auto pastH = builder.PastValue(features /*replaced below*/, 0.1f, hiddenDim, 1, L"pastH");
+    auto h = builder.Sigmoid(builder.Plus(builder.Plus(builder.Times(W, features, 1, L"Wf"), builder.Times(R, pastH)), b), L"h");
+    static_pointer_cast<ComputationNodeBase>(pastH)->SetInput(0, h);
+    auto z = builder.Times(V, h, 1, L"z");
+    auto criterion = builder.CrossEntropyWithSoftmax(labels, z, L"criterion");
+
+    net->FeatureNodes().push_back(features);
+    net->LabelNodes().push_back(labels);
+    net->FinalCriterionNodes().push_back(criterion);
+    net->CompileNetwork();
+    net->AllocateAllMatrices({}, {}, criterion);
+    net->Environment().m_skipGaps = skipGaps;
+    return net;
+}
+
+BOOST_AUTO_TEST_SUITE(GapSkippingSuite)
+
+// With skipGaps, the Times nodes outside the loop compute on the compacted valid columns, and the loop skips the time steps
+// that are gaps in all sequences. Criterion, parameter gradients, and the valid columns of the Times output must be the same
+// as when computing on the full grid and masking, also with garbage in the gaps.
+BOOST_AUTO_TEST_CASE(GapSkippingMatchesFullGrid)
+{
+    const size_t numSequences = 4, numTimeSteps = 8, numCols = numSequences * numTimeSteps;
+    const size_t sequenceLengths[numSequences] = {5, 3, 5, 2}; // time steps 5..7 are gaps in all sequences
+
+    std::mt19937 rng(13);
+    std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+    vector<float> features(featureDim * numCols), labels(labelDim * numCols, 0.0f);
+    for (size_t j = 0; j < numCols; j++)
+    {
+        bool isGap = j / numSequences >= sequenceLengths[j % numSequences];
+        for (size_t i = 0; i < featureDim; i++)
+            features[j * featureDim + i] = isGap ? 1000.0f : distribution(rng);
+        labels[j * labelDim + rng() % labelDim] = 1.0f;
+    }
+
+    const wstring names[] = {L"criterion", L"W", L"R", L"b", L"V"};
+    map<wstring, vector<float>> results[2];
+    vector<float> z[2];
+    for (bool skipGaps : {false, true})
+    {
+        auto net = CreateNetwork(skipGaps);
+        ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+        auto pMBLayout = net->GetMBLayoutPtr();
+        pMBLayout->Init(numSequences, numTimeSteps);
+        for (size_t s = 0; s < numSequences; s++)
+        {
+            pMBLayout->AddSequence(s, s, 0, sequenceLengths[s]);
+            pMBLayout->AddGap(s, sequenceLengths[s], numTimeSteps);
+        }
+        SetInput(net, L"features", featureDim, features);
+        SetInput(net, L"labels", labelDim, labels);
+
+        auto criterion = net->FinalCriterionNodes()[0];
+        net->ForwardProp(criterion);
+        z[skipGaps] = ToVector(GetNode(net, L"z")->Value());
+        net->Backprop(criterion);
+        for (const auto& name : names)
+            results[skipGaps][name] = ToVector(name == names[0] ? GetNode(net, name)->Value() : GetNode(net, name)->Gradient());
+    }
+
+    for (const auto& name : names)
+    {
+        const auto& expected = results[false][name];
+        const auto& actual = results[true][name];
+        BOOST_REQUIRE_EQUAL(actual.size(), expected.size());
+        for (size_t k = 0; k < expected.size(); k++)
+            BOOST_CHECK_LT(fabs(actual[k] - expected[k]), 1e-5f);
+    }
+
+    // valid columns as computed on the full grid; gap columns are zero, which shows that the compacted path was taken
+    for (size_t j = 0; j < numCols; j++)
+    {
+        bool isGap = j / numSequences >= sequenceLengths[j % numSequences];
+        for (size_t i = 0; i < labelDim; i++)
+            BOOST_CHECK_LT(fabs(z[true][j * labelDim + i] - (isGap ? 0.0f : z[false][j * labelDim + i])), 1e-5f);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
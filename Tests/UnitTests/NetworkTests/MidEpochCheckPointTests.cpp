@@ -0,0 +1,166 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "ComputationNetwork.h"
+#include "ComputationNetworkBuilder.h"
+#include "DataReader.h"
+#include "DataWriter.h"
+#include "SGD.h"
+#include <random>
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+static const size_t featureDim = 3;
+static const size_t labelDim = 2;
+static const size_t numRecords = 24; // 6 minibatches of 4
+
+// writes BinaryReader files with random features, and labels that mostly follow the sign of the first feature
+static void WriteDataFiles(const wstring& featuresPath, const wstring& labelsPath)
+{
+    ConfigParameters config;
+    config.Parse(msra::strfun::strprintf("writerType=BinaryReader\nwrecords=%d\n"
+                                         "features=[\nwfile=%ls\nwsize=1\ndim=%d\nsectionType=data\n]\n"
+                                         "labels=[\nwfile=%ls\nwsize=1\ndim=%d\nsectionType=data\n]\n",
+                                         (int) numRecords, featuresPath.c_str(), (int) featureDim, labelsPath.c_str(), (int) labelDim));
+    DataWriter writer(config);
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+    vector<float> features(featureDim * numRecords), labels(labelDim * numRecords, 0.0f);
+    for (size_t j = 0; j < numRecords; j++)
+    {
+        for (size_t i = 0; i < featureDim; i++)
+            features[j * featureDim + i] = distribution(rng);
+        labels[j * labelDim + (features[j * featureDim] + 0.3f * distribution(rng) > 0 ? 1 : 0)] = 1.0f;
+    }
+    std::map<std::wstring, void*, nocase_compare> matrices;
+    matrices[L"features"] = features.data();
+    matrices[L"labels"] = labels.data();
+    writer.SaveData(0, matrices, numRecords, numRecords);
+}
+
+// criterion = CrossEntropyWithSoftmax(labels, W * features), with ErrorPrediction as evaluation node
+static ComputationNetworkPtr CreateNetwork(DEVICEID_TYPE deviceId)
+{
+    auto net = make_shared<ComputationNetwork>(deviceId);
+    ComputationNetworkBuilder<float> builder(*net);
+    auto features = builder.CreateInputNode(L"features", featureDim);
+    auto labels = builder.CreateInputNode(L"labels", labelDim);
+    auto W = builder.CreateLearnableParameter(L"W", labelDim, featureDim);
+    W->Value().SetUniformRandomValue(-1.0f, 1.0f, 1);
+    auto z = builder.Times(W, features, 1, L"z");
+    net->FeatureNodes().push_back(features);
+    net->LabelNodes().push_back(labels);
+    net->FinalCriterionNodes().push_back(builder.CrossEntropyWithSoftmax(labels, z, L"criterion"));
+    net->EvaluationNodes().push_back(builder.ErrorPrediction(labels, z, L"errors"));
+    net->CompileNetwork();
+    return net;
+}
+
+// gives access to the training loss of the last epoch
+class TestSGD : public SGD<float>
+{
+public:
+    TestSGD(const ConfigParameters& config)
+        : SGD<float>(config)
+    {
+    }
+    double LastEpochTrainLoss() const { return m_lastFinishedEpochTrainLoss; }
+};
+
+// forwards to a reader, but fails after a given number of minibatches, like a training process that dies
+class InterruptingReader : public IDataReader
+{
+    IDataReader& m_reader;
+    size_t m_numMBsLeft;
+
+public:
+    InterruptingReader(IDataReader& reader, size_t numMBs)
+        : m_reader(reader), m_numMBsLeft(numMBs)
+    {
+    }
+    virtual void Init(const ConfigParameters&) override {}
+    virtual void Init(const ScriptableObjects::IConfigRecord&) override {}
+    virtual void Destroy() override {}
+    virtual void StartMinibatchLoop(size_t mbSize, size_t epoch, size_t requestedEpochSamples) override { m_reader.StartMinibatchLoop(mbSize, epoch, requestedEpochSamples); }
+    virtual bool GetMinibatch(StreamMinibatchInputs& matrices) override
+    {
+        if (m_numMBsLeft-- == 0)
+            RuntimeError("InterruptingReader: Interrupted.");
+        return m_reader.GetMinibatch(matrices);
+    }
+    virtual size_t GetNumParallelSequences() override { return m_reader.GetNumParallelSequences(); }
+    virtual bool DataEnd() override { return m_reader.DataEnd(); }
+    virtual void CopyMBLayoutTo(MBLayoutPtr pMBLayout) override { m_reader.CopyMBLayoutTo(pMBLayout); }
+};
+
+BOOST_AUTO_TEST_SUITE(MidEpochCheckPointSuite)
+
+// A run that is interrupted after a mid-epoch checkpoint and then resumed from it must end the epoch with the same
+// parameters and training loss as an uninterrupted run.
+BOOST_AUTO_TEST_CASE(ResumedEpochMatchesUninterrupted)
+{
+    const wstring featuresPath = L"MidEpochCheckPointTests.features.bin", labelsPath = L"MidEpochCheckPointTests.labels.bin";
+    const wstring modelPath = L"MidEpochCheckPointTests.dnn";
+    WriteDataFiles(featuresPath, labelsPath);
+
+    ConfigParameters readerConfig;
+    readerConfig.Parse(msra::strfun::strprintf("readerType=BinaryReader\nfile={%ls,%ls}\n", featuresPath.c_str(), labelsPath.c_str()));
+    ConfigParameters sgdConfig;
+    sgdConfig.Parse(msra::strfun::strprintf("modelPath=%ls\nminibatchSize=4\nlearningRatesPerSample=0.1\nmomentumPerMB=0.9\nmaxEpochs=1\nnumMBsToCheckpoint=2\n",
+                                            modelPath.c_str()));
+    auto trainedW = [&]()
+    {
+        auto net = ComputationNetwork::CreateFromFile<float>(CPUDEVICE, modelPath);
+        vector<float> W(labelDim * featureDim);
+        dynamic_pointer_cast<ComputationNode<float>>(net->GetNodeFromName(L"W"))->Value().CopySection(labelDim, featureDim, W.data(), labelDim);
+        return W;
+    };
+
+    // uninterrupted
+    double loss;
+    {
+        DataReader reader(readerConfig);
+        TestSGD sgd(sgdConfig);
+        sgd.Train(CreateNetwork, CPUDEVICE, &reader, nullptr, false);
+        loss = sgd.LastEpochTrainLoss();
+    }
+    const auto W = trainedW();
+    BOOST_CHECK(!fexists(modelPath + L".mid.ckp")); // deleted at the end of the epoch
+    _wunlink(modelPath.c_str());
+
+    // interrupted in minibatch 6, after the checkpoint after minibatch 4
+    {
+        DataReader reader(readerConfig);
+        InterruptingReader interruptingReader(reader, 5);
+        TestSGD sgd(sgdConfig);
+        BOOST_CHECK_THROW(sgd.Train(CreateNetwork, CPUDEVICE, &interruptingReader, nullptr, false), std::runtime_error);
+    } // waits for the checkpoint to be written
+    BOOST_REQUIRE(fexists(modelPath + L".mid.ckp"));
+    BOOST_CHECK(!fexists(modelPath));
+
+    // resumed
+    double resumedLoss;
+    {
+        DataReader reader(readerConfig);
+        TestSGD sgd(sgdConfig);
+        sgd.Train(CreateNetwork, CPUDEVICE, &reader, nullptr, false);
+        resumedLoss = sgd.LastEpochTrainLoss();
+    }
+    const auto resumedW = trainedW();
+    BOOST_CHECK(!fexists(modelPath + L".mid.ckp"));
+
+    BOOST_CHECK_CLOSE(resumedLoss, loss, 1e-4);
+    for (size_t i = 0; i < W.size(); i++)
+        BOOST_CHECK_CLOSE(resumedW[i], W[i], 1e-4);
+
+    for (auto path : {featuresPath, labelsPath, modelPath, modelPath + L".0", modelPath + L".ckp"})
+        _wunlink(path.c_str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
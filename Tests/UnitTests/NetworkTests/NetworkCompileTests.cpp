@@ -0,0 +1,218 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "ComputationNetwork.h"
+#include "ComputationNetworkBuilder.h"
+#include <chrono>
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// Builds a stack of 'numLayers' layers with nested recurrences, alternating between PastValue and FutureValue:
+//   x_i = Plus(in_i, Times(U_i, Delay(o_i)))              (outer loop, through o_i)
+//   h_i = Plus(Times(R_i, Delay(h_i)), Times(W_i, x_i))   (inner loop)
+//   o_i = Sigmoid(h_i)
+// where in_i is o_(i-1), plus o_(i-2) as a shortcut that crosses a loop. Returns the criterion node.
+static ComputationNodeBasePtr CreateNetwork(ComputationNetworkPtr net, size_t numLayers)
+{
+    const size_t dim = 4;
+    ComputationNetworkBuilder<float> builder(*net);
+    auto delay = [&](const shared_ptr<ComputationNode<float>>& input, bool future, const wstring& name)
+    {
+        return future ? builder.FutureValue(input, 0.1f, dim, 1, name) : builder.PastValue(input, 0.1f, dim, 1, name);
+    };
+
+    auto features = builder.CreateInputNode(L"features", dim);
+    auto labels = builder.CreateInputNode(L"labels", dim);
+    shared_ptr<ComputationNode<float>> o = features, prevO;
+    for (size_t i = 0; i < numLayers; i++)
+    {
+        auto suffix = std::to_wstring(i);
+        bool future = i % 2 != 0;
+        auto in = prevO ? builder.Plus(o, prevO, L"in" + suffix) : o;
+        auto delayO = delay(in /*replaced below*/, future, L"do" + suffix);
+        auto x = builder.Plus(in, builder.Times(builder.CreateLearnableParameter(L"U" + suffix, dim, dim), delayO, 1, L"Ud" + suffix), L"x" + suffix);
+        auto delayH = delay(x /*replaced below*/, future, L"dh" + suffix);
+        auto h = builder.Plus(builder.Times(builder.CreateLearnableParameter(L"R" + suffix, dim, dim), delayH, 1, L"Rd" + suffix),
+                              builder.Times(builder.CreateLearnableParameter(L"W" + suffix, dim, dim), x, 1, L"Wx" + suffix), L"h" + suffix);
+        static_pointer_cast<ComputationNodeBase>(delayH)->SetInput(0, h); // close the inner loop
+        prevO = o;
+        o = builder.Sigmoid(h, L"o" + suffix);
+        static_pointer_cast<ComputationNodeBase>(delayO)->SetInput(0, o); // close the outer loop
+    }
+    auto criterion = builder.SquareError(labels, o, L"criterion");
+    net->FeatureNodes().push_back(features);
+    net->LabelNodes().push_back(labels);
+    net->FinalCriterionNodes().push_back(criterion);
+    return criterion;
+}
+
+// recursive reference for ComputationNodeBase::EnumerateNodes(), as it was before it got an explicit stack
+static void EnumerateNodesRecursively(const ComputationNodeBasePtr& node, unordered_set<ComputationNodeBasePtr>& visited, vector<ComputationNodeBasePtr>& result)
+{
+    if (!visited.insert(node).second)
+        return;
+    for (const auto& input : node->GetInputs())
+        EnumerateNodesRecursively(input, visited, result);
+    result.push_back(node);
+}
+
+// recursive reference for the loop detection in ComputationNetwork::DetermineSCCs() (Tarjan's algorithm)
+struct RecursiveSCCs
+{
+    unordered_map<ComputationNodeBasePtr, size_t> index, minIndex;
+    unordered_set<ComputationNodeBasePtr> inStack;
+    vector<ComputationNodeBasePtr> stack;
+    map<wstring, set<wstring>> loops; // [name of the node the loop was entered at] -> names of all nodes in the loop
+
+    void Visit(const ComputationNodeBasePtr& node)
+    {
+        size_t nodeIndex = index.size();
+        index[node] = minIndex[node] = nodeIndex;
+        stack.push_back(node);
+        inStack.insert(node);
+        for (const auto& input : node->GetInputs())
+        {
+            if (index.find(input) == index.end())
+            {
+                Visit(input);
+                minIndex[node] = min(minIndex[node], minIndex[input]);
+            }
+            else if (inStack.find(input) != inStack.end())
+                minIndex[node] = min(minIndex[node], minIndex[input]);
+        }
+        if (minIndex[node] != index[node])
+            return;
+        set<wstring> loop;
+        for (ComputationNodeBasePtr member; member != node;)
+        {
+            member = stack.back();
+            stack.pop_back();
+            inStack.erase(member);
+            loop.insert(member->NodeName());
+        }
+        if (loop.size() > 1) // nodes outside loops are SCCs of size 1
+            loops[node->NodeName()] = loop;
+    }
+};
+
+// Builds a deep generated network of 'numLayers' layers, each with a small recurrent loop:
+//   h_i = Plus(Times(R_i, PastValue(h_i)), Sigmoid(Plus(Times(W_i, h_(i-1)), b_i)))
+// and returns the wall time of CompileNetwork() plus AllocateAllMatrices() for training on it.
+static double TimeCompileAndAllocate(size_t numLayers, size_t& numNodes)
+{
+    const size_t dim = 4;
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<float> builder(*net);
+
+    auto features = builder.CreateInputNode(L"features", dim);
+    auto labels = builder.CreateInputNode(L"labels", dim);
+    shared_ptr<ComputationNode<float>> h = features;
+    for (size_t i = 0; i < numLayers; i++)
+    {
+        auto suffix = std::to_wstring(i);
+        auto W = builder.CreateLearnableParameter(L"W" + suffix, dim, dim);
+        auto b = builder.CreateLearnableParameter(L"b" + suffix, dim, 1);
+        auto R = builder.CreateLearnableParameter(L"R" + suffix, dim, dim);
+        auto z = builder.Sigmoid(builder.Plus(builder.Times(W, h, 1, L"Wh" + suffix), b, L"z" + suffix), L"s" + suffix);
+        auto pastValue = builder.PastValue(z /*replaced below*/, 0.1f, dim, 1, L"pv" + suffix);
+        auto r = builder.Plus(builder.Times(R, pastValue, 1, L"Rp" + suffix), z, L"h" + suffix);
+        static_pointer_cast<ComputationNodeBase>(pastValue)->SetInput(0, r); // close the loop
+        h = r;
+    }
+    auto criterion = builder.SquareError(labels, h, L"criterion");
+    net->FeatureNodes().push_back(features);
+    net->LabelNodes().push_back(labels);
+    net->FinalCriterionNodes().push_back(criterion);
+    numNodes = net->GetTotalNumberOfNodes();
+
+    auto start = std::chrono::steady_clock::now();
+    net->CompileNetwork();
+    net->AllocateAllMatrices({}, {}, criterion);
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+BOOST_AUTO_TEST_SUITE(NetworkCompileSuite)
+
+// The node enumeration and loop detection use explicit stacks rather than recursion, so that deep networks do not
+// overflow the stack. They must find the same order and loops as the recursive versions, and give a valid evaluation order.
+BOOST_AUTO_TEST_CASE(NetworkCompileMatchesRecursiveAnalysis)
+{
+    const size_t numLayers = 50;
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    auto criterion = CreateNetwork(net, numLayers);
+
+    auto nodes = ComputationNodeBase::EnumerateNodes(vector<ComputationNodeBasePtr>{criterion});
+    unordered_set<ComputationNodeBasePtr> visited;
+    vector<ComputationNodeBasePtr> expectedNodes;
+    EnumerateNodesRecursively(criterion, visited, expectedNodes);
+    BOOST_REQUIRE(vector<ComputationNodeBasePtr>(nodes.begin(), nodes.end()) == expectedNodes);
+
+    RecursiveSCCs expected;
+    expected.Visit(criterion);
+    BOOST_CHECK_EQUAL(expected.loops.size(), numLayers);
+
+    net->CompileNetwork();
+    net->AllocateAllMatrices({}, {}, criterion);
+
+    // loops of the execution plan
+    map<wstring, set<wstring>> loops;
+    auto plan = dynamic_pointer_cast<FlowControlNode>(net->GetNestedNetwork(criterion));
+    BOOST_REQUIRE(plan);
+    for (const auto& step : plan->m_nestedNodes)
+    {
+        auto loop = dynamic_pointer_cast<FlowControlNode>(step);
+        if (!loop)
+            continue;
+        set<wstring>& names = loops[loop->NodeName().substr(wcslen(L"Loop_"))]; // the loop is named after the node it was entered at
+        for (const auto& node : loop->m_nestedNodes)
+            names.insert(node->NodeName());
+    }
+    BOOST_CHECK(loops == expected.loops);
+
+    // evaluation order: every node once, inputs before the nodes that use them except within a loop, and loops consecutive
+    const auto& evalOrder = net->GetEvalOrder(criterion);
+    BOOST_REQUIRE_EQUAL(evalOrder.size(), expectedNodes.size());
+    map<wstring, wstring> loopOfNode;
+    for (const auto& loop : loops)
+        for (const auto& name : loop.second)
+            loopOfNode[name] = loop.first;
+    unordered_set<ComputationNodeBasePtr> done;
+    set<wstring> loopsDone;
+    wstring currentLoop;
+    for (const auto& node : evalOrder)
+    {
+        BOOST_REQUIRE(done.insert(node).second);
+        wstring loop = loopOfNode.count(node->NodeName()) ? loopOfNode[node->NodeName()] : L"";
+        if (loop != currentLoop)
+        {
+            if (!currentLoop.empty())
+                loopsDone.insert(currentLoop);
+            BOOST_CHECK(loopsDone.find(loop) == loopsDone.end());
+            currentLoop = loop;
+        }
+        for (const auto& input : node->GetInputs())
+            BOOST_CHECK(done.find(input) != done.end() || (!loop.empty() && loopOfNode[input->NodeName()] == loop));
+    }
+}
+
+// Startup timing of compilation and allocation analysis for a 9k and a 36k node network. Near-linear scaling means about
+// 4x the time for the larger one, a quadratic pass about 16x. The times are only reported, since they depend on the machine.
+BOOST_AUTO_TEST_CASE(NetworkCompileTimeLargeGraph)
+{
+    const size_t smallNumLayers = 1000;
+    size_t smallNumNodes, largeNumNodes;
+    double smallSeconds = TimeCompileAndAllocate(smallNumLayers, smallNumNodes);
+    double largeSeconds = TimeCompileAndAllocate(4 * smallNumLayers, largeNumNodes);
+    BOOST_CHECK_EQUAL(largeNumNodes - 3, 4 * (smallNumNodes - 3)); // 9 nodes per layer, plus inputs and criterion
+
+    fprintf(stderr, "NetworkCompileTimeLargeGraph: %d nodes: %.3f s, %d nodes: %.3f s (ratio %.1f)\n",
+            (int) smallNumNodes, smallSeconds, (int) largeNumNodes, largeSeconds, largeSeconds / smallSeconds);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
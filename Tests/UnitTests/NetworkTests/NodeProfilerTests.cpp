@@ -0,0 +1,202 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "ComputationNetwork.h"
+#include "ComputationNetworkBuilder.h"
+#include "NodeProfiler.h"
+#include <random>
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+static const size_t featureDim = 4;
+static const size_t hiddenDim = 5;
+static const size_t labelDim = 3;
+static const wstring outputName = L"z \"quoted\" \\ name"; // must be escaped in the trace
+
+static shared_ptr<ComputationNode<float>> GetNode(const ComputationNetworkPtr& net, const wstring& name)
+{
+    return dynamic_pointer_cast<ComputationNode<float>>(net->GetNodeFromName(name));
+}
+
+// sets the value of an input node to 'data', and notifies it of the new minibatch size and the new value
+static void SetInput(const ComputationNetworkPtr& net, const wstring& name, size_t rows, vector<float>& data)
+{
+    auto input = GetNode(net, name);
+    input->Value().SetValue(rows, data.size() / rows, CPUDEVICE, data.data(), matrixFlagNormal);
+    input->NotifyFunctionValuesMBSizeModified();
+    input->BumpEvalTimeStamp();
+}
+
+// Builds a recurrent layer h = Sigmoid(W * features + R * PastValue(h) + b) with criterion = CrossEntropyWithSoftmax(labels, V * h),
+// and sets a minibatch of 'numSequences' full sequences of 'numTimeSteps' frames.
+static ComputationNetworkPtr CreateNetwork(size_t numSequences, size_t numTimeSteps)
+{
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<float> builder(*net);
+
+    auto features = builder.CreateInputNode(L"features", featureDim);
+    auto labels = builder.CreateInputNode(L"labels", labelDim);
+    auto W = builder.CreateLearnableParameter(L"W", hiddenDim, featureDim);
+    auto R = builder.CreateLearnableParameter(L"R", hiddenDim, hiddenDim);
+    auto b = builder.CreateLearnableParameter(L"b", hiddenDim, 1);
+    auto V = builder.CreateLearnableParameter(L"V", labelDim, hiddenDim);
+    unsigned long seed = 1;
+    for (auto& parameter : {W, R, b, V})
+        parameter->Value().SetUniformRandomValue(-1.0f, 1.0f, seed++);
+    auto pastH = builder.PastValue(features /*replaced below*/, 0.1f, hiddenDim, 1, L"pastH");
+    auto Rh = builder.Times(R, pastH, 1, L"Rh");
+    auto h = builder.Sigmoid(builder.Plus(builder.Plus(builder.Times(W, features, 1, L"Wf"), Rh, L"sum"), b, L"sumb"), L"h");
+    static_pointer_cast<ComputationNodeBase>(pastH)->SetInput(0, h);
+    auto z = builder.Times(V, h, 1, outputName);
+    auto criterion = builder.CrossEntropyWithSoftmax(labels, z, L"criterion");
+
+    net->FeatureNodes().push_back(features);
+    net->LabelNodes().push_back(labels);
+    net->FinalCriterionNodes().push_back(criterion);
+    net->CompileNetwork();
+    net->AllocateAllMatrices({}, {}, criterion);
+
+    const size_t numCols = numSequences * numTimeSteps;
+    std::mt19937 rng(17);
+    std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+    vector<float> featureData(featureDim * numCols), labelData(labelDim * numCols, 0.0f);
+    for (auto& value : featureData)
+        value = distribution(rng);
+    for (size_t j = 0; j < numCols; j++)
+        labelData[j * labelDim + rng() % labelDim] = 1.0f;
+    auto pMBLayout = net->GetMBLayoutPtr();
+    pMBLayout->Init(numSequences, numTimeSteps);
+    for (size_t s = 0; s < numSequences; s++)
+        pMBLayout->AddSequence(s, s, 0, numTimeSteps);
+    SetInput(net, L"features", featureDim, featureData);
+    SetInput(net, L"labels", labelDim, labelData);
+    return net;
+}
+
+// runs forward and backward 'numIterations' times on the same minibatch
+static void Train(const ComputationNetworkPtr& net, size_t numIterations)
+{
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+    auto criterion = net->FinalCriterionNodes()[0];
+    for (size_t i = 0; i < numIterations; i++)
+    {
+        ComputationNetwork::BumpEvalTimeStamp(net->FeatureNodes());
+        net->ForwardProp(criterion);
+        net->Backprop(criterion);
+    }
+}
+
+static string ReadFile(const wstring& path)
+{
+    FILE* f = fopenOrDie(path, L"rb");
+    string content(filesize(f), '\0');
+    freadOrDie(&content[0], 1, content.size(), f);
+    fcloseOrDie(f);
+    return content;
+}
+
+static size_t CountOccurrences(const string& text, const string& pattern)
+{
+    size_t count = 0;
+    for (size_t pos = text.find(pattern); pos != string::npos; pos = text.find(pattern, pos + pattern.size()))
+        count++;
+    return count;
+}
+
+// the report line of a node, split at blanks into %time, forward ms, calls, backward ms, calls, GFlop/s, value MB, grad MB, name...
+static vector<string> ReportLine(const string& report, const string& nodeName, const string& operationName)
+{
+    const string suffix = "  " + nodeName + " = " + operationName + "\n";
+    size_t end = report.find(suffix);
+    BOOST_REQUIRE(end != string::npos);
+    size_t begin = report.rfind('\n', end) + 1;
+    return msra::strfun::split(report.substr(begin, end - begin), " ");
+}
+
+BOOST_AUTO_TEST_SUITE(NodeProfilerSuite)
+
+// The report has one line per computing node with its forward and backward call counts: one per minibatch outside the loop,
+// one per time step inside (plus the backprop out of the loop). The trace is a JSON array with one event per top-level node call,
+// the loop being one event, and the node names escaped.
+BOOST_AUTO_TEST_CASE(NodeProfilerReportAndTrace)
+{
+    const size_t numSequences = 3, numTimeSteps = 5, numIterations = 2;
+    const wstring reportPath = L"NodeProfilerTests.report.txt";
+    const wstring tracePath = L"NodeProfilerTests.trace.json";
+
+    auto net = CreateNetwork(numSequences, numTimeSteps);
+    net->Environment().m_nodeProfiler = make_shared<NodeProfiler>(/*withStats=*/true, tracePath);
+    Train(net, numIterations);
+    const auto writeReport = [&](const string& title)
+    {
+        FILE* f = fopenOrDie(reportPath, L"wb");
+        net->Environment().m_nodeProfiler->WriteReport(f, title);
+        fcloseOrDie(f);
+        return ReadFile(reportPath);
+    };
+    const string report = writeReport("of the test");
+    BOOST_CHECK(writeReport("after reset").find(" = Times") == string::npos); // statistics are reset by the report
+    net->Environment().m_nodeProfiler.reset(); // closes the trace
+
+    BOOST_CHECK(report.find("Node profile of the test: forward ") != string::npos);
+    const struct
+    {
+        const char* nodeName;
+        const char* operationName;
+        size_t numForwardCalls;
+        size_t numBackwardCalls;
+    } expectedLines[] = {
+        {"Wf", "Times", 1, 1},
+        {"criterion", "CrossEntropyWithSoftmax", 1, 1},
+        {"z \"quoted\" \\ name", "Times", 1, 1},
+        {"h", "Sigmoid", numTimeSteps, numTimeSteps + 1},
+        {"Rh", "Times", numTimeSteps, numTimeSteps + 1},
+        {"pastH", "PastValue", numTimeSteps, numTimeSteps + 1},
+    };
+    for (const auto& expected : expectedLines)
+    {
+        auto fields = ReportLine(report, expected.nodeName, expected.operationName);
+        BOOST_REQUIRE(fields.size() >= 8);
+        BOOST_CHECK_EQUAL(atoi(fields[2].c_str()), (int) (numIterations * expected.numForwardCalls));
+        BOOST_CHECK_EQUAL(atoi(fields[4].c_str()), (int) (numIterations * expected.numBackwardCalls));
+    }
+    BOOST_CHECK(report.find("Loop") == string::npos); // the loop is accounted for by its nodes
+
+    // forward: Wf, the loop, z, and criterion; backward: these and the 6 inputs and parameters
+    const string trace = ReadFile(tracePath);
+    BOOST_CHECK_EQUAL(trace.substr(0, 2), "[\n");
+    BOOST_CHECK_EQUAL(trace.substr(trace.size() - 3), "\n]\n");
+    BOOST_CHECK_EQUAL(CountOccurrences(trace, "\"ph\":\"X\""), numIterations * (4 + 10));
+    BOOST_CHECK_EQUAL(CountOccurrences(trace, "\"cat\":\"forward\""), numIterations * 4);
+    BOOST_CHECK_EQUAL(CountOccurrences(trace, "\"op\":\"SEQTraversalFlowControlNode\",\"columns\":15}"), numIterations * 2);
+    BOOST_CHECK_EQUAL(CountOccurrences(trace, "\"name\":\"z \\\"quoted\\\" \\\\ name\""), numIterations * 2);
+    BOOST_CHECK_EQUAL(CountOccurrences(trace, "\"name\":\"h\""), 0);
+
+    _wunlink(reportPath.c_str());
+    _wunlink(tracePath.c_str());
+}
+
+// Once the trace reaches its maximum number of events, it is closed as a valid JSON array and no further events are written.
+BOOST_AUTO_TEST_CASE(NodeProfilerTraceIsCapped)
+{
+    const wstring tracePath = L"NodeProfilerTests.capped.json";
+    auto net = CreateNetwork(2, 3);
+    net->Environment().m_nodeProfiler = make_shared<NodeProfiler>(/*withStats=*/false, tracePath, /*maxTraceEvents=*/3);
+    Train(net, 2);
+    net->Environment().m_nodeProfiler.reset();
+
+    const string trace = ReadFile(tracePath);
+    BOOST_CHECK_EQUAL(CountOccurrences(trace, "\"ph\":\"X\""), 3);
+    BOOST_CHECK_EQUAL(CountOccurrences(trace, "]"), 1);
+    BOOST_CHECK_EQUAL(trace.substr(trace.size() - 3), "\n]\n");
+
+    _wunlink(tracePath.c_str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
@@ -0,0 +1,66 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "ComputationNetwork.h"
+#include "ComputationNetworkBuilder.h"
+#include "TrainingNodes.h"
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// Builds, with random weights and normalization statistics, and all BatchNormalization nodes in inference mode:
+//   z1 = W1 * BN0(features) + b1               (normalization before a Times: folded into W1 and b1)
+//   h1 = ReLU(BN1(z1))                          (normalization after Times and Plus: folded into W1 and b1)
+//   output = W3 * BN2(Plus(h1, b2))             (before a Times without bias; the Plus below is not a Times, so b2 must stay as is)
+static ComputationNetworkPtr CreateNetwork()
+{
+    const size_t inputDim = 6, hiddenDim = 8, outputDim = 4;
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<float> builder(*net);
+    unsigned long seed = 1;
+    auto parameter = [&](const wstring& name, size_t rows, size_t cols, float low, float high)
+    {
+        auto p = builder.CreateLearnableParameter(name, rows, cols);
+        p->Value().SetUniformRandomValue(low, high, seed++);
+        return p;
+    };
+    auto batchNormalization = [&](const shared_ptr<ComputationNode<float>>& input, size_t dim, const wstring& name)
+    {
+        return builder.BatchNormalization(input, parameter(name + L"_scale", dim, 1, 0.5f, 1.5f), parameter(name + L"_bias", dim, 1, -1.0f, 1.0f),
+                                          parameter(name + L"_mean", dim, 1, -1.0f, 1.0f), parameter(name + L"_invStdDev", dim, 1, 0.5f, 2.0f),
+                                          true /*eval*/, false /*spatial*/, 0, 1e-5, true, ImageLayoutKind::CHW, name);
+    };
+
+    auto features = builder.CreateInputNode(L"features", inputDim);
+    auto z1 = builder.Plus(builder.Times(parameter(L"W1", hiddenDim, inputDim, -1.0f, 1.0f), batchNormalization(features, inputDim, L"bn0"), 1, L"W1x"),
+                           parameter(L"b1", hiddenDim, 1, -1.0f, 1.0f), L"z1");
+    auto h1 = builder.RectifiedLinear(batchNormalization(z1, hiddenDim, L"bn1"), L"h1");
+    auto z2 = builder.Plus(h1, parameter(L"b2", hiddenDim, 1, -1.0f, 1.0f), L"z2");
+    auto output = builder.Times(parameter(L"W3", outputDim, hiddenDim, -1.0f, 1.0f), batchNormalization(z2, hiddenDim, L"bn2"), 1, L"output");
+
+    net->FeatureNodes().push_back(features);
+    net->OutputNodes().push_back(output);
+    net->CompileNetwork();
+    return net;
+}
+
+BOOST_AUTO_TEST_SUITE(NormalizationFoldingSuite)
+
+// Folding the normalization nodes into the adjacent weights must not change the outputs.
+BOOST_AUTO_TEST_CASE(FoldedNetworkMatchesUnfolded)
+{
+    auto net = CreateNetwork();
+    auto ref = net->Clone();
+    BOOST_CHECK_EQUAL(net->FoldNormalizationIntoParameters<float>(false /*verify*/), 3);
+    BOOST_CHECK(net->GetNodesWithType(OperationNameOf(BatchNormalizationNode)).empty());
+
+    double deviation = ComputationNetwork::MaxOutputDeviation<float>(net, ref);
+    BOOST_CHECK(deviation >= 0 && deviation < 1e-5);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
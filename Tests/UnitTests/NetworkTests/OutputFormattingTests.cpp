@@ -0,0 +1,182 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "ComputationNode.h"
+#include "DataWriter.h"
+#include "SimpleOutputWriter.h"
+#include <random>
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// format the way WriteMinibatchWithFormatting() used to, with one fprintf() per value: sequence s holds frames [s * numFrames, (s + 1) * numFrames)
+static std::string PrintfFormat(const std::vector<float>& data, size_t numRows, size_t numSequences, size_t numFrames, const char* valueFormat)
+{
+    std::string out;
+    char buf[64];
+    for (size_t s = 0; s < numSequences; s++)
+    {
+        for (size_t t = 0; t < numFrames; t++)
+        {
+            if (t > 0)
+                out += "\n";
+            for (size_t i = 0; i < numRows; i++)
+            {
+                if (i > 0)
+                    out += " ";
+                sprintf(buf, valueFormat, (double) data[(t * numSequences + s) * numRows + i]);
+                out += buf;
+            }
+        }
+        out += "\n";
+    }
+    return out;
+}
+
+BOOST_AUTO_TEST_SUITE(OutputFormattingSuite)
+
+// The fast fixed-point formatting of output values must give exactly what printf() gives, including rounding ties and negative zeros.
+BOOST_AUTO_TEST_CASE(FormatMinibatchMatchesPrintf)
+{
+    const size_t numRows = 7, numSequences = 3, numFrames = 50;
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> distribution(-1000.0f, 1000.0f);
+    std::vector<float> data(numRows * numSequences * numFrames);
+    for (size_t k = 0; k < data.size(); k++)
+    {
+        switch (k % 5)
+        {
+        case 0: data[k] = distribution(rng); break;
+        case 1: data[k] = distribution(rng) * 1e-6f; break;
+        case 2: data[k] = (float) ((int) distribution(rng)) / 8; break; // ties in the last printed digit
+        case 3: data[k] = -0.0f; break;
+        default: data[k] = distribution(rng) * 1e9f; break;
+        }
+    }
+
+    auto pMBLayout = make_shared<MBLayout>(numSequences, numFrames);
+    for (size_t s = 0; s < numSequences; s++)
+        pMBLayout->AddSequence(NEW_SEQUENCE_ID, s, 0, numFrames);
+
+    for (const char* valueFormat : {"%f", "%.0f", "%.2f", "%.3f", "%.9f", "%10.4f"})
+    {
+        std::vector<float> matData = data;
+        std::string formatted;
+        ComputationNode<float>::FormatMinibatch(formatted, matData.data(), numRows, pMBLayout, SIZE_MAX, SIZE_MAX, /*transpose=*/true, /*isCategoryLabel=*/false,
+                                                std::vector<std::string>(), "", "", "\n", " ", "\n", valueFormat);
+        BOOST_CHECK(formatted == PrintfFormat(data, numRows, numSequences, numFrames, valueFormat));
+    }
+}
+
+// binary=true writes each sequence as its number of rows and frames (int32), followed by the frames that lie within the
+// minibatch as float32 values. Sequences are written in MBLayout order, and gaps are skipped.
+BOOST_AUTO_TEST_CASE(FormatBinaryWritesSequencesInLayoutOrder)
+{
+    const size_t numRows = 2, numSequences = 3, numFrames = 4;
+    auto pMBLayout = make_shared<MBLayout>(numSequences, numFrames);
+    pMBLayout->AddSequence(NEW_SEQUENCE_ID, 0, 0, 4);  // the whole minibatch
+    pMBLayout->AddSequence(NEW_SEQUENCE_ID, 1, -2, 2); // begun in the previous minibatch
+    pMBLayout->AddSequence(NEW_SEQUENCE_ID, 1, 2, 6);  // going on into the next one
+    pMBLayout->AddSequence(NEW_SEQUENCE_ID, 2, 0, 3);
+    pMBLayout->AddGap(2, 3, 4);
+
+    std::vector<double> matData(numRows * numSequences * numFrames);
+    for (size_t j = 0; j < numSequences * numFrames; j++)
+        for (size_t i = 0; i < numRows; i++)
+            matData[j * numRows + i] = 100.0 * j + i + 0.5;
+
+    std::string expected;
+    auto appendSequence = [&](size_t s, size_t tBegin, size_t tEnd)
+    {
+        int32_t header[2] = {(int32_t) numRows, (int32_t) (tEnd - tBegin)};
+        expected.append((const char*) header, sizeof(header));
+        for (size_t t = tBegin; t < tEnd; t++)
+        {
+            for (size_t i = 0; i < numRows; i++)
+            {
+                float value = (float) matData[(t * numSequences + s) * numRows + i];
+                expected.append((const char*) &value, sizeof(value));
+            }
+        }
+    };
+    appendSequence(0, 0, 4);
+    appendSequence(1, 0, 2);
+    appendSequence(1, 2, 4);
+    appendSequence(2, 0, 3);
+
+    std::string formatted;
+    SimpleOutputWriter<double>::FormatBinary(formatted, matData.data(), numRows, pMBLayout);
+    BOOST_CHECK_EQUAL(formatted.size(), expected.size());
+    BOOST_CHECK(formatted == expected);
+
+    // without MBLayout, the data is a single sample
+    formatted.clear();
+    SimpleOutputWriter<double>::FormatBinary(formatted, matData.data(), numRows, nullptr);
+    expected.clear();
+    int32_t header[2] = {(int32_t) numRows, 1};
+    expected.append((const char*) header, sizeof(header));
+    for (size_t i = 0; i < numRows; i++)
+    {
+        float value = (float) matData[i];
+        expected.append((const char*) &value, sizeof(value));
+    }
+    BOOST_CHECK(formatted == expected);
+}
+
+// Minibatches are formatted in parallel in the background, later (smaller) ones possibly finishing first. They must be
+// written in the order they were passed in, with no more than outputQueueDepth of them pending at a time.
+BOOST_AUTO_TEST_CASE(AsyncOutputKeepsMinibatchOrder)
+{
+    const size_t numRows = 3, numSequences = 2, numMinibatches = 12, outputQueueDepth = 3;
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<float> builder(*net);
+    auto features = builder.CreateInputNode(L"features", numRows);
+    net->FeatureNodes().push_back(features);
+    net->CompileNetwork();
+    SimpleOutputWriter<float> writer(net, 0, outputQueueDepth);
+    SimpleOutputWriter<float>::WriteFormattingOptions formattingOptions;
+    const std::vector<std::string> labelMapping;
+
+    const std::string path = "OutputFormattingTests.out";
+    FILE* f = fopenOrDie(path, "wb");
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> distribution(-10.0f, 10.0f);
+    std::string expected;
+    std::deque<std::shared_future<void>> pendingWrites;
+    for (size_t mb = 0; mb < numMinibatches; mb++)
+    {
+        size_t numFrames = 400 - 30 * mb;
+        auto pMBLayout = net->GetMBLayoutPtr();
+        pMBLayout->Init(numSequences, numFrames);
+        pMBLayout->AddSequence(NEW_SEQUENCE_ID, 0, 0, numFrames);
+        pMBLayout->AddSequence(NEW_SEQUENCE_ID, 1, 0, numFrames - mb);
+        if (mb > 0)
+            pMBLayout->AddGap(1, numFrames - mb, numFrames);
+        std::vector<float> data(numRows * numSequences * numFrames);
+        for (auto& value : data)
+            value = distribution(rng);
+        features->Value().SetValue(numRows, numSequences * numFrames, CPUDEVICE, data.data(), matrixFlagNormal);
+
+        writer.WriteMinibatchAsync(pendingWrites, f, features, formattingOptions, "%.3f", labelMapping, mb, /*gradient=*/false);
+        BOOST_CHECK_LE(pendingWrites.size(), outputQueueDepth);
+        ComputationNode<float>::FormatMinibatch(expected, data.data(), numRows, pMBLayout, SIZE_MAX, SIZE_MAX, /*transpose=*/true, /*isCategoryLabel=*/false,
+                                                labelMapping, "", "", "\n", " ", "\n", "%.3f");
+    }
+    for (auto& pendingWrite : pendingWrites)
+        pendingWrite.get();
+    fcloseOrDie(f);
+
+    f = fopenOrDie(path, "rb");
+    std::string written(filesize(f), '\0');
+    freadOrDie(&written[0], 1, written.size(), f);
+    fcloseOrDie(f);
+    BOOST_CHECK(written == expected);
+    _wunlink(s2ws(path).c_str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
@@ -0,0 +1,88 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "ComputationNetwork.h"
+#include "ComputationNetworkBuilder.h"
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+// Builds output = W2 * ReLU(W1 * features + b1) with random weights.
+static ComputationNetworkPtr CreateNetwork()
+{
+    const size_t inputDim = 200, hiddenDim = 300, outputDim = 100;
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<float> builder(*net);
+
+    auto features = builder.CreateInputNode(L"features", inputDim);
+    auto W1 = builder.CreateLearnableParameter(L"W1", hiddenDim, inputDim);
+    auto b1 = builder.CreateLearnableParameter(L"b1", hiddenDim, 1);
+    auto W2 = builder.CreateLearnableParameter(L"W2", outputDim, hiddenDim);
+    unsigned long seed = 1;
+    for (auto& parameter : {W1, b1, W2})
+        parameter->Value().SetUniformRandomValue(-1.0f, 1.0f, seed++);
+    auto h = builder.RectifiedLinear(builder.Plus(builder.Times(W1, features, 1, L"W1x"), b1, L"z1"), L"h1");
+    auto output = builder.Times(W2, h, 1, L"output");
+
+    net->FeatureNodes().push_back(features);
+    net->OutputNodes().push_back(output);
+    net->CompileNetwork();
+    return net;
+}
+
+// zero all elements of a dense parameter below the magnitude at rank 'sparsity' (what pruning is expected to do)
+static void PruneByHand(const ComputationNetworkPtr& net, const wstring& name, double sparsity)
+{
+    auto& value = dynamic_pointer_cast<ComputationNode<float>>(net->GetNodeFromName(name))->Value();
+    size_t rows = value.GetNumRows(), cols = value.GetNumCols();
+    vector<float> data(rows * cols);
+    value.CopySection(rows, cols, data.data(), rows);
+    vector<float> magnitudes;
+    for (auto x : data)
+        magnitudes.push_back(fabs(x));
+    sort(magnitudes.begin(), magnitudes.end());
+    float threshold = magnitudes[(size_t) (sparsity * data.size())];
+    for (auto& x : data)
+        if (fabs(x) < threshold)
+            x = 0;
+    value.SetValue(rows, cols, CPUDEVICE, data.data(), matrixFlagNormal);
+}
+
+BOOST_AUTO_TEST_SUITE(ParameterPruningSuite)
+
+static MatrixType StorageOf(const ComputationNetworkPtr& net, const wstring& name)
+{
+    return dynamic_pointer_cast<ComputationNode<float>>(net->GetNodeFromName(name))->Value().GetMatrixType();
+}
+
+// The pruned network must compute the same outputs as the dense network with the same elements zeroed, also after saving
+// and loading it. The weight matrices are forced into sparse storage, so that this covers the CSR path of the Times node
+// and its Save/Load round trip, whichever storage would be faster on this machine.
+BOOST_AUTO_TEST_CASE(PrunedNetworkMatchesDensePruning)
+{
+    const double sparsity = 0.9;
+    auto net = CreateNetwork();
+    auto ref = net->Clone();
+    BOOST_CHECK_EQUAL(net->PruneParameters<float>(sparsity, L"", 256, /*minSparseSpeedup=*/0), 2); // W1 and W2, not the bias
+    PruneByHand(ref, L"W1", sparsity);
+    PruneByHand(ref, L"W2", sparsity);
+    BOOST_CHECK(StorageOf(net, L"W1") == MatrixType::SPARSE && StorageOf(net, L"W2") == MatrixType::SPARSE);
+
+    double deviation = ComputationNetwork::MaxOutputDeviation<float>(net, ref);
+    BOOST_CHECK(deviation >= 0 && deviation < 1e-5);
+
+    const wstring modelPath = L"ParameterPruningTests.model";
+    net->Save(modelPath);
+    auto loaded = ComputationNetwork::CreateFromFile<float>(CPUDEVICE, modelPath);
+    _wunlink(modelPath.c_str());
+    BOOST_CHECK(StorageOf(loaded, L"W1") == MatrixType::SPARSE && StorageOf(loaded, L"W2") == MatrixType::SPARSE);
+    deviation = ComputationNetwork::MaxOutputDeviation<float>(loaded, ref);
+    BOOST_CHECK(deviation >= 0 && deviation < 1e-5);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
@@ -0,0 +1,163 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "ComputationNetwork.h"
+#include "ComputationNetworkBuilder.h"
+#include <condition_variable>
+#include <mutex>
+#include <random>
+#include <thread>
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+static const size_t dim = 3;
+
+// stands in for MPIWrapper::AllReduce() across 'numWorkers' threads: blocks until all workers have contributed, then
+// returns the element-wise sum to each of them
+class SimulatedAllReduce
+{
+public:
+    SimulatedAllReduce(size_t numWorkers)
+        : m_numWorkers(numWorkers), m_numArrived(0), m_generation(0)
+    {
+    }
+
+    void operator()(double* data, size_t n)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_numArrived == 0)
+            m_sum.assign(n, 0);
+        for (size_t i = 0; i < n; i++)
+            m_sum[i] += data[i];
+        size_t generation = m_generation;
+        if (++m_numArrived == m_numWorkers)
+        {
+            m_result = m_sum;
+            m_numArrived = 0;
+            m_generation++;
+            m_allArrived.notify_all();
+        }
+        else
+            m_allArrived.wait(lock, [&]() { return m_generation != generation; });
+        std::copy(m_result.begin(), m_result.end(), data);
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_allArrived;
+    size_t m_numWorkers, m_numArrived, m_generation;
+    std::vector<double> m_sum, m_result;
+};
+
+// a network of features -> Mean, InvStdDev, of which each worker owns one
+struct PreComputeWorker
+{
+    ComputationNetworkPtr net;
+    std::list<ComputationNodeBasePtr> nodes;
+
+    PreComputeWorker()
+        : net(make_shared<ComputationNetwork>(CPUDEVICE))
+    {
+        ComputationNetworkBuilder<float> builder(*net);
+        auto features = builder.CreateInputNode(L"features", dim);
+        auto mean = builder.Mean(features, L"mean");
+        auto invStdDev = builder.InvStdDev(features, L"invStdDev");
+        net->FeatureNodes().push_back(features);
+        net->CompileNetwork();
+        net->AllocateAllMatrices({mean, invStdDev}, {}, nullptr);
+        nodes = {mean, invStdDev};
+    }
+
+    // accumulates over the columns of 'data' in minibatches of 'mbSize'
+    void Accumulate(const vector<float>& data, size_t mbSize)
+    {
+        ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::preComputing);
+        net->StartEvaluateMinibatchLoop(nodes);
+        for (auto& node : nodes)
+            dynamic_pointer_cast<IPreComputeNode>(node)->MarkComputed(false);
+        auto features = dynamic_pointer_cast<ComputationNode<float>>(net->GetNodeFromName(L"features"));
+        const size_t numCols = data.size() / dim;
+        for (size_t begin = 0; begin < numCols; begin += mbSize)
+        {
+            size_t numMBCols = min(mbSize, numCols - begin);
+            vector<float> mb(data.begin() + begin * dim, data.begin() + (begin + numMBCols) * dim);
+            net->GetMBLayoutPtr()->InitAsFrameMode(numMBCols);
+            features->Value().SetValue(dim, numMBCols, CPUDEVICE, mb.data(), matrixFlagNormal);
+            features->NotifyFunctionValuesMBSizeModified();
+            ComputationNetwork::BumpEvalTimeStamp(net->FeatureNodes());
+            net->ForwardProp(nodes);
+        }
+    }
+
+    void Finalize(const std::function<void(double*, size_t)>& allReduce)
+    {
+        ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::preComputing);
+        if (allReduce)
+            for (auto& node : nodes)
+                dynamic_pointer_cast<IPreComputeNode>(node)->AggregateAccumulators(allReduce);
+        for (auto& node : nodes)
+            dynamic_pointer_cast<IPreComputeNode>(node)->MarkComputed(true);
+    }
+
+    float Value(const wstring& name, size_t i)
+    {
+        return dynamic_pointer_cast<ComputationNode<float>>(net->GetNodeFromName(name))->Value()(i, 0);
+    }
+};
+
+BOOST_AUTO_TEST_SUITE(PreComputeSuite)
+
+// Workers accumulate Mean and InvStdDev over shares of the data that differ in size and distribution. After merging their
+// accumulators, all of them must hold the statistics of the whole data, as a single worker computes them.
+BOOST_AUTO_TEST_CASE(AggregatedMeanAndVarianceMatchSingleWorker)
+{
+    const size_t numSamples[] = {70, 13, 150, 1};
+    const size_t numWorkers = sizeof(numSamples) / sizeof(*numSamples);
+    std::mt19937 rng(3);
+    vector<vector<float>> shares(numWorkers);
+    vector<float> all;
+    for (size_t k = 0; k < numWorkers; k++)
+    {
+        std::normal_distribution<float> distribution(5.0f * k - 4.0f, 1.0f + k);
+        for (size_t j = 0; j < numSamples[k] * dim; j++)
+            shares[k].push_back(distribution(rng));
+        all.insert(all.end(), shares[k].begin(), shares[k].end());
+    }
+
+    PreComputeWorker reference;
+    reference.Accumulate(all, 32);
+    reference.Finalize(nullptr);
+
+    vector<unique_ptr<PreComputeWorker>> workers;
+    for (size_t k = 0; k < numWorkers; k++)
+        workers.emplace_back(new PreComputeWorker());
+    SimulatedAllReduce allReduce(numWorkers);
+    vector<std::thread> threads;
+    for (size_t k = 0; k < numWorkers; k++)
+    {
+        threads.emplace_back([&, k]()
+        {
+            workers[k]->Accumulate(shares[k], 32);
+            workers[k]->Finalize(std::ref(allReduce));
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    for (const auto& worker : workers)
+    {
+        for (size_t i = 0; i < dim; i++)
+        {
+            BOOST_CHECK_CLOSE(worker->Value(L"mean", i), reference.Value(L"mean", i), 1e-3);
+            BOOST_CHECK_CLOSE(worker->Value(L"invStdDev", i), reference.Value(L"invStdDev", i), 1e-3);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
@@ -0,0 +1,207 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "ComputationNetwork.h"
+#include "ComputationNetworkBuilder.h"
+#include "StreamingEvaluator.h"
+#include <random>
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+static const size_t featureDim = 3;
+static const size_t outputDim = 4;
+
+typedef StreamingEvaluator<float>::StreamBuffers StreamBuffers;
+
+// Builds a two-layer RNN with random weights:
+//   h1 = Tanh(W1 * features + R1 * PastValue(h1) + b1), h2 = Tanh(W2 * h1 + R2 * PastValue(h2) + b2), output = O * h2
+static ComputationNetworkPtr CreateRecurrentNetwork()
+{
+    const size_t hiddenDim = 5;
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<float> builder(*net);
+
+    auto features = builder.CreateInputNode(L"features", featureDim);
+    shared_ptr<ComputationNode<float>> h = features;
+    unsigned long seed = 1;
+    for (size_t layer = 1; layer <= 2; layer++)
+    {
+        auto suffix = std::to_wstring(layer);
+        auto W = builder.CreateLearnableParameter(L"W" + suffix, hiddenDim, layer == 1 ? featureDim : hiddenDim);
+        auto R = builder.CreateLearnableParameter(L"R" + suffix, hiddenDim, hiddenDim);
+        auto b = builder.CreateLearnableParameter(L"b" + suffix, hiddenDim, 1);
+        for (auto& parameter : {W, R, b})
+            parameter->Value().SetUniformRandomValue(-1.0f, 1.0f, seed++);
+
+        auto pastValue = builder.PastValue(h /*replaced below*/, 0.1f, hiddenDim, 1, L"pastH" + suffix);
+        auto next = builder.Tanh(builder.Plus(builder.Plus(builder.Times(W, h, 1, L"Wx" + suffix), builder.Times(R, pastValue, 1, L"Rh" + suffix), L"sum" + suffix), b, L"z" + suffix), L"h" + suffix);
+        static_pointer_cast<ComputationNodeBase>(pastValue)->SetInput(0, next); // close the loop
+        h = next;
+    }
+    auto O = builder.CreateLearnableParameter(L"O", outputDim, hiddenDim);
+    O->Value().SetUniformRandomValue(-1.0f, 1.0f, seed++);
+    auto output = builder.Times(O, h, 1, L"output");
+
+    net->FeatureNodes().push_back(features);
+    net->OutputNodes().push_back(output);
+    net->CompileNetwork();
+    return net;
+}
+
+// evaluate a complete sequence in one regular forward pass
+static vector<float> EvaluateSequence(ComputationNetworkPtr net, vector<float>& frames)
+{
+    size_t numFrames = frames.size() / featureDim;
+    ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::inferring);
+    auto pMBLayout = net->GetMBLayoutPtr();
+    pMBLayout->Init(1, numFrames);
+    pMBLayout->AddSequence(NEW_SEQUENCE_ID, 0, 0, numFrames);
+
+    auto features = dynamic_pointer_cast<ComputationNode<float>>(net->GetNodeFromName(L"features"));
+    features->Value().SetValue(featureDim, numFrames, CPUDEVICE, frames.data(), matrixFlagNormal);
+    features->NotifyFunctionValuesMBSizeModified();
+    ComputationNetwork::BumpEvalTimeStamp(net->FeatureNodes());
+    auto output = net->GetNodeFromName(L"output");
+    net->ForwardProp(output);
+
+    const auto& value = dynamic_pointer_cast<ComputationNode<float>>(output)->Value();
+    vector<float> result(value.GetNumElements());
+    value.CopySection(outputDim, numFrames, result.data(), outputDim);
+    return result;
+}
+
+static vector<float> RandomFrames(size_t numFrames, std::mt19937& rng)
+{
+    std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+    vector<float> frames(numFrames * featureDim);
+    for (auto& value : frames)
+        value = distribution(rng);
+    return frames;
+}
+
+BOOST_AUTO_TEST_SUITE(StreamingEvaluatorSuite)
+
+// Streams fed chunk by chunk, batched with each other in varying combinations and chunk lengths, must produce
+// the same outputs as evaluating each complete sequence at once. This includes a stream that is moved to
+// another stream id by exporting and importing its state.
+BOOST_AUTO_TEST_CASE(StreamingMatchesFullSequence)
+{
+    auto net = CreateRecurrentNetwork();
+    StreamingEvaluator<float> evaluator(net);
+
+    std::mt19937 rng(7);
+    vector<size_t> sequenceLengths = {9, 14, 5, 11};
+    vector<vector<float>> frames, expected;
+    for (auto length : sequenceLengths)
+    {
+        frames.push_back(RandomFrames(length, rng));
+        expected.push_back(EvaluateSequence(net, frames.back()));
+    }
+
+    const size_t numSequences = sequenceLengths.size();
+    const size_t movedSequence = 1, movedStreamId = 101;
+    vector<size_t> streamIds = {0, 1, 2, 3};
+    vector<size_t> position(numSequences, 0);
+    vector<vector<float>> actual(numSequences);
+    for (size_t call = 0;; call++)
+    {
+        // this call's chunks: stream 3 joins late, and each stream skips every third call
+        map<size_t, StreamBuffers> inputs, outputs;
+        vector<vector<float>> inputFrames(numSequences), outputFrames(numSequences);
+        for (size_t i = 0; i < numSequences; i++)
+        {
+            if (position[i] == sequenceLengths[i] || (i == 3 && call < 2) || (call + i) % 3 == 2)
+                continue;
+            size_t length = min(1 + (call + i) % 4, sequenceLengths[i] - position[i]);
+            inputFrames[i].assign(frames[i].begin() + position[i] * featureDim, frames[i].begin() + (position[i] + length) * featureDim);
+            inputs[streamIds[i]][L"features"] = &inputFrames[i];
+            outputs[streamIds[i]][L"output"] = &outputFrames[i];
+            position[i] += length;
+        }
+        if (inputs.empty() && position == sequenceLengths)
+            break;
+
+        evaluator.EvaluateChunk(inputs, outputs);
+        for (size_t i = 0; i < numSequences; i++)
+        {
+            BOOST_REQUIRE_EQUAL(outputFrames[i].size(), inputFrames[i].size() / featureDim * outputDim);
+            actual[i].insert(actual[i].end(), outputFrames[i].begin(), outputFrames[i].end());
+        }
+
+        if (call == 2) // move a stream to another id through its exported state
+        {
+            map<wstring, NodeStatePtr> states;
+            evaluator.ExportStreamState(streamIds[movedSequence], states);
+            BOOST_CHECK_EQUAL(states.size(), 2);
+            evaluator.EndStream(streamIds[movedSequence]);
+            evaluator.ImportStreamState(movedStreamId, states);
+            streamIds[movedSequence] = movedStreamId;
+        }
+    }
+
+    for (size_t i = 0; i < numSequences; i++)
+    {
+        BOOST_REQUIRE_EQUAL(actual[i].size(), expected[i].size());
+        for (size_t j = 0; j < expected[i].size(); j++)
+            BOOST_CHECK_SMALL(actual[i][j] - expected[i][j], 1e-5f);
+    }
+    BOOST_CHECK_EQUAL(evaluator.GetNumStreams(), numSequences);
+}
+
+// Many chunks of many streams: the output of each chunk, with the state carried over, must be the same as re-evaluating
+// the stream's history from its beginning, also when other streams are started and ended in between.
+// (The latency of both is compared by the streamingLatency command of EvalTest.)
+BOOST_AUTO_TEST_CASE(StreamingChunksMatchHistoryReEvaluation)
+{
+    const size_t numStreams = 16, numChunks = 40, chunkLength = 4;
+    auto net = CreateRecurrentNetwork();
+    StreamingEvaluator<float> evaluator(net);
+
+    std::mt19937 rng(11);
+    vector<vector<float>> frames;
+    for (size_t s = 0; s < numStreams; s++)
+        frames.push_back(RandomFrames(numChunks * chunkLength, rng));
+
+    auto evaluate = [&](size_t firstFrame, size_t numFrames, size_t streamIdBase)
+    {
+        map<size_t, StreamBuffers> inputs, outputs;
+        vector<vector<float>> inputFrames(numStreams), outputFrames(numStreams);
+        for (size_t s = 0; s < numStreams; s++)
+        {
+            inputFrames[s].assign(frames[s].begin() + firstFrame * featureDim, frames[s].begin() + (firstFrame + numFrames) * featureDim);
+            inputs[streamIdBase + s][L"features"] = &inputFrames[s];
+            outputs[streamIdBase + s][L"output"] = &outputFrames[s];
+        }
+        evaluator.EvaluateChunk(inputs, outputs);
+        return outputFrames;
+    };
+
+    for (size_t chunk = 0; chunk < numChunks; chunk++)
+    {
+        // streaming: the next chunk
+        auto actual = evaluate(chunk * chunkLength, chunkLength, 0);
+
+        // without carried-over state: the history up to and including the chunk, as new streams
+        size_t streamIdBase = (chunk + 1) * numStreams;
+        auto expected = evaluate(0, (chunk + 1) * chunkLength, streamIdBase);
+        for (size_t s = 0; s < numStreams; s++)
+            evaluator.EndStream(streamIdBase + s);
+
+        for (size_t s = 0; s < numStreams; s++)
+        {
+            BOOST_REQUIRE_EQUAL(actual[s].size(), chunkLength * outputDim);
+            BOOST_REQUIRE_EQUAL(expected[s].size(), (chunk + 1) * chunkLength * outputDim);
+            for (size_t k = 0; k < actual[s].size(); k++)
+                BOOST_CHECK_SMALL(actual[s][k] - expected[s][chunk * chunkLength * outputDim + k], 1e-5f);
+        }
+    }
+    BOOST_CHECK_EQUAL(evaluator.GetNumStreams(), numStreams);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
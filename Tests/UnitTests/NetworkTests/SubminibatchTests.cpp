@@ -0,0 +1,169 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "ComputationNetwork.h"
+#include "ComputationNetworkBuilder.h"
+#include "DataReaderHelpers.h"
+#include <random>
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+static const size_t featureDim = 4;
+static const size_t hiddenDim = 5;
+static const size_t labelDim = 3;
+
+// largest absolute difference between the elements of two matrices of the same dimensions
+static float MaxDeviation(const Matrix<float>& a, const Matrix<float>& b)
+{
+    BOOST_REQUIRE_EQUAL(a.GetNumRows(), b.GetNumRows());
+    BOOST_REQUIRE_EQUAL(a.GetNumCols(), b.GetNumCols());
+    vector<float> x(a.GetNumElements()), y(b.GetNumElements());
+    float* px = x.data();
+    float* py = y.data();
+    size_t nx = x.size(), ny = y.size();
+    a.CopyToArray(px, nx);
+    b.CopyToArray(py, ny);
+    float deviation = 0;
+    for (size_t i = 0; i < x.size(); i++)
+        deviation = max(deviation, fabs(x[i] - y[i]));
+    return deviation;
+}
+
+static shared_ptr<ComputationNode<float>> GetNode(const ComputationNetworkPtr& net, const wstring& name)
+{
+    return dynamic_pointer_cast<ComputationNode<float>>(net->GetNodeFromName(name));
+}
+
+// sets the value of an input node to 'data', and notifies it of the new minibatch size and the new value
+static void SetInput(const ComputationNetworkPtr& net, const wstring& name, size_t rows, vector<float>& data)
+{
+    auto input = GetNode(net, name);
+    input->Value().SetValue(rows, data.size() / rows, CPUDEVICE, data.data(), matrixFlagNormal);
+    input->NotifyFunctionValuesMBSizeModified();
+    input->BumpEvalTimeStamp();
+}
+
+// Builds a recurrent layer h = Sigmoid(W * features + R * PastValue(h) + b) with criterion = CrossEntropyWithSoftmax(labels, V * h)
+// and ErrorPrediction as evaluation node, with the same random weights every time.
+static ComputationNetworkPtr CreateNetwork()
+{
+    auto net = make_shared<ComputationNetwork>(CPUDEVICE);
+    ComputationNetworkBuilder<float> builder(*net);
+
+    auto features = builder.CreateInputNode(L"features", featureDim);
+    auto labels = builder.CreateInputNode(L"labels", labelDim);
+    auto W = builder.CreateLearnableParameter(L"W", hiddenDim, featureDim);
+    auto R = builder.CreateLearnableParameter(L"R", hiddenDim, hiddenDim);
+    auto b = builder.CreateLearnableParameter(L"b", hiddenDim, 1);
+    auto V = builder.CreateLearnableParameter(L"V", labelDim, hiddenDim);
+    unsigned long seed = 1;
+    for (auto& parameter : {W, R, b, V})
+        parameter->Value().SetUniformRandomValue(-1.0f, 1.0f, seed++);
+    auto pastH = builder.PastValue(features /*replaced below*/, 0.1f, hiddenDim, 1, L"pastH");
+    auto h = builder.Sigmoid(builder.Plus(builder.Plus(builder.Times(W, features), builder.Times(R, pastH)), b), L"h");
+    static_pointer_cast<ComputationNodeBase>(pastH)->SetInput(0, h);
+    auto z = builder.Times(V, h, 1, L"z");
+    auto criterion = builder.CrossEntropyWithSoftmax(labels, z, L"criterion");
+    auto errors = builder.ErrorPrediction(labels, z, L"errors");
+
+    net->FeatureNodes().push_back(features);
+    net->LabelNodes().push_back(labels);
+    net->FinalCriterionNodes().push_back(criterion);
+    net->EvaluationNodes().push_back(errors);
+    net->CompileNetwork();
+    net->AllocateAllMatrices({errors}, {}, criterion);
+    return net;
+}
+
+// the subminibatch dispatcher does not read, it only takes the reader for the interface
+class NoReader : public IDataReader
+{
+public:
+    virtual void Init(const ConfigParameters&) override {}
+    virtual void Init(const ScriptableObjects::IConfigRecord&) override {}
+    virtual void Destroy() override {}
+    virtual void StartMinibatchLoop(size_t, size_t, size_t) override { LogicError("NoReader: Not expected to be called."); }
+    virtual bool GetMinibatch(StreamMinibatchInputs&) override { LogicError("NoReader: Not expected to be called."); }
+    virtual size_t GetNumParallelSequences() override { LogicError("NoReader: Not expected to be called."); }
+    virtual bool DataEnd() override { LogicError("NoReader: Not expected to be called."); }
+    virtual void CopyMBLayoutTo(MBLayoutPtr) override { LogicError("NoReader: Not expected to be called."); }
+};
+
+BOOST_AUTO_TEST_SUITE(SubminibatchSuite)
+
+// Splitting a minibatch into subminibatches, whose parameter gradients are accumulated in place, must give the same
+// parameter gradients, criterion and evaluation values as computing the full minibatch at once.
+BOOST_AUTO_TEST_CASE(SubminibatchGradientsMatchFullMinibatch)
+{
+    const size_t numSequences = 5, numTimeSteps = 6, numCols = numSequences * numTimeSteps;
+    const size_t sequenceLengths[numSequences] = {6, 3, 6, 1, 4};
+
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+    vector<float> features(featureDim * numCols), labels(labelDim * numCols, 0.0f);
+    for (auto& value : features)
+        value = distribution(rng);
+    for (size_t j = 0; j < numCols; j++)
+        labels[j * labelDim + rng() % labelDim] = 1.0f;
+
+    const wstring parameterNames[] = {L"W", L"R", L"b", L"V"};
+    ComputationNetworkPtr reference;
+    for (size_t numSubminibatches : {1, 2, 3, 5})
+    {
+        auto net = CreateNetwork();
+        ScopedNetworkOperationMode modeGuard(net, NetworkOperationMode::training);
+        auto pMBLayout = net->GetMBLayoutPtr();
+        pMBLayout->Init(numSequences, numTimeSteps);
+        for (size_t s = 0; s < numSequences; s++)
+        {
+            pMBLayout->AddSequence(s, s, 0, sequenceLengths[s]);
+            pMBLayout->AddGap(s, sequenceLengths[s], numTimeSteps);
+        }
+        SetInput(net, L"features", featureDim, features);
+        SetInput(net, L"labels", labelDim, labels);
+
+        auto criterion = net->FinalCriterionNodes()[0];
+        auto errors = net->EvaluationNodes()[0];
+        if (numSubminibatches == 1)
+        {
+            net->ForwardProp(errors);
+            net->ForwardProp(criterion);
+            net->Backprop(criterion);
+            reference = net;
+            continue;
+        }
+
+        StreamMinibatchInputs inputMatrices;
+        for (const auto& node : {net->FeatureNodes()[0], net->LabelNodes()[0]})
+            inputMatrices.AddInputMatrix(node->NodeName(), node->ValuePtr());
+        DataReaderHelpers::SubminibatchDispatcher<float> dispatcher;
+        dispatcher.Init(net, net->LearnableParameterNodes(criterion), net->FinalCriterionNodes(), net->EvaluationNodes());
+        NoReader reader;
+        size_t actualNumSubminibatches = dispatcher.GetMinibatchIntoCache(reader, *net, inputMatrices, numSubminibatches);
+        BOOST_REQUIRE_EQUAL(actualNumSubminibatches, numSubminibatches);
+        for (size_t i = 0; i < actualNumSubminibatches; i++)
+        {
+            dispatcher.GetSubMinibatchToNet(i);
+            ComputationNetwork::BumpEvalTimeStamp(net->FeatureNodes());
+            ComputationNetwork::BumpEvalTimeStamp(net->LabelNodes());
+            net->ForwardProp(errors);
+            net->ForwardProp(criterion);
+            net->Backprop(criterion, /*accumulateParameterGradients=*/i > 0);
+            dispatcher.DoneWithCurrentSubMinibatch(i);
+        }
+        dispatcher.DoneWithCurrentMinibatch();
+
+        BOOST_CHECK_LT(MaxDeviation(GetNode(net, L"criterion")->Value(), GetNode(reference, L"criterion")->Value()), 1e-4f);
+        BOOST_CHECK_LT(MaxDeviation(GetNode(net, L"errors")->Value(), GetNode(reference, L"errors")->Value()), 1e-6f);
+        for (const auto& name : parameterNames)
+            BOOST_CHECK_LT(MaxDeviation(GetNode(net, name)->Gradient(), GetNode(reference, name)->Gradient()), 1e-5f);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
@@ -0,0 +1,154 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "Actions.h"
+#include <fstream>
+#include <random>
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+static const size_t numShards = 4;
+static const size_t minTextSize = numShards << 20; // the word counting does not start a thread for less than 1 MB
+
+// Writes a text of ASCII and multi-byte UTF-8 words that writeWordAndClass counts in 'numShards' shards. Among the lines are
+// empty ones, ones of blanks, and ones that already have the sequence delimiters; many words occur equally often, from lines
+// all over the file. The last line is padded until the first shard boundary falls inside a UTF-8 sequence and the others
+// inside a line.
+static void WriteText(const string& path)
+{
+    const vector<string> stems = {"w", "w\xc3\xb6rter", "\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e", "na\xc3\xafve", "\xf0\x9f\x98\x80"};
+    std::mt19937 rng(5);
+    string text;
+    for (size_t lineIndex = 0; text.size() < minTextSize; lineIndex++)
+    {
+        switch (rng() % 20)
+        {
+        case 0: text += "\n"; continue;
+        case 1: text += "   \n"; continue;
+        case 2: text += "<s> "; break;
+        case 3: text += "  \t"; break;
+        }
+        size_t numWords = 3 + rng() % 12;
+        for (size_t i = 0; i < numWords; i++)
+            text += (i > 0 ? " " : "") + stems[rng() % stems.size()] + std::to_string(rng() % 60);
+        text += " tie" + std::to_string(lineIndex % 5000); // occur about equally often
+        text += rng() % 10 == 0 ? " </s>  \n" : "\n";
+    }
+
+    auto boundariesAsRequired = [&]()
+    {
+        for (size_t k = 1; k < numShards; k++)
+        {
+            size_t boundary = text.size() * k / numShards;
+            if (k == 1 ? (text[boundary] & 0xc0) != 0x80 : text[boundary - 1] == '\n')
+                return false;
+        }
+        return true;
+    };
+    for (size_t i = 0; i < 1000 && !boundariesAsRequired(); i++)
+        text.insert(text.size() - 1, "x");
+    BOOST_REQUIRE(boundariesAsRequired());
+
+    FILE* f = fopenOrDie(path, "wb");
+    fwriteOrDie(text.data(), 1, text.size(), f);
+    fcloseOrDie(f);
+}
+
+static string ReadFile(const string& path)
+{
+    FILE* f = fopenOrDie(path, "rb");
+    string content(filesize(f), '\0');
+    freadOrDie(&content[0], 1, content.size(), f);
+    fcloseOrDie(f);
+    return content;
+}
+
+// the word counting of DoWriteWordAndClassInfo() before it was split into shards, line by line, as the reference
+static void CountWordsLineByLine(const string& inputFile, const string& beginSequence, const string& endSequence, unordered_map<string, double>& counts)
+{
+    std::ifstream fp(inputFile.c_str());
+    BOOST_REQUIRE(fp);
+    const string beginSequencePattern = beginSequence + " ";
+    const string endSequencePattern = " " + endSequence;
+    string str;
+    while (getline(fp, str))
+    {
+        str.erase(0, str.find_first_not_of(' ')); // prefixing spaces
+        str.erase(str.find_last_not_of(' ') + 1); // surfixing spaces
+
+        if (!beginSequence.empty() && str.find(beginSequencePattern) == str.npos)
+            str = beginSequencePattern + str;
+
+        if (!endSequence.empty() && str.find(endSequencePattern) == str.npos)
+            str = str + endSequencePattern;
+
+        auto vstr = msra::strfun::split(str, "\t ");
+        for (size_t i = 1; i < vstr.size(); i++)
+            counts[vstr[i]]++;
+    }
+}
+
+BOOST_AUTO_TEST_SUITE(WriteWordAndClassInfoSuite)
+
+// Counting the words in one or several shards must give the same counts as the line-by-line reference, and must insert the
+// words into the hash table in the same order, since its iteration order decides how words of equal count are sorted.
+BOOST_AUTO_TEST_CASE(WordCountMatchesLineByLineReference)
+{
+    const string textPath = "WriteWordAndClassInfoTests.txt";
+    WriteText(textPath);
+
+    unordered_map<string, double> reference;
+    CountWordsLineByLine(textPath, "<s>", "</s>", reference);
+    typedef vector<pair<string, double>> WordCounts; // in the iteration order of the hash table
+    const WordCounts expected(reference.begin(), reference.end());
+    BOOST_CHECK(expected.size() > 5000);
+    BOOST_CHECK_EQUAL(reference["tie7"], reference["tie4007"]);
+    for (size_t numThreads : {(size_t) 1, numShards})
+    {
+        unordered_map<string, double> counts;
+        CountWords(textPath, "<s>", "</s>", numThreads, counts);
+        BOOST_CHECK(WordCounts(counts.begin(), counts.end()) == expected);
+    }
+
+    _wunlink(s2ws(textPath).c_str());
+}
+
+// Counting the words in several shards, whose boundaries split lines and UTF-8 sequences, must give the same
+// vocabulary and class files as counting them in one pass.
+BOOST_AUTO_TEST_CASE(ShardedWordCountMatchesSinglePass)
+{
+    const string textPath = "WriteWordAndClassInfoTests.txt";
+    WriteText(textPath);
+
+    vector<string> outputPaths;
+    for (size_t numThreads : {(size_t) 1, numShards})
+    {
+        auto path = [&](const char* name) { return msra::strfun::strprintf("WriteWordAndClassInfoTests.%d.%s", (int) numThreads, name); };
+        ConfigParameters config;
+        config.Parse(msra::strfun::strprintf("inputFile=%s\noutputVocabFile=%s\noutputWord2Cls=%s\noutputCls2Index=%s\n"
+                                             "vocabSize=100\nnbrClass=10\ncutoff=1\nbeginSequence=</s>\nendSequence=</s>\nmakeMode=false\nnumThreads=%d\n",
+                                             textPath.c_str(), path("vocab").c_str(), path("wrd2cls").c_str(), path("cls2idx").c_str(), (int) numThreads));
+        DoWriteWordAndClassInfo<float>(config);
+        for (auto name : {"vocab", "wrd2cls", "cls2idx"})
+            outputPaths.push_back(path(name));
+    }
+
+    for (size_t i = 0; i < 3; i++)
+    {
+        auto expected = ReadFile(outputPaths[i]);
+        BOOST_CHECK(!expected.empty());
+        BOOST_CHECK(ReadFile(outputPaths[3 + i]) == expected);
+    }
+
+    for (const auto& path : outputPaths)
+        _wunlink(s2ws(path).c_str());
+    _wunlink(s2ws(textPath).c_str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
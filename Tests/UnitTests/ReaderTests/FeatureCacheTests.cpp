@@ -0,0 +1,90 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "../../../Source/Readers/HTKMLFReader/featurecache.h"
+#include <random>
+
+using namespace msra::dbn;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+static const size_t featDim = 13;
+static const size_t chunkFrames[] = {5, 0, 17, 3};
+static const size_t numChunks = sizeof(chunkFrames) / sizeof(*chunkFrames);
+
+static void RandomChunks(std::vector<matrix>& chunks)
+{
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+    for (size_t k = 0; k < numChunks; k++)
+    {
+        chunks.emplace_back(featDim, chunkFrames[k]);
+        for (size_t j = 0; j < chunkFrames[k]; j++)
+            for (size_t i = 0; i < featDim; i++)
+                chunks[k](i, j) = distribution(rng);
+    }
+}
+
+// compares the chunks read back from an open cache with the ones it was built from
+static bool ChunksMatch(const featurecache& cache, const std::vector<matrix>& chunks)
+{
+    for (size_t k = 0; k < numChunks; k++)
+    {
+        matrix frames(cache.featdim(), chunkFrames[k]);
+        cache.readchunk(k, frames);
+        for (size_t j = 0; j < chunkFrames[k]; j++)
+            for (size_t i = 0; i < featDim; i++)
+                if (frames(i, j) != chunks[k](i, j))
+                    return false;
+    }
+    return true;
+}
+
+BOOST_AUTO_TEST_SUITE(FeatureCacheSuite)
+
+// A cache reads back what it was built from, also when two builders (e.g. MPI ranks) write it concurrently,
+// and one of them replaces the file while a reader has it mapped. A different key makes it stale.
+BOOST_AUTO_TEST_CASE(FeatureCacheRoundTrip)
+{
+    const std::wstring path = L"FeatureCacheTests.cache";
+    const uint64_t key = featurecache::hashstring(featurecache::hashinit(), L"utterance list");
+    _wunlink(path.c_str());
+    std::vector<matrix> chunks;
+    RandomChunks(chunks);
+
+    featurecache builder1(path), builder2(path);
+    builder1.beginbuild(numChunks);
+    builder2.beginbuild(numChunks);
+    for (size_t k = 0; k < numChunks; k++)
+    {
+        builder1.writechunk(k, chunks[k]);
+        builder2.writechunk(k, chunks[k]);
+    }
+    builder1.endbuild(key, "USER", 100000);
+
+    featurecache reader(path);
+    BOOST_REQUIRE(reader.open(key, numChunks));
+    builder2.endbuild(key, "USER", 100000);
+    BOOST_CHECK(ChunksMatch(reader, chunks));
+
+    featurecache reader2(path);
+    BOOST_REQUIRE(reader2.open(key, numChunks));
+    BOOST_CHECK_EQUAL(reader2.featkind(), "USER");
+    BOOST_CHECK_EQUAL(reader2.featdim(), featDim);
+    BOOST_CHECK_EQUAL(reader2.sampperiod(), 100000);
+    BOOST_CHECK(ChunksMatch(reader2, chunks));
+
+    featurecache stale(path);
+    BOOST_CHECK(!stale.open(key + 1, numChunks));
+    BOOST_CHECK(!stale.open(key, numChunks + 1));
+
+    reader.open(key + 1, numChunks); // unmap before deleting
+    reader2.open(key + 1, numChunks);
+    _wunlink(path.c_str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
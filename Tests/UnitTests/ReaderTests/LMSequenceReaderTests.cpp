@@ -0,0 +1,125 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "DataReader.h"
+#include <map>
+#include <set>
+
+using namespace Microsoft::MSR::CNTK;
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+static const std::vector<std::string> words = {"<s>", "</s>", "<unk>", "w0", "w1", "w2", "w3", "w4", "w5", "w6", "w7", "w8", "w9"};
+
+// sentences of different lengths, among them single tokens, which have no word to predict, and other short lines
+static const char* text =
+    "<s> w9 w8 w2 w5 </s>\n"
+    "w3\n"
+    "<s> w7 w9 w1 w9 w0 w7 w4 w8 w3 </s>\n"
+    "<s> w7 w8 w8 w7 </s>\n"
+    "</s>\n"
+    "<s> w2 w3 w2 w8 w6 </s>\n"
+    "w4\n"
+    "<s> w0 w1 w2 w9 w0 w4 w0 w4 w7 w9 w6 </s>\n"
+    "<s> w1 </s>\n"
+    "<s> w5 w5 w6 </s>\n"
+    "w1 w2\n"
+    "w6 w5 w7\n";
+
+// (input word, next word) of all samples in the text; the parser skips lines of fewer than three tokens
+static std::multiset<std::pair<size_t, size_t>> ExpectedSamples()
+{
+    std::map<std::string, size_t> ids;
+    for (size_t i = 0; i < words.size(); i++)
+        ids[words[i]] = i;
+    std::multiset<std::pair<size_t, size_t>> samples;
+    for (const auto& line : msra::strfun::split(std::string(text), "\n"))
+    {
+        auto tokens = msra::strfun::split(line, " ");
+        if (tokens.size() < 3)
+            continue;
+        for (size_t i = 0; i + 1 < tokens.size(); i++)
+            samples.insert(std::make_pair(ids[tokens[i]], ids[tokens[i + 1]]));
+    }
+    return samples;
+}
+
+// reads an epoch, and returns the (input word, next word) of all frames that are not gaps
+static std::multiset<std::pair<size_t, size_t>> ReadEpoch(DataReader& reader, size_t epoch)
+{
+    auto features = make_shared<Matrix<float>>(CPUDEVICE);
+    auto labels = make_shared<Matrix<float>>(CPUDEVICE);
+    StreamMinibatchInputs matrices;
+    matrices.AddInputMatrix(L"features", features);
+    matrices.AddInputMatrix(L"labels", labels);
+    auto pMBLayout = make_shared<MBLayout>();
+
+    std::multiset<std::pair<size_t, size_t>> samples;
+    reader.StartMinibatchLoop(4, epoch, requestDataSize);
+    while (reader.GetMinibatch(matrices))
+    {
+        reader.CopyMBLayoutTo(pMBLayout);
+        size_t numSequences = pMBLayout->GetNumParallelSequences();
+        BOOST_REQUIRE_EQUAL(features->GetNumCols(), numSequences * pMBLayout->GetNumTimeSteps());
+        for (size_t t = 0; t < pMBLayout->GetNumTimeSteps(); t++)
+        {
+            for (size_t s = 0; s < numSequences; s++)
+            {
+                if (pMBLayout->IsGap(FrameRange(pMBLayout, t).Sequence(s)))
+                    continue;
+                size_t j = t * numSequences + s, word = SIZE_MAX;
+                for (size_t i = 0; i < features->GetNumRows(); i++)
+                    if ((*features)(i, j) == 1)
+                        word = i;
+                samples.insert(std::make_pair(word, (size_t) (*labels)(0, j)));
+            }
+        }
+        reader.DataEnd();
+    }
+    return samples;
+}
+
+BOOST_AUTO_TEST_SUITE(LMSequenceReaderSuite)
+
+// With bucketByLength, the sentences of a minibatch are of similar length, and the shorter ones are padded with gaps.
+// Every sample must be returned once per epoch, also from the word-id corpus, and sentences of a single token skipped.
+BOOST_AUTO_TEST_CASE(LMSequenceReaderBucketByLength)
+{
+    const std::wstring textPath = L"LMSequenceReaderTests.txt";
+    const std::wstring mappingPath = L"LMSequenceReaderTests.map";
+    const std::wstring corpusPath = L"LMSequenceReaderTests.corpus";
+    FILE* f = fopenOrDie(textPath, L"wb");
+    fputs(text, f);
+    fcloseOrDie(f);
+    f = fopenOrDie(mappingPath, L"wb");
+    for (const auto& word : words)
+        fprintf(f, "%s\n", word.c_str());
+    fcloseOrDie(f);
+    _wunlink(corpusPath.c_str());
+
+    const auto expected = ExpectedSamples();
+    for (bool useWordIdCorpus : {false, true})
+    {
+        ConfigParameters config;
+        config.Parse(msra::strfun::strprintf("readerType=LMSequenceReader\nfile=%ls\nnbruttsineachrecurrentiter=3\nbucketByLength=true\ncacheBlockSize=100\n"
+                                             "%s"
+                                             "features=[\ndim=0\nmode=softmax\n]\n"
+                                             "labelIn=[\nlabelType=category\nlabelDim=%d\nlabelMappingFile=%ls\nbeginSequence=<s>\nendSequence=</s>\n]\n"
+                                             "labels=[\nlabelType=nextWord\nlabelMappingFile=%ls\nbeginSequence=<s>\nendSequence=</s>\n]\n",
+                                             textPath.c_str(), useWordIdCorpus ? msra::strfun::strprintf("wordIdCorpus=%ls\n", corpusPath.c_str()).c_str() : "",
+                                             (int) words.size(), mappingPath.c_str(), mappingPath.c_str()));
+        DataReader reader(config);
+        for (size_t epoch = 0; epoch < 2; epoch++)
+            BOOST_CHECK(ReadEpoch(reader, epoch) == expected);
+    }
+
+    _wunlink(corpusPath.c_str());
+    _wunlink(mappingPath.c_str());
+    _wunlink(textPath.c_str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
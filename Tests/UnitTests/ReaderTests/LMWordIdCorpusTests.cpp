@@ -0,0 +1,107 @@
+//
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE.md file in the project root for full license information.
+//
+#include "stdafx.h"
+#include "../../../Source/Readers/LMSequenceReader/SequenceParser.h"
+
+namespace Microsoft { namespace MSR { namespace CNTK { namespace Test {
+
+static const size_t vocabSize = 10;
+static const std::vector<std::vector<unsigned int>> sentences = {{1, 2, 3}, {4}, {5, 6, 7, 8, 9}, {0, 0}};
+
+static uint64_t HashVocabulary(size_t size)
+{
+    uint64_t hash = LMWordIdCorpus::HashInit();
+    for (size_t i = 0; i < size; i++)
+        hash = LMWordIdCorpus::HashWord(hash, msra::strfun::strprintf("w%d", (int) i));
+    return hash;
+}
+
+static void WriteSentences(LMWordIdCorpus& corpus)
+{
+    for (const auto& sentence : sentences)
+        corpus.WriteSentence(sentence.data(), sentence.size());
+}
+
+// compares the sentences read back from an open corpus with the ones it was compiled from
+static bool SentencesMatch(LMWordIdCorpus& corpus)
+{
+    std::vector<unsigned int> wordIds;
+    std::vector<SentenceInfo> sentenceInfos;
+    corpus.Reset();
+    while (corpus.Read(4, wordIds, sentenceInfos) > 0)
+        ;
+    if (sentenceInfos.size() != sentences.size())
+        return false;
+    for (size_t k = 0; k < sentences.size(); k++)
+    {
+        if (sentenceInfos[k].sLen != sentences[k].size())
+            return false;
+        for (size_t i = 0; i < sentences[k].size(); i++)
+            if (wordIds[sentenceInfos[k].sBegin + i] != sentences[k][i])
+                return false;
+    }
+    return true;
+}
+
+BOOST_AUTO_TEST_SUITE(LMWordIdCorpusSuite)
+
+// A corpus reads back what it was compiled from, also when two writers (e.g. MPI ranks) compile it concurrently,
+// and one of them replaces the file while a reader has it open. A different vocabulary or text file makes it stale.
+BOOST_AUTO_TEST_CASE(LMWordIdCorpusRoundTrip)
+{
+    const std::wstring textPath = L"LMWordIdCorpusTests.txt";
+    const std::wstring path = L"LMWordIdCorpusTests.corpus";
+    _wunlink(path.c_str());
+    FILE* f = fopenOrDie(textPath, L"wb");
+    fputs("w1 w2 w3\nw4\nw5 w6 w7 w8 w9\nw0 w0\n", f);
+    fcloseOrDie(f);
+    const LMWordIdCorpus::Source source(textPath, HashVocabulary(vocabSize));
+
+    LMWordIdCorpus reader;
+    BOOST_CHECK(!reader.Open(path, vocabSize, source));
+
+    LMWordIdCorpus writer1, writer2;
+    writer1.BeginWrite(path, vocabSize, source);
+    writer2.BeginWrite(path, vocabSize, source);
+    WriteSentences(writer1);
+    WriteSentences(writer2);
+    writer1.EndWrite();
+
+    BOOST_REQUIRE(reader.Open(path, vocabSize, source));
+    writer2.EndWrite();
+    BOOST_CHECK_EQUAL(reader.GetNumSentences(), sentences.size());
+    BOOST_CHECK_EQUAL(reader.GetNumTokens(), 11);
+    BOOST_CHECK(SentencesMatch(reader));
+
+    LMWordIdCorpus reader2;
+    BOOST_REQUIRE(reader2.Open(path, vocabSize, source));
+    BOOST_CHECK(SentencesMatch(reader2));
+
+    // an interrupted writer leaves the corpus as it was
+    {
+        LMWordIdCorpus interrupted;
+        interrupted.BeginWrite(path, vocabSize, source);
+        interrupted.WriteSentence(sentences[0].data(), sentences[0].size());
+    }
+    BOOST_REQUIRE(reader2.Open(path, vocabSize, source));
+    BOOST_CHECK(SentencesMatch(reader2));
+
+    LMWordIdCorpus stale;
+    BOOST_CHECK(!stale.Open(path, vocabSize + 1, source));
+    BOOST_CHECK(!stale.Open(path, vocabSize, LMWordIdCorpus::Source(textPath, HashVocabulary(vocabSize - 1))));
+    f = fopenOrDie(textPath, L"ab");
+    fputs("w1\n", f);
+    fcloseOrDie(f);
+    BOOST_CHECK(!stale.Open(path, vocabSize, LMWordIdCorpus::Source(textPath, HashVocabulary(vocabSize))));
+
+    reader.Open(path, vocabSize + 1, source); // close before deleting
+    reader2.Open(path, vocabSize + 1, source);
+    _wunlink(path.c_str());
+    _wunlink(textPath.c_str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}}}}
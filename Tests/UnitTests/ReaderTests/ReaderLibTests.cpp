@@ -8,6 +8,8 @@
 #include "NoRandomizer.h"
 #include "DataDeserializer.h"
 #include "BlockRandomizer.h"
+#include "SequencePacker.h"
+#include "HeapMemoryProvider.h"
 
 using namespace Microsoft::MSR::CNTK;
 
@@ -260,6 +262,139 @@ BOOST_AUTO_TEST_CASE(NoRandomizerOneEpoch)
                                   actual.begin(), actual.end());
 }
 
+// Returns all given sequences of scalar samples in a single call.
+class MockSequenceTransformer : public Transformer
+{
+private:
+    std::vector<std::vector<float>>& m_sequences;
+    StreamDescriptionPtr m_stream;
+    bool m_done;
+
+public:
+    MockSequenceTransformer(std::vector<std::vector<float>>& sequences)
+        : m_sequences(sequences), m_done(false)
+    {
+        m_stream = std::make_shared<StreamDescription>(StreamDescription{
+            L"input",
+            0,
+            StorageType::dense,
+            ElementType::tfloat,
+            std::make_shared<TensorShape>(1)
+        });
+    }
+
+    void Initialize(TransformerPtr, const ConfigParameters&) override {}
+
+    std::vector<StreamDescriptionPtr> GetStreamDescriptions() const override
+    {
+        return std::vector<StreamDescriptionPtr> { m_stream };
+    }
+
+    void StartEpoch(const EpochConfiguration&) override {}
+
+    Sequences GetNextSequences(size_t) override
+    {
+        Sequences result;
+        result.m_endOfEpoch = true;
+        if (m_done)
+        {
+            return result;
+        }
+
+        m_done = true;
+        result.m_data.resize(1);
+        for (auto& sequence : m_sequences)
+        {
+            auto data = std::make_shared<DenseSequenceData>();
+            data->m_data = sequence.data();
+            data->m_numberOfSamples = sequence.size();
+            data->m_sampleLayout = m_stream->m_sampleLayout;
+            result.m_data[0].push_back(data);
+        }
+        return result;
+    }
+};
+
+// Packs sequences of the given lengths (sample t of sequence k has value 10 * k + t + 1),
+// checks that each sequence ends up contiguously in its parallel sequence and that gaps are zero,
+// and returns the packed layout.
+static MBLayoutPtr PackSequences(const std::vector<size_t>& lengths, double& paddingEfficiency)
+{
+    std::vector<std::vector<float>> sequences;
+    for (size_t k = 0; k < lengths.size(); k++)
+    {
+        sequences.push_back(std::vector<float>());
+        for (size_t t = 0; t < lengths[k]; t++)
+        {
+            sequences.back().push_back((float)(10 * k + t + 1));
+        }
+    }
+
+    auto transformer = std::make_shared<MockSequenceTransformer>(sequences);
+    auto packer = std::make_shared<SequencePacker>(std::make_shared<HeapMemoryProvider>(), transformer, 100, transformer->GetStreamDescriptions());
+    Minibatch minibatch = packer->ReadMinibatch();
+    BOOST_REQUIRE_EQUAL(minibatch.m_data.size(), 1);
+
+    auto layout = minibatch.m_data[0]->m_layout;
+    const float* data = reinterpret_cast<const float*>(minibatch.m_data[0]->m_data);
+    BOOST_CHECK_EQUAL(minibatch.m_data[0]->m_dataSize, layout->GetNumCols() * sizeof(float));
+
+    const size_t numParallelSequences = layout->GetNumParallelSequences();
+    std::vector<float> firstSamples;
+    for (const auto& sequence : layout->GetAllSequences())
+    {
+        for (size_t t = (size_t)sequence.tBegin; t < sequence.tEnd; t++)
+        {
+            float value = data[t * numParallelSequences + sequence.s];
+            if (sequence.seqId == GAP_SEQUENCE_ID)
+            {
+                BOOST_CHECK_EQUAL(value, 0.0f);
+            }
+            else
+            {
+                BOOST_CHECK_EQUAL(value, data[sequence.tBegin * numParallelSequences + sequence.s] + (t - sequence.tBegin));
+            }
+        }
+        if (sequence.seqId != GAP_SEQUENCE_ID)
+        {
+            firstSamples.push_back(data[sequence.tBegin * numParallelSequences + sequence.s]);
+        }
+    }
+
+    std::sort(firstSamples.begin(), firstSamples.end());
+    BOOST_REQUIRE_EQUAL(firstSamples.size(), lengths.size());
+    for (size_t k = 0; k < lengths.size(); k++)
+    {
+        BOOST_CHECK_EQUAL(firstSamples[k], (float)(10 * k + 1));
+    }
+
+    BOOST_CHECK(packer->ReadMinibatch().m_data.empty());
+    paddingEfficiency = packer->GetPaddingEfficiency();
+    return layout;
+}
+
+BOOST_AUTO_TEST_CASE(SequencePackerWithoutGaps)
+{
+    // first-fit decreasing: [5], [4 1], [3 2]
+    double paddingEfficiency;
+    auto layout = PackSequences(std::vector<size_t> { 5, 2, 3, 1, 4 }, paddingEfficiency);
+    BOOST_CHECK_EQUAL(layout->GetNumTimeSteps(), 5);
+    BOOST_CHECK_EQUAL(layout->GetNumParallelSequences(), 3);
+    BOOST_CHECK(!layout->HasGaps());
+    BOOST_CHECK_EQUAL(paddingEfficiency, 1.0);
+}
+
+BOOST_AUTO_TEST_CASE(SequencePackerWithGaps)
+{
+    // first-fit decreasing: [4], [3 1], [3]
+    double paddingEfficiency;
+    auto layout = PackSequences(std::vector<size_t> { 3, 1, 4, 3 }, paddingEfficiency);
+    BOOST_CHECK_EQUAL(layout->GetNumTimeSteps(), 4);
+    BOOST_CHECK_EQUAL(layout->GetNumParallelSequences(), 3);
+    BOOST_CHECK(layout->HasGaps());
+    BOOST_CHECK_CLOSE(paddingEfficiency, 11.0 / 12.0, 1e-6);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 } } } }